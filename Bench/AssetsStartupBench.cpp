@@ -0,0 +1,116 @@
+#include "Bench.hpp"
+#include "Common/AssetsPreloader.hpp"
+#include "Common/IdProvider.hpp"
+
+#include <fstream>
+#include <random>
+#include <string>
+
+/*
+    Сканирование медиаресурсов при запуске сервера на сгенерированном каталоге:
+    сырые текстуры и модели со ссылками на них, часть ссылок - на отсутствующие текстуры
+    (идентификаторы им выдаются после параллельного разбора).
+
+    холодный запуск - манифеста нет, всё читается и хешируется;
+    перезапуск      - хеши сырых файлов берутся из манифеста;
+    перезапуск без содержимого - получатель ресурсов не задан, сырые файлы не читаются
+*/
+
+using namespace LV;
+
+namespace {
+
+constexpr size_t TEXTURES = 4000;
+constexpr size_t TEXTURE_BYTES = 16*1024;
+constexpr size_t MODELS = 1000;
+
+void writeFile(const fs::path& path, const std::string& data) {
+    fs::create_directories(path.parent_path());
+    std::ofstream(path, std::ios::binary).write(data.data(), data.size());
+}
+
+fs::path makeAssets() {
+    fs::path root = fs::temp_directory_path() / "luavox_bench_assets";
+    fs::remove_all(root);
+
+    std::mt19937 rng(7);
+    fs::path domain = root / "assets" / "bench";
+    std::string data(TEXTURE_BYTES, '\0');
+    for(size_t index = 0; index < TEXTURES; index++) {
+        for(char& byte : data)
+            byte = char(rng());
+
+        writeFile(domain / "texture" / ("tex_" + std::to_string(index)), data);
+    }
+
+    for(size_t index = 0; index < MODELS; index++) {
+        std::string texture = index % 10 == 0
+            ? "missing_" + std::to_string(index)
+            : "tex_" + std::to_string(index % TEXTURES);
+
+        writeFile(domain / "model" / ("block_" + std::to_string(index) + ".json"),
+            "{\"textures\": {\"all\": \"" + texture + "\", \"side\": \"tex_" + std::to_string((index * 7) % TEXTURES) + "\"}}");
+    }
+
+    return root;
+}
+
+struct Run {
+    double Seconds;
+    std::array<std::vector<IdProvider<EnumAssets>::BindDomainKeyInfo>, size_t(EnumAssets::MAX_ENUM)> Ids;
+};
+
+Run scan(const fs::path& root, bool needContent) {
+    IdProvider<EnumAssets> ids;
+    AssetsPreloader preloader;
+    preloader.setManifestPath(root / "assets_manifest.bin");
+
+    AssetsPreloader::AssetsRegister instances;
+    instances.Assets.push_back(root);
+
+    size_t bytes = 0;
+    std::function<void(std::u8string&&, ResourceFile::Hash_t, fs::path)> onParsed;
+    if(needContent)
+        onParsed = [&](std::u8string&& resource, ResourceFile::Hash_t, fs::path) { bytes += resource.size(); };
+
+    Bench::Clock::time_point start = Bench::Clock::now();
+    AssetsPreloader::Out_checkAndPrepareResourcesUpdate out = preloader.checkAndPrepareResourcesUpdate(instances,
+        [&](EnumAssets type, std::string_view domain, std::string_view key) { return ids.getId(type, domain, key); },
+        onParsed);
+    preloader.applyResourcesUpdate(out);
+    double seconds = Bench::secondsSince(start);
+
+    Bench::keep(bytes);
+    return {seconds, ids.bake()};
+}
+
+}
+
+int main() {
+    fs::path root = makeAssets();
+    const double files = double(TEXTURES + MODELS);
+    const double mb = double(TEXTURES * TEXTURE_BYTES) / (1024*1024);
+
+    Run cold = scan(root, true);
+    Bench::report("холодный запуск, файлов", files / cold.Seconds, "1/с");
+    Bench::report("холодный запуск, сырых данных", mb / cold.Seconds, "МБ/с");
+
+    Run warm = scan(root, true);
+    Bench::report("перезапуск, файлов", files / warm.Seconds, "1/с");
+
+    Run headless = scan(root, false);
+    Bench::report("перезапуск без содержимого, файлов", files / headless.Seconds, "1/с");
+
+    // Идентификаторы не должны зависеть от того, в каком порядке потоки разобрали ресурсы
+    bool same = true;
+    for(size_t type = 0; type < size_t(EnumAssets::MAX_ENUM); type++) {
+        const auto &a = cold.Ids[type], &b = warm.Ids[type];
+        same &= a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+            [](const auto& x, const auto& y) { return x.Domain == y.Domain && x.Key == y.Key; });
+    }
+
+    Bench::report("идентификаторы совпадают между запусками", same ? 1 : 0, "");
+
+    fs::remove_all(root);
+    return same ? 0 : 1;
+}
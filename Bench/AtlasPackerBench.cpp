@@ -0,0 +1,145 @@
+#include "Bench.hpp"
+#include "Client/Vulkan/AtlasPipeline/AtlasPacker.hpp"
+
+#include <random>
+#include <string>
+
+/*
+    Упаковщики слоёв атласа без Vulkan: заполнение слоёв текстурами блоков,
+    перезаполнение после удалений и расселение почти пустого слоя, как это делает
+    частичный репак (RepackMode::Incremental) после удаления ресурсов
+*/
+
+using namespace AtlasPacking;
+
+namespace {
+
+constexpr uint32_t SIDE = 2048;
+constexpr uint32_t LAYERS = 4;
+// Поля вокруг текстуры как у атласа с PaddingPx = 2
+constexpr uint32_t PADDING = 4;
+
+struct Placed {
+    Rect Place;
+    uint32_t Layer;
+};
+
+// Размеры как у текстур блоков: в основном 16, реже 32 и 64
+uint32_t randomSide(std::mt19937& rng) {
+    uint32_t roll = rng() % 16;
+    return (roll < 12 ? 16 : roll < 15 ? 32 : 64) + PADDING;
+}
+
+// Вставляет в первый слой, где нашлось место
+bool insert(std::vector<LayerPacker>& layers, std::vector<Placed>& placed, uint32_t w, uint32_t h) {
+    for(uint32_t layer = 0; layer < layers.size(); layer++) {
+        if(auto rect = layers[layer].insert(w, h)) {
+            placed.push_back({*rect, layer});
+            return true;
+        }
+    }
+
+    return false;
+}
+
+double fillShare(const std::vector<Placed>& placed) {
+    uint64_t used = 0;
+    for(const Placed& item : placed)
+        used += uint64_t(item.Place.W) * item.Place.H;
+
+    return double(used) / (double(SIDE) * SIDE * LAYERS);
+}
+
+void run(AtlasPacker kind, std::string_view name) {
+    std::mt19937 rng(11);
+    std::vector<LayerPacker> layers(LAYERS);
+    for(LayerPacker& layer : layers)
+        layer.reset(kind, SIDE, SIDE);
+
+    std::vector<Placed> placed;
+    std::string prefix(name);
+
+    // Заполнение до первого отказа
+    {
+        LV::Bench::Clock::time_point start = LV::Bench::Clock::now();
+        while(true) {
+            uint32_t side = randomSide(rng);
+            if(!insert(layers, placed, side, side))
+                break;
+        }
+
+        double seconds = LV::Bench::secondsSince(start);
+        LV::Bench::report(prefix + " заполнение", placed.size() / seconds / 1e3, "тыс. вставок/с");
+        LV::Bench::report(prefix + " заполнено", fillShare(placed) * 100, "%");
+    }
+
+    // Удаление половины случайных текстур и дозаполнение
+    {
+        std::shuffle(placed.begin(), placed.end(), rng);
+        size_t removed = placed.size() / 2;
+
+        LV::Bench::Clock::time_point start = LV::Bench::Clock::now();
+        for(size_t iter = 0; iter < removed; iter++) {
+            const Placed& item = placed.back();
+            layers[item.Layer].free(item.Place);
+            placed.pop_back();
+        }
+
+        size_t inserted = 0;
+        while(true) {
+            uint32_t side = randomSide(rng);
+            if(!insert(layers, placed, side, side))
+                break;
+
+            inserted++;
+        }
+
+        double seconds = LV::Bench::secondsSince(start);
+        LV::Bench::report(prefix + " перезаполнение", (removed + inserted) / seconds / 1e3, "тыс. операций/с");
+        LV::Bench::report(prefix + " заполнено после перезаполнения", fillShare(placed) * 100, "%");
+    }
+
+    // В последнем слое остаётся десятая часть, остальные слои освобождаются наполовину,
+    // затем последний слой расселяется по остальным
+    {
+        uint32_t source = LAYERS - 1;
+        std::vector<Placed> kept, moving;
+        size_t counter = 0;
+        for(const Placed& item : placed) {
+            bool drop = item.Layer == source ? counter % 10 != 0 : counter % 2 != 0;
+            counter++;
+
+            if(drop)
+                layers[item.Layer].free(item.Place);
+            else if(item.Layer == source)
+                moving.push_back(item);
+            else
+                kept.push_back(item);
+        }
+
+        size_t moved = 0;
+        LV::Bench::Clock::time_point start = LV::Bench::Clock::now();
+        for(const Placed& item : moving) {
+            for(uint32_t layer = 0; layer < source; layer++) {
+                if(auto rect = layers[layer].insert(item.Place.W, item.Place.H)) {
+                    layers[source].free(item.Place);
+                    kept.push_back({*rect, layer});
+                    moved++;
+                    break;
+                }
+            }
+        }
+
+        double seconds = LV::Bench::secondsSince(start);
+        LV::Bench::report(prefix + " расселение слоя", moving.empty() ? 0 : moved / seconds / 1e3, "тыс. переносов/с");
+        LV::Bench::report(prefix + " перенесено", moving.empty() ? 100 : double(moved) / moving.size() * 100, "%");
+        LV::Bench::keep(kept.size());
+    }
+}
+
+}
+
+int main() {
+    run(AtlasPacker::MaxRects, "MaxRects");
+    run(AtlasPacker::Skyline, "Skyline");
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+
+namespace LV::Bench {
+
+/*
+    Общие мелочи для замеров: таймер, запуск на нескольких потоках и вывод строки результата.
+    Каждый замер печатает строки вида "имя: значение единица", чтобы их было удобно сравнивать между сборками
+*/
+
+using Clock = std::chrono::steady_clock;
+
+inline double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Исполняет body(index) на threads потоках с общим стартом, возвращает время до завершения последнего
+template<typename Body>
+double runThreads(size_t threads, Body&& body) {
+    std::vector<std::jthread> pool;
+    pool.reserve(threads);
+    std::atomic<bool> go = false;
+
+    for(size_t index = 0; index < threads; index++)
+        pool.emplace_back([&, index]() {
+            while(!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+
+            body(index);
+        });
+
+    Clock::time_point start = Clock::now();
+    go.store(true, std::memory_order_release);
+    pool.clear();
+    return secondsSince(start);
+}
+
+inline void report(std::string_view name, double value, std::string_view unit) {
+    std::printf("%.*s: %.3f %.*s\n", int(name.size()), name.data(), value, int(unit.size()), unit.data());
+}
+
+// Не даёт компилятору выбросить результат замера
+template<typename T>
+inline void keep(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Потоки для замеров масштабирования: 1, 2, 4 ... до числа ядер
+inline std::vector<size_t> threadSteps() {
+    size_t hw = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    std::vector<size_t> steps;
+    for(size_t count = 1; count < hw; count *= 2)
+        steps.push_back(count);
+
+    steps.push_back(hw);
+    return steps;
+}
+
+}
@@ -0,0 +1,115 @@
+#include "Bench.hpp"
+#include "Client/Vulkan/VulkanRenderSession.hpp"
+
+#include <cmath>
+#include <random>
+#include <string>
+#include <thread>
+
+/*
+    Верширование чанков без окна и устройства: ChunkMeshGenerator получает поддельную
+    сессию с регионами холмистой местности и пещер и строит меши без моделей нод (кубоиды).
+    Замеряется пропускная способность на разном числе потоков и повтор тех же чанков из кеша мешей
+*/
+
+using namespace LV;
+using namespace LV::Client;
+using namespace LV::Client::VK;
+
+namespace {
+
+constexpr int REGIONS_XZ = 4, REGIONS_Y = 2;
+constexpr int CHUNKS_XZ = REGIONS_XZ * 4, CHUNKS_Y = REGIONS_Y * 4;
+constexpr WorldId_t WORLD = 0;
+
+class BenchSession : public IServerSession {
+public:
+    void update(GlobalTime, float) override {}
+};
+
+void generate(BenchSession& session) {
+    std::mt19937 rng(41);
+    WorldInfo& world = session.Content.Worlds[WORLD];
+
+    for(int rx = 0; rx < REGIONS_XZ; rx++)
+        for(int ry = 0; ry < REGIONS_Y; ry++)
+            for(int rz = 0; rz < REGIONS_XZ; rz++) {
+                Region& region = world.Regions[Pos::GlobalRegion(rx, ry, rz)];
+
+                for(int cx = 0; cx < 4; cx++)
+                    for(int cy = 0; cy < 4; cy++)
+                        for(int cz = 0; cz < 4; cz++) {
+                            Chunk& chunk = region.Chunks[Pos::bvec4u(cx, cy, cz).pack()];
+
+                            for(int z = 0; z < 16; z++)
+                                for(int x = 0; x < 16; x++) {
+                                    int gx = (rx*4 + cx)*16 + x, gz = (rz*4 + cz)*16 + z;
+                                    // Холмы вокруг середины высоты мира
+                                    int height = CHUNKS_Y*8 + int(12*std::sin(gx*0.05f) + 12*std::cos(gz*0.07f));
+
+                                    for(int y = 0; y < 16; y++) {
+                                        int gy = (ry*4 + cy)*16 + y;
+                                        Node& node = chunk.Nodes[x + y*16 + z*256];
+                                        // Редкие пустоты под поверхностью дают открытые грани внутри толщи
+                                        bool solid = gy < height && rng() % 16;
+                                        node.NodeId = solid ? 1 + (gy < height - 4) : 0;
+                                        node.Meta = 0;
+                                    }
+                                }
+                        }
+            }
+}
+
+// Отдаёт все чанки генератору и ждёт готовые меши, возвращает секунды и число вершин
+std::pair<double, size_t> meshAll(ChunkMeshGenerator& generator) {
+    std::vector<std::tuple<WorldId_t, Pos::GlobalChunk, uint32_t>> requests;
+    for(int x = 0; x < CHUNKS_XZ; x++)
+        for(int y = 0; y < CHUNKS_Y; y++)
+            for(int z = 0; z < CHUNKS_XZ; z++)
+                requests.emplace_back(WORLD, Pos::GlobalChunk(x, y, z), uint32_t(requests.size()));
+
+    size_t total = requests.size(), done = 0, vertexs = 0;
+
+    LV::Bench::Clock::time_point start = LV::Bench::Clock::now();
+    generator.Input.push_range(std::move(requests));
+
+    while(done < total) {
+        size_t got = generator.Output.consumeAll([&](ChunkMeshGenerator::ChunkObj_t&& chunk) {
+            vertexs += chunk.NodeVertexs.size();
+        });
+
+        done += got;
+        if(!got)
+            std::this_thread::yield();
+    }
+
+    return {LV::Bench::secondsSince(start), vertexs};
+}
+
+}
+
+int main() {
+    BenchSession session;
+    generate(session);
+
+    const size_t chunks = size_t(CHUNKS_XZ) * CHUNKS_Y * CHUNKS_XZ;
+    ChunkMeshGenerator generator(&session);
+
+    for(size_t threads : LV::Bench::threadSteps()) {
+        generator.changeThreadsCount(uint8_t(std::min<size_t>(threads, 255)));
+        generator.invalidateMeshCache();
+
+        auto [seconds, vertexs] = meshAll(generator);
+        LV::Bench::report("верширование, потоков " + std::to_string(threads), chunks / seconds, "чанков/с");
+        LV::Bench::keep(vertexs);
+    }
+
+    // Те же чанки ещё раз: содержимое уже встречалось, меши берутся из кеша
+    {
+        auto [seconds, vertexs] = meshAll(generator);
+        LV::Bench::report("повтор из кеша мешей", chunks / seconds, "чанков/с");
+        LV::Bench::keep(vertexs);
+    }
+
+    generator.changeThreadsCount(0);
+}
@@ -0,0 +1,125 @@
+#include "Bench.hpp"
+#include "Client/Vulkan/ChunkVisibility.hpp"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+    Отсечение пещер без окна: связность сторон чанков считается на подземном мире
+    из шумовых пещер, затем от чанка игрока идёт тот же обход, что и в
+    VulkanRenderSession (traverseChunkVisibility), но без пирамиды видимости
+*/
+
+using namespace LV::Client::VK;
+
+namespace {
+
+constexpr int SIDE_X = 16, SIDE_Y = 8, SIDE_Z = 16;
+constexpr int CHUNKS = SIDE_X * SIDE_Y * SIDE_Z;
+
+// Сглаженный решётчатый шум, пещеры там, где значение выше порога
+struct CaveNoise {
+    static constexpr int CELL = 8;
+    uint32_t Seed;
+
+    float lattice(int x, int y, int z) const {
+        uint32_t h = uint32_t(x) * 0x8da6b343u ^ uint32_t(y) * 0xd8163841u ^ uint32_t(z) * 0xcb1ab31fu ^ Seed;
+        h ^= h >> 13;
+        h *= 0x5bd1e995u;
+        h ^= h >> 15;
+        return float(h & 0xffff) / 65535.f;
+    }
+
+    float operator()(int x, int y, int z) const {
+        int cx = x / CELL, cy = y / CELL, cz = z / CELL;
+        float fx = float(x % CELL) / CELL, fy = float(y % CELL) / CELL, fz = float(z % CELL) / CELL;
+
+        auto lerp = [](float a, float b, float t) { return a + (b - a) * t; };
+        float v[2][2];
+        for(int dy = 0; dy < 2; dy++)
+            for(int dz = 0; dz < 2; dz++)
+                v[dy][dz] = lerp(lattice(cx, cy+dy, cz+dz), lattice(cx+1, cy+dy, cz+dz), fx);
+
+        return lerp(lerp(v[0][0], v[0][1], fz), lerp(v[1][0], v[1][1], fz), fy);
+    }
+};
+
+using FullMap = uint8_t[18][18][18];
+
+void fillChunk(FullMap& full, const CaveNoise& noise, float threshold, int chunkX, int chunkY, int chunkZ) {
+    std::memset(full, 1, sizeof(FullMap));
+    for(int x = 0; x < 16; x++)
+        for(int y = 0; y < 16; y++)
+            for(int z = 0; z < 16; z++)
+                full[x+1][y+1][z+1] = noise(chunkX*16 + x, chunkY*16 + y, chunkZ*16 + z) < threshold;
+}
+
+// Число чанков, до которых доходит обход
+int traverse(const std::vector<uint16_t>& connectivity, int start, bool occlusion) {
+    static std::vector<uint8_t> visited;
+    static std::vector<ChunkVisibilityStep> queue;
+
+    traverseChunkVisibility(SIDE_X, SIDE_Y, SIDE_Z, start, occlusion, visited, queue,
+        [&](const ChunkVisibilityStep& step, int, int, int) -> std::optional<uint16_t> { return connectivity[step.Index]; });
+
+    return int(queue.size());
+}
+
+}
+
+int main() {
+    static FullMap full;
+
+    // Связность на крайних случаях: пустой, сплошной и пещерный чанк
+    {
+        CaveNoise noise{7};
+        struct Case { const char* Name; float Threshold; } cases[] = {
+            {"воздух", -1.f}, {"камень", 2.f}, {"пещеры", 0.7f}
+        };
+
+        for(const Case& test : cases) {
+            fillChunk(full, noise, test.Threshold, 0, 0, 0);
+
+            constexpr int REPEATS = 2000;
+            LV::Bench::Clock::time_point start = LV::Bench::Clock::now();
+            for(int iter = 0; iter < REPEATS; iter++)
+                LV::Bench::keep(computeChunkFaceConnectivity(full));
+
+            double seconds = LV::Bench::secondsSince(start);
+            LV::Bench::report(std::string("связность, ") + test.Name, REPEATS / seconds / 1e3, "тыс. чанков/с");
+        }
+    }
+
+    // Подземный мир: чем реже пещеры, тем больше отсекает обход
+    for(float threshold : {0.75f, 0.7f, 0.6f}) {
+        CaveNoise noise{11};
+        std::vector<uint16_t> connectivity(CHUNKS);
+
+        LV::Bench::Clock::time_point start = LV::Bench::Clock::now();
+        for(int z = 0; z < SIDE_Z; z++)
+            for(int y = 0; y < SIDE_Y; y++)
+                for(int x = 0; x < SIDE_X; x++) {
+                    fillChunk(full, noise, threshold, x, y, z);
+                    connectivity[x + (y + z * SIDE_Y) * SIDE_X] = computeChunkFaceConnectivity(full);
+                }
+
+        double buildSeconds = LV::Bench::secondsSince(start);
+
+        int startChunk = SIDE_X / 2 + (SIDE_Y / 2 + SIDE_Z / 2 * SIDE_Y) * SIDE_X;
+        constexpr int TRAVERSALS = 200;
+        int reached = 0;
+
+        start = LV::Bench::Clock::now();
+        for(int iter = 0; iter < TRAVERSALS; iter++)
+            reached = traverse(connectivity, startChunk, true);
+
+        double traverseSeconds = LV::Bench::secondsSince(start);
+        int all = traverse(connectivity, startChunk, false);
+
+        std::string prefix = "пещеры, порог " + std::to_string(threshold).substr(0, 4);
+        LV::Bench::report(prefix + " шум и связность мира", CHUNKS / buildSeconds / 1e3, "тыс. чанков/с");
+        LV::Bench::report(prefix + " обход", traverseSeconds / TRAVERSALS * 1e6, "мкс");
+        LV::Bench::report(prefix + " отсечено", double(all - reached) / all * 100, "% чанков");
+    }
+}
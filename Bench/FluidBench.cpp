@@ -0,0 +1,122 @@
+#include "Bench.hpp"
+#include "Server/World.hpp"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+    Течение жидкостей без сервера: FluidSimulator над регионами 2x1x2 с каменным дном.
+    Прорыв плотины - куб воды в углу растекается по дну, замеряются такты до покоя
+    при разном бюджете нод за такт. Спокойное озеро - загрузка регионов с ровной гладью
+    и холостые такты, которые должны ничего не стоить.
+    Изменения пишутся прямо в регионы, свет и рассылка здесь не участвуют
+*/
+
+using namespace LV;
+using namespace LV::Server;
+
+namespace {
+
+using Regions = std::unordered_map<Pos::GlobalRegion, std::unique_ptr<Region>>;
+
+constexpr DefNodeId STONE = 1, WATER = 2;
+constexpr int REGIONS_X = 2, REGIONS_Z = 2;
+constexpr int MAX_STEPS = 5000;
+
+const std::vector<NodeFluidInfo> FluidTable = {{0}, {0}, {1}};
+
+Node& nodeAt(Regions& regions, Pos::GlobalNode pos) {
+    Pos::bvec4u cPos = (pos >> 4) & 0x3;
+    Pos::bvec16u nPos = pos & 0xf;
+    return regions.at(pos >> 6)->Nodes[cPos.pack()][nPos.pack()];
+}
+
+// Каменное дно и вода в заданном объёме, остальное воздух
+void build(Regions& regions, int waterX, int waterY, int waterZ) {
+    regions.clear();
+    for(int rx = 0; rx < REGIONS_X; rx++)
+        for(int rz = 0; rz < REGIONS_Z; rz++)
+            regions[Pos::GlobalRegion(rx, 0, rz)] = std::make_unique<Region>();
+
+    for(int x = 0; x < REGIONS_X*64; x++)
+        for(int z = 0; z < REGIONS_Z*64; z++) {
+            nodeAt(regions, Pos::GlobalNode(x, 0, z)).NodeId = STONE;
+
+            if(x < waterX && z < waterZ)
+                for(int y = 1; y <= waterY; y++)
+                    nodeAt(regions, Pos::GlobalNode(x, y, z)) = FluidSimulator::makeFluid(WATER, FluidSimulator::MAX_LEVEL);
+        }
+}
+
+// Загружает регионы в симулятор, возвращает секунды
+double load(FluidSimulator& fluids, const Regions& regions) {
+    Bench::Clock::time_point start = Bench::Clock::now();
+    for(const auto& [rPos, region] : regions)
+        fluids.onRegionLoaded(rPos);
+
+    return Bench::secondsSince(start);
+}
+
+}
+
+int main() {
+    Regions regions;
+
+    // Прорыв плотины: 32x32x32 полных нод
+    for(uint32_t budget : {FluidSimulator::DEFAULT_BUDGET, 4u * FluidSimulator::DEFAULT_BUDGET, 1u << 20}) {
+        build(regions, 32, 32, 32);
+
+        FluidSimulator fluids(regions);
+        fluids.setFluidTable(&FluidTable);
+        fluids.setBudget(budget);
+        load(fluids, regions);
+
+        size_t changes = 0, peakActive = 0;
+        FluidSimulator::SetNode setNode = [&](Pos::GlobalNode pos, Node node) {
+            Node& current = nodeAt(regions, pos);
+            if(current.Data == node.Data)
+                return;
+
+            current = node;
+            changes++;
+            fluids.onNodeChanged(pos);
+        };
+
+        int steps = 0;
+        Bench::Clock::time_point start = Bench::Clock::now();
+        for(; steps < MAX_STEPS && fluids.activeCount(); steps++) {
+            fluids.step(setNode);
+            peakActive = std::max(peakActive, fluids.activeCount());
+        }
+
+        double seconds = Bench::secondsSince(start);
+        std::string prefix = "плотина, бюджет " + std::to_string(budget);
+        Bench::report(prefix + " такт", seconds / std::max(steps, 1) * 1e3, "мс");
+        Bench::report(prefix + " изменения нод", changes / seconds / 1e6, "млн/с");
+        Bench::report(prefix + " до покоя", steps, fluids.activeCount() ? "тактов (не успокоилась)" : "тактов");
+        Bench::report(prefix + " наибольшее активных", peakActive, "нод");
+    }
+
+    // Спокойное озеро глубиной 16 на всех регионах
+    {
+        build(regions, REGIONS_X*64, 16, REGIONS_Z*64);
+
+        FluidSimulator fluids(regions);
+        fluids.setFluidTable(&FluidTable);
+        double loadSeconds = load(fluids, regions);
+
+        constexpr int IDLE_STEPS = 1000;
+        size_t changes = 0;
+        Bench::Clock::time_point start = Bench::Clock::now();
+        for(int step = 0; step < IDLE_STEPS; step++)
+            fluids.step([&](Pos::GlobalNode, Node) { changes++; });
+
+        double seconds = Bench::secondsSince(start);
+        Bench::report("озеро, загрузка региона", loadSeconds / regions.size() * 1e3, "мс");
+        Bench::report("озеро, активных после загрузки", fluids.activeCount(), "нод");
+        Bench::report("озеро, холостой такт", seconds / IDLE_STEPS * 1e6, "мкс");
+        Bench::keep(changes);
+    }
+}
@@ -0,0 +1,98 @@
+#include "Bench.hpp"
+#include "Common/IdProvider.hpp"
+
+#include <string>
+
+/*
+    Поиск идентификаторов по (домен, ключ) и обратно из нескольких потоков.
+    Сравниваются опубликованные bake() таблицы и путь через шарды под shared_mutex,
+    которым идут идентификаторы, выданные после последнего bake()
+*/
+
+using namespace LV;
+
+namespace {
+
+constexpr size_t KEYS = 4096;
+constexpr size_t LOOKUPS_PER_THREAD = 1 << 20;
+
+std::vector<std::string> makeKeys() {
+    std::vector<std::string> keys;
+    keys.reserve(KEYS);
+    for(size_t index = 0; index < KEYS; index++)
+        keys.push_back("block/texture_" + std::to_string(index));
+
+    return keys;
+}
+
+void measure(const char* label, IdProvider<EnumAssets>& provider, const std::vector<std::string>& keys) {
+    for(size_t threads : Bench::threadSteps()) {
+        double seconds = Bench::runThreads(threads, [&](size_t index) {
+            ResourceId sum = 0;
+            for(size_t iter = 0; iter < LOOKUPS_PER_THREAD; iter++) {
+                const std::string& key = keys[(iter * 7 + index * 131) % KEYS];
+                ResourceId id = provider.getId(EnumAssets::Texture, "core", key);
+                if((iter & 15) == 0)
+                    sum += provider.getDK(EnumAssets::Texture, id)->Key.size();
+
+                sum += id;
+            }
+
+            Bench::keep(sum);
+        });
+
+        std::string name = std::string(label) + ", потоков " + std::to_string(threads);
+        Bench::report(name, double(threads * LOOKUPS_PER_THREAD) / seconds / 1e6, "млн/с");
+    }
+}
+
+}
+
+int main() {
+    std::vector<std::string> keys = makeKeys();
+
+    {
+        IdProvider<EnumAssets> provider;
+        for(const std::string& key : keys)
+            provider.getId(EnumAssets::Texture, "core", key);
+
+        measure("getId без bake()", provider, keys);
+    }
+
+    {
+        IdProvider<EnumAssets> provider;
+        for(const std::string& key : keys)
+            provider.getId(EnumAssets::Texture, "core", key);
+
+        provider.bake();
+        measure("getId после bake()", provider, keys);
+    }
+
+#ifdef NDEBUG
+    // В отладочной сборке bake() одновременно с getId() запрещён проверкой
+    {
+        // Перепубликация под нагрузкой: заменённые таблицы должны освобождаться по ходу работы
+        IdProvider<EnumAssets> provider;
+        for(const std::string& key : keys)
+            provider.getId(EnumAssets::Texture, "core", key);
+
+        provider.bake();
+
+        std::atomic<bool> stop = false;
+        std::jthread baker([&]() {
+            for(size_t iter = 0; !stop.load(std::memory_order_relaxed); iter++) {
+                provider.getId(EnumAssets::Texture, "mod", std::to_string(iter));
+                provider.bake();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+
+        measure("getId при bake() раз в 1 мс", provider, keys);
+        stop = true;
+        baker.join();
+        Bench::report("не освобождено копий таблиц", double(provider.reclaim()), "шт");
+    }
+#endif
+
+    return 0;
+}
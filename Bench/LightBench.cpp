@@ -0,0 +1,166 @@
+#include "Bench.hpp"
+#include "Server/World.hpp"
+
+#include <cmath>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+    Освещение нод: полный расчёт региона (computeRegion, как в пуле потоков сервера)
+    и задержка инкрементального обновления после одной правки.
+    Местность - холмы с пещерами и факелами, 3x2x3 региона со сшитым светом.
+    Правки идут в середине: факел в пещере ставится и снимается (распространение
+    и удаление источника), блок над землёй ставится и убирается (тень неба)
+*/
+
+using namespace LV;
+using namespace LV::Server;
+
+namespace {
+
+using Regions = std::unordered_map<Pos::GlobalRegion, std::unique_ptr<Region>>;
+
+constexpr DefNodeId STONE = 1, TORCH = 2;
+constexpr int SIDE = 3, LAYERS = 2;
+constexpr int EDITS = 500;
+
+const std::vector<NodeLightInfo> LightTable = {{0, 0}, {0, 15}, {14, 0}};
+
+int surface(int x, int z) {
+    return 80 + int(8*std::sin(x*0.06f) + 6*std::cos(z*0.05f));
+}
+
+// Пещеры - шары в толще, с редкими факелами
+bool cave(int x, int y, int z) {
+    uint32_t h = uint32_t(x >> 3) * 0x8da6b343u ^ uint32_t(y >> 3) * 0xd8163841u ^ uint32_t(z >> 3) * 0xcb1ab31fu;
+    h ^= h >> 13;
+    h *= 0x5bd1e995u;
+    h ^= h >> 15;
+    if(h % 3)
+        return false;
+
+    int dx = (x & 7) - 4, dy = (y & 7) - 4, dz = (z & 7) - 4;
+    return dx*dx + dy*dy + dz*dz < 14;
+}
+
+Node& nodeAt(Regions& regions, Pos::GlobalNode pos) {
+    Pos::bvec4u cPos = (pos >> 4) & 0x3;
+    Pos::bvec16u nPos = pos & 0xf;
+    return regions.at(pos >> 6)->Nodes[cPos.pack()][nPos.pack()];
+}
+
+void generate(Region& region, Pos::GlobalRegion rPos) {
+    for(int x = 0; x < 64; x++)
+        for(int z = 0; z < 64; z++) {
+            int gx = rPos.x*64 + x, gz = rPos.z*64 + z;
+            int height = surface(gx, gz);
+
+            for(int y = 0; y < 64; y++) {
+                int gy = rPos.y*64 + y;
+                Node node;
+                node.Data = 0;
+
+                if(gy < height && !(gy < height - 4 && cave(gx, gy, gz)))
+                    node.NodeId = STONE;
+                else if(gy < height && (gx*31 + gy*17 + gz*7) % 97 == 0)
+                    node.NodeId = TORCH;
+
+                region.Nodes[Pos::bvec4u(x >> 4, y >> 4, z >> 4).pack()][(x & 15) + (y & 15)*16 + (z & 15)*256] = node;
+            }
+        }
+}
+
+// Правка ноды с обновлением света, возвращает секунды
+double edit(Regions& regions, LightEngine& engine, Pos::GlobalNode pos, DefNodeId id) {
+    Bench::Clock::time_point start = Bench::Clock::now();
+    nodeAt(regions, pos).NodeId = id;
+    engine.onNodeChanged(pos);
+    engine.update();
+    return Bench::secondsSince(start);
+}
+
+void reportEdits(const std::string& name, const std::vector<double>& seconds) {
+    double sum = 0, worst = 0;
+    for(double value : seconds) {
+        sum += value;
+        worst = std::max(worst, value);
+    }
+
+    Bench::report(name + ", среднее", sum / seconds.size() * 1e6, "мкс");
+    Bench::report(name + ", худшее", worst * 1e6, "мкс");
+}
+
+}
+
+int main() {
+    Regions regions;
+    for(int x = 0; x < SIDE; x++)
+        for(int y = 0; y < LAYERS; y++)
+            for(int z = 0; z < SIDE; z++) {
+                Pos::GlobalRegion rPos(x, y, z);
+                generate(*(regions[rPos] = std::make_unique<Region>()), rPos);
+            }
+
+    // Полный расчёт: каждый регион как отдельное задание пула
+    std::unordered_map<Pos::GlobalRegion, std::unique_ptr<RegionLight>> computed;
+    {
+        Bench::Clock::time_point start = Bench::Clock::now();
+        for(auto& [rPos, region] : regions) {
+            std::unique_ptr<RegionLight>& light = computed[rPos] = std::make_unique<RegionLight>();
+            LightEngine::computeRegion(region->Nodes, &LightTable, *light);
+        }
+
+        double seconds = Bench::secondsSince(start);
+        Bench::report("расчёт региона", seconds / regions.size() * 1e3, "мс");
+    }
+
+    LightEngine engine(regions);
+    engine.setNodeTable(&LightTable);
+
+    {
+        Bench::Clock::time_point start = Bench::Clock::now();
+        for(auto& [rPos, light] : computed)
+            engine.installRegion(rPos, *light);
+
+        engine.update();
+        double seconds = Bench::secondsSince(start);
+        Bench::report("установка и сшивка региона", seconds / regions.size() * 1e3, "мс");
+    }
+
+    std::mt19937 rng(39);
+    const int base = 64, span = 64;
+
+    // Факелы в воздухе пещер среднего региона
+    {
+        std::vector<double> place, remove;
+        while(int(place.size()) < EDITS) {
+            Pos::GlobalNode pos(base + int(rng() % span), int(rng() % 128), base + int(rng() % span));
+            if(pos.y >= surface(pos.x, pos.z) - 4 || nodeAt(regions, pos).NodeId != 0)
+                continue;
+
+            place.push_back(edit(regions, engine, pos, TORCH));
+            remove.push_back(edit(regions, engine, pos, 0));
+        }
+
+        reportEdits("факел в пещере, установка", place);
+        reportEdits("факел в пещере, снятие", remove);
+    }
+
+    // Блок над землёй отбрасывает тень неба вниз до поверхности
+    {
+        std::vector<double> place, remove;
+        for(int iter = 0; iter < EDITS; iter++) {
+            int x = base + int(rng() % span), z = base + int(rng() % span);
+            Pos::GlobalNode pos(x, surface(x, z) + 4, z);
+
+            place.push_back(edit(regions, engine, pos, STONE));
+            remove.push_back(edit(regions, engine, pos, 0));
+        }
+
+        reportEdits("блок над землёй, установка", place);
+        reportEdits("блок над землёй, снятие", remove);
+    }
+}
@@ -0,0 +1,138 @@
+#include "Bench.hpp"
+#include "Server/NodeTickScheduler.hpp"
+
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+    Колесо таймеров тактов нод: 100 тыс. ожидающих тактов на 64 регионах.
+    Задержки покрывают все уровни колеса и переполнение, как у ростков (долгие) и механизмов (короткие).
+    Замеряются планирование, отмена, разбор тактов и установившийся режим,
+    где каждая сработавшая нода планирует себя снова
+*/
+
+using namespace LV;
+using namespace LV::Server;
+
+namespace {
+
+constexpr size_t PENDING = 100000;
+constexpr int STEADY_TICKS = 20000;
+
+// Задержка в тактах: в основном короткие, часть на старших уровнях и за пределами колеса
+uint32_t tickDelay(std::mt19937& rng) {
+    switch(rng() % 8) {
+    case 0: return 1 + rng() % (1u << 24);
+    case 1:
+    case 2: return 1 + rng() % (1u << 14);
+    default: return 1 + rng() % 256;
+    }
+}
+
+std::vector<Pos::GlobalNode> makePositions(std::mt19937& rng) {
+    std::vector<Pos::GlobalNode> positions;
+    positions.reserve(PENDING);
+
+    // Регионы 4x4x4, совпавшая позиция просто не планируется второй раз
+    for(size_t iter = 0; iter < PENDING; iter++)
+        positions.push_back(Pos::GlobalNode(int(rng() % 256), int(rng() % 256), int(rng() % 256)));
+
+    return positions;
+}
+
+}
+
+int main() {
+    std::mt19937 rng(38);
+    const std::vector<Pos::GlobalNode> positions = makePositions(rng);
+    std::vector<uint32_t> delays(PENDING);
+    for(uint32_t& delay : delays)
+        delay = tickDelay(rng);
+
+    NodeTickScheduler scheduler;
+
+    {
+        Bench::Clock::time_point start = Bench::Clock::now();
+        for(size_t iter = 0; iter < PENDING; iter++)
+            scheduler.schedule(positions[iter], delays[iter]);
+
+        double seconds = Bench::secondsSince(start);
+        Bench::report("планирование", PENDING / seconds / 1e6, "млн тактов/с");
+        Bench::report("ожидает", scheduler.pendingCount(), "тактов");
+    }
+
+    {
+        size_t cancels = PENDING / 4;
+        Bench::Clock::time_point start = Bench::Clock::now();
+        for(size_t iter = 0; iter < cancels; iter++)
+            scheduler.cancel(positions[iter * 4]);
+
+        double seconds = Bench::secondsSince(start);
+        Bench::report("отмена", cancels / seconds / 1e6, "млн тактов/с");
+    }
+
+    // Установившийся режим: сработавшая нода планируется снова, число ожидающих не меняется
+    {
+        for(size_t iter = 0; iter < PENDING; iter += 4)
+            scheduler.schedule(positions[iter], tickDelay(rng));
+
+        std::vector<Pos::GlobalNode> fired;
+        size_t total = 0;
+
+        Bench::Clock::time_point start = Bench::Clock::now();
+        for(int tick = 0; tick < STEADY_TICKS; tick++) {
+            fired.clear();
+            scheduler.advance(fired);
+            total += fired.size();
+
+            for(Pos::GlobalNode pos : fired)
+                scheduler.schedule(pos, 1 + uint32_t(pos.x * 7 + pos.z + tick) % 256);
+        }
+
+        double seconds = Bench::secondsSince(start);
+        Bench::report("такт мира", seconds / STEADY_TICKS * 1e6, "мкс");
+        Bench::report("сработало и перепланировано", total / seconds / 1e6, "млн тактов/с");
+        Bench::report("ожидает", scheduler.pendingCount(), "тактов");
+    }
+
+    // Выгрузка и загрузка всех регионов, как при сохранении мира
+    {
+        std::vector<std::pair<Pos::GlobalRegion, std::vector<NodeTickRecord>>> saved;
+        size_t records = 0;
+
+        Bench::Clock::time_point start = Bench::Clock::now();
+        for(int x = 0; x < 4; x++)
+            for(int y = 0; y < 4; y++)
+                for(int z = 0; z < 4; z++) {
+                    Pos::GlobalRegion rPos(x, y, z);
+                    saved.emplace_back(rPos, scheduler.collectRegion(rPos));
+                    records += saved.back().second.size();
+                    scheduler.dropRegion(rPos);
+                }
+
+        for(const auto& [rPos, ticks] : saved)
+            scheduler.restoreRegion(rPos, ticks);
+
+        double seconds = Bench::secondsSince(start);
+        Bench::report("выгрузка и загрузка регионов", records / seconds / 1e6, "млн тактов/с");
+    }
+
+    // Разбор до пустого колеса, в основном холостые такты между далёкими срабатываниями
+    {
+        std::vector<Pos::GlobalNode> fired;
+        size_t ticks = 0, total = 0;
+
+        Bench::Clock::time_point start = Bench::Clock::now();
+        while(scheduler.pendingCount()) {
+            fired.clear();
+            scheduler.advance(fired);
+            total += fired.size();
+            ticks++;
+        }
+
+        double seconds = Bench::secondsSince(start);
+        Bench::report("разбор до пустого", ticks / seconds / 1e6, "млн тактов мира/с");
+        Bench::report("сработало", total, "тактов");
+    }
+}
@@ -0,0 +1,126 @@
+#include "Bench.hpp"
+#include "Common/ConcurrentQueue.hpp"
+#include "TOSLib.hpp"
+
+#include <queue>
+#include <string>
+
+/*
+    Передача элементов от нескольких производителей одному потребителю.
+    Сравниваются очереди из Common/ConcurrentQueue.hpp и прежний вариант
+    TOS::SpinlockObject<std::queue>, который потребитель опрашивает в цикле
+*/
+
+using namespace LV;
+
+namespace {
+
+constexpr size_t ITEMS_PER_PRODUCER = 1 << 19;
+
+// Потребитель - поток с индексом 0, остальные производят
+template<typename Produce, typename Consume>
+double measure(size_t producers, Produce&& produce, Consume&& consume) {
+    return Bench::runThreads(producers + 1, [&](size_t index) {
+        if(index == 0) {
+            uint64_t sum = 0;
+            size_t left = producers * ITEMS_PER_PRODUCER;
+            while(left)
+                left -= consume(sum);
+
+            Bench::keep(sum);
+        } else {
+            for(size_t iter = 0; iter < ITEMS_PER_PRODUCER; iter++)
+                produce(uint64_t(iter));
+        }
+    });
+}
+
+void report(const char* label, size_t producers, double seconds) {
+    std::string name = std::string(label) + ", производителей " + std::to_string(producers);
+    Bench::report(name, double(producers * ITEMS_PER_PRODUCER) / seconds / 1e6, "млн/с");
+}
+
+}
+
+int main() {
+    for(size_t producers : Bench::threadSteps()) {
+        {
+            TOS::SpinlockObject<std::queue<uint64_t>> queue;
+            double seconds = measure(producers,
+                [&](uint64_t value) { queue.lock()->push(value); },
+                [&](uint64_t& sum) -> size_t {
+                    if(queue.get_read().empty())
+                        return 0;
+
+                    auto lock = queue.lock();
+                    size_t count = lock->size();
+                    for(; !lock->empty(); lock->pop())
+                        sum += lock->front();
+
+                    return count;
+                });
+
+            report("SpinlockObject<std::queue>", producers, seconds);
+        }
+
+        {
+            MPSCQueue<uint64_t> queue;
+            double seconds = measure(producers,
+                [&](uint64_t value) { queue.push(value); },
+                [&](uint64_t& sum) -> size_t {
+                    uint32_t seq = queue.sequence();
+                    size_t count = queue.consumeAll([&](uint64_t value) { sum += value; });
+                    if(!count)
+                        queue.wait(seq);
+
+                    return count;
+                });
+
+            report("MPSCQueue", producers, seconds);
+        }
+
+        {
+            // Ёмкость как у очереди действий игрока, производители ждут освобождения места
+            BoundedQueue<uint64_t> queue(256);
+            double seconds = measure(producers,
+                [&](uint64_t value) {
+                    while(!queue.tryPush(value))
+                        std::this_thread::yield();
+                },
+                [&](uint64_t& sum) -> size_t {
+                    size_t count = 0;
+                    while(std::optional<uint64_t> value = queue.tryPop()) {
+                        sum += *value;
+                        count++;
+                    }
+
+                    if(!count)
+                        std::this_thread::yield();
+
+                    return count;
+                });
+
+            report("BoundedQueue(256)", producers, seconds);
+        }
+
+        {
+            WorkQueue<uint64_t> queue;
+            double seconds = measure(producers,
+                [&](uint64_t value) { queue.push(value); },
+                [&](uint64_t& sum) -> size_t {
+                    uint32_t seq = queue.sequence();
+                    if(std::optional<uint64_t> value = queue.tryPop()) {
+                        sum += *value;
+                        return 1;
+                    }
+
+                    queue.wait(seq);
+                    return 0;
+                });
+
+            report("WorkQueue", producers, seconds);
+        }
+    }
+
+    return 0;
+}
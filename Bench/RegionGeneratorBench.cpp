@@ -0,0 +1,122 @@
+#include "Bench.hpp"
+#include "Server/ContentManager.hpp"
+#include "Server/RegionGenerator.hpp"
+
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+    Генерация регионов: встроенный генератор против генератора мода в LuaJIT,
+    который пишет ноды региона через ffi без копирования (LuaRegionGenerator, как в BackingAsyncLua).
+    Оба получают одни и те же буферы шума. Скрипт строит такую же местность (трава, земля, камень
+    по карте высот), но без деревьев и перлин-шума. Замер на одном потоке и на всех ядрах,
+    у каждого потока своё состояние Lua, как у потоков сервера
+*/
+
+using namespace LV;
+using namespace LV::Server;
+
+namespace {
+
+constexpr int SIDE = 8;
+constexpr int NOISE_BUFFERS = 16;
+constexpr WorldId_t WORLD = 0;
+
+const char* Script = R"LUA(
+local grass = gen.node_id("test:grass")
+local dirt = gen.node_id("test:dirt")
+local stone = gen.node_id("test:stone")
+local index, node = gen.index, gen.node
+local floor, sin = math.floor, math.sin
+
+return function(nodes, noise, bx, by, bz)
+    for z = 0, 63 do
+        for x = 0, 63 do
+            local gx, gz = bx + x, bz + z
+            local surface = floor(18 + sin(gx*0.02)*8 + sin(gz*0.03)*8 + noise[z*64 + x]*3 + 0.5)
+
+            for y = 0, 63 do
+                local gy = by + y
+                if gy <= surface then
+                    local id = stone
+                    if gy == surface then
+                        id = node(grass, 1)
+                    elseif gy >= surface - 3 then
+                        id = dirt
+                    end
+
+                    nodes[index(x, y, z)] = id
+                end
+            end
+        end
+    end
+end
+)LUA";
+
+// Регионы SIDE x 2 x SIDE вокруг поверхности
+std::vector<Pos::GlobalRegion> regionList() {
+    std::vector<Pos::GlobalRegion> regions;
+    for(int x = 0; x < SIDE; x++)
+        for(int y = -1; y <= 0; y++)
+            for(int z = 0; z < SIDE; z++)
+                regions.push_back(Pos::GlobalRegion(x, y, z));
+
+    return regions;
+}
+
+}
+
+int main() {
+    AssetsManager am;
+    ContentManager cm(am);
+
+    const ModScript script{"bench", "bench_generator", Script};
+    const std::vector<Pos::GlobalRegion> regions = regionList();
+
+    std::mt19937 rng(41);
+    std::vector<std::unique_ptr<std::array<float, 64*64*64>>> noises;
+    for(int iter = 0; iter < NOISE_BUFFERS; iter++) {
+        noises.push_back(std::make_unique<std::array<float, 64*64*64>>());
+        for(float& value : *noises.back())
+            value = float(rng() % 2001) / 1000.f - 1.f;
+    }
+
+    // Идентификаторы нод выдаются заранее, чтобы потоки только читали их
+    {
+        auto lru = cm.createLRU();
+        for(const char* key : {"grass", "dirt", "stone", "log", "leaves", "lava", "water", "fire"})
+            lru.getIdNode("test", key);
+    }
+
+    for(size_t threads : {size_t(1), Bench::threadSteps().back()}) {
+        // Каждый поток проходит все регионы, пропускная способность - суммарная
+        double nativeSeconds = Bench::runThreads(threads, [&](size_t) {
+            std::unique_ptr<World::RegionIn> out = std::make_unique<World::RegionIn>();
+            for(size_t iter = 0; iter < regions.size(); iter++) {
+                generateRegionNative(cm, regions[iter], *noises[iter % NOISE_BUFFERS], *out);
+                Bench::keep(out->Nodes[0][0].Data);
+            }
+        });
+
+        double luaSeconds = Bench::runThreads(threads, [&](size_t) {
+            LuaRegionGenerator lua(cm);
+            lua.init();
+
+            // Открытие состояния и загрузка скрипта первым вызовом входят в замер, как при старте потока сервера
+            std::unique_ptr<World::RegionIn> out = std::make_unique<World::RegionIn>();
+            for(size_t iter = 0; iter < regions.size(); iter++) {
+                if(!lua.generate(WORLD, script, regions[iter], *noises[iter % NOISE_BUFFERS], *out))
+                    std::abort();
+
+                Bench::keep(out->Nodes[0][0].Data);
+            }
+        });
+
+        std::string suffix = ", потоков " + std::to_string(threads);
+        Bench::report("встроенный" + suffix, regions.size() * threads / nativeSeconds, "регионов/с");
+        Bench::report("lua ffi" + suffix, regions.size() * threads / luaSeconds, "регионов/с");
+    }
+}
@@ -0,0 +1,109 @@
+#include "Bench.hpp"
+#include "sha2.hpp"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+    Хеширование ресурсов SHA-256: крупные сообщения (поток байт) и пакеты мелких,
+    как текстуры и модели при сканировании ассетов. Каждый путь, который поддерживает
+    процессор, замеряется отдельно, в конце - выбранный при запуске
+*/
+
+namespace {
+
+constexpr size_t LARGE = 64 << 20;
+constexpr size_t SMALL_COUNT = 200000;
+
+using Hash = sha2::sha256_hash;
+
+// То же, что sha256(), но с заданной функцией сжатия
+Hash hashWith(sha2::sha256_compress_fn compress, const uint8_t* data, uint64_t length) {
+    uint32_t state[8];
+    std::copy_n(sha2::sha256_initial_hash_values, 8, state);
+
+    const size_t full = length / 64;
+    compress(state, data, full);
+
+    uint8_t tail[128];
+    compress(state, tail, sha2::sha256_pad_tail(tail, data + full * 64, length));
+
+    Hash out;
+    for(int iter = 0; iter < 8; iter++)
+        sha2::write_u32(&out[iter * 4], state[iter]);
+
+    return out;
+}
+
+struct Small {
+    std::vector<const uint8_t*> Data;
+    std::vector<uint64_t> Lengths;
+    size_t Bytes = 0;
+};
+
+void measureCompress(std::string_view name, sha2::sha256_compress_fn compress, const std::vector<uint8_t>& large, const Small& small) {
+    {
+        LV::Bench::Clock::time_point start = LV::Bench::Clock::now();
+        LV::Bench::keep(hashWith(compress, large.data(), large.size()));
+        double seconds = LV::Bench::secondsSince(start);
+        LV::Bench::report(std::string(name) + " крупные", large.size() / seconds / (1 << 20), "МиБ/с");
+    }
+
+    {
+        LV::Bench::Clock::time_point start = LV::Bench::Clock::now();
+        for(size_t iter = 0; iter < small.Data.size(); iter++)
+            LV::Bench::keep(hashWith(compress, small.Data[iter], small.Lengths[iter]));
+
+        double seconds = LV::Bench::secondsSince(start);
+        LV::Bench::report(std::string(name) + " мелкие", small.Data.size() / seconds / 1e6, "млн сообщений/с");
+        LV::Bench::report(std::string(name) + " мелкие", small.Bytes / seconds / (1 << 20), "МиБ/с");
+    }
+}
+
+}
+
+int main() {
+    std::mt19937 rng(31);
+    std::vector<uint8_t> large(LARGE);
+    for(uint8_t& byte : large)
+        byte = rng();
+
+    // Мелкие ресурсы: от десятков байт до нескольких КиБ, как описания моделей и текстуры 16x16
+    Small small;
+    for(size_t iter = 0; iter < SMALL_COUNT; iter++) {
+        uint64_t length = 32 + rng() % 4096;
+        small.Data.push_back(large.data() + rng() % (LARGE - length));
+        small.Lengths.push_back(length);
+        small.Bytes += length;
+    }
+
+    measureCompress("переносимый", &sha2::sha256_compress_portable, large, small);
+
+#if SHA2_X86_DISPATCH
+    if(sha2::cpu_has_sha_ni())
+        measureCompress("sha-ni", &sha2::sha256_compress_shani, large, small);
+
+    if(sha2::cpu_has_avx2()) {
+        std::vector<Hash> out(small.Data.size());
+        LV::Bench::Clock::time_point start = LV::Bench::Clock::now();
+        sha2::sha256_batch_avx2(small.Data.data(), small.Lengths.data(), out.data(), out.size());
+        double seconds = LV::Bench::secondsSince(start);
+        LV::Bench::keep(out.back());
+        LV::Bench::report("avx2 x8 мелкие", small.Data.size() / seconds / 1e6, "млн сообщений/с");
+        LV::Bench::report("avx2 x8 мелкие", small.Bytes / seconds / (1 << 20), "МиБ/с");
+    }
+#endif
+
+    {
+        std::vector<Hash> out(small.Data.size());
+        LV::Bench::Clock::time_point start = LV::Bench::Clock::now();
+        sha2::sha256_batch(small.Data.data(), small.Lengths.data(), out.data(), out.size());
+        double seconds = LV::Bench::secondsSince(start);
+        LV::Bench::keep(out.back());
+
+        std::printf("sha256_batch: %s\n", sha2::sha256_implementation());
+        LV::Bench::report("sha256_batch мелкие", small.Data.size() / seconds / 1e6, "млн сообщений/с");
+    }
+}
@@ -0,0 +1,98 @@
+#include "Bench.hpp"
+#include "Common/TexturePipelineProgram.hpp"
+
+#include <map>
+#include <random>
+#include <string>
+
+/*
+    Исполнение программ текстурных пайплайнов на процессоре: разбор и связывание
+    один раз, затем запекание на разных моментах времени, как при смене кадров анимации.
+    Плавные анимации запекаются каждый кадр, поэтому отдельно замеряется смешивание кадров
+*/
+
+namespace {
+
+constexpr int BAKES = 400;
+
+struct Sheet {
+    uint32_t Size;
+    std::vector<uint32_t> Pixels;
+};
+
+}
+
+int main() {
+    std::mt19937 rng(5);
+    std::map<uint32_t, Sheet> sheets;
+    std::map<std::string, uint32_t, std::less<>> ids;
+
+    auto make = [&](const std::string& name, uint32_t size) {
+        Sheet sheet{size, std::vector<uint32_t>(size_t(size) * size)};
+        for(uint32_t& px : sheet.Pixels)
+            px = rng();
+
+        uint32_t id = uint32_t(ids.size()) + 1;
+        ids[name] = id;
+        sheets[id] = std::move(sheet);
+    };
+
+    make("stone", 16);
+    make("glass", 16);
+    make("sheet", 64);
+    make("big", 256);
+
+    auto resolver = [&](std::string_view name) -> std::optional<uint32_t> {
+        auto iter = ids.find(name);
+        if(iter == ids.end())
+            return std::nullopt;
+
+        return iter->second;
+    };
+
+    auto provider = [&](uint32_t id) -> std::optional<Texture> {
+        auto iter = sheets.find(id);
+        if(iter == sheets.end())
+            return std::nullopt;
+
+        return Texture{iter->second.Size, iter->second.Size, iter->second.Pixels.data()};
+    };
+
+    const std::pair<const char*, const char*> programs[] = {
+        {"простая текстура", "stone"},
+        {"наложение и яркость", "stone |> overlay(\"glass\") |> brighten()"},
+        {"цепочка фильтров 256x256", "big |> opacity(200) |> invert(\"rgba\") |> contrast(40, 10) |> multiply(\"#80FF40\") |> screen(\"#102030\") |> noalpha"},
+        {"маски 256x256", "big |> overlay(\"big\") |> mask(\"big\") |> lowpart(50, \"big\")"},
+        {"анимация по кадрам", "anim(\"sheet\", 16, 16, fps=8)"},
+        {"плавная анимация", "anim(\"sheet\", 16, 16, axis=\"x\", smooth=1)"},
+        {"плавная анимация 256x256", "big |> anim(256, 64, fps=10, smooth=1)"},
+    };
+
+    for(const auto& [name, source] : programs) {
+        TexturePipelineProgram program;
+        std::string err;
+        if(!program.compile(source, &err) || !program.link(resolver, &err)) {
+            std::printf("%s: ошибка %s\n", name, err.c_str());
+            return 1;
+        }
+
+        size_t pixels = 0;
+        LV::Bench::Clock::time_point start = LV::Bench::Clock::now();
+        for(int iter = 0; iter < BAKES; iter++) {
+            TexturePipelineProgram::OwnedTexture out;
+            if(!program.bake(provider, out, iter * 0.037, &err)) {
+                std::printf("%s: ошибка %s\n", name, err.c_str());
+                return 1;
+            }
+
+            pixels += out.Pixels.size();
+            LV::Bench::keep(out.Pixels.data());
+        }
+
+        double seconds = LV::Bench::secondsSince(start);
+        LV::Bench::report(std::string(name) + ", запеканий", BAKES / seconds, "1/с");
+        LV::Bench::report(std::string(name) + ", пикселей", double(pixels) / seconds / 1e6, "млн/с");
+    }
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include "Bench.hpp"
+#include "Client/Vulkan/TlsfAllocator.hpp"
+
+#include <random>
+#include <string>
+
+/*
+    Разметка пула вершин без устройства, как в VertexPool: гранулы по 64 вершины,
+    пул на 65536 гранул. Замеряется перестройка мешей чанков (освобождение и новое выделение),
+    раздробленность после неё и дефрагментация кадрами с бюджетом переноса
+*/
+
+using LV::Client::VK::TlsfAllocator;
+
+namespace {
+
+constexpr uint32_t PER_POOL = 1 << 16;
+// 4 МиБ за кадр при 64 вершинах по 32 байта в грануле
+constexpr uint32_t FRAME_BUDGET = (4u << 20) / (64 * 32);
+constexpr int REBUILDS = 2000000;
+
+// Размер меша чанка в гранулах: в основном мелкие, изредка крупные
+uint32_t meshSize(std::mt19937& rng) {
+    return rng() % 8 ? 1 + rng() % 16 : 16 + rng() % 240;
+}
+
+}
+
+int main() {
+    std::mt19937 rng(17);
+    TlsfAllocator allocator(PER_POOL);
+    std::vector<uint32_t> meshes;
+
+    while(std::optional<uint32_t> id = allocator.allocate(meshSize(rng)))
+        meshes.push_back(*id);
+
+    // Половина мешей исчезает, оставшиеся перестраиваются с новым размером
+    for(size_t iter = 0; iter < meshes.size(); iter += 2)
+        allocator.free(meshes[iter]);
+
+    std::erase_if(meshes, [&, index = size_t(0)](uint32_t) mutable { return index++ % 2 == 0; });
+
+    {
+        size_t failed = 0;
+        LV::Bench::Clock::time_point start = LV::Bench::Clock::now();
+        for(int iter = 0; iter < REBUILDS; iter++) {
+            uint32_t& mesh = meshes[rng() % meshes.size()];
+            allocator.free(mesh);
+
+            std::optional<uint32_t> id = allocator.allocate(meshSize(rng));
+            if(!id) {
+                id = allocator.allocate(1);
+                failed++;
+            }
+
+            mesh = *id;
+        }
+
+        double seconds = LV::Bench::secondsSince(start);
+        LV::Bench::report("перестройка мешей", REBUILDS / seconds / 1e6, "млн освобождений+выделений/с");
+        LV::Bench::report("не поместилось", double(failed) / REBUILDS * 100, "%");
+    }
+
+    TlsfAllocator::Stats stats = allocator.stats();
+    LV::Bench::report("занято", double(stats.Used) / stats.Capacity * 100, "%");
+    LV::Bench::report("свободных блоков", stats.FreeBlocks, "шт");
+    LV::Bench::report("наибольший свободный", double(stats.LargestFree) / (stats.Capacity - stats.Used) * 100, "% свободного");
+
+    // Кадры дефрагментации до одного свободного блока
+    {
+        int frames = 0;
+        size_t moves = 0;
+        uint64_t moved = 0;
+        double seconds = 0;
+
+        while(allocator.freeBlocks() > 1 && frames < 10000) {
+            LV::Bench::Clock::time_point start = LV::Bench::Clock::now();
+            std::vector<TlsfAllocator::Move> frame = allocator.defragment(FRAME_BUDGET, [](uint32_t) { return true; });
+            seconds += LV::Bench::secondsSince(start);
+
+            if(frame.empty())
+                break;
+
+            // Старые места отпускаются после кадра, как в notifyGpuFinished
+            for(const TlsfAllocator::Move& move : frame) {
+                allocator.releaseBlock(move.OldBlock);
+                moved += move.Size;
+            }
+
+            moves += frame.size();
+            frames++;
+        }
+
+        LV::Bench::report("кадров дефрагментации", frames, "шт");
+        LV::Bench::report("перенесено", double(moved) / PER_POOL * 100, "% пула");
+        LV::Bench::report("планирование переносов", seconds ? moves / seconds / 1e6 : 0, "млн переносов/с");
+        LV::Bench::report("свободных блоков после", allocator.freeBlocks(), "шт");
+    }
+}
@@ -0,0 +1,167 @@
+#include "Bench.hpp"
+#include "Server/World.hpp"
+
+#include <atomic>
+#include <barrier>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+    Обновление мира шардами: World::onUpdate на разном числе регионов и потоков.
+    В каждом регионе каменное дно с травой (случайные такты) и столб воды, который
+    растекается по дну и переходит в соседние регионы, бюджет жидкостей не ограничивает.
+    Шарды разбирает пул с барьерами, как BackingWorldShards сервера: главный поток
+    участвует наравне с рабочими. Свет считается вне замера, как после такта на сервере
+*/
+
+using namespace LV;
+using namespace LV::Server;
+
+namespace {
+
+constexpr DefNodeId STONE = 1, WATER = 2, GRASS = 3;
+constexpr int TICKS = 200;
+
+const std::vector<NodeFluidInfo> FluidTable = {{0}, {0}, {1}, {0}};
+const std::vector<NodeLightInfo> LightTable = {{0, 0}, {0, 15}, {0, 2}, {0, 15}};
+const std::vector<uint8_t> RandomTickFilter = {0, 0, 0, 1};
+
+// Пул на workers потоков, job разбирается вместе с вызывающим потоком
+class ShardPool {
+public:
+    explicit ShardPool(size_t workers)
+        : Start(workers+1), End(workers+1)
+    {
+        for(size_t iter = 0; iter < workers; iter++)
+            Threads.emplace_back([this]() { run(); });
+    }
+
+    ~ShardPool() {
+        NeedShutdown.store(true, std::memory_order_release);
+        Start.arrive_and_wait();
+        for(std::thread& thread : Threads)
+            thread.join();
+    }
+
+    void parallelFor(size_t count, const std::function<void(size_t)>& job) {
+        Job = &job;
+        JobCount = count;
+        NextJob.store(0, std::memory_order_relaxed);
+
+        Start.arrive_and_wait();
+        drain();
+        End.arrive_and_wait();
+    }
+
+private:
+    std::barrier<> Start, End;
+    std::vector<std::thread> Threads;
+    std::atomic<bool> NeedShutdown = false;
+
+    const std::function<void(size_t)>* Job = nullptr;
+    size_t JobCount = 0;
+    std::atomic<size_t> NextJob = 0;
+
+    void run() {
+        while(true) {
+            Start.arrive_and_wait();
+            if(NeedShutdown.load(std::memory_order_acquire))
+                return;
+
+            drain();
+            End.arrive_and_wait();
+        }
+    }
+
+    void drain() {
+        for(size_t index; (index = NextJob.fetch_add(1, std::memory_order_relaxed)) < JobCount;)
+            (*Job)(index);
+    }
+};
+
+void fillRegion(World::RegionIn& region) {
+    for(int x = 0; x < 64; x++)
+        for(int y = 0; y < 64; y++)
+            for(int z = 0; z < 64; z++) {
+                Node node;
+                node.Data = 0;
+
+                if(y < 8)
+                    node.NodeId = STONE;
+                else if(y == 8)
+                    node.NodeId = GRASS;
+                else if(y < 33 && x >= 24 && x < 40 && z >= 24 && z < 40)
+                    node = FluidSimulator::makeFluid(WATER, FluidSimulator::MAX_LEVEL);
+
+                region.Nodes[Pos::bvec4u(x >> 4, y >> 4, z >> 4).pack()][(x & 15) + (y & 15)*16 + (z & 15)*256] = node;
+            }
+}
+
+// Мир из sideX x 1 x sideZ регионов со светом, готовый к тактам
+std::unique_ptr<World> makeWorld(int sideX, int sideZ) {
+    std::unique_ptr<World> world = std::make_unique<World>(0);
+    world->setNodeFluidTable(&FluidTable);
+    world->setNodeLightTable(&LightTable);
+    world->setRandomTickFilter(&RandomTickFilter);
+    world->setFluidBudget(UINT32_MAX);
+
+    // Пачками по ряду, чтобы не держать копии нод всех регионов сразу
+    for(int x = 0; x < sideX; x++) {
+        std::vector<std::pair<Pos::GlobalRegion, World::RegionIn>> batch(sideZ);
+        for(int z = 0; z < sideZ; z++) {
+            batch[z].first = Pos::GlobalRegion(x, 0, z);
+            fillRegion(batch[z].second);
+        }
+
+        world->pushRegions(std::move(batch));
+    }
+
+    std::unique_ptr<RegionLight> light = std::make_unique<RegionLight>();
+    for(const World::LightJob& job : world->takeLightJobs()) {
+        LightEngine::computeRegion(world->Regions.at(job.Pos)->Nodes, &LightTable, *light);
+        world->applyRegionLight(job.Pos, job.Id, *light);
+    }
+
+    world->updateLight();
+    return world;
+}
+
+}
+
+int main() {
+    for(int side : {8, 12, 16}) {
+        double single = 0;
+
+        for(size_t threads : Bench::threadSteps()) {
+            std::unique_ptr<World> world = makeWorld(side, side);
+            ShardPool pool(threads-1);
+            if(threads > 1)
+                world->setParallelFor([&](size_t count, const std::function<void(size_t)>& job) {
+                    pool.parallelFor(count, job);
+                });
+
+            size_t events = 0;
+            double seconds = 0;
+            for(int tick = 0; tick < TICKS; tick++) {
+                Bench::Clock::time_point start = Bench::Clock::now();
+                world->onUpdate(nullptr, 0.05f);
+                seconds += Bench::secondsSince(start);
+
+                events += world->takeNodeTickEvents().size();
+                world->updateLight();
+            }
+
+            if(threads == 1)
+                single = seconds;
+
+            std::string prefix = "регионов " + std::to_string(side*side) + ", шардов " + std::to_string(world->getShardCount())
+                + ", потоков " + std::to_string(threads);
+            Bench::report(prefix + " такт", seconds / TICKS * 1e3, "мс");
+            Bench::report(prefix + " ускорение", single / seconds, "раз");
+            Bench::keep(events);
+        }
+    }
+}
@@ -44,8 +44,8 @@ struct Chunk {
     std::vector<VoxelCube> Voxels;
     // Ноды
     std::array<Node, 16*16*16> Nodes;
-    // Ограничения прохождения света, идущего от солнца (от верха карты до верхней плоскости чанка)
-    // LightPrism Lights[16][16];
+    // Освещённость нод (источники и небо), рассчитывается сервером
+    ChunkLight Light = {};
 };
 
 class Entity {
@@ -191,6 +191,8 @@ struct DefNode {
     void reBind(const std::function<ResourceId(EnumAssets, ResourceId)>& am) {
         RenderStates = am(EnumAssets::Nodestate, std::get<AssetsNodestate>(RenderStates));
     }
+
+    bool operator==(const DefNode&) const = default;
 };
 
 struct DefWorld {
@@ -200,6 +200,7 @@ AssetsCacheManager::~AssetsCacheManager() {
 
 coro<> AssetsCacheManager::asyncDestructor() {
     NeedShutdown = true;
+    WorkSignal.notify();
     co_await IAsyncDestructible::asyncDestructor();
 }
 
@@ -209,7 +210,12 @@ void AssetsCacheManager::readWriteThread(AsyncUseControl::Lock lock) {
         [[maybe_unused]] size_t maxLifeTime = 0;
         bool databaseSizeKnown = false;
 
-        while(!NeedShutdown || !WriteQueue.get_read().empty()) {
+        while(true) {
+            uint32_t seq = WorkSignal.sequence();
+
+            if(NeedShutdown && WriteQueue.empty())
+                break;
+
             // Получить новые данные
             if(Changes.get_read().MaxChange) {
                 auto lock = Changes.lock();
@@ -235,14 +241,8 @@ void AssetsCacheManager::readWriteThread(AsyncUseControl::Lock lock) {
             }
 
             // Чтение
-            if(!ReadQueue.get_read().empty()) {
-                Hash_t hash;
-
-                {
-                    auto lock = ReadQueue.lock();
-                    hash = lock->front();
-                    lock->pop();
-                }
+            if(std::optional<Hash_t> next = ReadQueue.tryPop()) {
+                Hash_t hash = *next;
 
                 bool finded = false;
                 // Поищем в малой базе
@@ -254,7 +254,7 @@ void AssetsCacheManager::readWriteThread(AsyncUseControl::Lock lock) {
                     int size = sqlite3_column_bytes(STMT_INLINE_GET, 0);
                     Resource res(data, size);
                     finded = true;
-                    ReadyQueue.lock()->emplace_back(hash, res);
+                    ReadyQueue.emplace(hash, res);
                 } else if(errc != SQLITE_DONE) {
                     sqlite3_reset(STMT_INLINE_GET);
                     MAKE_ERROR("Не удалось выполнить подготовленный запрос STMT_INLINE_GET: " << sqlite3_errmsg(DB));
@@ -290,7 +290,7 @@ void AssetsCacheManager::readWriteThread(AsyncUseControl::Lock lock) {
                         }
                         
                         finded = true;
-                        ReadyQueue.lock()->emplace_back(hash, PathFiles / hashKey.substr(0, 2) / hashKey.substr(2));
+                        ReadyQueue.emplace(hash, PathFiles / hashKey.substr(0, 2) / hashKey.substr(2));
                     } else if(errc != SQLITE_DONE) {
                         sqlite3_reset(STMT_DISK_CONTAINS);
                         MAKE_ERROR("Не удалось выполнить подготовленный запрос STMT_DISK_CONTAINS: " << sqlite3_errmsg(DB));
@@ -312,21 +312,15 @@ void AssetsCacheManager::readWriteThread(AsyncUseControl::Lock lock) {
 
                 if(!finded) {
                     // Не нашли
-                    ReadyQueue.lock()->emplace_back(hash, std::nullopt);
+                    ReadyQueue.emplace(hash, std::nullopt);
                 }
 
                 continue;
             }
 
             // Запись
-            if(!WriteQueue.get_read().empty()) {
-                Resource res;
-
-                {
-                    auto lock = WriteQueue.lock();
-                    res = lock->front();
-                    lock->pop();
-                }
+            if(std::optional<Resource> next = WriteQueue.tryPop()) {
+                Resource res = std::move(*next);
 
                 if(!databaseSizeKnown) {
                     size_t diskSize = 0;
@@ -491,7 +485,7 @@ void AssetsCacheManager::readWriteThread(AsyncUseControl::Lock lock) {
                 continue;
             }
 
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            WorkSignal.wait(seq);
         }
     } catch(const std::exception& exc) {
         LOG.warn() << "Ошибка в работе потока:\n" << exc.what();
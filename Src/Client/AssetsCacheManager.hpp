@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Common/Abstract.hpp"
+#include "Common/ConcurrentQueue.hpp"
 #include <cassert>
 #include <functional>
 #include <memory>
@@ -99,17 +100,17 @@ public:
 
     // Добавить новый полученный с сервера ресурс
     void pushResources(std::vector<Resource> resources) {
-        WriteQueue.lock()->push_range(resources);
+        WriteQueue.push_range(std::move(resources));
     }
 
     // Добавить задачи на чтение по хэшу
     void pushReads(std::vector<Hash_t> hashes) {
-        ReadQueue.lock()->push_range(hashes);
+        ReadQueue.push_range(std::move(hashes));
     }
 
     // Получить считанные данные по хэшу
     std::vector<std::pair<Hash_t, std::optional<Resource>>> pullReads() {
-        return std::move(*ReadyQueue.lock());
+        return ReadyQueue.popAll();
     }
 
     // Размер всего хранимого кеша
@@ -123,6 +124,8 @@ public:
         lock->MaxLifeTime = maxLifeTime;
         lock->MaxCacheDatabaseSize = maxCacheDirectorySize;
         lock->MaxChange = true;
+        lock.unlock();
+        WorkSignal.notify();
     }
 
     // Запуск процедуры проверки хешей всего хранимого кеша
@@ -130,6 +133,8 @@ public:
         auto lock = Changes.lock();
         lock->OnRecheckEnd = std::move(func);
         lock->FullRecheck = true;
+        lock.unlock();
+        WorkSignal.notify();
     }
 
     bool hasError() {
@@ -165,12 +170,14 @@ private:
     // Полный размер данных на диске (насколько известно)
     volatile size_t DatabaseSize = 0;
 
+    // Будит поток обработки при появлении задач или изменении параметров
+    EventSignal WorkSignal;
     // Очередь задач на чтение
-    TOS::SpinlockObject<std::queue<Hash_t>> ReadQueue;
+    MPSCQueue<Hash_t> ReadQueue{&WorkSignal};
     // Очередь на запись ресурсов
-    TOS::SpinlockObject<std::queue<Resource>> WriteQueue;
+    MPSCQueue<Resource> WriteQueue{&WorkSignal};
     // Очередь на выдачу результатов чтения
-    TOS::SpinlockObject<std::vector<std::pair<Hash_t, std::optional<Resource>>>> ReadyQueue;
+    MPSCQueue<std::pair<Hash_t, std::optional<Resource>>> ReadyQueue;
 
     struct Changes_t {
         size_t MaxCacheDatabaseSize, MaxLifeTime;
@@ -1,6 +1,7 @@
 // https://gist.github.com/podgorskiy/e698d18879588ada9014768e3e82a644
 
 #include <glm/matrix.hpp>
+#include <cstdint>
 
 class Frustum
 {
@@ -13,6 +14,15 @@ public:
 	// http://iquilezles.org/www/articles/frustumcorrect/frustumcorrect.htm
 	bool IsBoxVisible(const glm::vec3& minp, const glm::vec3& maxp) const;
 
+	enum class Intersection { Outside, Intersect, Inside };
+
+	static constexpr uint8_t AllPlanes = 0x3f;
+
+	// Иерархический тест: плоскости, относительно которых бокс полностью внутри, снимаются
+	// с planeMask, и вложенные боксы проверяются только по оставшимся.
+	// coherentPlane - плоскость, отсёкшая предыдущий бокс; проверяется первой и обновляется
+	Intersection TestBox(const glm::vec3& minp, const glm::vec3& maxp, uint8_t& planeMask, uint8_t* coherentPlane = nullptr) const;
+
 private:
 	enum Planes
 	{
@@ -109,6 +119,47 @@ inline bool Frustum::IsBoxVisible(const glm::vec3& minp, const glm::vec3& maxp)
 	return true;
 }
 
+inline Frustum::Intersection Frustum::TestBox(const glm::vec3& minp, const glm::vec3& maxp, uint8_t& planeMask, uint8_t* coherentPlane) const
+{
+	// false - бокс целиком снаружи плоскости
+	auto testPlane = [&](int i) -> bool
+	{
+		const glm::vec4& p = m_planes[i];
+		const glm::vec3 pv(p.x >= 0 ? maxp.x : minp.x, p.y >= 0 ? maxp.y : minp.y, p.z >= 0 ? maxp.z : minp.z);
+		if (glm::dot(glm::vec3(p), pv) + p.w < 0.0f)
+			return false;
+
+		const glm::vec3 nv(p.x >= 0 ? minp.x : maxp.x, p.y >= 0 ? minp.y : maxp.y, p.z >= 0 ? minp.z : maxp.z);
+		if (glm::dot(glm::vec3(p), nv) + p.w >= 0.0f)
+			planeMask &= ~uint8_t(1u << i);
+
+		return true;
+	};
+
+	int first = -1;
+	if (coherentPlane && *coherentPlane < Count && (planeMask >> *coherentPlane) & 1)
+	{
+		first = *coherentPlane;
+		if (!testPlane(first))
+			return Intersection::Outside;
+	}
+
+	for (int i = 0; i < Count; i++)
+	{
+		if (i == first || !((planeMask >> i) & 1))
+			continue;
+
+		if (!testPlane(i))
+		{
+			if (coherentPlane)
+				*coherentPlane = uint8_t(i);
+			return Intersection::Outside;
+		}
+	}
+
+	return planeMask ? Intersection::Intersect : Intersection::Inside;
+}
+
 template<Frustum::Planes a, Frustum::Planes b, Frustum::Planes c>
 inline glm::vec3 Frustum::intersection(const glm::vec3* crosses) const
 {
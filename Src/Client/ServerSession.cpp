@@ -50,7 +50,7 @@ const char* toClientPacketName(ToClient type) {
     case ToClient::DefinitionsUpdate: return "DefinitionsUpdate";
     case ToClient::ChunkVoxels: return "ChunkVoxels";
     case ToClient::ChunkNodes: return "ChunkNodes";
-    case ToClient::ChunkLightPrism: return "ChunkLightPrism";
+    case ToClient::ChunkLight: return "ChunkLight";
     case ToClient::RemoveRegion: return "RemoveRegion";
     case ToClient::Tick: return "Tick";
     case ToClient::TestLinkCameraToEntity: return "TestLinkCameraToEntity";
@@ -216,6 +216,18 @@ void ServerSession::requestModsReload() {
     LOG.info() << "Запрос на перезагрузку модов отправлен";
 }
 
+void ServerSession::requestLuaProfilerToggle() {
+    if(!Socket || !isConnected())
+        return;
+
+    Net::Packet packet;
+    packet << (uint8_t) ToServer::L1::System
+        << (uint8_t) ToServer::L2System::ToggleLuaProfiler;
+
+    Socket->pushPacket(std::move(packet));
+    LOG.info() << "Запрос на переключение профилировщика Lua отправлен";
+}
+
 void ServerSession::onResize(uint32_t width, uint32_t height) {
 
 }
@@ -410,6 +422,12 @@ void ServerSession::update(GlobalTime gTime, float dTime) {
                             }
                         );
 
+                        // Профиль не изменился, меши с этой нодой перестраивать незачем
+                        if(auto iterOld = Profiles.DefNodes.find(id); iterOld != Profiles.DefNodes.end() && iterOld->second == profile) {
+                            profile_Node_AddOrChange.erase(id);
+                            continue;
+                        }
+
                         profile_Node_AddOrChange[id] = profile;
                     }
 
@@ -578,12 +596,14 @@ void ServerSession::update(GlobalTime gTime, float dTime) {
         // Чанки
         std::unordered_map<WorldId_t, std::unordered_map<Pos::GlobalChunk, std::vector<VoxelCube>>> chunks_AddOrChange_Voxel_Result;
         std::unordered_map<WorldId_t, std::unordered_map<Pos::GlobalChunk, std::array<Node, 16*16*16>>> chunks_AddOrChange_Node_Result;
+        std::unordered_map<WorldId_t, std::unordered_map<Pos::GlobalChunk, ChunkLight>> chunks_AddOrChange_Light_Result;
         std::unordered_map<WorldId_t, std::vector<Pos::GlobalChunk>> chunks_Changed;
         std::unordered_map<WorldId_t, std::unordered_set<Pos::GlobalRegion>> regions_Lost_Result;
 
         {
             std::unordered_map<WorldId_t, std::unordered_map<Pos::GlobalChunk, std::u8string>> chunks_AddOrChange_Voxel;
             std::unordered_map<WorldId_t, std::unordered_map<Pos::GlobalChunk, std::u8string>> chunks_AddOrChange_Node;
+            std::unordered_map<WorldId_t, std::unordered_map<Pos::GlobalChunk, std::u8string>> chunks_AddOrChange_Light;
             std::unordered_map<WorldId_t, std::unordered_set<Pos::GlobalRegion>> regions_Lost;
 
             for(TickData& data : ticks) {
@@ -611,6 +631,15 @@ void ServerSession::update(GlobalTime gTime, float dTime) {
 
                 data.Chunks_AddOrChange_Node.clear();
 
+                // Освещение приходит позже нод и заменяет предыдущее целиком
+                for(auto& [wId, chunks] : data.Chunks_AddOrChange_Light) {
+                    auto& list = chunks_AddOrChange_Light[wId];
+                    for(auto& [pos, value] : chunks)
+                        list.insert_or_assign(pos, std::move(value));
+                }
+
+                data.Chunks_AddOrChange_Light.clear();
+
                 for(auto& [wId, regions] : data.Regions_Lost) {
                     std::sort(regions.begin(), regions.end());
 
@@ -639,6 +668,13 @@ void ServerSession::update(GlobalTime gTime, float dTime) {
                         for(Pos::GlobalChunk pos : toDelete)
                             iter->second.erase(iter->second.find(pos));
                     }
+
+                    if(auto iter = chunks_AddOrChange_Light.find(wId); iter != chunks_AddOrChange_Light.end())
+                    {
+                        std::erase_if(iter->second, [&](const auto& entry) {
+                            return std::binary_search(regions.begin(), regions.end(), Pos::GlobalRegion(entry.first >> 2));
+                        });
+                    }
                 
                     regions_Lost[wId].insert_range(regions);
                 }
@@ -677,6 +713,20 @@ void ServerSession::update(GlobalTime gTime, float dTime) {
                 }
             }
 
+            // Свет на перестройку мешей не влияет, в chunks_Changed не попадает
+            for(auto& [wId, list] : chunks_AddOrChange_Light) {
+                auto& caoclr = chunks_AddOrChange_Light_Result[wId];
+
+                for(auto& [pos, val] : list) {
+                    auto& sizes = VisibleChunkCompressed[wId][pos];
+                    VisibleChunkCompressedBytes -= sizes.Light;
+                    sizes.Light = val.size();
+                    VisibleChunkCompressedBytes += sizes.Light;
+
+                    unCompressLight(val, caoclr[pos]);
+                }
+            }
+
             regions_Lost_Result = std::move(regions_Lost);
 
             for(auto& [wId, list] : chunks_Changed) {
@@ -759,6 +809,7 @@ void ServerSession::update(GlobalTime gTime, float dTime) {
                         if(Pos::GlobalRegion(iter->first >> 2) == rPos) {
                             VisibleChunkCompressedBytes -= iter->second.Voxels;
                             VisibleChunkCompressedBytes -= iter->second.Nodes;
+                            VisibleChunkCompressedBytes -= iter->second.Light;
                             iter = iterSizesWorld->second.erase(iter);
                         } else {
                             ++iter;
@@ -785,6 +836,14 @@ void ServerSession::update(GlobalTime gTime, float dTime) {
                     regions[pos >> 2].Chunks[Pos::bvec4u(pos & 0x3).pack()].Nodes = std::move(data);
                 }
             }
+
+            for(auto& [wId, light] : chunks_AddOrChange_Light_Result) {
+                auto& regions = Content.Worlds[wId].Regions;
+
+                for(auto& [pos, data] : light) {
+                    regions[pos >> 2].Chunks[Pos::bvec4u(pos & 0x3).pack()].Light = data;
+                }
+            }
         }
 
         // Сущности
@@ -976,8 +1035,8 @@ coro<> ServerSession::readPacket(Net::AsyncSocket &sock) {
     case ToClient::ChunkNodes:
         co_await rP_ChunkNodes(sock);
         co_return;
-    case ToClient::ChunkLightPrism:
-        co_await rP_ChunkLightPrism(sock);
+    case ToClient::ChunkLight:
+        co_await rP_ChunkLight(sock);
         co_return;
     case ToClient::RemoveRegion:
         co_await rP_RemoveRegion(sock);
@@ -1407,8 +1466,17 @@ coro<> ServerSession::rP_ChunkNodes(Net::AsyncSocket &sock) {
     co_return;
 }
 
-coro<> ServerSession::rP_ChunkLightPrism(Net::AsyncSocket &sock) {
-    (void)sock;
+coro<> ServerSession::rP_ChunkLight(Net::AsyncSocket &sock) {
+    WorldId_t wcId = co_await sock.read<WorldId_t>();
+    Pos::GlobalChunk pos;
+    pos.unpack(co_await sock.read<Pos::GlobalChunk::Pack>());
+
+    uint32_t compressedSize = co_await sock.read<uint32_t>();
+    assert(compressedSize <= std::pow(2, 24));
+    std::u8string compressed(compressedSize, '\0');
+    co_await sock.read((std::byte*) compressed.data(), compressedSize);
+
+    AsyncContext.ThisTickEntry.Chunks_AddOrChange_Light[wcId].insert_or_assign(pos, std::move(compressed));
     co_return;
 }
 
@@ -37,6 +37,7 @@ public:
 
     void shutdown(EnumDisconnect type);
     void requestModsReload();
+    void requestLuaProfilerToggle();
 
     bool isConnected() {
         return Socket->isAlive() && IsConnected; 
@@ -141,6 +142,7 @@ private:
 
         std::unordered_map<WorldId_t, std::unordered_map<Pos::GlobalChunk, std::u8string>> Chunks_AddOrChange_Voxel;
         std::unordered_map<WorldId_t, std::unordered_map<Pos::GlobalChunk, std::u8string>> Chunks_AddOrChange_Node;
+        std::unordered_map<WorldId_t, std::unordered_map<Pos::GlobalChunk, std::u8string>> Chunks_AddOrChange_Light;
         std::unordered_map<WorldId_t, std::vector<Pos::GlobalRegion>> Regions_Lost;
         std::vector<std::pair<EntityId_t, EntityInfo>> Entity_AddOrChange;
         std::vector<EntityId_t> Entity_Lost;
@@ -149,6 +151,7 @@ private:
     struct ChunkCompressedSize {
         uint32_t Voxels = 0;
         uint32_t Nodes = 0;
+        uint32_t Light = 0;
     };
 
     struct {
@@ -202,7 +205,7 @@ private:
     coro<> rP_DefinitionsUpdate(Net::AsyncSocket &sock);
     coro<> rP_ChunkVoxels(Net::AsyncSocket &sock);
     coro<> rP_ChunkNodes(Net::AsyncSocket &sock);
-    coro<> rP_ChunkLightPrism(Net::AsyncSocket &sock);
+    coro<> rP_ChunkLight(Net::AsyncSocket &sock);
     coro<> rP_RemoveRegion(Net::AsyncSocket &sock);
     coro<> rP_Tick(Net::AsyncSocket &sock);
     coro<> rP_TestLinkCameraToEntity(Net::AsyncSocket &sock);
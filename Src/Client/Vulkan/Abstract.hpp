@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <cstring>
+#include <functional>
 
 /*
     Воксели рендерятся точками, которые распаковываются в квадратные плоскости
@@ -50,3 +51,17 @@ struct NodeVertexStatic {
 };
 
 }
+
+namespace std {
+    template<>
+    struct hash<LV::Client::VK::NodeVertexStatic> {
+        size_t operator()(const LV::Client::VK::NodeVertexStatic& v) const {
+            const uint32_t* ptr = reinterpret_cast<const uint32_t*>(&v);
+            size_t h1 = std::hash<uint32_t>{}(ptr[0]);
+            size_t h2 = std::hash<uint32_t>{}(ptr[1]);
+            size_t h3 = std::hash<uint32_t>{}(ptr[2]);
+
+            return h1 ^ (h2 << 1) ^ (h3 << 2);
+        }
+    };
+}
@@ -0,0 +1,450 @@
+// AtlasPacker.hpp
+#pragma once
+
+/*
+  Упаковщики прямоугольников для слоёв TextureAtlas.
+  Не зависят от Vulkan: атлас хранит по LayerPacker на слой и только
+  спрашивает у них координаты.
+*/
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+namespace AtlasPacking {
+
+// Алгоритм упаковки текстур в слой
+enum class AtlasPacker {
+  MaxRects,   // best area fit, точнее на разнородных размерах, но дорогая вставка/освобождение
+  Skyline     // skyline bottom-left + индексированная карта отходов, быстрая вставка тысяч мелких текстур
+};
+
+// ============================= MaxRects packer =============================
+
+struct Rect {
+  uint32_t X = 0, Y = 0, W = 0, H = 0;
+};
+
+struct MaxRectsBin {
+  uint32_t Width = 0;
+  uint32_t Height = 0;
+  std::vector<Rect> FreeRects;
+
+  void reset(uint32_t w, uint32_t h) {
+    Width = w; Height = h;
+    FreeRects.clear();
+    FreeRects.push_back(Rect{0,0,w,h});
+  }
+
+  static bool _contains(const Rect& a, const Rect& b) {
+    return b.X >= a.X && b.Y >= a.Y &&
+           (b.X + b.W) <= (a.X + a.W) &&
+           (b.Y + b.H) <= (a.Y + a.H);
+  }
+
+  static bool _intersects(const Rect& a, const Rect& b) {
+    return !(b.X >= a.X + a.W || b.X + b.W <= a.X ||
+             b.Y >= a.Y + a.H || b.Y + b.H <= a.Y);
+  }
+
+  void _prune() {
+    // удаляем прямоугольники, которые содержатся в других
+    for(size_t i = 0; i < FreeRects.size(); ++i) {
+      for(size_t j = i + 1; j < FreeRects.size();) {
+        if(_contains(FreeRects[i], FreeRects[j])) {
+          FreeRects.erase(FreeRects.begin() + j);
+        } else if(_contains(FreeRects[j], FreeRects[i])) {
+          FreeRects.erase(FreeRects.begin() + i);
+          --i;
+          break;
+        } else {
+          ++j;
+        }
+      }
+    }
+  }
+
+  std::optional<Rect> insert(uint32_t w, uint32_t h) {
+    // Best Area Fit
+    size_t bestIdx = std::numeric_limits<size_t>::max();
+    uint64_t bestAreaWaste = std::numeric_limits<uint64_t>::max();
+    uint32_t bestShortSide = std::numeric_limits<uint32_t>::max();
+
+    for(size_t i = 0; i < FreeRects.size(); ++i) {
+      const Rect& r = FreeRects[i];
+      if(w <= r.W && h <= r.H) {
+        const uint64_t waste = static_cast<uint64_t>(r.W) * r.H - static_cast<uint64_t>(w) * h;
+        const uint32_t shortSide = std::min(r.W - w, r.H - h);
+        if(waste < bestAreaWaste || (waste == bestAreaWaste && shortSide < bestShortSide)) {
+          bestAreaWaste = waste;
+          bestShortSide = shortSide;
+          bestIdx = i;
+        }
+      }
+    }
+
+    if(bestIdx == std::numeric_limits<size_t>::max()) {
+      return std::nullopt;
+    }
+
+    Rect placed{ FreeRects[bestIdx].X, FreeRects[bestIdx].Y, w, h };
+    _splitFree(placed);
+    _prune();
+    return placed;
+  }
+
+  void _splitFree(const Rect& used) {
+    std::vector<Rect> newFree;
+    newFree.reserve(FreeRects.size() * 2);
+
+    for(const Rect& fr : FreeRects) {
+      if(!_intersects(fr, used)) {
+        newFree.push_back(fr);
+        continue;
+      }
+
+      // сверху
+      if(used.Y > fr.Y) {
+        newFree.push_back(Rect{ fr.X, fr.Y, fr.W, used.Y - fr.Y });
+      }
+      // снизу
+      if(used.Y + used.H < fr.Y + fr.H) {
+        newFree.push_back(Rect{ fr.X, used.Y + used.H, fr.W,
+                                (fr.Y + fr.H) - (used.Y + used.H) });
+      }
+      // слева
+      if(used.X > fr.X) {
+        const uint32_t x = fr.X;
+        const uint32_t y = std::max(fr.Y, used.Y);
+        const uint32_t h = std::min(fr.Y + fr.H, used.Y + used.H) - y;
+        newFree.push_back(Rect{ x, y, used.X - fr.X, h });
+      }
+      // справа
+      if(used.X + used.W < fr.X + fr.W) {
+        const uint32_t x = used.X + used.W;
+        const uint32_t y = std::max(fr.Y, used.Y);
+        const uint32_t h = std::min(fr.Y + fr.H, used.Y + used.H) - y;
+        newFree.push_back(Rect{ x, y, (fr.X + fr.W) - (used.X + used.W), h });
+      }
+    }
+
+    // удаляем нулевые
+    FreeRects.clear();
+    FreeRects.reserve(newFree.size());
+    for(const Rect& r : newFree) {
+      if(r.W > 0 && r.H > 0)
+        FreeRects.push_back(r);
+    }
+  }
+
+  void free(const Rect& r) {
+    FreeRects.push_back(r);
+    _mergeAdjacent();
+    _prune();
+  }
+
+  void _mergeAdjacent() {
+    bool merged = true;
+    while (merged) {
+      merged = false;
+      for(size_t i = 0; i < FreeRects.size() && !merged; ++i) {
+        for(size_t j = i + 1; j < FreeRects.size(); ++j) {
+          Rect a = FreeRects[i];
+          Rect b = FreeRects[j];
+
+          // vertical merge
+          if(a.X == b.X && a.W == b.W) {
+            if(a.Y + a.H == b.Y) {
+              FreeRects[i] = Rect{ a.X, a.Y, a.W, a.H + b.H };
+              FreeRects.erase(FreeRects.begin() + j);
+              merged = true;
+              break;
+            } else if(b.Y + b.H == a.Y) {
+              FreeRects[i] = Rect{ b.X, b.Y, b.W, b.H + a.H };
+              FreeRects.erase(FreeRects.begin() + j);
+              merged = true;
+              break;
+            }
+          }
+
+          // horizontal merge
+          if(a.Y == b.Y && a.H == b.H) {
+            if(a.X + a.W == b.X) {
+              FreeRects[i] = Rect{ a.X, a.Y, a.W + b.W, a.H };
+              FreeRects.erase(FreeRects.begin() + j);
+              merged = true;
+              break;
+            } else if(b.X + b.W == a.X) {
+              FreeRects[i] = Rect{ b.X, b.Y, b.W + a.W, b.H };
+              FreeRects.erase(FreeRects.begin() + j);
+              merged = true;
+              break;
+            }
+          }
+        }
+      }
+    }
+  }
+};
+
+// ============================= Skyline packer =============================
+/*
+  Линия горизонта (bottom-left) + карта отходов.
+  Пространство под поставленным прямоугольником и освобождённые места уходят в карту
+  отходов, проиндексированную по классу высоты (floor(log2(H))), и переиспользуются
+  guillotine-разбиением. Вставка не требует попарной чистки свободных прямоугольников.
+*/
+
+struct SkylineBin {
+  struct Segment {
+    uint32_t X = 0, Y = 0, W = 0;
+  };
+
+  static constexpr uint32_t kHeightClasses = 16;
+
+  uint32_t Width = 0;
+  uint32_t Height = 0;
+  std::vector<Segment> Skyline;
+  std::array<std::vector<Rect>, kHeightClasses> Waste;
+
+  void reset(uint32_t w, uint32_t h) {
+    Width = w; Height = h;
+    Skyline.clear();
+    Skyline.push_back(Segment{0, 0, w});
+    for(auto& bucket : Waste)
+      bucket.clear();
+  }
+
+  static uint32_t _heightClass(uint32_t h) {
+    return std::min<uint32_t>(std::bit_width(h) - 1, kHeightClasses - 1);
+  }
+
+  std::optional<Rect> insert(uint32_t w, uint32_t h) {
+    if(w == 0 || h == 0)
+      return std::nullopt;
+
+    if(auto placed = _insertWaste(w, h))
+      return placed;
+
+    // Bottom-left: минимальная верхняя граница, при равенстве — левее
+    size_t bestIdx = std::numeric_limits<size_t>::max();
+    uint32_t bestY = 0;
+    uint32_t bestTop = std::numeric_limits<uint32_t>::max();
+
+    for(size_t i = 0; i < Skyline.size(); ++i) {
+      uint32_t y;
+      if(_fitAt(i, w, h, y) && y + h < bestTop) {
+        bestTop = y + h;
+        bestY = y;
+        bestIdx = i;
+      }
+    }
+
+    if(bestIdx == std::numeric_limits<size_t>::max())
+      return std::nullopt;
+
+    Rect placed{ Skyline[bestIdx].X, bestY, w, h };
+    occupy(placed);
+    return placed;
+  }
+
+  void free(const Rect& r) {
+    _addWaste(_mergeWaste(r));
+  }
+
+  // Занимает прямоугольник, лежащий на линии горизонта или выше неё.
+  // Перестроение по существующим размещениям должно идти в порядке возрастания Y.
+  void occupy(const Rect& r) {
+    const uint32_t end = r.X + r.W;
+    for(const Segment& seg : Skyline) {
+      const uint32_t segEnd = seg.X + seg.W;
+      if(segEnd <= r.X || seg.X >= end)
+        continue;
+      if(seg.Y < r.Y) {
+        const uint32_t x0 = std::max(seg.X, r.X);
+        const uint32_t x1 = std::min(segEnd, end);
+        _addWaste(Rect{ x0, seg.Y, x1 - x0, r.Y - seg.Y });
+      }
+    }
+
+    _raise(r.X, r.W, r.Y + r.H);
+  }
+
+  bool _fitAt(size_t i, uint32_t w, uint32_t h, uint32_t& outY) const {
+    if(Skyline[i].X + w > Width)
+      return false;
+
+    uint32_t y = 0;
+    uint32_t left = w;
+    for(size_t j = i; left > 0 && j < Skyline.size(); ++j) {
+      y = std::max(y, Skyline[j].Y);
+      if(y + h > Height)
+        return false;
+      left -= std::min(left, Skyline[j].W);
+    }
+
+    outY = y;
+    return left == 0;
+  }
+
+  void _raise(uint32_t x, uint32_t w, uint32_t top) {
+    const uint32_t end = x + w;
+    std::vector<Segment> out;
+    out.reserve(Skyline.size() + 2);
+
+    bool inserted = false;
+    for(const Segment& seg : Skyline) {
+      const uint32_t segEnd = seg.X + seg.W;
+      if(segEnd <= x) {
+        out.push_back(seg);
+        continue;
+      }
+      if(seg.X >= end) {
+        if(!inserted) {
+          out.push_back(Segment{x, top, w});
+          inserted = true;
+        }
+        out.push_back(seg);
+        continue;
+      }
+
+      if(seg.X < x)
+        out.push_back(Segment{seg.X, seg.Y, x - seg.X});
+      if(!inserted) {
+        out.push_back(Segment{x, top, w});
+        inserted = true;
+      }
+      if(segEnd > end)
+        out.push_back(Segment{end, seg.Y, segEnd - end});
+    }
+    if(!inserted)
+      out.push_back(Segment{x, top, w});
+
+    Skyline.clear();
+    for(const Segment& seg : out) {
+      if(!Skyline.empty() && Skyline.back().Y == seg.Y)
+        Skyline.back().W += seg.W;
+      else
+        Skyline.push_back(seg);
+    }
+  }
+
+  std::optional<Rect> _insertWaste(uint32_t w, uint32_t h) {
+    // В классах выше нужного подходят все по высоте, достаточно первого класса с кандидатом
+    for(uint32_t cls = _heightClass(h); cls < kHeightClasses; ++cls) {
+      std::vector<Rect>& bucket = Waste[cls];
+      size_t bestIdx = std::numeric_limits<size_t>::max();
+      uint64_t bestWaste = std::numeric_limits<uint64_t>::max();
+
+      for(size_t i = 0; i < bucket.size(); ++i) {
+        const Rect& r = bucket[i];
+        if(w <= r.W && h <= r.H) {
+          const uint64_t waste = uint64_t(r.W) * r.H - uint64_t(w) * h;
+          if(waste < bestWaste) {
+            bestWaste = waste;
+            bestIdx = i;
+          }
+        }
+      }
+
+      if(bestIdx == std::numeric_limits<size_t>::max())
+        continue;
+
+      const Rect fr = bucket[bestIdx];
+      bucket[bestIdx] = bucket.back();
+      bucket.pop_back();
+
+      // Guillotine: целым остаётся больший из остатков
+      if(fr.W - w > fr.H - h) {
+        _addWaste(Rect{ fr.X + w, fr.Y, fr.W - w, fr.H });
+        _addWaste(Rect{ fr.X, fr.Y + h, w, fr.H - h });
+      } else {
+        _addWaste(Rect{ fr.X + w, fr.Y, fr.W - w, h });
+        _addWaste(Rect{ fr.X, fr.Y + h, fr.W, fr.H - h });
+      }
+
+      return Rect{ fr.X, fr.Y, w, h };
+    }
+
+    return std::nullopt;
+  }
+
+  void _addWaste(const Rect& r) {
+    if(r.W == 0 || r.H == 0)
+      return;
+    Waste[_heightClass(r.H)].push_back(r);
+  }
+
+  // Склеивает освобождаемый прямоугольник с соседями по общей стороне
+  Rect _mergeWaste(Rect r) {
+    bool merged = true;
+    while(merged) {
+      merged = false;
+      for(auto& bucket : Waste) {
+        for(size_t i = 0; i < bucket.size(); ++i) {
+          const Rect& b = bucket[i];
+          Rect joined;
+          if(b.X == r.X && b.W == r.W && (b.Y + b.H == r.Y || r.Y + r.H == b.Y)) {
+            joined = Rect{ r.X, std::min(r.Y, b.Y), r.W, r.H + b.H };
+          } else if(b.Y == r.Y && b.H == r.H && (b.X + b.W == r.X || r.X + r.W == b.X)) {
+            joined = Rect{ std::min(r.X, b.X), r.Y, r.W + b.W, r.H };
+          } else {
+            continue;
+          }
+
+          bucket[i] = bucket.back();
+          bucket.pop_back();
+          r = joined;
+          merged = true;
+          break;
+        }
+        if(merged)
+          break;
+      }
+    }
+
+    return r;
+  }
+};
+
+// Упаковщик одного слоя атласа, алгоритм задаётся Config::Packer
+struct LayerPacker {
+  AtlasPacker Kind = AtlasPacker::MaxRects;
+  MaxRectsBin MaxRects;
+  SkylineBin Skyline;
+
+  void reset(AtlasPacker kind, uint32_t w, uint32_t h) {
+    Kind = kind;
+    if(Kind == AtlasPacker::Skyline)
+      Skyline.reset(w, h);
+    else
+      MaxRects.reset(w, h);
+  }
+
+  std::optional<Rect> insert(uint32_t w, uint32_t h) {
+    return Kind == AtlasPacker::Skyline ? Skyline.insert(w, h) : MaxRects.insert(w, h);
+  }
+
+  void free(const Rect& r) {
+    if(Kind == AtlasPacker::Skyline)
+      Skyline.free(r);
+    else
+      MaxRects.free(r);
+  }
+
+  // Отметить уже размещённый прямоугольник занятым (перестроение после роста/свапа)
+  void occupy(const Rect& r) {
+    if(Kind == AtlasPacker::Skyline) {
+      Skyline.occupy(r);
+    } else {
+      MaxRects._splitFree(r);
+      MaxRects._prune();
+    }
+  }
+};
+
+} // namespace AtlasPacking
@@ -70,11 +70,13 @@ void PipelinedTextureAtlas::freeByPipeline(const HashedPipeline& pipeline) {
 
 void PipelinedTextureAtlas::updateTexture(uint32_t texId, const StoredTexture& texture) {
     _ResToTexture[texId] = texture;
+    _TextureGenerations[texId] = ++_NextTextureGeneration;
     _ChangedTextures.push_back(texId);
 }
 
 void PipelinedTextureAtlas::updateTexture(uint32_t texId, StoredTexture&& texture) {
     _ResToTexture[texId] = std::move(texture);
+    _TextureGenerations[texId] = ++_NextTextureGeneration;
     _ChangedTextures.push_back(texId);
 }
 
@@ -83,6 +85,8 @@ void PipelinedTextureAtlas::freeTexture(uint32_t texId) {
     if (iter != _ResToTexture.end()) {
         _ResToTexture.erase(iter);
     }
+
+    _TextureGenerations.erase(texId);
 }
 
 bool PipelinedTextureAtlas::getHostTexture(TextureId texId, HostTextureView& out) const {
@@ -191,7 +195,7 @@ void PipelinedTextureAtlas::flushNewPipelines() {
         auto iterPTTI = _PipeToTexId.find(pipeline);
         assert(iterPTTI != _PipeToTexId.end());
 
-        StoredTexture texture = _generatePipelineTexture(pipeline);
+        StoredTexture texture = bakePipelineCached(pipeline);
         AtlasTextureId atlasTexId = iterPTTI->second;
         auto& stored = _AtlasCpuTextures[atlasTexId];
         stored = std::move(texture);
@@ -250,32 +254,7 @@ bool PipelinedTextureAtlas::updateAnimatedPipelines(double timeSeconds) {
         for (size_t i = 0; i < entry.Specs.size(); ++i) {
             const auto& spec = entry.Specs[i];
 
-            uint32_t fpsQ = spec.FpsQ ? spec.FpsQ : TexturePipelineProgram::DefaultAnimFpsQ;
-            double fps = double(fpsQ) / 256.0;
-            double frameTime = timeSeconds * fps;
-            if (frameTime < 0.0)
-                frameTime = 0.0;
-
-            uint32_t frameCount = spec.FrameCount;
-            // Авторасчёт количества кадров
-            if (frameCount == 0) {
-                auto iterTex = _ResToTexture.find(spec.TexId);
-                if (iterTex != _ResToTexture.end()) {
-                    uint32_t fw = spec.FrameW ? spec.FrameW : iterTex->second._Widht;
-                    uint32_t fh = spec.FrameH ? spec.FrameH : iterTex->second._Widht;
-                    if (fw > 0 && fh > 0) {
-                        if (spec.Flags & detail::AnimHorizontal)
-                            frameCount = iterTex->second._Widht / fw;
-                        else
-                            frameCount = iterTex->second._Height / fh;
-                    }
-                }
-            }
-
-            if (frameCount == 0)
-                frameCount = 1;
-
-            uint32_t frameIndex = frameCount ? (uint32_t(frameTime) % frameCount) : 0u;
+            uint32_t frameIndex = animFrameIndex(spec, timeSeconds);
             if (entry.LastFrames[i] != frameIndex) {
                 entry.LastFrames[i] = frameIndex;
                 pipelineChanged = true;
@@ -291,6 +270,94 @@ bool PipelinedTextureAtlas::updateAnimatedPipelines(double timeSeconds) {
     return changed;
 }
 
+uint32_t PipelinedTextureAtlas::animFrameCount(const detail::AnimSpec16& spec) const {
+    if (spec.FrameCount)
+        return spec.FrameCount;
+
+    // Авторасчёт по листу кадров так же, как в TexturePipelineProgram
+    auto iterTex = _ResToTexture.find(spec.TexId);
+    if (iterTex == _ResToTexture.end())
+        return 0;
+
+    const StoredTexture& sheet = iterTex->second;
+    uint32_t fw = spec.FrameW ? spec.FrameW : sheet._Widht;
+    uint32_t fh = spec.FrameH ? spec.FrameH : sheet._Height;
+    if (fw == 0 || fh == 0)
+        return 0;
+
+    uint32_t avail;
+    if (spec.Flags & detail::AnimGrid)
+        avail = (sheet._Widht / fw) * (sheet._Height / fh);
+    else if (spec.Flags & detail::AnimHorizontal)
+        avail = sheet._Widht / fw;
+    else
+        avail = sheet._Height / fh;
+
+    return std::max<uint32_t>(1u, avail);
+}
+
+uint32_t PipelinedTextureAtlas::animFrameIndex(const detail::AnimSpec16& spec, double timeSeconds) const {
+    uint32_t fpsQ = spec.FpsQ ? spec.FpsQ : TexturePipelineProgram::DefaultAnimFpsQ;
+    double fps = double(fpsQ) / 256.0;
+    double frameTime = timeSeconds * fps;
+    if (frameTime < 0.0)
+        frameTime = 0.0;
+
+    uint32_t frameCount = animFrameCount(spec);
+    return frameCount ? (uint32_t(frameTime) % frameCount) : uint32_t(frameTime);
+}
+
+StoredTexture PipelinedTextureAtlas::bakePipelineCached(const HashedPipeline& pipeline) {
+    BakeKey key;
+    key.Pipeline = pipeline;
+
+    auto iterAnim = _AnimatedPipelines.find(pipeline);
+    if (iterAnim != _AnimatedPipelines.end()) {
+        if (iterAnim->second.Smooth) {
+            return _generatePipelineTexture(pipeline);
+        }
+
+        for (const auto& spec : iterAnim->second.Specs) {
+            // Без зацикливания номер кадра растёт бесконечно и каждый кадр занимал бы кеш заново
+            if (!animFrameCount(spec))
+                return _generatePipelineTexture(pipeline);
+
+            key.Frames.push_back(animFrameIndex(spec, _AnimTimeSeconds));
+        }
+    }
+
+    for (uint32_t texId : pipeline.getDependencedTextures()) {
+        auto iterGen = _TextureGenerations.find(texId);
+        key.Generations.push_back(iterGen == _TextureGenerations.end() ? 0 : iterGen->second);
+    }
+
+    auto iter = _BakeCache.find(key);
+    if (iter != _BakeCache.end()) {
+        _BakeLru.splice(_BakeLru.end(), _BakeLru, iter->second.Lru);
+        return iter->second.Texture;
+    }
+
+    StoredTexture texture = _generatePipelineTexture(pipeline);
+    const size_t bytes = texture._Pixels.size() * sizeof(uint32_t);
+    if (bytes > kBakeCacheMaxBytes / 4) {
+        return texture;
+    }
+
+    while (_BakeCacheBytes + bytes > kBakeCacheMaxBytes && !_BakeLru.empty()) {
+        auto iterOld = _BakeCache.find(_BakeLru.front());
+        assert(iterOld != _BakeCache.end());
+        _BakeCacheBytes -= iterOld->second.Texture._Pixels.size() * sizeof(uint32_t);
+        _BakeCache.erase(iterOld);
+        _BakeLru.pop_front();
+    }
+
+    auto lru = _BakeLru.insert(_BakeLru.end(), key);
+    _BakeCache.emplace(std::move(key), BakeEntry{texture, lru});
+    _BakeCacheBytes += bytes;
+
+    return texture;
+}
+
 std::optional<StoredTexture> PipelinedTextureAtlas::tryCopyFirstDependencyTexture(const HashedPipeline& pipeline) const {
     auto deps = pipeline.getDependencedTextures();
     if (!deps.empty()) {
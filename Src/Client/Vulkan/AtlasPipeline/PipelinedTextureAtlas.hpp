@@ -7,6 +7,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <limits>
+#include <list>
 #include <optional>
 #include <unordered_map>
 #include <utility>
@@ -53,7 +54,8 @@ struct SrcRef16 {
 
 enum AnimFlags16 : Word {
     AnimSmooth = 1 << 0,
-    AnimHorizontal = 1 << 1
+    AnimHorizontal = 1 << 1,
+    AnimGrid = 1 << 2
 };
 
 struct AnimSpec16 {
@@ -417,6 +419,46 @@ private:
     std::unordered_map<HashedPipeline, AnimatedPipelineState, HashedPipelineKeyHash, HashedPipelineKeyEqual> _AnimatedPipelines;
     double _AnimTimeSeconds = 0.0;
 
+    // Поколения загруженных текстур (меняются при каждом updateTexture)
+    std::unordered_map<TextureId, uint64_t> _TextureGenerations;
+    uint64_t _NextTextureGeneration = 0;
+
+    // Кеш результатов пайплайнов: одинаковые входы и кадр дают одинаковую текстуру,
+    // поэтому циклические анимации и повторные сборки не выполняют программу заново
+    struct BakeKey {
+        HashedPipeline Pipeline;
+        // Поколения зависимых текстур в порядке getDependencedTextures()
+        boost::container::small_vector<uint64_t, 8> Generations;
+        // Текущие кадры анимаций пайплайна
+        boost::container::small_vector<uint32_t, 4> Frames;
+
+        bool operator==(const BakeKey& obj) const noexcept {
+            return Pipeline == obj.Pipeline && Generations == obj.Generations && Frames == obj.Frames;
+        }
+    };
+
+    struct BakeKeyHash {
+        std::size_t operator()(const BakeKey& k) const noexcept {
+            std::size_t hash = k.Pipeline._Hash;
+            for(uint64_t gen : k.Generations)
+                hash = (hash ^ gen) * 1099511628211ull;
+            for(uint32_t frame : k.Frames)
+                hash = (hash ^ frame) * 1099511628211ull;
+            return hash;
+        }
+    };
+
+    struct BakeEntry {
+        StoredTexture Texture;
+        std::list<BakeKey>::iterator Lru;
+    };
+
+    static constexpr size_t kBakeCacheMaxBytes = 32u << 20;
+    std::unordered_map<BakeKey, BakeEntry, BakeKeyHash> _BakeCache;
+    // Начало - давно не использованные
+    std::list<BakeKey> _BakeLru;
+    size_t _BakeCacheBytes = 0;
+
 public:
     PipelinedTextureAtlas(TextureAtlas&& tk);
 
@@ -484,6 +526,13 @@ public:
     bool updateAnimatedPipelines(double timeSeconds);
 
 private:
+    // Результат пайплайна через кеш (плавные анимации не кешируются)
+    StoredTexture bakePipelineCached(const HashedPipeline& pipeline);
+    // Число кадров, 0 - определяется только при исполнении программы (анимация результата операций)
+    uint32_t animFrameCount(const detail::AnimSpec16& spec) const;
+    // Номер кадра, без зацикливания если число кадров неизвестно
+    uint32_t animFrameIndex(const detail::AnimSpec16& spec, double timeSeconds) const;
+
     std::optional<StoredTexture> tryCopyFirstDependencyTexture(const HashedPipeline& pipeline) const;
 
     static StoredTexture makeSolidColorTexture(uint32_t rgba);
@@ -211,8 +211,12 @@ TextureAtlas::DescriptorOut TextureAtlas::flushUploadsAndBarriers(VkCommandBuffe
   if(Repack_.SwapReady) {
     _swapToRepackedAtlas();
   }
+  _maybeRequestIncrementalRepack();
   if(Repack_.Requested && !Repack_.Active) {
-    _startRepackIfPossible();
+    if(Repack_.Mode == RepackMode::Incremental)
+      _incrementalRepack(cmdBuffer);
+    else
+      _startRepackIfPossible();
   }
 
   _processPendingLayerGrow(cmdBuffer);
@@ -240,6 +244,11 @@ TextureAtlas::DescriptorOut TextureAtlas::flushUploadsAndBarriers(VkCommandBuffe
   pendingNow.reserve(Pending_.size());
   collectQueue(Pending_, PendingInQueue_, pendingNow);
 
+  // Пакетная вставка: сначала крупные, так упаковщик меньше фрагментирует слои
+  std::stable_sort(pendingNow.begin(), pendingNow.end(), [this](TextureId a, TextureId b) {
+    return _packOrderKey(a) > _packOrderKey(b);
+  });
+
   std::vector<TextureId> repackPending;
   if(Repack_.Active) {
     if(Repack_.InPending.empty()) {
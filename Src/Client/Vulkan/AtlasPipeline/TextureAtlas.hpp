@@ -47,6 +47,7 @@ TextureAtlas — как пользоваться (кратко)
 
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <cstdint>
 #include <cstring>
 #include <deque>
@@ -62,6 +63,7 @@ TextureAtlas — как пользоваться (кратко)
 
 #include <MaxRectsBinPack.h>
 
+#include "AtlasPacker.hpp"
 #include "SharedStagingBuffer.hpp"
 
 class TextureAtlas final {
@@ -71,6 +73,9 @@ public:
 
   // ----------------------------- Конфигурация -----------------------------
 
+  // Алгоритм упаковки текстур в слой
+  using AtlasPacker = AtlasPacking::AtlasPacker;
+
   struct Config {
     uint32_t MaxTextureId = 4096;        // Размер SSBO: MaxTextureId * sizeof(Entry)
     uint32_t InitialSide = 1024;         // {1024, 2048, 4096}
@@ -79,6 +84,7 @@ public:
     uint32_t MaxTextureSize = 2048;      // w,h <= 2048
     VkFilter SamplerFilter = VK_FILTER_LINEAR;
     bool SamplerAnisotropyEnable = false;
+    AtlasPacker Packer = AtlasPacker::MaxRects;
 
     // Если хотите — можно задать внешний sampler (тогда класс его НЕ уничтожает)
     VkSampler ExternalSampler = VK_NULL_HANDLE;
@@ -136,7 +142,11 @@ public:
   enum class RepackMode {
     Tightest,
     KeepCurrentCapacity,
-    AllowGrow
+    AllowGrow,
+    // Без нового атласа: содержимое наименее заполненного слоя переносится
+    // копиями внутри атласа в свободное место остальных слоёв (не более kIncrementalMoveBudget за раз).
+    // Запрашивается и автоматически, когда после удалений один из слоёв почти пуст
+    Incremental
   };
 
   // ----------------------------- Жизненный цикл -----------------------------
@@ -347,6 +357,11 @@ private:
   // ============================= Vulkan ресурсы =============================
 
   static constexpr VkDeviceSize kStagingSizeBytes = 64ull * 1024ull * 1024ull;
+  static constexpr uint32_t kIncrementalMoveBudget = 256;
+  // Проверка фрагментации запускается, когда освобождено не меньше этой доли слоя
+  static constexpr double kIncrementalCheckFreed = 0.25;
+  // Слой заполненный меньше этой доли считается кандидатом на расселение
+  static constexpr double kIncrementalSparseFill = 0.25;
 
   struct BufferRes {
     VkBuffer Buffer = VK_NULL_HANDLE;
@@ -363,173 +378,10 @@ private:
     uint32_t Layers = 0;
   };
 
-  // ============================= MaxRects packer =============================
-
-  struct Rect {
-    uint32_t X = 0, Y = 0, W = 0, H = 0;
-  };
-
-  struct MaxRectsBin {
-    uint32_t Width = 0;
-    uint32_t Height = 0;
-    std::vector<Rect> FreeRects;
-
-    void reset(uint32_t w, uint32_t h) {
-      Width = w; Height = h;
-      FreeRects.clear();
-      FreeRects.push_back(Rect{0,0,w,h});
-    }
-
-    static bool _contains(const Rect& a, const Rect& b) {
-      return b.X >= a.X && b.Y >= a.Y &&
-             (b.X + b.W) <= (a.X + a.W) &&
-             (b.Y + b.H) <= (a.Y + a.H);
-    }
-
-    static bool _intersects(const Rect& a, const Rect& b) {
-      return !(b.X >= a.X + a.W || b.X + b.W <= a.X ||
-               b.Y >= a.Y + a.H || b.Y + b.H <= a.Y);
-    }
-
-    void _prune() {
-      // удаляем прямоугольники, которые содержатся в других
-      for(size_t i = 0; i < FreeRects.size(); ++i) {
-        for(size_t j = i + 1; j < FreeRects.size();) {
-          if(_contains(FreeRects[i], FreeRects[j])) {
-            FreeRects.erase(FreeRects.begin() + j);
-          } else if(_contains(FreeRects[j], FreeRects[i])) {
-            FreeRects.erase(FreeRects.begin() + i);
-            --i;
-            break;
-          } else {
-            ++j;
-          }
-        }
-      }
-    }
-
-    std::optional<Rect> insert(uint32_t w, uint32_t h) {
-      // Best Area Fit
-      size_t bestIdx = std::numeric_limits<size_t>::max();
-      uint64_t bestAreaWaste = std::numeric_limits<uint64_t>::max();
-      uint32_t bestShortSide = std::numeric_limits<uint32_t>::max();
-
-      for(size_t i = 0; i < FreeRects.size(); ++i) {
-        const Rect& r = FreeRects[i];
-        if(w <= r.W && h <= r.H) {
-          const uint64_t waste = static_cast<uint64_t>(r.W) * r.H - static_cast<uint64_t>(w) * h;
-          const uint32_t shortSide = std::min(r.W - w, r.H - h);
-          if(waste < bestAreaWaste || (waste == bestAreaWaste && shortSide < bestShortSide)) {
-            bestAreaWaste = waste;
-            bestShortSide = shortSide;
-            bestIdx = i;
-          }
-        }
-      }
-
-      if(bestIdx == std::numeric_limits<size_t>::max()) {
-        return std::nullopt;
-      }
-
-      Rect placed{ FreeRects[bestIdx].X, FreeRects[bestIdx].Y, w, h };
-      _splitFree(placed);
-      _prune();
-      return placed;
-    }
-
-    void _splitFree(const Rect& used) {
-      std::vector<Rect> newFree;
-      newFree.reserve(FreeRects.size() * 2);
-
-      for(const Rect& fr : FreeRects) {
-        if(!_intersects(fr, used)) {
-          newFree.push_back(fr);
-          continue;
-        }
-
-        // сверху
-        if(used.Y > fr.Y) {
-          newFree.push_back(Rect{ fr.X, fr.Y, fr.W, used.Y - fr.Y });
-        }
-        // снизу
-        if(used.Y + used.H < fr.Y + fr.H) {
-          newFree.push_back(Rect{ fr.X, used.Y + used.H, fr.W,
-                                  (fr.Y + fr.H) - (used.Y + used.H) });
-        }
-        // слева
-        if(used.X > fr.X) {
-          const uint32_t x = fr.X;
-          const uint32_t y = std::max(fr.Y, used.Y);
-          const uint32_t h = std::min(fr.Y + fr.H, used.Y + used.H) - y;
-          newFree.push_back(Rect{ x, y, used.X - fr.X, h });
-        }
-        // справа
-        if(used.X + used.W < fr.X + fr.W) {
-          const uint32_t x = used.X + used.W;
-          const uint32_t y = std::max(fr.Y, used.Y);
-          const uint32_t h = std::min(fr.Y + fr.H, used.Y + used.H) - y;
-          newFree.push_back(Rect{ x, y, (fr.X + fr.W) - (used.X + used.W), h });
-        }
-      }
-
-      // удаляем нулевые
-      FreeRects.clear();
-      FreeRects.reserve(newFree.size());
-      for(const Rect& r : newFree) {
-        if(r.W > 0 && r.H > 0)
-          FreeRects.push_back(r);
-      }
-    }
-
-    void free(const Rect& r) {
-      FreeRects.push_back(r);
-      _mergeAdjacent();
-      _prune();
-    }
-
-    void _mergeAdjacent() {
-      bool merged = true;
-      while (merged) {
-        merged = false;
-        for(size_t i = 0; i < FreeRects.size() && !merged; ++i) {
-          for(size_t j = i + 1; j < FreeRects.size(); ++j) {
-            Rect a = FreeRects[i];
-            Rect b = FreeRects[j];
-
-            // vertical merge
-            if(a.X == b.X && a.W == b.W) {
-              if(a.Y + a.H == b.Y) {
-                FreeRects[i] = Rect{ a.X, a.Y, a.W, a.H + b.H };
-                FreeRects.erase(FreeRects.begin() + j);
-                merged = true;
-                break;
-              } else if(b.Y + b.H == a.Y) {
-                FreeRects[i] = Rect{ b.X, b.Y, b.W, b.H + a.H };
-                FreeRects.erase(FreeRects.begin() + j);
-                merged = true;
-                break;
-              }
-            }
-
-            // horizontal merge
-            if(a.Y == b.Y && a.H == b.H) {
-              if(a.X + a.W == b.X) {
-                FreeRects[i] = Rect{ a.X, a.Y, a.W + b.W, a.H };
-                FreeRects.erase(FreeRects.begin() + j);
-                merged = true;
-                break;
-              } else if(b.X + b.W == a.X) {
-                FreeRects[i] = Rect{ b.X, b.Y, b.W + a.W, b.H };
-                FreeRects.erase(FreeRects.begin() + j);
-                merged = true;
-                break;
-              }
-            }
-          }
-        }
-      }
-    }
-  };
+  // Упаковщики слоёв — AtlasPacker.hpp
+  using Rect = AtlasPacking::Rect;
+  using SkylineBin = AtlasPacking::SkylineBin;
+  using LayerPacker = AtlasPacking::LayerPacker;
 
   // ============================= Repack state =============================
 
@@ -732,6 +584,16 @@ private:
     return false;
   }
 
+  // Порядок пакетной вставки по убыванию: MaxRects — по площади, Skyline — по высоте, затем по ширине
+  uint64_t _packOrderKey(TextureId id) const {
+    const Slot& s = Slots_[id];
+    const uint64_t wP = s.W + 2u * Cfg_.PaddingPx;
+    const uint64_t hP = s.H + 2u * Cfg_.PaddingPx;
+    if(Cfg_.Packer == AtlasPacker::Skyline)
+      return (hP << 32) | wP;
+    return wP * hP;
+  }
+
   bool _tryPlaceInExistingLayers(TextureId id, uint32_t wP, uint32_t hP) {
     for(uint32_t layer = 0; layer < Atlas_.Layers; ++layer) {
       auto placed = Packers_[layer].insert(wP, hP);
@@ -860,6 +722,7 @@ private:
     if(s.Place.Layer < Packers_.size()) {
       Packers_[s.Place.Layer].free(Rect{s.Place.X, s.Place.Y, s.Place.WP, s.Place.HP});
     }
+    FreedAreaSinceCheck_ += uint64_t(s.Place.WP) * s.Place.HP;
     s.HasPlacement = false;
     s.Place = Placement{};
     s.StateWasValid = false;
@@ -869,29 +732,28 @@ private:
     Packers_.clear();
     Packers_.resize(Atlas_.Layers);
     for(uint32_t l = 0; l < Atlas_.Layers; ++l) {
-      Packers_[l].reset(Atlas_.Side, Atlas_.Side);
+      Packers_[l].reset(Cfg_.Packer, Atlas_.Side, Atlas_.Side);
     }
 
-    // Занимаем прямоугольники: проще "вставить" их, временно сбросив FreeRects и применив split.
-    // Здесь делаем упрощённо: для каждого placement просто "split free" через Insert (в том же месте нельзя),
-    // поэтому вместо этого: удаляем из free списка все пересечения и добавляем остатки — сложно.
-    // Практичный компромисс: строим "новый packer" через последовательные Insert в порядке убывания площади,
-    // сохраняя уже существующие координаты нельзя. Поэтому делаем корректнее:
-    // - Создадим маску занятости списком usedRects, а затем выведем FreeRects как "полосы" — это сложно.
-    //
-    // В этой реализации: после роста/свапа мы допускаем, что packer не обязан идеально отражать текущее заполнение,
-    // и рекомендуем пользователю при сильной фрагментации вызывать requestFullRepack().
-    //
-    // Однако, чтобы не потерять место полностью, добавим занятые как "запрещённые" через SplitFree_ вручную.
+    // Занимаем текущие размещения. Skyline требует порядка по возрастанию Y,
+    // тогда пустоты под прямоугольниками попадают в карту отходов без пересечений.
+    std::vector<std::pair<uint32_t, Rect>> used;
     for(TextureId id = 0; id < Cfg_.MaxTextureId; ++id) {
       const Slot& s = Slots_[id];
       if(!s.InUse || !s.HasPlacement) continue;
       if(s.Place.Layer >= Packers_.size()) continue;
-      // имитируем занятие used (не проверяем пересечения — считаем, что данных не битые)
-      MaxRectsBin& bin = Packers_[s.Place.Layer];
-      bin._splitFree(Rect{s.Place.X, s.Place.Y, s.Place.WP, s.Place.HP});
-      bin._prune();
+      used.emplace_back(s.Place.Layer, Rect{s.Place.X, s.Place.Y, s.Place.WP, s.Place.HP});
     }
+
+    if(Cfg_.Packer == AtlasPacker::Skyline) {
+      std::sort(used.begin(), used.end(), [](const auto& a, const auto& b) {
+        return a.second.Y < b.second.Y;
+      });
+    }
+
+    // не проверяем пересечения — считаем, что данные не битые
+    for(const auto& [layer, rect] : used)
+      Packers_[layer].occupy(rect);
   }
 
   // ============================= Padding edge-extend =============================
@@ -956,6 +818,9 @@ private:
     if(side == 0 || layers == 0) 
       return false;
 
+    if(Cfg_.Packer == AtlasPacker::Skyline)
+      return _tryPackWithSkyline(side, layers, ids, outPlan);
+
     std::vector<rbp::MaxRectsBinPack> bins;
     bins.reserve(layers);
     for(uint32_t l = 0; l < layers; ++l)
@@ -997,6 +862,41 @@ private:
     return true;
   }
 
+  bool _tryPackWithSkyline(uint32_t side,
+                           uint32_t layers,
+                           const std::vector<TextureId>& ids,
+                           std::unordered_map<TextureId, PlannedPlacement>& outPlan)
+  {
+    std::vector<SkylineBin> bins(layers);
+    for(SkylineBin& bin : bins)
+      bin.reset(side, side);
+
+    outPlan.clear();
+    outPlan.reserve(ids.size());
+
+    for(TextureId id : ids) {
+      const Slot& s = Slots_[id];
+      const uint32_t wP = s.W + 2u * Cfg_.PaddingPx;
+      const uint32_t hP = s.H + 2u * Cfg_.PaddingPx;
+
+      bool placed = false;
+      for(uint32_t layer = 0; layer < layers; ++layer) {
+        if(auto rect = bins[layer].insert(wP, hP)) {
+          outPlan[id] = PlannedPlacement{rect->X, rect->Y, wP, hP, layer};
+          placed = true;
+          break;
+        }
+      }
+
+      if(!placed) {
+        outPlan.clear();
+        return false;
+      }
+    }
+
+    return true;
+  }
+
   // ============================= Repack =============================
 
   void _startRepackIfPossible() {
@@ -1017,13 +917,9 @@ private:
       return;
     }
 
-    // сортировка по площади убыванию (wP*hP)
+    // сначала крупные (см. _packOrderKey)
     std::sort(ids.begin(), ids.end(), [&](TextureId a, TextureId b) {
-      const Slot& A = Slots_[a];
-      const Slot& B = Slots_[b];
-      const uint64_t areaA = uint64_t(A.W + 2u*Cfg_.PaddingPx) * uint64_t(A.H + 2u*Cfg_.PaddingPx);
-      const uint64_t areaB = uint64_t(B.W + 2u*Cfg_.PaddingPx) * uint64_t(B.H + 2u*Cfg_.PaddingPx);
-      return areaA > areaB;
+      return _packOrderKey(a) > _packOrderKey(b);
     });
 
     // Выбираем capacity по mode
@@ -1123,6 +1019,149 @@ private:
     _emitEventOncePerFlush(AtlasEvent::RepackStarted);
   }
 
+  /*
+    Частичный репак без нового атласа: из наименее заполненного слоя переносим
+    до kIncrementalMoveBudget текстур в свободное место других слоёв копией внутри атласа.
+    Entries обновляются в том же Flush, перезаливка из CPU не нужна.
+  */
+  std::vector<uint64_t> _usedAreaPerLayer() const {
+    std::vector<uint64_t> usedArea(Atlas_.Layers, 0);
+    for(TextureId id = 0; id < Cfg_.MaxTextureId; ++id) {
+      const Slot& s = Slots_[id];
+      if(!s.InUse || !s.HasPlacement || s.Place.Layer >= Atlas_.Layers) continue;
+      usedArea[s.Place.Layer] += uint64_t(s.Place.WP) * s.Place.HP;
+    }
+    return usedArea;
+  }
+
+  static uint32_t _leastUsedLayer(const std::vector<uint64_t>& usedArea) {
+    uint32_t source = 0;
+    for(uint32_t layer = 1; layer < usedArea.size(); ++layer) {
+      if(usedArea[layer] < usedArea[source])
+        source = layer;
+    }
+    return source;
+  }
+
+  /*
+    Автоматический запрос частичного репака. После удалений слои остаются
+    полупустыми: если наименее заполненный слой почти пуст и его содержимое
+    помещается в свободное место остальных, запрашиваем RepackMode::Incremental.
+    Слоты сканируются только после освобождения заметной площади.
+  */
+  void _maybeRequestIncrementalRepack() {
+    if(Repack_.Requested || Repack_.Active || Atlas_.Layers < 2)
+      return;
+
+    const uint64_t layerArea = uint64_t(Atlas_.Side) * Atlas_.Side;
+    if(FreedAreaSinceCheck_ < uint64_t(layerArea * kIncrementalCheckFreed))
+      return;
+    FreedAreaSinceCheck_ = 0;
+
+    std::vector<uint64_t> usedArea = _usedAreaPerLayer();
+    uint32_t source = _leastUsedLayer(usedArea);
+    if(usedArea[source] == 0 || usedArea[source] > uint64_t(layerArea * kIncrementalSparseFill))
+      return;
+
+    uint64_t freeElsewhere = 0;
+    for(uint32_t layer = 0; layer < Atlas_.Layers; ++layer) {
+      if(layer != source)
+        freeElsewhere += layerArea - std::min(layerArea, usedArea[layer]);
+    }
+    if(freeElsewhere < usedArea[source])
+      return;
+
+    Repack_.Requested = true;
+    Repack_.Mode = RepackMode::Incremental;
+  }
+
+  void _incrementalRepack(VkCommandBuffer cmdBuffer) {
+    Repack_.Requested = false;
+    if(Atlas_.Layers < 2 || Atlas_.Layout == VK_IMAGE_LAYOUT_UNDEFINED)
+      return;
+
+    std::vector<uint64_t> usedArea = _usedAreaPerLayer();
+    uint32_t source = _leastUsedLayer(usedArea);
+    if(usedArea[source] == 0)
+      return;
+
+    std::vector<TextureId> ids;
+    for(TextureId id = 0; id < Cfg_.MaxTextureId; ++id) {
+      const Slot& s = Slots_[id];
+      if(s.InUse && s.HasPlacement && s.Place.Layer == source && s.StateValue == State::VALID)
+        ids.push_back(id);
+    }
+
+    std::sort(ids.begin(), ids.end(), [&](TextureId a, TextureId b) {
+      return _packOrderKey(a) > _packOrderKey(b);
+    });
+    if(ids.size() > kIncrementalMoveBudget)
+      ids.resize(kIncrementalMoveBudget);
+
+    std::vector<VkImageCopy> copies;
+    copies.reserve(ids.size());
+
+    for(TextureId id : ids) {
+      Slot& s = Slots_[id];
+      for(uint32_t layer = 0; layer < Atlas_.Layers; ++layer) {
+        if(layer == source) continue;
+        auto placed = Packers_[layer].insert(s.Place.WP, s.Place.HP);
+        if(!placed) continue;
+
+        VkImageCopy copy{};
+        copy.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copy.srcSubresource.mipLevel = 0;
+        copy.srcSubresource.baseArrayLayer = source;
+        copy.srcSubresource.layerCount = 1;
+        copy.srcOffset = { static_cast<int32_t>(s.Place.X), static_cast<int32_t>(s.Place.Y), 0 };
+        copy.dstSubresource = copy.srcSubresource;
+        copy.dstSubresource.baseArrayLayer = layer;
+        copy.dstOffset = { static_cast<int32_t>(placed->X), static_cast<int32_t>(placed->Y), 0 };
+        copy.extent = { s.Place.WP, s.Place.HP, 1 };
+        copies.push_back(copy);
+
+        Packers_[source].free(Rect{s.Place.X, s.Place.Y, s.Place.WP, s.Place.HP});
+        s.Place = Placement{ placed->X, placed->Y, s.Place.WP, s.Place.HP, layer };
+        _setEntryValid(id);
+        break;
+      }
+    }
+
+    if(copies.empty())
+      return;
+
+    // Бюджет исчерпан — в слое ещё остались текстуры, продолжим в следующем Flush
+    if(copies.size() == kIncrementalMoveBudget) {
+      Repack_.Requested = true;
+      Repack_.Mode = RepackMode::Incremental;
+    }
+
+    EntriesDirty_ = true;
+    _emitEventOncePerFlush(AtlasEvent::RepackStarted);
+
+    // Источник и приёмник — один image, области в разных слоях не пересекаются
+    _transitionImage(cmdBuffer, Atlas_,
+                     VK_IMAGE_LAYOUT_GENERAL,
+                     VK_ACCESS_SHADER_READ_BIT,
+                     VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+                     VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                     VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    vkCmdCopyImage(cmdBuffer,
+                   Atlas_.Image, VK_IMAGE_LAYOUT_GENERAL,
+                   Atlas_.Image, VK_IMAGE_LAYOUT_GENERAL,
+                   static_cast<uint32_t>(copies.size()), copies.data());
+
+    _transitionImage(cmdBuffer, Atlas_,
+                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                     VK_ACCESS_TRANSFER_WRITE_BIT,
+                     VK_ACCESS_SHADER_READ_BIT,
+                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+                     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+    _emitEventOncePerFlush(AtlasEvent::RepackFinished);
+  }
+
   void _swapToRepackedAtlas() {
     // Переключаем текущий atlas на Repack_.Atlas, а старый — в deferred destroy
     DeferredImages_.push_back(Atlas_);
@@ -1433,7 +1472,7 @@ private:
   std::vector<bool> PendingInQueue_ = std::vector<bool>(Cfg_.MaxTextureId, false);
 
   // packer по слоям
-  std::vector<MaxRectsBin> Packers_;
+  std::vector<LayerPacker> Packers_;
 
   // deferred destroy старых атласов
   std::vector<ImageRes> DeferredImages_;
@@ -1445,6 +1484,9 @@ private:
   // рост индикатор
   bool GrewThisFlush_ = false;
 
+  // Площадь, освобождённая с последней проверки фрагментации
+  uint64_t FreedAreaSinceCheck_ = 0;
+
   // repack state
   RepackState Repack_;
 };
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+
+namespace LV::Client::VK {
+
+// 128 бит содержимого чанка. Две независимые линии, чтобы коллизия была практически невозможна
+struct ChunkContentKey {
+    uint64_t A = 0, B = 0;
+
+    bool operator==(const ChunkContentKey&) const = default;
+};
+
+struct ChunkContentKeyHash {
+    size_t operator()(const ChunkContentKey& key) const {
+        return size_t(key.A ^ std::rotl(key.B, 31));
+    }
+};
+
+// Потоковое хеширование того, от чего зависит меш чанка
+class ChunkContentHasher {
+public:
+    void add(uint64_t value) {
+        A = std::rotl((A ^ value) * 0x9e3779b97f4a7c15ull, 27);
+        B = (B + value) * 0xc2b2ae3d27d4eb4full;
+        B ^= B >> 29;
+    }
+
+    ChunkContentKey finish() const {
+        return {fmix(A ^ Count), fmix(B + Count)};
+    }
+
+    template<typename T>
+    void addWords(const T* data, size_t count) requires (sizeof(T) == 4) {
+        const uint32_t* words = reinterpret_cast<const uint32_t*>(data);
+        size_t iter = 0;
+        for(; iter+1 < count; iter += 2)
+            add(uint64_t(words[iter]) | (uint64_t(words[iter+1]) << 32));
+
+        if(iter < count)
+            add(words[iter]);
+
+        Count += count;
+    }
+
+private:
+    uint64_t A = 0x243f6a8885a308d3ull, B = 0x13198a2e03707344ull;
+    uint64_t Count = 0;
+
+    static uint64_t fmix(uint64_t k) {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdull;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ull;
+        k ^= k >> 33;
+        return k;
+    }
+};
+
+/*
+    LRU готовых мешей чанков по хешу содержимого.
+    Ограничение задаётся в байтах, размер записи сообщает вставляющий.
+    К записи прикладывается отсортированный список того, от чего меш зависит помимо содержимого
+    (профили нод и вокселей), evict удаляет только записи с изменившимися зависимостями.
+    Потокобезопасен, записи неизменяемы и раздаются через shared_ptr.
+*/
+template<typename Mesh>
+class ChunkMeshCache {
+public:
+    struct Stats {
+        size_t Entries = 0, Bytes = 0;
+        uint64_t Hits = 0, Misses = 0;
+    };
+
+    explicit ChunkMeshCache(size_t maxBytes)
+        : MaxBytes(maxBytes)
+    {}
+
+    std::shared_ptr<const Mesh> find(const ChunkContentKey& key) {
+        std::lock_guard lock(Mutex);
+        auto iter = Index.find(key);
+        if(iter == Index.end()) {
+            Misses++;
+            return nullptr;
+        }
+
+        Hits++;
+        Lru.splice(Lru.begin(), Lru, iter->second);
+        return iter->second->Value;
+    }
+
+    void insert(const ChunkContentKey& key, std::shared_ptr<const Mesh> value, size_t bytes, std::vector<uint64_t> deps = {}) {
+        if(bytes > MaxBytes)
+            return;
+
+        std::lock_guard lock(Mutex);
+        if(auto iter = Index.find(key); iter != Index.end()) {
+            Bytes -= iter->second->Bytes;
+            Lru.erase(iter->second);
+            Index.erase(iter);
+        }
+
+        Lru.push_front({key, std::move(value), bytes, std::move(deps)});
+        Index.emplace(key, Lru.begin());
+        Bytes += bytes;
+
+        while(Bytes > MaxBytes) {
+            Bytes -= Lru.back().Bytes;
+            Index.erase(Lru.back().Key);
+            Lru.pop_back();
+        }
+    }
+
+    // Удаляет записи, зависящие хотя бы от одного из changed, возвращает их число
+    size_t evict(const std::unordered_set<uint64_t>& changed) {
+        std::lock_guard lock(Mutex);
+        size_t count = 0;
+        for(auto iter = Lru.begin(); iter != Lru.end();) {
+            bool hit = false;
+            for(uint64_t dep : iter->Deps) {
+                if(changed.contains(dep)) {
+                    hit = true;
+                    break;
+                }
+            }
+
+            if(!hit) {
+                ++iter;
+                continue;
+            }
+
+            Bytes -= iter->Bytes;
+            Index.erase(iter->Key);
+            iter = Lru.erase(iter);
+            count++;
+        }
+
+        return count;
+    }
+
+    void clear() {
+        std::lock_guard lock(Mutex);
+        Lru.clear();
+        Index.clear();
+        Bytes = 0;
+    }
+
+    Stats stats() const {
+        std::lock_guard lock(Mutex);
+        return {Index.size(), Bytes, Hits, Misses};
+    }
+
+private:
+    struct Item {
+        ChunkContentKey Key;
+        std::shared_ptr<const Mesh> Value;
+        size_t Bytes;
+        std::vector<uint64_t> Deps;
+    };
+
+    mutable std::mutex Mutex;
+    std::list<Item> Lru;
+    std::unordered_map<ChunkContentKey, typename std::list<Item>::iterator, ChunkContentKeyHash> Index;
+    size_t MaxBytes, Bytes = 0;
+    uint64_t Hits = 0, Misses = 0;
+};
+
+}
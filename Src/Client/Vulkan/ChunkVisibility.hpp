@@ -0,0 +1,162 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+
+namespace LV::Client::VK {
+
+/*
+    Связность сторон чанка для отсечения невидимых пещер.
+    Стороны нумеруются как соседи в генераторе мешей: +X, -X, +Y, -Y, +Z, -Z.
+    Две стороны связаны, если между ними есть путь по неполным нодам внутри чанка.
+    На каждую неупорядоченную пару сторон отводится один бит (всего 15).
+*/
+
+static constexpr uint16_t CHUNK_FACES_ALL_CONNECTED = 0x7fff;
+
+constexpr int chunkFacePairBit(int a, int b) {
+    if(a > b)
+        std::swap(a, b);
+
+    return a*(11-a)/2 + b - a - 1;
+}
+
+constexpr int chunkOppositeFace(int face) {
+    return face ^ 1;
+}
+
+inline bool chunkFacesConnected(uint16_t connectivity, int a, int b) {
+    return a == b || ((connectivity >> chunkFacePairBit(a, b)) & 1);
+}
+
+// full - карта полных нод генератора мешей, с рамкой соседей (чанк в индексах 1..16)
+inline uint16_t computeChunkFaceConnectivity(const uint8_t full[18][18][18]) {
+    uint16_t result = 0;
+    std::bitset<16*16*16> visited;
+    uint16_t stack[16*16*16];
+
+    for(int start = 0; start < 16*16*16; start++) {
+        if(visited.test(start))
+            continue;
+
+        int sx = start & 0xf, sy = (start >> 4) & 0xf, sz = start >> 8;
+        if(full[sx+1][sy+1][sz+1])
+            continue;
+
+        uint8_t faces = 0;
+        int top = 0;
+        stack[top++] = start;
+        visited.set(start);
+
+        while(top) {
+            int index = stack[--top];
+            int x = index & 0xf, y = (index >> 4) & 0xf, z = index >> 8;
+
+            if(x == 15) faces |= 1 << 0;
+            if(x == 0) faces |= 1 << 1;
+            if(y == 15) faces |= 1 << 2;
+            if(y == 0) faces |= 1 << 3;
+            if(z == 15) faces |= 1 << 4;
+            if(z == 0) faces |= 1 << 5;
+
+            auto visit = [&](int nx, int ny, int nz) {
+                if(nx < 0 || nx > 15 || ny < 0 || ny > 15 || nz < 0 || nz > 15)
+                    return;
+
+                int next = nx | (ny << 4) | (nz << 8);
+                if(visited.test(next) || full[nx+1][ny+1][nz+1])
+                    return;
+
+                visited.set(next);
+                stack[top++] = next;
+            };
+
+            visit(x+1, y, z);
+            visit(x-1, y, z);
+            visit(x, y+1, z);
+            visit(x, y-1, z);
+            visit(x, y, z+1);
+            visit(x, y, z-1);
+        }
+
+        for(int a = 0; a < 6; a++)
+            for(int b = a+1; b < 6; b++)
+                if(((faces >> a) & 1) && ((faces >> b) & 1))
+                    result |= 1 << chunkFacePairBit(a, b);
+
+        if(result == CHUNK_FACES_ALL_CONNECTED)
+            break;
+    }
+
+    return result;
+}
+
+// Шаг обхода видимости
+struct ChunkVisibilityStep {
+    // Индекс чанка в кубе обхода: x + (y + z*sideY)*sideX
+    int Index;
+    // Сторона, через которую вошли в чанк (-1 у начального)
+    int8_t EntryFace;
+    // Пройденные направления
+    uint8_t Directions;
+};
+
+/*
+    Обход видимости от чанка start по соседям через стороны (cave culling) в ширину,
+    внутри параллелепипеда sideX x sideY x sideZ чанков.
+    В соседа переходим, если сторона входа в текущий чанк связана со стороной выхода
+    и направление не противоположно уже пройденным (путь взгляда не разворачивается).
+    visit(step, x, y, z) вызывается для каждого чанка из очереди и возвращает связность его сторон,
+    либо std::nullopt, если чанк отсечён и обход через него не идёт.
+    Без occlusion обход проходит все достижимые чанки без учёта связности.
+    visited и queue - рабочие буферы вызывающего, queue после обхода содержит пройденные шаги
+*/
+template<typename Visit>
+void traverseChunkVisibility(int sideX, int sideY, int sideZ, int start, bool occlusion,
+    std::vector<uint8_t>& visited, std::vector<ChunkVisibilityStep>& queue, Visit&& visit)
+{
+    static constexpr int8_t faceStep[6][3] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+
+    visited.assign(size_t(sideX)*sideY*sideZ, 0);
+    queue.clear();
+
+    visited[start] = 1;
+    queue.push_back({start, -1, 0});
+
+    for(size_t head = 0; head < queue.size(); head++) {
+        const ChunkVisibilityStep step = queue[head];
+        const int x = step.Index % sideX, y = step.Index / sideX % sideY, z = step.Index / (sideX*sideY);
+        const bool isStart = step.EntryFace < 0;
+
+        std::optional<uint16_t> connectivity = visit(step, x, y, z);
+        if(!connectivity)
+            continue;
+
+        for(int face = 0; face < 6; face++) {
+            if(occlusion) {
+                if((step.Directions >> chunkOppositeFace(face)) & 1)
+                    continue;
+
+                if(!isStart && !chunkFacesConnected(*connectivity, step.EntryFace, face))
+                    continue;
+            }
+
+            int nx = x+faceStep[face][0], ny = y+faceStep[face][1], nz = z+faceStep[face][2];
+            if(nx < 0 || nx >= sideX || ny < 0 || ny >= sideY || nz < 0 || nz >= sideZ)
+                continue;
+
+            int next = nx+(ny+nz*sideY)*sideX;
+            if(visited[next])
+                continue;
+
+            visited[next] = 1;
+            queue.push_back({next, int8_t(chunkOppositeFace(face)), uint8_t(step.Directions | (1 << face))});
+        }
+    }
+}
+
+}
@@ -0,0 +1,405 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+
+namespace LV::Client::VK {
+
+/*
+    Two-Level Segregated Fit над диапазоном [0, Capacity) условных единиц.
+
+    Свободные блоки лежат в списках по классам размера: первый уровень - floor(log2(size)),
+    второй делит его на SL_COUNT равных частей. Непустые списки отмечены в битовых масках,
+    поэтому поиск подходящего блока и освобождение выполняются за O(1).
+    При освобождении блок сливается с соседними свободными.
+
+    Аллокатор оперирует только числами и не знает о памяти устройства.
+    Выделения адресуются стабильным AllocId: дефрагментация меняет смещение,
+    но не идентификатор.
+*/
+class TlsfAllocator {
+public:
+    static constexpr uint32_t SL_BITS = 4;
+    static constexpr uint32_t SL_COUNT = 1u << SL_BITS;
+    static constexpr uint32_t FL_COUNT = 32 - SL_BITS + 1;
+    static constexpr uint32_t NONE = ~0u;
+
+    struct Stats {
+        uint32_t Capacity = 0;
+        uint32_t Used = 0;
+        uint32_t LargestFree = 0;
+        uint32_t FreeBlocks = 0;
+        uint32_t Allocations = 0;
+    };
+
+    // Перенос выделения. Старый блок остаётся занятым, пока его не отпустят через releaseBlock()
+    struct Move {
+        uint32_t AllocId;
+        uint32_t SrcOffset, DstOffset, Size;
+        uint32_t OldBlock;
+    };
+
+    explicit TlsfAllocator(uint32_t capacity)
+        : Capacity(capacity)
+    {
+        assert(capacity > 0);
+        for(auto& heads : FreeHeads)
+            for(uint32_t& head : heads)
+                head = NONE;
+
+        Tail = newBlock(0, capacity);
+        insertFree(Tail);
+    }
+
+    std::optional<uint32_t> allocate(uint32_t size) {
+        uint32_t block = takeFree(size, NONE);
+        if(block == NONE)
+            return std::nullopt;
+
+        uint32_t allocId;
+        if(!FreeAllocIds.empty()) {
+            allocId = FreeAllocIds.back();
+            FreeAllocIds.pop_back();
+            Allocs[allocId] = block;
+        } else {
+            allocId = Allocs.size();
+            Allocs.push_back(block);
+        }
+
+        Blocks[block].AllocId = allocId;
+        AllocCount++;
+        return allocId;
+    }
+
+    void free(uint32_t allocId) {
+        assert(allocId < Allocs.size() && Allocs[allocId] != NONE);
+        uint32_t block = Allocs[allocId];
+        Allocs[allocId] = NONE;
+        FreeAllocIds.push_back(allocId);
+        AllocCount--;
+
+        releaseBlock(block);
+    }
+
+    uint32_t offset(uint32_t allocId) const {
+        return Blocks[Allocs[allocId]].Offset;
+    }
+
+    // Фактический размер блока (может быть больше запрошенного)
+    uint32_t size(uint32_t allocId) const {
+        return Blocks[Allocs[allocId]].Size;
+    }
+
+    // Освобождает блок, оставшийся от переноса (или любой занятый блок без AllocId)
+    void releaseBlock(uint32_t block) {
+        Block& b = Blocks[block];
+        assert(!b.Free);
+        b.Free = true;
+        b.AllocId = NONE;
+        Used -= b.Size;
+
+        uint32_t prev = b.PrevPhys;
+        if(prev != NONE && Blocks[prev].Free) {
+            removeFree(prev);
+            absorbNext(prev);
+            block = prev;
+        }
+
+        uint32_t next = Blocks[block].NextPhys;
+        if(next != NONE && Blocks[next].Free) {
+            removeFree(next);
+            absorbNext(block);
+        }
+
+        insertFree(block);
+    }
+
+    /*
+        Переносит занятые блоки с конца диапазона в свободное место ниже них,
+        пока суммарный размер переносов не превысит budget.
+        canMove(allocId) позволяет пропустить выделения, которые сейчас нельзя трогать.
+    */
+    template<typename Pred>
+    std::vector<Move> defragment(uint32_t budget, Pred&& canMove) {
+        std::vector<Move> moves;
+        uint32_t moved = 0;
+
+        for(uint32_t cur = Tail; cur != NONE && moved < budget;) {
+            const Block& b = Blocks[cur];
+            if(b.Free || b.AllocId == NONE || b.Moved || !canMove(b.AllocId)) {
+                cur = b.PrevPhys;
+                continue;
+            }
+
+            const uint32_t allocId = b.AllocId;
+            const uint32_t srcOffset = b.Offset;
+            const uint32_t size = b.Size;
+
+            uint32_t dst = takeFree(size, srcOffset);
+            if(dst == NONE) {
+                cur = Blocks[cur].PrevPhys;
+                continue;
+            }
+
+            Allocs[allocId] = dst;
+            Blocks[dst].AllocId = allocId;
+            // Проход идёт к началу и дойдёт до нового места: второй перенос того же выделения
+            // дал бы пересекающиеся области в одном копировании
+            Blocks[dst].Moved = true;
+            Blocks[cur].AllocId = NONE;
+            moves.push_back({allocId, srcOffset, Blocks[dst].Offset, size, cur});
+            moved += size;
+
+            cur = Blocks[cur].PrevPhys;
+        }
+
+        for(const Move& move : moves)
+            Blocks[Allocs[move.AllocId]].Moved = false;
+
+        return moves;
+    }
+
+    uint32_t capacity() const { return Capacity; }
+    uint32_t used() const { return Used; }
+    uint32_t freeBlocks() const { return FreeBlockCount; }
+    uint32_t allocations() const { return AllocCount; }
+
+    uint32_t largestFree() const {
+        if(!FlBitmap)
+            return 0;
+
+        uint32_t fl = 31 - std::countl_zero(FlBitmap);
+        uint32_t sl = 31 - std::countl_zero(SlBitmap[fl]);
+        uint32_t largest = 0;
+        for(uint32_t block = FreeHeads[fl][sl]; block != NONE; block = Blocks[block].NextFree)
+            largest = std::max(largest, Blocks[block].Size);
+
+        return largest;
+    }
+
+    Stats stats() const {
+        return {Capacity, Used, largestFree(), FreeBlockCount, AllocCount};
+    }
+
+    // Свободное место раздроблено: блоков не меньше minFreeBlocks и наибольший меньше доли ratio от свободного
+    bool fragmented(uint32_t minFreeBlocks, float ratio) const {
+        if(FreeBlockCount < minFreeBlocks)
+            return false;
+
+        return largestFree() < (Capacity - Used)*ratio;
+    }
+
+private:
+    struct Block {
+        uint32_t Offset = 0, Size = 0;
+        uint32_t PrevPhys = NONE, NextPhys = NONE;
+        uint32_t PrevFree = NONE, NextFree = NONE;
+        uint32_t AllocId = NONE;
+        bool Free = false;
+        // Место назначения переноса в текущем проходе defragment
+        bool Moved = false;
+    };
+
+    uint32_t Capacity;
+    uint32_t Used = 0;
+    uint32_t FreeBlockCount = 0;
+    uint32_t AllocCount = 0;
+    // Блок с наибольшим смещением
+    uint32_t Tail = NONE;
+
+    std::vector<Block> Blocks;
+    std::vector<uint32_t> FreeNodes;
+    std::vector<uint32_t> Allocs;
+    std::vector<uint32_t> FreeAllocIds;
+
+    uint32_t FlBitmap = 0;
+    uint32_t SlBitmap[FL_COUNT] = {};
+    uint32_t FreeHeads[FL_COUNT][SL_COUNT];
+
+    static void mapping(uint32_t size, uint32_t& fl, uint32_t& sl) {
+        if(size < SL_COUNT) {
+            fl = 0;
+            sl = size;
+            return;
+        }
+
+        uint32_t log2 = std::bit_width(size) - 1;
+        sl = (size >> (log2 - SL_BITS)) ^ SL_COUNT;
+        fl = log2 - SL_BITS + 1;
+    }
+
+    // Класс, все блоки которого гарантированно вмещают size
+    static void mappingSearch(uint32_t size, uint32_t& fl, uint32_t& sl) {
+        if(size >= SL_COUNT)
+            size += (1u << (std::bit_width(size) - 1 - SL_BITS)) - 1;
+
+        mapping(size, fl, sl);
+    }
+
+    uint32_t newBlock(uint32_t offset, uint32_t size) {
+        uint32_t id;
+        if(!FreeNodes.empty()) {
+            id = FreeNodes.back();
+            FreeNodes.pop_back();
+            Blocks[id] = Block();
+        } else {
+            id = Blocks.size();
+            Blocks.emplace_back();
+        }
+
+        Blocks[id].Offset = offset;
+        Blocks[id].Size = size;
+        return id;
+    }
+
+    void insertFree(uint32_t block) {
+        Block& b = Blocks[block];
+        b.Free = true;
+
+        uint32_t fl, sl;
+        mapping(b.Size, fl, sl);
+
+        b.PrevFree = NONE;
+        b.NextFree = FreeHeads[fl][sl];
+        if(b.NextFree != NONE)
+            Blocks[b.NextFree].PrevFree = block;
+
+        FreeHeads[fl][sl] = block;
+        FlBitmap |= 1u << fl;
+        SlBitmap[fl] |= 1u << sl;
+        FreeBlockCount++;
+    }
+
+    void removeFree(uint32_t block) {
+        Block& b = Blocks[block];
+
+        uint32_t fl, sl;
+        mapping(b.Size, fl, sl);
+
+        if(b.PrevFree != NONE)
+            Blocks[b.PrevFree].NextFree = b.NextFree;
+        else
+            FreeHeads[fl][sl] = b.NextFree;
+
+        if(b.NextFree != NONE)
+            Blocks[b.NextFree].PrevFree = b.PrevFree;
+
+        if(FreeHeads[fl][sl] == NONE) {
+            SlBitmap[fl] &= ~(1u << sl);
+            if(!SlBitmap[fl])
+                FlBitmap &= ~(1u << fl);
+        }
+
+        b.PrevFree = b.NextFree = NONE;
+        FreeBlockCount--;
+    }
+
+    // Присоединяет следующий физический блок к block
+    void absorbNext(uint32_t block) {
+        uint32_t next = Blocks[block].NextPhys;
+        Blocks[block].Size += Blocks[next].Size;
+        Blocks[block].NextPhys = Blocks[next].NextPhys;
+
+        if(Blocks[block].NextPhys != NONE)
+            Blocks[Blocks[block].NextPhys].PrevPhys = block;
+        else
+            Tail = block;
+
+        FreeNodes.push_back(next);
+    }
+
+    // Первый блок подходящего класса, O(1)
+    uint32_t findFree(uint32_t size) const {
+        uint32_t fl, sl;
+        mappingSearch(size, fl, sl);
+        if(fl >= FL_COUNT)
+            return NONE;
+
+        uint32_t slMap = SlBitmap[fl] & (~0u << sl);
+        if(!slMap) {
+            uint32_t flMap = fl + 1 < 32 ? FlBitmap & (~0u << (fl + 1)) : 0;
+            if(!flMap)
+                return NONE;
+
+            fl = std::countr_zero(flMap);
+            slMap = SlBitmap[fl];
+        }
+
+        sl = std::countr_zero(slMap);
+        return FreeHeads[fl][sl];
+    }
+
+    /*
+        Блок, вмещающий size и заканчивающийся не дальше limit. Голова списка может лежать
+        выше limit, тогда как ниже есть подходящие блоки того же класса, поэтому списки
+        просматриваются целиком. Используется только дефрагментацией, её объём ограничен бюджетом
+    */
+    uint32_t findFreeBelow(uint32_t size, uint32_t limit) const {
+        uint32_t fl, sl;
+        mappingSearch(size, fl, sl);
+
+        // Класс size без округления: в нём тоже могут быть достаточно большие блоки
+        uint32_t exactFl, exactSl;
+        mapping(size, exactFl, exactSl);
+
+        for(uint32_t curFl = exactFl; curFl < FL_COUNT; curFl++) {
+            uint32_t slMap = SlBitmap[curFl];
+            if(curFl == exactFl)
+                slMap &= ~0u << exactSl;
+
+            for(; slMap; slMap &= slMap - 1) {
+                uint32_t curSl = std::countr_zero(slMap);
+                bool surelyFits = curFl > fl || (curFl == fl && curSl >= sl);
+
+                for(uint32_t block = FreeHeads[curFl][curSl]; block != NONE; block = Blocks[block].NextFree) {
+                    const Block& b = Blocks[block];
+                    if((surelyFits || b.Size >= size) && b.Offset + size <= limit)
+                        return block;
+                }
+            }
+        }
+
+        return NONE;
+    }
+
+    // Забирает свободный блок размером не меньше size со смещением меньше limit
+    uint32_t takeFree(uint32_t size, uint32_t limit) {
+        if(size == 0 || size > Capacity)
+            return NONE;
+
+        uint32_t block = limit == NONE ? findFree(size) : findFreeBelow(size, limit);
+        if(block == NONE)
+            return NONE;
+
+        assert(Blocks[block].Size >= size);
+        removeFree(block);
+        Blocks[block].Free = false;
+
+        // Остаток возвращается в свободные. Соседи свободного блока всегда заняты, слияние не нужно
+        if(Blocks[block].Size > size) {
+            uint32_t rest = newBlock(Blocks[block].Offset + size, Blocks[block].Size - size);
+            Block& b = Blocks[block];
+            b.Size = size;
+
+            Blocks[rest].PrevPhys = block;
+            Blocks[rest].NextPhys = b.NextPhys;
+            if(b.NextPhys != NONE)
+                Blocks[b.NextPhys].PrevPhys = rest;
+            else
+                Tail = rest;
+            b.NextPhys = rest;
+
+            insertFree(rest);
+        }
+
+        Used += size;
+        return block;
+    }
+};
+
+}
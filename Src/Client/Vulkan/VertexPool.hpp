@@ -2,8 +2,8 @@
 
 #include "Vulkan.hpp"
 #include "Client/Vulkan/AtlasPipeline/SharedStagingBuffer.hpp"
+#include "Client/Vulkan/TlsfAllocator.hpp"
 #include <algorithm>
-#include <bitset>
 #include <cstring>
 #include <memory>
 #include <optional>
@@ -40,15 +40,20 @@ inline void resetVertexStaging() {
 
 /*
     Память на устройстве выделяется пулами
-    Для массивов вершин память выделяется блоками по PerBlock вершин в каждом
-    Размер пулла sizeof(Vertex)*PerBlock*PerPool
+    Внутри пула место раздаётся TLSF аллокатором с шагом Granule вершин
+    Размер пулла sizeof(Vertex)*Granule*PerPool
 
     Получаемые вершины сначала пишутся в общий буфер, потом передаются на устройство
+    Фрагментированные пулы понемногу уплотняются копированием на устройстве
 */
-// Нужна реализация индексного буфера
-template<typename Vertex, uint16_t PerBlock = 1 << 10, uint16_t PerPool = 1 << 12, bool IsIndex = false>
+template<typename Vertex, uint32_t Granule = 1 << 6, uint32_t PerPool = 1 << 16, bool IsIndex = false>
 class VertexPool {
-    static constexpr size_t HC_Buffer_Size = size_t(PerBlock)*size_t(PerPool);
+    static constexpr size_t HC_Buffer_Size = size_t(Granule)*size_t(PerPool);
+    // Сколько байт за кадр можно перенести при дефрагментации
+    static constexpr VkDeviceSize DefragBytesPerFrame = VkDeviceSize(4) << 20;
+    // Дефрагментация запускается, если наибольший свободный участок меньше этой доли свободного места
+    static constexpr float DefragLargestFreeRatio = 0.5f;
+    static constexpr uint32_t DefragMinFreeBlocks = 16;
 
     Vulkan *Inst;
 
@@ -59,17 +64,19 @@ class VertexPool {
     struct Pool {
         // Память на устройстве
         Buffer DeviceBuff;
-        // Свободные блоки
-        std::bitset<PerPool> Allocation;
+        // Разметка памяти пула в гранулах
+        TlsfAllocator Allocator;
+        // Блоки, перенесённые дефрагментацией; освобождаются после завершения кадра на GPU
+        std::vector<uint32_t> MovedBlocks;
 
         Pool(Vulkan* inst)
             : DeviceBuff(inst, 
-                sizeof(Vertex)*size_t(PerBlock)*size_t(PerPool)+4 /* Для vkCmdFillBuffer */, 
-                (IsIndex ? VK_BUFFER_USAGE_INDEX_BUFFER_BIT : VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
-        {
-            Allocation.set();
-        }
+                sizeof(Vertex)*HC_Buffer_Size+4 /* Для vkCmdFillBuffer */, 
+                (IsIndex ? VK_BUFFER_USAGE_INDEX_BUFFER_BIT : VK_BUFFER_USAGE_VERTEX_BUFFER_BIT)
+                    | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+              Allocator(PerPool)
+        {}
     };
 
     std::vector<Pool> Pools;
@@ -77,7 +84,7 @@ class VertexPool {
     struct Task {
         std::vector<Vertex> Data;
         uint8_t PoolId; // Куда потом направить
-        uint16_t BlockId; // И в какой блок
+        uint32_t AllocId; // И в какое выделение (смещение определяется при отправке)
     };
 
     /*
@@ -86,10 +93,17 @@ class VertexPool {
     */
     std::queue<Task> TasksWait, TasksPostponed;
 
+    // Счётчики для статистики
+    uint64_t TotalAllocations = 0, TotalFrees = 0, TotalMoves = 0, TotalMovedBytes = 0;
+
 
 private:
-    void pushData(std::vector<Vertex>&& data, uint8_t poolId, uint16_t blockId) {
-        TasksWait.push({std::move(data), poolId, blockId});
+    void pushData(std::vector<Vertex>&& data, uint8_t poolId, uint32_t allocId) {
+        TasksWait.push({std::move(data), poolId, allocId});
+    }
+
+    static uint32_t granules(size_t count) {
+        return (count+Granule-1) / Granule;
     }
 
 public:
@@ -108,11 +122,18 @@ public:
 
 
     struct Pointer {
-        uint32_t PoolId : 8, BlockId : 16, VertexCount = 0;
+        uint32_t PoolId : 8, AllocId : 24, VertexCount = 0;
 
         operator bool() const { return VertexCount; }
     };
 
+    struct Stats {
+        size_t Pools = 0;
+        VkDeviceSize CapacityBytes = 0, UsedBytes = 0, LargestFreeBytes = 0;
+        uint32_t FreeBlocks = 0, Allocations = 0;
+        uint64_t TotalAllocations = 0, TotalFrees = 0, TotalMoves = 0, TotalMovedBytes = 0;
+    };
+
     /*
         Переносит вершины на устройство, заранее передаёт указатель на область в памяти
         Надеемся что к следующему кадру данные будут переданы 
@@ -121,55 +142,31 @@ public:
         if(data.empty())
             return {0, 0, 0};
 
-        // Необходимое количество блоков
-        uint16_t blocks = (data.size()+PerBlock-1) / PerBlock;
-        assert(blocks <= PerPool);
-
-        // Нужно найти пулл в котором будет свободно blocks количество блоков или создать новый
-        for(size_t iterPool = 0; iterPool < Pools.size(); iterPool++) {
-            Pool &pool = Pools[iterPool];
-            size_t pos = pool.Allocation._Find_first();
-
-            if(pos == PerPool)
-                continue;
+        // Необходимое количество гранул
+        uint32_t need = granules(data.size());
+        assert(need <= PerPool);
 
-            while(true) {
-                int countEmpty = 1;
-                for(size_t pos2 = pos+1; pos2 < PerPool && pool.Allocation.test(pos2) && countEmpty < blocks; pos2++, countEmpty++);
-
-                if(countEmpty == blocks) {
-                    for(int block = 0; block < blocks; block++) {
-                        pool.Allocation.reset(pos+block);
-                    }
-
-                    size_t count = data.size();
-                    pushData(std::move(data), iterPool, pos);
-
-                    return Pointer(iterPool, pos, count);
-                }
-
-                pos += countEmpty;
-                
-                if(pos >= PerPool)
-                    break;
-                
-                pos = pool.Allocation._Find_next(pos+countEmpty);
-            }
+        // Первый пул, в котором нашлось место; иначе создаём новый
+        std::optional<uint32_t> allocId;
+        size_t poolId = 0;
+        for(; poolId < Pools.size(); poolId++) {
+            if((allocId = Pools[poolId].Allocator.allocate(need)))
+                break;
         }
 
-        // Не нашлось подходящего пула, создаём новый
-        assert(Pools.size() < 256);
-
-        Pools.emplace_back(Inst);
-        Pool &last = Pools.back();
-        // vkCmdFillBuffer(nullptr, last.DeviceBuff, 0, last.DeviceBuff.getSize() & ~0x3, 0);
-        for(int block = 0; block < blocks; block++)
-            last.Allocation.reset(block);
+        if(!allocId) {
+            assert(Pools.size() < 256);
+            Pools.emplace_back(Inst);
+            poolId = Pools.size()-1;
+            allocId = Pools.back().Allocator.allocate(need);
+            assert(allocId && *allocId < (1u << 24));
+        }
 
+        TotalAllocations++;
         size_t count = data.size();
-        pushData(std::move(data), Pools.size()-1, 0);
+        pushData(std::move(data), poolId, *allocId);
 
-        return Pointer(Pools.size()-1, 0, count);
+        return Pointer(poolId, *allocId, count);
     }
 
     /*
@@ -180,14 +177,8 @@ public:
             return;
 
         assert(pointer.PoolId < Pools.size());
-        assert(pointer.BlockId < PerPool);
-
-        Pool &pool = Pools[pointer.PoolId];
-        int blocks = (pointer.VertexCount+PerBlock-1) / PerBlock;
-        for(int indexBlock = 0; indexBlock < blocks; indexBlock++) {
-            assert(!pool.Allocation.test(pointer.BlockId+indexBlock));
-            pool.Allocation.set(pointer.BlockId+indexBlock);
-        }
+        Pools[pointer.PoolId].Allocator.free(pointer.AllocId);
+        TotalFrees++;
     }
 
     void dropVertexs(Pointer &pointer) {
@@ -209,11 +200,10 @@ public:
         } else if(!pointer) {
             pointer = pushVertexs(std::move(data));
         } else {
-            int needBlocks = (data.size()+PerBlock-1) / PerBlock;
-
-            if((pointer.VertexCount+PerBlock-1) / PerBlock == needBlocks) {
+            // Данные помещаются в уже выделенный блок
+            if(granules(data.size()) <= Pools[pointer.PoolId].Allocator.size(pointer.AllocId)) {
                 pointer.VertexCount = data.size();
-                pushData(std::move(data), pointer.PoolId, pointer.BlockId);
+                pushData(std::move(data), pointer.PoolId, pointer.AllocId);
             } else {
                 dropVertexs(pointer);
                 pointer = pushVertexs(std::move(data));
@@ -223,21 +213,38 @@ public:
 
     /*
         Транслирует локальный указатель в буффер и позицию вершины в нём
+        Позиция может меняться после дефрагментации, поэтому её нужно получать заново каждый кадр
     */
     std::pair<VkBuffer, int> map(const Pointer pointer) {
         assert(pointer.PoolId < Pools.size());
-        assert(pointer.BlockId < PerPool);
 
-        return {Pools[pointer.PoolId].DeviceBuff.getBuffer(), pointer.BlockId*PerBlock};
+        const Pool& pool = Pools[pointer.PoolId];
+        return {pool.DeviceBuff.getBuffer(), int(pool.Allocator.offset(pointer.AllocId)*Granule)};
+    }
+
+    Stats getStats() const {
+        Stats stats;
+        stats.Pools = Pools.size();
+        for(const Pool& pool : Pools) {
+            TlsfAllocator::Stats a = pool.Allocator.stats();
+            stats.CapacityBytes += VkDeviceSize(a.Capacity)*Granule*sizeof(Vertex);
+            stats.UsedBytes += VkDeviceSize(a.Used)*Granule*sizeof(Vertex);
+            stats.LargestFreeBytes = std::max(stats.LargestFreeBytes, VkDeviceSize(a.LargestFree)*Granule*sizeof(Vertex));
+            stats.FreeBlocks += a.FreeBlocks;
+            stats.Allocations += a.Allocations;
+        }
+
+        stats.TotalAllocations = TotalAllocations;
+        stats.TotalFrees = TotalFrees;
+        stats.TotalMoves = TotalMoves;
+        stats.TotalMovedBytes = TotalMovedBytes;
+        return stats;
     }
 
     /*
         Должно вызываться после приёма всех данных, до начала рендера в командном буфере
     */
     void flushUploadsAndBarriers(VkCommandBuffer commandBuffer) {
-        if(TasksWait.empty())
-            return;
-
         struct CopyTask {
             VkBuffer DstBuffer;
             VkDeviceSize SrcOffset;
@@ -271,50 +278,53 @@ public:
             copies.push_back({
                 Pools[task.PoolId].DeviceBuff.getBuffer(),
                 *stagingOffset,
-                task.BlockId*sizeof(Vertex)*size_t(PerBlock),
+                Pools[task.PoolId].Allocator.offset(task.AllocId)*sizeof(Vertex)*size_t(Granule),
                 bytes,
                 task.PoolId
             });
             touchedPools[task.PoolId] = 1;
         }
 
-        if(copies.empty())
-            return;
-
-        VkBufferMemoryBarrier stagingBarrier = {
-            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-            nullptr,
-            VK_ACCESS_HOST_WRITE_BIT,
-            VK_ACCESS_TRANSFER_READ_BIT,
-            VK_QUEUE_FAMILY_IGNORED,
-            VK_QUEUE_FAMILY_IGNORED,
-            Staging->Buffer(),
-            0,
-            Staging->Size()
-        };
+        if(!copies.empty()) {
+            VkBufferMemoryBarrier stagingBarrier = {
+                VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                nullptr,
+                VK_ACCESS_HOST_WRITE_BIT,
+                VK_ACCESS_TRANSFER_READ_BIT,
+                VK_QUEUE_FAMILY_IGNORED,
+                VK_QUEUE_FAMILY_IGNORED,
+                Staging->Buffer(),
+                0,
+                Staging->Size()
+            };
 
-        vkCmdPipelineBarrier(
-            commandBuffer,
-            VK_PIPELINE_STAGE_HOST_BIT,
-            VK_PIPELINE_STAGE_TRANSFER_BIT,
-            0,
-            0, nullptr,
-            1, &stagingBarrier,
-            0, nullptr
-        );
+            vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_HOST_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0,
+                0, nullptr,
+                1, &stagingBarrier,
+                0, nullptr
+            );
 
-        for(const CopyTask& copy : copies) {
-            VkBufferCopy copyRegion {
-                copy.SrcOffset,
-                copy.DstOffset,
-                copy.Size
-            };
+            for(const CopyTask& copy : copies) {
+                VkBufferCopy copyRegion {
+                    copy.SrcOffset,
+                    copy.DstOffset,
+                    copy.Size
+                };
 
-            assert(copyRegion.dstOffset+copyRegion.size <= Pools[copy.PoolId].DeviceBuff.getSize());
+                assert(copyRegion.dstOffset+copyRegion.size <= Pools[copy.PoolId].DeviceBuff.getSize());
 
-            vkCmdCopyBuffer(commandBuffer, Staging->Buffer(), copy.DstBuffer, 1, &copyRegion);
+                vkCmdCopyBuffer(commandBuffer, Staging->Buffer(), copy.DstBuffer, 1, &copyRegion);
+            }
         }
 
+        // Пока есть неотправленные данные, их смещения должны оставаться на месте
+        if(TasksPostponed.empty())
+            defragment(commandBuffer, touchedPools);
+
         std::vector<VkBufferMemoryBarrier> dstBarriers;
         dstBarriers.reserve(Pools.size());
         for(size_t poolId = 0; poolId < Pools.size(); poolId++) {
@@ -355,10 +365,82 @@ public:
             TasksWait.push(std::move(postponed.front()));
             postponed.pop();
         }
+
+        // Кадр, записанный со старыми смещениями, завершён - прежние места можно отдавать
+        for(Pool& pool : Pools) {
+            for(uint32_t block : pool.MovedBlocks)
+                pool.Allocator.releaseBlock(block);
+
+            pool.MovedBlocks.clear();
+        }
+    }
+
+private:
+    /*
+        Переносит меши с конца фрагментированных пулов в свободные места ближе к началу
+        Копирование выполняется на устройстве внутри того же буфера
+        Старые места занимаются до notifyGpuFinished()
+    */
+    void defragment(VkCommandBuffer commandBuffer, std::vector<uint8_t>& touchedPools) {
+        constexpr VkDeviceSize granuleBytes = VkDeviceSize(Granule)*sizeof(Vertex);
+        uint32_t budget = DefragBytesPerFrame / granuleBytes;
+        bool barrier = false;
+
+        for(size_t poolId = 0; poolId < Pools.size() && budget; poolId++) {
+            Pool& pool = Pools[poolId];
+            TlsfAllocator& allocator = pool.Allocator;
+
+            if(!pool.MovedBlocks.empty() || !allocator.fragmented(DefragMinFreeBlocks, DefragLargestFreeRatio))
+                continue;
+
+            std::vector<TlsfAllocator::Move> moves = allocator.defragment(budget, [](uint32_t) { return true; });
+            if(moves.empty())
+                continue;
+
+            // Перенос читает данные, записанные копированием ранее в этом или прошлых кадрах
+            if(!barrier) {
+                VkMemoryBarrier memoryBarrier = {
+                    VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                    nullptr,
+                    VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT
+                };
+
+                vkCmdPipelineBarrier(
+                    commandBuffer,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    0,
+                    1, &memoryBarrier,
+                    0, nullptr,
+                    0, nullptr
+                );
+                barrier = true;
+            }
+
+            std::vector<VkBufferCopy> regions;
+            regions.reserve(moves.size());
+            for(const TlsfAllocator::Move& move : moves) {
+                regions.push_back({
+                    move.SrcOffset*granuleBytes,
+                    move.DstOffset*granuleBytes,
+                    move.Size*granuleBytes
+                });
+
+                pool.MovedBlocks.push_back(move.OldBlock);
+                budget -= std::min(budget, move.Size);
+                TotalMoves++;
+                TotalMovedBytes += move.Size*granuleBytes;
+            }
+
+            VkBuffer buffer = pool.DeviceBuff.getBuffer();
+            vkCmdCopyBuffer(commandBuffer, buffer, buffer, static_cast<uint32_t>(regions.size()), regions.data());
+            touchedPools[poolId] = 1;
+        }
     }
 };
 
-template<typename Type, uint16_t PerBlock = 1 << 10, uint16_t PerPool = 1 << 12>
-using IndexPool = VertexPool<Type, PerBlock, PerPool, true>;
+template<typename Type, uint32_t Granule = 1 << 6, uint32_t PerPool = 1 << 16>
+using IndexPool = VertexPool<Type, Granule, PerPool, true>;
 
 }
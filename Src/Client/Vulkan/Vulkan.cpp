@@ -604,10 +604,12 @@ void Vulkan::run()
 				}
 
 				// Насильно ожидаем завершения рендера кадра
+				auto waitStart = std::chrono::steady_clock::now();
 				vkWaitForFences(Graphics.Device, 1, &drawEndFence, true, -1);
+				double fenceSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
 				vkResetFences(Graphics.Device, 1, &drawEndFence);
 				if(Game.RSession)
-					Game.RSession->onGpuFinished();
+					Game.RSession->onGpuFinished(fenceSeconds);
 			}
 
 			{
@@ -2308,6 +2310,10 @@ void Vulkan::gui_ConnectedToServer() {
 				Game.Session->requestModsReload();
 			}
 
+			if(ImGui::Button("Профилировщик Lua")) {
+				Game.Session->requestLuaProfilerToggle();
+			}
+
 			if(ImGui::Button("Выйти")) {
 				Game.Выйти = true;
 				Game.ImGuiInterfaces.pop_back();
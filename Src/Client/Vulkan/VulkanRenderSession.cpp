@@ -22,24 +22,11 @@
 #include <vulkan/vulkan_core.h>
 #include <fstream>
 
-namespace std {
-    template<>
-    struct hash<LV::Client::VK::NodeVertexStatic> {
-        size_t operator()(const LV::Client::VK::NodeVertexStatic& v) const {
-            const uint32_t* ptr = reinterpret_cast<const uint32_t*>(&v);
-            size_t h1 = std::hash<uint32_t>{}(ptr[0]);
-            size_t h2 = std::hash<uint32_t>{}(ptr[1]);
-            size_t h3 = std::hash<uint32_t>{}(ptr[2]);
-
-            return h1 ^ (h2 << 1) ^ (h3 << 2);
-        }
-    };
-}
-
 namespace LV::Client::VK {
 
 void ChunkMeshGenerator::changeThreadsCount(uint8_t threads) {
     Sync.NeedShutdown = true;
+    Input.wake();
     std::unique_lock lock(Sync.Mutex);
     Sync.CV_CountInRun.wait(lock, [&]() { return Sync.CountInRun == 0; });
 
@@ -68,10 +55,24 @@ void ChunkMeshGenerator::run(uint8_t id) {
     }
 
     LOG.debug() << "Старт потока верширования чанков";
-    int timeWait = 1;
+
+    ThreadScratch scratch;
+
+    std::vector<NodeStateInfo> metaStatesInfo;
+    {
+        NodeStateInfo info;
+        info.Name = "meta";
+        info.Variations = 256;
+        metaStatesInfo.push_back(std::move(info));
+    }
 
     try {
-        while(!Sync.NeedShutdown) {
+        while(true) {
+            uint32_t seq = InputSignal.sequence();
+
+            if(Sync.NeedShutdown)
+                break;
+
             if(Sync.Stop) {
                 // Мир клиента начинает обрабатывать такты
                 std::unique_lock lock(Sync.Mutex);
@@ -81,33 +82,28 @@ void ChunkMeshGenerator::run(uint8_t id) {
                     Sync.CV_CountInRun.wait(lock, [&](){ return !Sync.Stop; });
                     Sync.CountInRun += 1;
                 }
-            }
-
-            // Если нет входных запросов - ожидаем
-            if(Input.get_read().empty()) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(timeWait));
-                if(++timeWait > 20)
-                    timeWait = 20;
 
-                continue;
+                scratch.dropCaches();
             }
 
-            timeWait = 0;
-
             WorldId_t wId;
             Pos::GlobalChunk pos;
             uint32_t requestId;
 
             {
-                auto lock = Input.lock();
-                if(lock->empty())
+                std::optional<std::tuple<WorldId_t, Pos::GlobalChunk, uint32_t>> v = InputUrgent.tryPop();
+                if(!v)
+                    v = Input.tryPop();
+
+                // Если нет входных запросов - ожидаем
+                if(!v) {
+                    InputSignal.wait(seq);
                     continue;
+                }
 
-                std::tuple<WorldId_t, Pos::GlobalChunk, uint32_t> v = lock->front();
-                wId = std::get<0>(v);
-                pos = std::get<1>(v);
-                requestId = std::get<2>(v);
-                lock->pop();
+                wId = std::get<0>(*v);
+                pos = std::get<1>(*v);
+                requestId = std::get<2>(*v);
             }
 
             ChunkObj_t result;
@@ -115,15 +111,16 @@ void ChunkMeshGenerator::run(uint8_t id) {
             result.WId = wId;
             result.Pos = pos;
 
+            ChunkContentKey cacheKey;
+            bool cacheable = false;
+
             const std::array<Node, 16*16*16>* chunk;
             const std::vector<VoxelCube>* voxels;
             // Если на позиции полная нода, то она перекрывает стороны соседей
             uint8_t fullNodes[18][18][18];
 
-            // Профиль, который используется если на стороне клиента отсутствует нужных профиль
-            DefNode defaultProfileNode;
             // Кеш запросов профилей нод
-            std::unordered_map<DefNodeId, const DefNode*> profilesNodeCache;
+            auto& profilesNodeCache = scratch.ProfilesNodeCache;
             auto getNodeProfile = [&](DefNodeId id) -> const DefNode* {
                 auto iterCache = profilesNodeCache.find(id);
                 if(iterCache == profilesNodeCache.end()) {
@@ -133,21 +130,13 @@ void ChunkMeshGenerator::run(uint8_t id) {
                         return (profilesNodeCache[id] = &iterSS->second);
                     } else {
                         // Профиль отсутствует на клиенте
-                        return (profilesNodeCache[id] = &defaultProfileNode);
+                        return (profilesNodeCache[id] = &scratch.DefaultProfileNode);
                     }
                 } else {
                     return iterCache->second;
                 }
             };
 
-            std::vector<NodeStateInfo> metaStatesInfo;
-            {
-                NodeStateInfo info;
-                info.Name = "meta";
-                info.Variations = 256;
-                metaStatesInfo.push_back(std::move(info));
-            }
-
             // Воксели пока не рендерим
             if(auto iterWorld = SS->Content.Worlds.find(wId); iterWorld != SS->Content.Worlds.end()) {
                 Pos::GlobalRegion rPos = pos >> 2;
@@ -185,9 +174,92 @@ void ChunkMeshGenerator::run(uint8_t id) {
                     }
                 }
 
+                // Меш зависит от нод чанка, вокселей, прилегающих граней соседей и поколения профилей
+                {
+                    ChunkContentHasher hasher;
+                    hasher.add(ProfileGeneration.load(std::memory_order_relaxed));
+                    hasher.add(NSP != nullptr);
+                    hasher.addWords(chunk->data(), chunk->size());
+
+                    hasher.add(voxels->size());
+                    for(const VoxelCube& cube : *voxels) {
+                        hasher.add(uint64_t(cube.Data) | (uint64_t(cube.Pos.pack()) << 32));
+                        hasher.add(cube.Size.pack());
+                    }
+
+                    for(int var = 0; var < 6; var++) {
+                        if(!chunks[var]) {
+                            hasher.add(~uint64_t(var));
+                            continue;
+                        }
+
+                        // Грань соседа, прилегающая к чанку
+                        const Node* n = chunks[var]->data();
+                        const int axis = var >> 1, layer = (var & 1) ? 15 : 0;
+                        for(int b = 0; b < 16; b++)
+                            for(int a = 0; a < 16; a += 2) {
+                                int i0, i1;
+                                if(axis == 0) {
+                                    i0 = layer+a*16+b*256;
+                                    i1 = i0+16;
+                                } else if(axis == 1) {
+                                    i0 = a+layer*16+b*256;
+                                    i1 = i0+1;
+                                } else {
+                                    i0 = a+b*16+layer*256;
+                                    i1 = i0+1;
+                                }
+
+                                hasher.add(uint64_t(n[i0].Data) | (uint64_t(n[i1].Data) << 32));
+                            }
+                    }
+
+                    cacheKey = hasher.finish();
+                    cacheable = true;
+
+                    if(std::shared_ptr<const ChunkObj_t> cached = MeshCache.find(cacheKey)) {
+                        // Содержимое уже встречалось, остаётся только загрузка на устройство
+                        result = *cached;
+                        result.RequestId = requestId;
+                        result.WId = wId;
+                        result.Pos = pos;
+                        cacheable = false;
+                        goto end;
+                    }
+
+                    // Профили нод чанка и прилегающих граней соседей и вокселей, при их смене запись устаревает
+                    std::vector<uint64_t>& deps = scratch.MeshDeps;
+                    deps.clear();
+                    auto addNode = [&](const Node& node) {
+                        uint64_t dep = nodeMeshDep(node.NodeId);
+                        if(deps.empty() || deps.back() != dep)
+                            deps.push_back(dep);
+                    };
+
+                    for(const Node& node : *chunk)
+                        addNode(node);
+
+                    for(int var = 0; var < 6; var++) {
+                        if(!chunks[var])
+                            continue;
+
+                        const Node* n = chunks[var]->data();
+                        const int axis = var >> 1, layer = (var & 1) ? 15 : 0;
+                        for(int b = 0; b < 16; b++)
+                            for(int a = 0; a < 16; a++)
+                                addNode(n[axis == 0 ? layer+a*16+b*256 : axis == 1 ? a+layer*16+b*256 : a+b*16+layer*256]);
+                    }
+
+                    for(const VoxelCube& cube : *voxels)
+                        deps.push_back(voxelMeshDep(cube.VoxelId));
+
+                    std::sort(deps.begin(), deps.end());
+                    deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+                }
+
                 std::fill(((uint8_t*) fullNodes), ((uint8_t*) fullNodes)+18*18*18, 0);
 
-                std::unordered_map<DefNodeId, bool> nodeFullCuboidCache;
+                auto& nodeFullCuboidCache = scratch.NodeFullCuboidCache;
                 auto nodeIsFull = [&](Node node) -> bool {
                     if(node.NodeId == 0)
                         return false;
@@ -322,6 +394,8 @@ void ChunkMeshGenerator::run(uint8_t id) {
             } else 
                 goto end;
 
+            result.FaceConnectivity = computeChunkFaceConnectivity(fullNodes);
+
             {
                 result.VoxelDefines.reserve(voxels->size());
                 for(const VoxelCube& cube : *voxels)
@@ -350,6 +424,10 @@ void ChunkMeshGenerator::run(uint8_t id) {
 
             // Генерация вершин нод
             {
+                // Вершины собираются в буфер потока, в результат уходит только сокращённый набор
+                std::vector<NodeVertexStatic>& rawVertexs = scratch.RawVertexs;
+                rawVertexs.clear();
+
                 NodeVertexStatic v;
                 std::memset(&v, 0, sizeof(v));
 
@@ -362,11 +440,8 @@ void ChunkMeshGenerator::run(uint8_t id) {
                 std::array<uint8_t, 16> generatedColumnY = {};
                 std::array<uint8_t, 16> generatedColumnZ = {};
 
-                struct ModelCacheEntry {
-                    std::vector<std::vector<std::pair<float, std::unordered_map<EnumFace, std::vector<NodeVertexStatic>>>>> Routes;
-                };
-
-                std::unordered_map<uint32_t, ModelCacheEntry> modelCache;
+                using ModelCacheEntry = ThreadScratch::ModelCacheEntry;
+                auto& modelCache = scratch.ModelCache;
                 std::unordered_map<AssetsTexture, uint32_t> baseTextureCache;
 
                 auto isFaceCovered = [&](EnumFace face, int covered) -> bool {
@@ -415,7 +490,7 @@ void ChunkMeshGenerator::run(uint8_t id) {
                             vert.FX = uint32_t(vert.FX + x * 64);
                             vert.FY = uint32_t(vert.FY + y * 64);
                             vert.FZ = uint32_t(vert.FZ + z * 64);
-                            result.NodeVertexs.push_back(vert);
+                            rawVertexs.push_back(vert);
                         }
                     }
                 };
@@ -428,7 +503,7 @@ void ChunkMeshGenerator::run(uint8_t id) {
                     if(nodeData.NodeId == 0)
                         continue;
 
-                    const size_t vertexStart = result.NodeVertexs.size();
+                    const size_t vertexStart = rawVertexs.size();
                     int fullCovered = 0;
 
                     fullCovered |= fullNodes[x+1+1][y+1][z+1];
@@ -490,31 +565,31 @@ void ChunkMeshGenerator::run(uint8_t id) {
                         v.FZ = 224+z*64+64;
                         v.TU = 0;
                         v.TV = 0;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FX += 64;
                         v.TU = 65535;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FZ -= 64;
                         v.TV = 65535;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FX = 224+x*64;
                         v.FZ = 224+z*64+64;
                         v.TU = 0;
                         v.TV = 0;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FX += 64;
                         v.FZ -= 64;
                         v.TV = 65535;
                         v.TU = 65535;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FX -= 64;
                         v.TU = 0;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
                     }
 
                     // XZ-Y
@@ -524,31 +599,31 @@ void ChunkMeshGenerator::run(uint8_t id) {
                         v.FZ = 224+z*64+64;
                         v.TU = 0;
                         v.TV = 0;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FZ -= 64;
                         v.TV = 65535;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FX += 64;
                         v.TU = 65535;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FX = 224+x*64;
                         v.FZ = 224+z*64+64;
                         v.TU = 0;
                         v.TV = 0;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FX += 64;
                         v.FZ -= 64;
                         v.TV = 65535;
                         v.TU = 65535;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FZ += 64;
                         v.TV = 0;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
                     }
 
                     //YZ+X
@@ -558,31 +633,31 @@ void ChunkMeshGenerator::run(uint8_t id) {
                         v.FZ = 224+z*64+64;
                         v.TU = 0;
                         v.TV = 0;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FZ -= 64;
                         v.TV = 65535;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FY += 64;
                         v.TU = 65535;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FY = 224+y*64;
                         v.FZ = 224+z*64+64;
                         v.TU = 0;
                         v.TV = 0;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FY += 64;
                         v.FZ -= 64;
                         v.TV = 65535;
                         v.TU = 65535;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FZ += 64;
                         v.TV = 0;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
                     }
 
                     //YZ-X
@@ -592,31 +667,31 @@ void ChunkMeshGenerator::run(uint8_t id) {
                         v.FZ = 224+z*64+64;
                         v.TU = 0;
                         v.TV = 0;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FY += 64;
                         v.TU = 65535;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FZ -= 64;
                         v.TV = 65535;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FY = 224+y*64;
                         v.FZ = 224+z*64+64;
                         v.TU = 0;
                         v.TV = 0;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FY += 64;
                         v.FZ -= 64;
                         v.TV = 65535;
                         v.TU = 65535;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FY -= 64;
                         v.TU = 0;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
                     }
 
                     //XY+Z
@@ -626,31 +701,31 @@ void ChunkMeshGenerator::run(uint8_t id) {
                         v.FZ = 224+z*64+64;
                         v.TU = 0;
                         v.TV = 0;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FX += 64;
                         v.TU = 65535;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FY += 64;
                         v.TV = 65535;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FX = 224+x*64;
                         v.FY = 224+y*64;
                         v.TU = 0;
                         v.TV = 0;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FX += 64;
                         v.FY += 64;
                         v.TV = 65535;
                         v.TU = 65535;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FX -= 64;
                         v.TU = 0;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
                     }
 
                     // XY-Z
@@ -660,31 +735,31 @@ void ChunkMeshGenerator::run(uint8_t id) {
                         v.FZ = 224+z*64;
                         v.TU = 0;
                         v.TV = 0;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FY += 64;
                         v.TV = 65535;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FX += 64;
                         v.TU = 65535;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FX = 224+x*64;
                         v.FY = 224+y*64;
                         v.TU = 0;
                         v.TV = 0;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FX += 64;
                         v.FY += 64;
                         v.TV = 65535;
                         v.TU = 65535;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
 
                         v.FY -= 64;
                         v.TV = 0;
-                        result.NodeVertexs.push_back(v);
+                        rawVertexs.push_back(v);
                     }
 
                     node_done:
@@ -693,43 +768,53 @@ void ChunkMeshGenerator::run(uint8_t id) {
                 // Вычислить индексы и сократить вершины
                 {
                     uint32_t nextIndex = 0;
-                    std::vector<NodeVertexStatic> vertexes;
-                    std::unordered_map<NodeVertexStatic, uint32_t> vertexTable;
-                    std::vector<uint32_t> indexes;
-                    
-                    for(const NodeVertexStatic& vertex : result.NodeVertexs) {
-                        auto iter = vertexTable.find(vertex);
-                        if(iter == vertexTable.end()) {
-                            vertexTable.insert({vertex, nextIndex});
-                            vertexes.push_back(vertex);
-                            indexes.push_back(nextIndex);
+                    auto& vertexTable = scratch.VertexTable;
+                    auto& indexes = scratch.Indexes;
+                    vertexTable.clear();
+                    indexes.clear();
+                    indexes.reserve(rawVertexs.size());
+
+                    // Уникальные вершины сдвигаются в начало сырого буфера
+                    for(const NodeVertexStatic& vertex : rawVertexs) {
+                        auto [iter, inserted] = vertexTable.try_emplace(vertex, nextIndex);
+                        if(inserted) {
+                            rawVertexs[nextIndex] = vertex;
                             nextIndex += 1;
-                        } else {
-                            indexes.push_back(iter->second);
                         }
+
+                        indexes.push_back(iter->second);
                     }
 
-                    result.NodeVertexs = std::move(vertexes);
+                    result.NodeVertexs.assign(rawVertexs.begin(), rawVertexs.begin()+nextIndex);
 
                     if(nextIndex <= (1 << 16)) {
-                        std::vector<uint16_t> indexes16;
-                        indexes16.reserve(indexes.size());
-                        for(size_t iter = 0; iter < indexes.size(); iter++)
-                            indexes16.push_back(indexes[iter]);
-
-                        result.NodeIndexes = std::move(indexes16);
+                        result.NodeIndexes = std::vector<uint16_t>(indexes.begin(), indexes.end());
                     } else {
-                        result.NodeIndexes = std::move(indexes);
+                        result.NodeIndexes = std::vector<uint32_t>(indexes.begin(), indexes.end());
                     }
                 }
             }
+
+            if(cacheable) {
+                size_t bytes = sizeof(ChunkObj_t)
+                    + result.VoxelDefines.size()*sizeof(DefVoxelId)
+                    + result.VoxelVertexs.size()*sizeof(VoxelVertexPoint)
+                    + result.NodeDefines.size()*sizeof(DefNodeId)
+                    + result.NodeVertexs.size()*sizeof(NodeVertexStatic)
+                    + std::visit([](const auto& indexes) { return indexes.size()*sizeof(indexes[0]); }, result.NodeIndexes);
+
+                bytes += scratch.MeshDeps.size()*sizeof(uint64_t);
+                MeshCache.insert(cacheKey, std::make_shared<const ChunkObj_t>(result), bytes, scratch.MeshDeps);
+            }
+
             end:
-            Output.lock()->emplace_back(std::move(result));
+            Output.push(std::move(result));
 
         }
     } catch(const std::exception& exc) {
         LOG.debug() << "Ошибка в работе потока:\n" << exc.what();
         Sync.NeedShutdown = true;
+        Input.wake();
     }
 
     {
@@ -749,6 +834,10 @@ void ChunkPreparator::tickSync(const TickSyncData& data) {
 
     std::unordered_map<WorldId_t, std::vector<Pos::GlobalChunk>> changedChunks = data.ChangedChunks;
 
+    // Потоки генератора стоят, кеш мешей можно чистить без гонок с вставкой
+    if(!data.ChangedNodes.empty() || !data.ChangedVoxels.empty())
+        CMG.invalidateMeshCache(data.ChangedNodes, data.ChangedVoxels);
+
     if(!data.ChangedNodes.empty()) {
         std::unordered_set<DefNodeId> changedNodes(data.ChangedNodes.begin(), data.ChangedNodes.end());
 
@@ -813,7 +902,8 @@ void ChunkPreparator::tickSync(const TickSyncData& data) {
 
     // Добавляем к изменёным чанкам пересчёт соседей
     {
-        std::vector<std::tuple<WorldId_t, Pos::GlobalChunk, uint32_t>> toBuild;
+        // Уже показанные чанки (правки игрока и соседи) перестраиваются вне общей очереди
+        std::vector<std::tuple<WorldId_t, Pos::GlobalChunk, uint32_t>> toBuild, toRebuild;
         for(auto& [wId, chunks] : changedChunks) {
             std::vector<Pos::GlobalChunk> list;
             for(const Pos::GlobalChunk& pos : chunks) {
@@ -831,17 +921,42 @@ void ChunkPreparator::tickSync(const TickSyncData& data) {
             list.erase(eraseIter, list.end());
 
 
+            auto iterMeshWorld = ChunksMesh.find(wId);
             for(Pos::GlobalChunk& pos : list) {
                 Pos::GlobalRegion rPos = pos >> 2;
+                uint32_t requestId;
                 auto iterRegion = Requests[wId].find(rPos);
                 if(iterRegion != Requests[wId].end())
-                    toBuild.emplace_back(wId, pos, iterRegion->second);
+                    requestId = iterRegion->second;
                 else
-                    toBuild.emplace_back(wId, pos, Requests[wId][rPos] = NextRequest++);
+                    requestId = Requests[wId][rPos] = NextRequest++;
+
+                bool shown = false;
+                if(iterMeshWorld != ChunksMesh.end())
+                    if(auto iterMesh = iterMeshWorld->second.find(rPos); iterMesh != iterMeshWorld->second.end()) {
+                        const ChunkObj_t& chunk = iterMesh->second[Pos::bvec4u(pos & 0x3).pack()];
+                        shown = chunk.VoxelPointer || chunk.NodePointer;
+                    }
+
+                (shown ? toRebuild : toBuild).emplace_back(wId, pos, requestId);
             }
         }
 
-        CMG.Input.lock()->push_range(toBuild);
+        // Ближние к камере чанки строятся первыми
+        auto distanceToCamera = [&](const std::tuple<WorldId_t, Pos::GlobalChunk, uint32_t>& entry) -> int32_t {
+            if(std::get<0>(entry) != CameraWorld)
+                return std::numeric_limits<int32_t>::max();
+
+            Pos::GlobalChunk d = std::get<1>(entry) - CameraChunk;
+            return int32_t(d.x)*d.x + int32_t(d.y)*d.y + int32_t(d.z)*d.z;
+        };
+
+        auto byDistance = [&](const auto& a, const auto& b) { return distanceToCamera(a) < distanceToCamera(b); };
+        std::sort(toRebuild.begin(), toRebuild.end(), byDistance);
+        std::sort(toBuild.begin(), toBuild.end(), byDistance);
+
+        CMG.InputUrgent.push_range(std::move(toRebuild));
+        CMG.Input.push_range(std::move(toBuild));
     }
 
     // Чистим запросы и чанки
@@ -874,7 +989,7 @@ void ChunkPreparator::tickSync(const TickSyncData& data) {
 
     // Получаем готовые чанки
     {
-        std::vector<ChunkMeshGenerator::ChunkObj_t> chunks = std::move(*CMG.Output.lock());
+        std::vector<ChunkMeshGenerator::ChunkObj_t> chunks = CMG.Output.popAll();
         uint8_t frameRetirement = (FrameRoulette+FRAME_COUNT_RESOURCE_LATENCY) % FRAME_COUNT_RESOURCE_LATENCY;
         for(auto& chunk : chunks) {
             auto iterWorld = Requests.find(chunk.WId);
@@ -898,6 +1013,7 @@ void ChunkPreparator::tickSync(const TickSyncData& data) {
             rChunk.VoxelPointer = {};
             rChunk.NodePointer = {};
             rChunk.NodeIndexes = {};
+            rChunk.FaceConnectivity = chunk.FaceConnectivity;
             rChunk.Voxels = std::move(chunk.VoxelDefines);
             if(!chunk.VoxelVertexs.empty())
                 rChunk.VoxelPointer = VertexPool_Voxels.pushVertexs(std::move(chunk.VoxelVertexs));
@@ -948,65 +1064,126 @@ std::pair<
     Pos::GlobalChunk playerChunk = pos >> Pos::Object_t::BS_Bit >> 4;
     Pos::GlobalRegion center = playerChunk >> 2;
 
+    CameraWorld = worldId;
+    CameraChunk = playerChunk;
+
     std::vector<std::tuple<float, Pos::GlobalChunk, std::pair<VkBuffer, int>, uint32_t>> vertexVoxels;
     std::vector<std::tuple<float, Pos::GlobalChunk, std::pair<VkBuffer, int>, std::pair<VkBuffer, int>, bool, uint32_t>> vertexNodes;
 
+    LastCullStats = {};
+
     auto iterWorld = ChunksMesh.find(worldId);
     if(iterWorld == ChunksMesh.end())
         return {};
 
     Frustum fr(projView);
 
-    for(int z = -distance; z <= distance; z++) {
-        for(int y = -distance; y <= distance; y++) {
-            for(int x = -distance; x <= distance; x++) {
-                Pos::GlobalRegion region = center + Pos::GlobalRegion(x, y, z);
-                glm::vec3 begin = glm::vec3(region - x64offset) * 64.f;
-                glm::vec3 end = begin + glm::vec3(64.f);
+    /*
+        Обход видимости от чанка камеры (traverseChunkVisibility, cave culling).
+        Регионы проверяются фрустумом один раз; чанки только по плоскостям, которые регион пересекает.
+    */
+    const int regionSide = 2*distance+1;
+    const int chunkSide = regionSide*4;
+    const Pos::GlobalRegion regionOrigin = center - Pos::GlobalRegion(distance);
+    const Pos::GlobalChunk chunkOrigin = Pos::GlobalChunk(regionOrigin) << 2;
+
+    CullRegions.assign(regionSide*regionSide*regionSide, CullRegion{});
+
+    auto getRegion = [&](int rx, int ry, int rz) -> CullRegion& {
+        CullRegion& cr = CullRegions[rx+(ry+rz*regionSide)*regionSide];
+        if(cr.Tested)
+            return cr;
+
+        cr.Tested = true;
+        Pos::GlobalRegion region = regionOrigin + Pos::GlobalRegion(rx, ry, rz);
+        glm::vec3 begin = glm::vec3(region - x64offset) * 64.f;
+        LastCullStats.RegionsTested++;
+        if(fr.TestBox(begin, begin + glm::vec3(64.f), cr.Mask) == Frustum::Intersection::Outside) {
+            cr.Outside = true;
+            LastCullStats.RegionsCulled++;
+            return cr;
+        }
 
-                if(!fr.IsBoxVisible(begin, end))
-                    continue;
+        if(auto iterRegion = iterWorld->second.find(region); iterRegion != iterWorld->second.end())
+            cr.Chunks = &iterRegion->second;
 
-                auto iterRegion = iterWorld->second.find(region);
-                if(iterRegion == iterWorld->second.end()) 
-                    continue;
+        return cr;
+    };
 
-                Pos::GlobalChunk local = Pos::GlobalChunk(region) << 2;
+    uint8_t coherentPlane = 0;
+    uint32_t meshedFrustumCulled = 0;
 
-                for(size_t index = 0; index < iterRegion->second.size(); index++) {
-                    Pos::bvec4u localPos;
-                    localPos.unpack(index);
+    Pos::GlobalChunk startLocal = playerChunk - chunkOrigin;
+    int startIndex = startLocal.x+(startLocal.y+startLocal.z*chunkSide)*chunkSide;
 
-                    glm::vec3 chunkPos = begin+glm::vec3(localPos)*16.f;
-                    if(!fr.IsBoxVisible(chunkPos, chunkPos+glm::vec3(16)))
-                        continue;
+    traverseChunkVisibility(chunkSide, chunkSide, chunkSide, startIndex, OcclusionCulling, CullVisited, CullQueue,
+        [&](const ChunkVisibilityStep& step, int lx, int ly, int lz) -> std::optional<uint16_t>
+    {
+        const bool isStart = step.EntryFace < 0;
+
+        CullRegion& cr = getRegion(lx >> 2, ly >> 2, lz >> 2);
+        if(cr.Outside && !isStart) {
+            LastCullStats.ChunksFrustumCulled++;
+            return std::nullopt;
+        }
 
-                    auto &chunk = iterRegion->second[index];
-                    
-                    float distance;
+        LastCullStats.ChunksVisited++;
+
+        Pos::GlobalChunk chunkGlobal = chunkOrigin + Pos::GlobalChunk(lx, ly, lz);
+        glm::vec3 chunkPos = glm::vec3(chunkGlobal - (Pos::GlobalChunk(x64offset) << 2)) * 16.f;
+        uint8_t mask = cr.Mask;
+        const ChunkObj_t* chunkPtr = cr.Chunks ? &(*cr.Chunks)[Pos::bvec4u(lx & 3, ly & 3, lz & 3).pack()] : nullptr;
+        if(!isStart && fr.TestBox(chunkPos, chunkPos+glm::vec3(16), mask, &coherentPlane) == Frustum::Intersection::Outside) {
+            LastCullStats.ChunksFrustumCulled++;
+            if(chunkPtr && (chunkPtr->VoxelPointer || chunkPtr->NodePointer))
+                meshedFrustumCulled++;
+            return std::nullopt;
+        }
 
-                    if(chunk.VoxelPointer || chunk.NodePointer) {
-                        Pos::GlobalChunk cp = local+Pos::GlobalChunk(localPos)-playerChunk;
-                        distance = cp.x*cp.x+cp.y*cp.y+cp.z*cp.z;
-                    }
+        if(!chunkPtr)
+            return CHUNK_FACES_ALL_CONNECTED;
 
-                    if(chunk.VoxelPointer) {
-                        vertexVoxels.emplace_back(distance, local+Pos::GlobalChunk(localPos), VertexPool_Voxels.map(chunk.VoxelPointer), chunk.VoxelPointer.VertexCount);
-                    }
+        const ChunkObj_t &chunk = *chunkPtr;
+        float distance;
 
-                    if(chunk.NodePointer) {
-                        vertexNodes.emplace_back(
-                            distance, local+Pos::GlobalChunk(localPos), 
-                            VertexPool_Nodes.map(chunk.NodePointer), 
-                            chunk.NodeIndexes.index() == 0
-                                ? IndexPool_Nodes_16.map(std::get<0>(chunk.NodeIndexes))
-                                : IndexPool_Nodes_32.map(std::get<1>(chunk.NodeIndexes))
-                            , chunk.NodeIndexes.index() == 0, 
-                            std::visit<uint32_t>([](const auto& val) -> uint32_t { return val.VertexCount; }, chunk.NodeIndexes));
-                    }
-                }
-            }
+        if(chunk.VoxelPointer || chunk.NodePointer) {
+            Pos::GlobalChunk cp = chunkGlobal-playerChunk;
+            distance = cp.x*cp.x+cp.y*cp.y+cp.z*cp.z;
+            LastCullStats.ChunksRendered++;
+        }
+
+        if(chunk.VoxelPointer) {
+            vertexVoxels.emplace_back(distance, chunkGlobal, VertexPool_Voxels.map(chunk.VoxelPointer), chunk.VoxelPointer.VertexCount);
+        }
+
+        if(chunk.NodePointer) {
+            vertexNodes.emplace_back(
+                distance, chunkGlobal, 
+                VertexPool_Nodes.map(chunk.NodePointer), 
+                chunk.NodeIndexes.index() == 0
+                    ? IndexPool_Nodes_16.map(std::get<0>(chunk.NodeIndexes))
+                    : IndexPool_Nodes_32.map(std::get<1>(chunk.NodeIndexes))
+                , chunk.NodeIndexes.index() == 0, 
+                std::visit<uint32_t>([](const auto& val) -> uint32_t { return val.VertexCount; }, chunk.NodeIndexes));
+        }
+
+        return chunk.FaceConnectivity;
+    });
+
+    // Чанки с мешами в видимых регионах, до которых обход не дошёл
+    {
+        uint32_t meshed = 0;
+        for(const CullRegion& cr : CullRegions) {
+            if(cr.Outside || !cr.Chunks)
+                continue;
+
+            for(const ChunkObj_t& chunk : *cr.Chunks)
+                if(chunk.VoxelPointer || chunk.NodePointer)
+                    meshed++;
         }
+
+        uint32_t reached = LastCullStats.ChunksRendered + meshedFrustumCulled;
+        LastCullStats.ChunksOcclusionCulled = meshed > reached ? meshed - reached : 0;
     }
 
     {
@@ -1666,14 +1843,27 @@ void VulkanRenderSession::setCameraPos(WorldId_t worldId, Pos::Object pos, glm::
 }
 
 void VulkanRenderSession::beforeDraw(double timeSeconds) {
-    if(TP)
-        TP->update(timeSeconds);
+    if(TP) {
+        auto start = std::chrono::steady_clock::now();
+        TP->update(timeSeconds, VkInst->Graphics.CommandBufferRender);
+        GpuWaits.TextureUpdateSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
     LightDummy.atlasUpdateDynamicData();
     CP.flushUploadsAndBarriers(VkInst->Graphics.CommandBufferRender);
 }
 
-void VulkanRenderSession::onGpuFinished() {
+void VulkanRenderSession::onGpuFinished(double fenceSeconds) {
+    auto start = std::chrono::steady_clock::now();
+    if(TP)
+        TP->notifyGpuFinished();
     CP.notifyGpuFinished();
+
+    GpuWaitStats& stats = GpuWaits;
+    stats.Frames++;
+    stats.FenceWaitSeconds += fenceSeconds;
+    stats.WorstFenceWaitSeconds = std::max(stats.WorstFenceWaitSeconds, fenceSeconds);
+    stats.GpuFinishedSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 }
 
 void VulkanRenderSession::drawWorld(GlobalTime gTime, float dTime, VkCommandBuffer drawCmd) {
@@ -3,6 +3,7 @@
 #include "Client/AssetsManager.hpp"
 #include "Client/Abstract.hpp"
 #include "Common/Abstract.hpp"
+#include "Common/ConcurrentQueue.hpp"
 #include <Client/Vulkan/Vulkan.hpp>
 #include <algorithm>
 #include <array>
@@ -27,6 +28,8 @@
 #include "Abstract.hpp"
 #include "TOSLib.hpp"
 #include "VertexPool.hpp"
+#include "ChunkVisibility.hpp"
+#include "ChunkMeshCache.hpp"
 #include "assets.hpp"
 #include "glm/common.hpp"
 #include "glm/fwd.hpp"
@@ -475,6 +478,7 @@ public:
         {
             TextureAtlas::Config cfg;
             cfg.MaxTextureId = 1 << 18;
+            cfg.Packer = TextureAtlas::AtlasPacker::Skyline;
             AtlasStaging = std::make_shared<SharedStagingBuffer>(
                 Inst->Graphics.Device,
                 Inst->Graphics.PhysicalDevice
@@ -484,23 +488,10 @@ public:
             );
         }
 
-        {
-            const VkFenceCreateInfo info = {
-                .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-                .pNext = nullptr,
-                .flags = 0
-            };
-
-            vkAssert(!vkCreateFence(Inst->Graphics.Device, &info, nullptr, &UpdateFence));
-        }
-
         NeedsUpload = true;
     }
 
     ~TextureProvider() {
-        if(UpdateFence)
-            vkDestroyFence(Inst->Graphics.Device, UpdateFence, nullptr);
-
         if(DescLayout)
             vkDestroyDescriptorSetLayout(Inst->Graphics.Device, DescLayout, nullptr);
     }
@@ -596,7 +587,13 @@ public:
         return result;
     }
 
-    void update(double timeSeconds) {
+    /*
+        Записывает загрузку атласа в командный буфер кадра (вне render pass).
+        Копии и барьеры выполняются на GPU раньше рендера этого же кадра,
+        поэтому дескриптор переключается сразу, без отдельного submit и ожидания fence.
+        Staging и отложенные ресурсы освобождаются в notifyGpuFinished() по fence кадра.
+    */
+    void update(double timeSeconds, VkCommandBuffer commandBuffer) {
         std::lock_guard lock(Mutex);
         if(!Atlas)
             return;
@@ -609,55 +606,21 @@ public:
 
         Atlas->flushNewPipelines();
 
-        VkCommandBufferAllocateInfo allocInfo {
-            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-            nullptr,
-            Inst->Graphics.Pool,
-            VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-            1
-        };
-
-        VkCommandBuffer commandBuffer;
-        vkAssert(!vkAllocateCommandBuffers(Inst->Graphics.Device, &allocInfo, &commandBuffer));
-
-        VkCommandBufferBeginInfo beginInfo {
-            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-            nullptr,
-            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-            nullptr
-        };
-
-        vkAssert(!vkBeginCommandBuffer(commandBuffer, &beginInfo));
-
         TextureAtlas::DescriptorOut desc = Atlas->flushUploadsAndBarriers(commandBuffer);
+        updateDescriptor(desc);
 
-        vkAssert(!vkEndCommandBuffer(commandBuffer));
-
-        VkSubmitInfo submitInfo {
-            VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            nullptr,
-            0, nullptr,
-            nullptr,
-            1,
-            &commandBuffer,
-            0,
-            nullptr
-        };
-
-        {
-            auto lockQueue = Inst->Graphics.DeviceQueueGraphic.lock();
-            vkAssert(!vkQueueSubmit(*lockQueue, 1, &submitInfo, UpdateFence));
-        }
-
-        vkAssert(!vkWaitForFences(Inst->Graphics.Device, 1, &UpdateFence, VK_TRUE, UINT64_MAX));
-        vkAssert(!vkResetFences(Inst->Graphics.Device, 1, &UpdateFence));
+        UploadInFlight = true;
+        NeedsUpload = false;
+    }
 
-        vkFreeCommandBuffers(Inst->Graphics.Device, Inst->Graphics.Pool, 1, &commandBuffer);
+    // Вызывается после завершения GPU команд кадра, в который была записана загрузка
+    void notifyGpuFinished() {
+        std::lock_guard lock(Mutex);
+        if(!Atlas || !UploadInFlight)
+            return;
 
         Atlas->notifyGpuFinished();
-        updateDescriptor(desc);
-
-        NeedsUpload = false;
+        UploadInFlight = false;
     }
 
 private:
@@ -779,7 +742,6 @@ private:
     VkDescriptorPool DescPool = VK_NULL_HANDLE;
     VkDescriptorSetLayout DescLayout = VK_NULL_HANDLE;
     VkDescriptorSet Descriptor = VK_NULL_HANDLE;
-    VkFence UpdateFence = VK_NULL_HANDLE;
 
     std::shared_ptr<SharedStagingBuffer> AtlasStaging;
     std::unique_ptr<PipelinedTextureAtlas> Atlas;
@@ -787,6 +749,8 @@ private:
     std::unordered_map<AssetsTexture, AnimatedSource> AnimatedSources;
 
     bool NeedsUpload = false;
+    // Загрузка записана в кадр, ждём его завершения на GPU
+    bool UploadInFlight = false;
     Logger LOG = "Client>TextureProvider";
     mutable std::mutex Mutex;
 };
@@ -1018,12 +982,21 @@ struct ChunkMeshGenerator {
         std::vector<NodeVertexStatic> NodeVertexs;
         // Индексы
         std::variant<std::vector<uint16_t>, std::vector<uint32_t>> NodeIndexes;
+        // Связность сторон чанка через пустоты (ChunkVisibility.hpp)
+        uint16_t FaceConnectivity = CHUNK_FACES_ALL_CONNECTED;
     };
 
-    // Очередь чанков на перерисовку
-    TOS::SpinlockObject<std::queue<std::tuple<WorldId_t, Pos::GlobalChunk, uint32_t>>> Input;
+private:
+    // Общий сигнал входных очередей
+    EventSignal InputSignal;
+
+public:
+    // Очередь чанков на перерисовку (ближние к камере должны идти первыми)
+    WorkQueue<std::tuple<WorldId_t, Pos::GlobalChunk, uint32_t>> Input{&InputSignal};
+    // Перерисовка уже показанных чанков после изменений в мире, разбирается раньше Input
+    WorkQueue<std::tuple<WorldId_t, Pos::GlobalChunk, uint32_t>> InputUrgent{&InputSignal};
     // Выход
-    TOS::SpinlockObject<std::vector<ChunkObj_t>> Output;
+    MPSCQueue<ChunkObj_t> Output;
 
 public:
     ChunkMeshGenerator(IServerSession* serverSession)
@@ -1039,12 +1012,45 @@ public:
     // Меняет количество обрабатывающих потоков
     void changeThreadsCount(uint8_t threads);
 
+    // Все аппаратные потоки, кроме основного
+    static uint8_t defaultThreadsCount() {
+        unsigned hw = std::thread::hardware_concurrency();
+        if(hw == 0)
+            return 3;
+
+        return std::clamp<unsigned>(hw-1, 1, 255);
+    }
+
     void setNodestateProvider(NodestateProvider* provider) {
         NSP = provider;
+        invalidateMeshCache();
+    }
+
+    // Сменился источник моделей, устарели все сохранённые меши
+    void invalidateMeshCache() {
+        ProfileGeneration.fetch_add(1, std::memory_order_relaxed);
+        MeshCache.clear();
+    }
+
+    // Профили нод или вокселей изменились, устарели только меши, в которых они встречаются
+    void invalidateMeshCache(const std::vector<DefNodeId>& nodes, const std::vector<DefVoxelId>& voxels) {
+        std::unordered_set<uint64_t> changed;
+        for(DefNodeId id : nodes)
+            changed.insert(nodeMeshDep(id));
+        for(DefVoxelId id : voxels)
+            changed.insert(voxelMeshDep(id));
+
+        MeshCache.evict(changed);
+    }
+
+    ChunkMeshCache<ChunkObj_t>::Stats getMeshCacheStats() const {
+        return MeshCache.stats();
     }
 
     void prepareTickSync() {
         Sync.Stop = true;
+        // Ожидающие входа потоки должны заметить остановку
+        Input.wake();
     }
 
     void pushStageTickSync() {
@@ -1070,6 +1076,46 @@ private:
     NodestateProvider* NSP = nullptr;
     std::vector<std::thread> Threads;
 
+    static constexpr size_t MESH_CACHE_BYTES = 128 << 20;
+
+    // Готовые меши для чанков, содержимое которых уже встречалось (повторная отправка, возврат в зону видимости)
+    ChunkMeshCache<ChunkObj_t> MeshCache{MESH_CACHE_BYTES};
+    std::atomic<uint32_t> ProfileGeneration = 0;
+
+    // Зависимости записи кеша мешей: ноды и воксели в раздельных диапазонах
+    static uint64_t nodeMeshDep(DefNodeId id) { return id; }
+    static uint64_t voxelMeshDep(DefVoxelId id) { return (uint64_t(1) << 32) | id; }
+
+    /*
+        Рабочие данные потока, переживают отдельные чанки, чтобы не выделять память на каждый.
+        Кеши профилей действительны только между синхронизациями такта:
+        в такте профили и состояния нод могут измениться.
+    */
+    struct ThreadScratch {
+        struct ModelCacheEntry {
+            std::vector<std::vector<std::pair<float, std::unordered_map<EnumFace, std::vector<NodeVertexStatic>>>>> Routes;
+        };
+
+        // Профиль, который используется если на стороне клиента отсутствует нужных профиль
+        DefNode DefaultProfileNode;
+        std::unordered_map<DefNodeId, const DefNode*> ProfilesNodeCache;
+        std::unordered_map<DefNodeId, bool> NodeFullCuboidCache;
+        std::unordered_map<uint32_t, ModelCacheEntry> ModelCache;
+
+        // Сырые вершины до сокращения, таблица сокращения и индексы
+        std::vector<NodeVertexStatic> RawVertexs;
+        std::unordered_map<NodeVertexStatic, uint32_t> VertexTable;
+        std::vector<uint32_t> Indexes;
+        // Ноды и воксели, от которых зависит меш чанка (записи кеша мешей)
+        std::vector<uint64_t> MeshDeps;
+
+        void dropCaches() {
+            ProfilesNodeCache.clear();
+            NodeFullCuboidCache.clear();
+            ModelCache.clear();
+        }
+    };
+
     void run(uint8_t id);
 };
 
@@ -1099,7 +1145,7 @@ public:
         assert(vkInst);
         assert(serverSession);
 
-        CMG.changeThreadsCount(3);
+        CMG.changeThreadsCount(ChunkMeshGenerator::defaultThreadsCount());
     }
 
     ~ChunkPreparator() {
@@ -1143,6 +1189,19 @@ public:
         std::vector<std::tuple<Pos::GlobalChunk, std::pair<VkBuffer, int>, std::pair<VkBuffer, int>, bool, uint32_t>>
     > getChunksForRender(WorldId_t worldId, Pos::Object pos, uint8_t distance, glm::mat4 projView, Pos::GlobalRegion x64offset);
 
+    // Счётчики последнего вызова getChunksForRender
+    struct CullStats {
+        uint32_t RegionsTested = 0, RegionsCulled = 0;
+        uint32_t ChunksVisited = 0, ChunksFrustumCulled = 0, ChunksOcclusionCulled = 0, ChunksRendered = 0;
+    };
+
+    const CullStats& getCullStats() const {
+        return LastCullStats;
+    }
+
+    // Отсечение по связности сторон чанков. Без него обход покрывает весь фрустум
+    bool OcclusionCulling = true;
+
 private:
     static constexpr uint8_t FRAME_COUNT_RESOURCE_LATENCY = 6;
 
@@ -1163,6 +1222,8 @@ private:
         std::vector<DefNodeId> Nodes;
         VertexPool<NodeVertexStatic>::Pointer NodePointer;
         std::variant<IndexPool<uint16_t>::Pointer, IndexPool<uint32_t>::Pointer> NodeIndexes;
+        // Пока меш не построен, чанк считается прозрачным со всех сторон
+        uint16_t FaceConnectivity = CHUNK_FACES_ALL_CONNECTED;
     };
 
     // Склад указателей на вершины чанков
@@ -1178,6 +1239,24 @@ private:
         std::variant<IndexPool<uint16_t>::Pointer, IndexPool<uint32_t>::Pointer>
     >> VPN_ToFree[FRAME_COUNT_RESOURCE_LATENCY];
 
+    // Рабочие буферы обхода видимости, переиспользуются между кадрами
+    struct CullRegion {
+        // Плоскости фрустума, которые регион пересекает
+        uint8_t Mask = Frustum::AllPlanes;
+        bool Tested = false, Outside = false;
+        std::array<ChunkObj_t, 4*4*4>* Chunks = nullptr;
+    };
+
+    std::vector<CullRegion> CullRegions;
+    std::vector<uint8_t> CullVisited;
+    std::vector<ChunkVisibilityStep> CullQueue;
+    CullStats LastCullStats;
+    GpuWaitStats GpuWaits;
+
+    // Положение камеры с последнего кадра, по нему упорядочивается построение мешей
+    WorldId_t CameraWorld = 0;
+    Pos::GlobalChunk CameraChunk = Pos::GlobalChunk(0);
+
     // Следующий идентификатор запроса
     uint32_t NextRequest = 0;
     // Список ожидаемых чанков. Если регион был потерян, следующая его запись получит
@@ -1276,8 +1355,24 @@ public:
         return glm::translate(glm::mat4(quat), camOffset);
     }
 
+    /*
+        Время CPU на кадр вокруг GPU: запись загрузки атласа (TextureProvider::update),
+        ожидание fence кадра и освобождение ресурсов после него (onGpuFinished).
+        Накапливается с начала сессии, худшее ожидание fence - отдельно
+    */
+    struct GpuWaitStats {
+        uint64_t Frames = 0;
+        double TextureUpdateSeconds = 0, FenceWaitSeconds = 0, GpuFinishedSeconds = 0;
+        double WorstFenceWaitSeconds = 0;
+    };
+
+    const GpuWaitStats& getGpuWaitStats() const {
+        return GpuWaits;
+    }
+
     void beforeDraw(double timeSeconds);
-    void onGpuFinished();
+    // fenceSeconds - сколько CPU ждал fence этого кадра
+    void onGpuFinished(double fenceSeconds);
     void drawWorld(GlobalTime gTime, float dTime, VkCommandBuffer drawCmd);
     void pushStage(EnumRenderStage stage);
 
@@ -794,6 +794,18 @@ void unCompressNodes(std::u8string_view compressed, Node* ptr) {
     //     return unCompressNodes_bit(next, ptr);
 }
 
+std::u8string compressLight(const ChunkLight& light) {
+    return compressLinear(std::u8string_view((const char8_t*) light.data(), light.size()));
+}
+
+void unCompressLight(std::u8string_view compressed, ChunkLight& light) {
+    const std::u8string& next = unCompressLinear(compressed);
+    if(next.size() != light.size())
+        MAKE_ERROR("Неверный размер освещённости чанка: " << next.size());
+
+    std::copy(next.begin(), next.end(), (char8_t*) light.data());
+}
+
 std::u8string compressLinear(std::u8string_view data) {
     std::stringstream in;
     in.write((const char*) data.data(), data.size());
@@ -2082,25 +2094,46 @@ struct Resource::InlinePtr {
         Hash = sha2::sha256((const uint8_t*) Data.data(), Data.size());
     }
 
+    InlinePtr(std::u8string&& data, const Hash_t& hash)
+        : Data(std::move(data)), Hash(hash)
+    {}
+
     const std::byte* data() const { return (const std::byte*) Data.data(); }
     size_t size() const { return Data.size(); }
 };
 
+struct Resource::InlineView {
+    std::shared_ptr<const void> Owner;
+    const std::byte* Data;
+    size_t Size;
+    Hash_t Hash;
+
+    const std::byte* data() const { return Data; }
+    size_t size() const { return Size; }
+};
 
 Resource::Resource(fs::path path)
-    : In(std::make_shared<std::variant<InlineMMap, InlinePtr>>(InlineMMap(path)))
+    : In(std::make_shared<std::variant<InlineMMap, InlinePtr, InlineView>>(InlineMMap(path)))
 {}
 
 Resource::Resource(const uint8_t* data, size_t size)
-    : In(std::make_shared<std::variant<InlineMMap, InlinePtr>>(InlinePtr(data, size)))
+    : In(std::make_shared<std::variant<InlineMMap, InlinePtr, InlineView>>(InlinePtr(data, size)))
 {}
 
 Resource::Resource(const std::u8string& data) 
-    : In(std::make_shared<std::variant<InlineMMap, InlinePtr>>(InlinePtr((const uint8_t*) data.data(), data.size())))
+    : In(std::make_shared<std::variant<InlineMMap, InlinePtr, InlineView>>(InlinePtr((const uint8_t*) data.data(), data.size())))
 {}
 
 Resource::Resource(std::u8string&& data)
-    : In(std::make_shared<std::variant<InlineMMap, InlinePtr>>(InlinePtr(std::move(data))))
+    : In(std::make_shared<std::variant<InlineMMap, InlinePtr, InlineView>>(InlinePtr(std::move(data))))
+{}
+
+Resource::Resource(std::u8string&& data, const Hash_t& hash)
+    : In(std::make_shared<std::variant<InlineMMap, InlinePtr, InlineView>>(InlinePtr(std::move(data), hash)))
+{}
+
+Resource::Resource(std::shared_ptr<const void> owner, const std::byte* data, size_t size, const Hash_t& hash)
+    : In(std::make_shared<std::variant<InlineMMap, InlinePtr, InlineView>>(InlineView{std::move(owner), data, size, hash}))
 {}
 
 const std::byte* Resource::data() const { assert(In); return std::visit<const std::byte*>([](auto& obj){ return obj.data(); }, *In); }
@@ -2111,7 +2144,7 @@ Resource Resource::convertToMem() const {
     if(InlineMMap* ptr = std::get_if<InlineMMap>(&*In)) {
         std::u8string data(ptr->size(), '\0');
         std::copy(ptr->data(), ptr->data()+ptr->size(), (std::byte*) data.data());
-        return Resource(std::move(data));
+        return Resource(std::move(data), ptr->Hash);
     } else {
         return *this;
     }
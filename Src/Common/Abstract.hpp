@@ -3,6 +3,7 @@
 #include "TOSLib.hpp"
 #include "boost/json/array.hpp"
 #include <algorithm>
+#include <array>
 #include <cstdint>
 #include <glm/ext.hpp>
 #include <memory>
@@ -476,9 +477,11 @@ using DefItemId       = ResourceId;
 
 using WorldId_t = ResourceId;
 
-// struct LightPrism {
-//     uint8_t R : 2, G : 2, B : 2;
-// };
+/*
+    Освещённость нод чанка, по байту на ноду:
+    младшие 4 бита - свет от источников, старшие 4 бита - небесный свет
+*/
+using ChunkLight = std::array<uint8_t, 16*16*16>;
 
 
 
@@ -529,6 +532,9 @@ struct CompressedNodes {
 std::u8string compressNodes(const Node* nodes, bool fast = true);
 void unCompressNodes(std::u8string_view compressed, Node* ptr);
 
+std::u8string compressLight(const ChunkLight& light);
+void unCompressLight(std::u8string_view compressed, ChunkLight& light);
+
 std::u8string compressLinear(std::u8string_view data);
 std::u8string unCompressLinear(std::u8string_view data);
 
@@ -1035,8 +1041,9 @@ struct Resource {
 private:
     struct InlineMMap;
     struct InlinePtr;
+    struct InlineView;
 
-    std::shared_ptr<std::variant<InlineMMap, InlinePtr>> In;
+    std::shared_ptr<std::variant<InlineMMap, InlinePtr, InlineView>> In;
 
 public:
     Resource() = default;
@@ -1044,6 +1051,11 @@ public:
     Resource(const uint8_t* data, size_t size);
     Resource(const std::u8string& data);
     Resource(std::u8string&& data);
+    // Хеш уже известен (посчитан при сканировании), повторно не считается
+    Resource(std::u8string&& data, const Hash_t& hash);
+    // Представление чужой памяти без копирования (например, пакета ресурсов).
+    // owner удерживает память, пока жив ресурс; хеш не пересчитывается.
+    Resource(std::shared_ptr<const void> owner, const std::byte* data, size_t size, const Hash_t& hash);
 
     Resource(const Resource&) = default;
     Resource(Resource&&) = default;
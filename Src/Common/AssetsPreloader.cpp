@@ -2,17 +2,34 @@
 #include "Common/Abstract.hpp"
 #include "Common/TexturePipelineProgram.hpp"
 #include "sha2.hpp"
+#include <algorithm>
 #include <atomic>
+#include <cassert>
+#include <chrono>
+#include <exception>
 #include <filesystem>
 #include <fstream>
+#include <mutex>
+#include <thread>
+#include <tuple>
 #include <unordered_set>
 #include <utility>
 
+#ifdef LUAVOX_HAVE_LIBURING
+#include <fcntl.h>
+#include <liburing.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace LV {
 
 static TOS::Logger LOG = "AssetsPreloader";
 
-static ResourceFile readFileBytes(const fs::path& path) {
+static constexpr uint32_t MANIFEST_MAGIC = 0x4c56414d; // LVAM
+static constexpr uint32_t MANIFEST_VERSION = 1;
+
+static std::u8string readFileData(const fs::path& path) {
     std::ifstream file(path, std::ios::binary);
     if(!file)
         throw std::runtime_error("Не удалось открыть файл: " + path.string());
@@ -23,26 +40,154 @@ static ResourceFile readFileBytes(const fs::path& path) {
         size = 0;
     file.seekg(0, std::ios::beg);
 
-    ResourceFile out;
-    out.Data.resize(static_cast<size_t>(size));
+    std::u8string out;
+    out.resize(static_cast<size_t>(size));
     if(size > 0) {
-        file.read(reinterpret_cast<char*>(out.Data.data()), size);
+        file.read(reinterpret_cast<char*>(out.data()), size);
         if (!file)
             throw std::runtime_error("Не удалось прочитать файл: " + path.string());
     }
 
-    out.calcHash();
     return out;
 }
 
+// Ресурс хранится как есть, без преобразования в headless
+static bool isRawAsset(AssetType type) {
+    return type != AssetType::Nodestate && type != AssetType::Model;
+}
+
+/*
+    Пакетное чтение файлов целиком.
+    С io_uring все чтения пакета отправляются одним submit, иначе последовательно.
+    Файлы, которые не удалось прочитать, помечаются в failed (вызывающий повторит через readFileData,
+    чтобы получить нормальное сообщение об ошибке).
+*/
+class BatchFileReader {
+public:
+    static constexpr unsigned BATCH_SIZE = 32;
+
+    BatchFileReader() {
+    #ifdef LUAVOX_HAVE_LIBURING
+        HasRing = io_uring_queue_init(BATCH_SIZE, &Ring, 0) == 0;
+    #endif
+    }
+
+    ~BatchFileReader() {
+    #ifdef LUAVOX_HAVE_LIBURING
+        if(HasRing)
+            io_uring_queue_exit(&Ring);
+    #endif
+    }
+
+    BatchFileReader(const BatchFileReader&) = delete;
+    BatchFileReader& operator=(const BatchFileReader&) = delete;
+
+    void read(const std::vector<const fs::path*>& paths, std::vector<std::u8string>& out, std::vector<bool>& failed) {
+        assert(paths.size() <= BATCH_SIZE);
+        out.resize(paths.size());
+        failed.assign(paths.size(), false);
+
+    #ifdef LUAVOX_HAVE_LIBURING
+        if(HasRing) {
+            readRing(paths, out, failed);
+            return;
+        }
+    #endif
+
+        for(size_t iter = 0; iter < paths.size(); iter++) {
+            try {
+                out[iter] = readFileData(*paths[iter]);
+            } catch(...) {
+                failed[iter] = true;
+            }
+        }
+    }
+
+private:
+#ifdef LUAVOX_HAVE_LIBURING
+    io_uring Ring;
+    bool HasRing = false;
+
+    void readRing(const std::vector<const fs::path*>& paths, std::vector<std::u8string>& out, std::vector<bool>& failed) {
+        std::vector<int> fds(paths.size(), -1);
+        unsigned submitted = 0;
+
+        for(size_t iter = 0; iter < paths.size(); iter++) {
+            int fd = ::open(paths[iter]->c_str(), O_RDONLY | O_CLOEXEC);
+            struct stat st;
+            if(fd < 0 || ::fstat(fd, &st) != 0) {
+                if(fd >= 0)
+                    ::close(fd);
+                failed[iter] = true;
+                continue;
+            }
+
+            fds[iter] = fd;
+            out[iter].resize(static_cast<size_t>(st.st_size));
+            if(out[iter].empty())
+                continue;
+
+            io_uring_sqe* sqe = io_uring_get_sqe(&Ring);
+            io_uring_prep_read(sqe, fd, out[iter].data(), out[iter].size(), 0);
+            io_uring_sqe_set_data64(sqe, iter);
+            submitted++;
+        }
+
+        if(submitted && io_uring_submit(&Ring) < 0) {
+            // Отправка не удалась, читаем по старинке
+            for(size_t iter = 0; iter < paths.size(); iter++) {
+                if(fds[iter] >= 0)
+                    ::close(fds[iter]);
+
+                failed[iter] = true;
+            }
+
+            return;
+        }
+
+        for(unsigned done = 0; done < submitted; done++) {
+            io_uring_cqe* cqe;
+            if(io_uring_wait_cqe(&Ring, &cqe) != 0) {
+                std::fill(failed.begin(), failed.end(), true);
+                break;
+            }
+
+            size_t index = io_uring_cqe_get_data64(cqe);
+            int res = cqe->res;
+            io_uring_cqe_seen(&Ring, cqe);
+
+            if(res < 0) {
+                failed[index] = true;
+                continue;
+            }
+
+            // Короткое чтение дочитываем синхронно
+            size_t offset = static_cast<size_t>(res);
+            while(offset < out[index].size()) {
+                ssize_t readed = ::pread(fds[index], out[index].data()+offset, out[index].size()-offset, offset);
+                if(readed <= 0) {
+                    failed[index] = true;
+                    break;
+                }
+
+                offset += static_cast<size_t>(readed);
+            }
+        }
+
+        for(int fd : fds)
+            if(fd >= 0)
+                ::close(fd);
+    }
+#endif
+};
+
 static std::u8string readOptionalMeta(const fs::path& path) {
     fs::path metaPath = path;
     metaPath += ".meta";
     if(!fs::exists(metaPath) || !fs::is_regular_file(metaPath))
         return {};
 
-    ResourceFile meta = readFileBytes(metaPath);
-    return std::move(meta.Data);
+    return readFileData(metaPath);
 }
 
 AssetsPreloader::AssetsPreloader() {
@@ -172,6 +317,7 @@ AssetsPreloader::Out_checkAndPrepareResourcesUpdate AssetsPreloader::_checkAndPr
                             firstStage[key] = ResourceFindInfo{
                                 .Path = file,
                                 .Timestamp = timestamp,
+                                .Size = begin->file_size(),
                                 .Id = idResolver(assetType, domain, key)
                             };
                         }
@@ -185,8 +331,31 @@ AssetsPreloader::Out_checkAndPrepareResourcesUpdate AssetsPreloader::_checkAndPr
         }
     }
 
+    using IdResolver = std::function<ResourceId(EnumAssets type, std::string_view domain, std::string_view key)>;
+
+    /*
+        Разбор ресурсов идёт в пуле потоков. Чтобы идентификаторы не зависели от порядка прихода потоков,
+        там разрешаются только ссылки на найденные при сканировании ресурсы (их идентификаторы уже выданы),
+        остальные откладываются и выдаются одним проходом в порядке заданий
+    */
+    auto findScanned = [&](EnumAssets type, std::string_view domain, std::string_view key) -> std::optional<ResourceId> {
+        const auto& byDomain = resourcesFirstStage[static_cast<size_t>(type)];
+        auto iterDomain = byDomain.find(domain);
+        if(iterDomain == byDomain.end())
+            return std::nullopt;
+
+        auto iterKey = iterDomain->second.find(key);
+        if(iterKey == iterDomain->second.end())
+            return std::nullopt;
+
+        return iterKey->second.Id;
+    };
+
     // Функция парсинга ресурсов
-    auto buildResource = [&](AssetType type, std::string_view domain, std::string_view key, const ResourceFindInfo& info) -> PendingResource {
+    // data - содержимое файла, knownHash - уже известный хеш сырого файла (из манифеста или пакетного хеширования)
+    auto buildResource = [&](AssetType type, std::string_view domain, std::string_view key, const ResourceFindInfo& info,
+        std::u8string&& data, const ResourceFile::Hash_t* knownHash, const IdResolver& resolve
+    ) -> PendingResource {
         PendingResource out;
         out.Key = key;
         out.Timestamp = info.Timestamp;
@@ -195,14 +364,14 @@ AssetsPreloader::Out_checkAndPrepareResourcesUpdate AssetsPreloader::_checkAndPr
             = [&](const std::string_view model) -> uint32_t
         {
             auto [mDomain, mKey] = parseDomainKey(model, domain);
-            return idResolver(AssetType::Model, mDomain, mKey);
+            return resolve(AssetType::Model, mDomain, mKey);
         };
 
         std::function<std::optional<uint32_t>(std::string_view)> textureIdResolver
             = [&](std::string_view texture) -> std::optional<uint32_t>
         {
             auto [mDomain, mKey] = parseDomainKey(texture, domain);
-            return idResolver(AssetType::Texture, mDomain, mKey);
+            return resolve(AssetType::Texture, mDomain, mKey);
         };
 
         std::function<std::vector<uint8_t>(const std::string_view)> textureResolver
@@ -219,8 +388,7 @@ AssetsPreloader::Out_checkAndPrepareResourcesUpdate AssetsPreloader::_checkAndPr
         };
 
         if (type == AssetType::Nodestate) {
-            ResourceFile file = readFileBytes(info.Path);
-            std::string_view view(reinterpret_cast<const char*>(file.Data.data()), file.Data.size());
+            std::string_view view(reinterpret_cast<const char*>(data.data()), data.size());
             js::object obj = js::parse(view).as_object();
 
             HeadlessNodeState hns;
@@ -230,8 +398,7 @@ AssetsPreloader::Out_checkAndPrepareResourcesUpdate AssetsPreloader::_checkAndPr
         } else if (type == AssetType::Model) {
             const std::string ext = info.Path.extension().string();
             if (ext == ".json") {
-                ResourceFile file = readFileBytes(info.Path);
-                std::string_view view(reinterpret_cast<const char*>(file.Data.data()), file.Data.size());
+                std::string_view view(reinterpret_cast<const char*>(data.data()), data.size());
                 js::object obj = js::parse(view).as_object();
 
                 HeadlessModel hm;
@@ -246,18 +413,14 @@ AssetsPreloader::Out_checkAndPrepareResourcesUpdate AssetsPreloader::_checkAndPr
             } else {
                 throw std::runtime_error("Не поддерживаемый формат модели: " + info.Path.string());
             }
-        } else if (type == AssetType::Texture) {
-            ResourceFile file = readFileBytes(info.Path);
-            out.Resource = std::move(file.Data);
-            out.Hash = file.Hash;
-            out.Header = readOptionalMeta(info.Path);
         } else {
-            ResourceFile file = readFileBytes(info.Path);
-            out.Resource = std::move(file.Data);
-            out.Hash = file.Hash;
+            out.Hash = knownHash ? *knownHash : ResourceFile::calcHash(data.data(), data.size());
+            out.Resource = std::move(data);
+            if(type == AssetType::Texture)
+                out.Header = readOptionalMeta(info.Path);
         }
 
-        out.Id = idResolver(type, domain, key);
+        out.Id = info.Id;
 
         return out;
     }; 
@@ -271,6 +434,24 @@ AssetsPreloader::Out_checkAndPrepareResourcesUpdate AssetsPreloader::_checkAndPr
         static_cast<size_t>(EnumAssets::MAX_ENUM)
     > uniqueExists;
 
+    struct BuildJob {
+        AssetType Type;
+        std::string_view Domain, Key;
+        const ResourceFindInfo* Info;
+        // Хеш из манифеста, если размер и время изменения совпали
+        std::optional<ResourceFile::Hash_t> KnownHash;
+        bool NeedRead = true;
+        PendingResource Result;
+        std::exception_ptr Error;
+        // Ссылки на ресурсы, не найденные при сканировании, в порядке разбора
+        std::vector<std::tuple<EnumAssets, std::string, std::string>> Unresolved;
+    };
+
+    std::vector<BuildJob> jobs;
+    loadManifest();
+    bool manifestChanged = false;
+    std::unordered_set<std::string> seenRawPaths;
+
     for(size_t type = 0; type < static_cast<size_t>(AssetType::MAX_ENUM); ++type) {
         auto& uniqueExistsTypes = uniqueExists[type];
         const auto& resourceLinksTyped = ResourceLinks[type];
@@ -288,51 +469,240 @@ AssetsPreloader::Out_checkAndPrepareResourcesUpdate AssetsPreloader::_checkAndPr
             for(const auto& [key, res] : keys) {
                 uniqueExistsTypes.insert(res.Id);
 
-                if(res.Id >= resourceLinksTyped.size() || !resourceLinksTyped[res.Id].IsExist)
-                {   // Если идентификатора нет в таблице или ресурс не привязан
-                    PendingResource resource = buildResource(static_cast<AssetType>(type), domain, key, res);
-                    if(onNewResourceParsed)
-                        onNewResourceParsed(std::move(resource.Resource), resource.Hash, res.Path);
-                    result.HashToPathNew[resource.Hash].push_back(res.Path);
-
-                    if(res.Id >= result.MaxNewSize[type])
-                        result.MaxNewSize[type] = res.Id+1;
-
-                    result.ResourceUpdates[type].emplace_back(res.Id, resource.Hash, std::move(resource.Header), resource.Timestamp, res.Path);
-                } else if(resourceLinksTyped[res.Id].Path != res.Path
-                    || resourceLinksTyped[res.Id].LastWrite != res.Timestamp
-                ) { // Если ресурс теперь берётся с другого места или изменилось время изменения файла
-                    const auto& lastResource = resourceLinksTyped[res.Id];
-                    PendingResource resource = buildResource(static_cast<AssetType>(type), domain, key, res);
-                    
-                    if(lastResource.Hash != resource.Hash) {
-                        // Хэш изменился
-                        // Сообщаем о новом ресурсе
-                        if(onNewResourceParsed)
-                            onNewResourceParsed(std::move(resource.Resource), resource.Hash, res.Path);
-                        // Старый хэш более не доступен по этому расположению.
-                        result.HashToPathLost[lastResource.Hash].push_back(resourceLinksTyped[res.Id].Path);
-                        // Новый хеш стал доступен по этому расположению.
-                        result.HashToPathNew[resource.Hash].push_back(res.Path);
-                    } else if(resourceLinksTyped[res.Id].Path != res.Path) {
-                        // Изменился конечный путь.
-                        // Хэш более не доступен по этому расположению.
-                        result.HashToPathLost[resource.Hash].push_back(resourceLinksTyped[res.Id].Path);
-                        // Хеш теперь доступен по этому расположению.
-                        result.HashToPathNew[resource.Hash].push_back(res.Path);
-                    } else {
-                        // Ресурс без заголовка никак не изменился.
-                    }
+                if(isRawAsset(static_cast<AssetType>(type)))
+                    seenRawPaths.insert(res.Path.string());
 
-                    // Чтобы там не поменялось, мог поменятся заголовок. Уведомляем о новой привязке.
-                    result.ResourceUpdates[type].emplace_back(res.Id, resource.Hash, std::move(resource.Header), resource.Timestamp, res.Path);
-                } else {
+                if(res.Id < resourceLinksTyped.size() && resourceLinksTyped[res.Id].IsExist
+                    && resourceLinksTyped[res.Id].Path == res.Path
+                    && resourceLinksTyped[res.Id].LastWrite == res.Timestamp
+                ) {
                     // Ресурс не изменился
+                    continue;
+                }
+
+                BuildJob& job = jobs.emplace_back();
+                job.Type = static_cast<AssetType>(type);
+                job.Domain = domain;
+                job.Key = key;
+                job.Info = &res;
+
+                if(isRawAsset(job.Type)) {
+                    auto iter = Manifest.find(res.Path.string());
+                    if(iter != Manifest.end()
+                        && iter->second.Size == res.Size
+                        && iter->second.Timestamp == res.Timestamp.time_since_epoch().count()
+                    ) {
+                        job.KnownHash = iter->second.Hash;
+                        // Содержимое нужно только получателю распаршенных ресурсов
+                        job.NeedRead = bool(onNewResourceParsed);
+                    }
+                }
+            }
+        }
+    }
+
+    // Чтение, разбор и хеширование в пуле потоков
+    auto timeStart = std::chrono::steady_clock::now();
+    std::atomic<size_t> nextJob = 0, bytesRead = 0;
+
+    auto worker = [&]() {
+        BatchFileReader reader;
+        std::vector<const fs::path*> paths;
+        std::vector<size_t> indexes;
+        std::vector<std::u8string> datas;
+        std::vector<bool> failed;
+        std::vector<ResourceFile::Hash_t> hashes;
+        std::vector<const uint8_t*> hashData;
+        std::vector<uint64_t> hashSizes;
+        std::vector<size_t> hashIndexes;
+
+        while(true) {
+            size_t begin = nextJob.fetch_add(BatchFileReader::BATCH_SIZE);
+            if(begin >= jobs.size())
+                break;
+
+            size_t end = std::min<size_t>(begin+BatchFileReader::BATCH_SIZE, jobs.size());
+
+            paths.clear();
+            indexes.clear();
+            for(size_t iter = begin; iter < end; iter++) {
+                if(!jobs[iter].NeedRead)
+                    continue;
+
+                paths.push_back(&jobs[iter].Info->Path);
+                indexes.push_back(iter);
+            }
+
+            reader.read(paths, datas, failed);
+
+            // Сырые файлы пакета хешируются вместе (sha256_batch раскладывает их по полосам SIMD)
+            hashData.clear();
+            hashSizes.clear();
+            hashIndexes.clear();
+            for(size_t iter = 0; iter < indexes.size(); iter++) {
+                const BuildJob& job = jobs[indexes[iter]];
+                if(failed[iter] || job.KnownHash || !isRawAsset(job.Type))
+                    continue;
+
+                hashData.push_back(reinterpret_cast<const uint8_t*>(datas[iter].data()));
+                hashSizes.push_back(datas[iter].size());
+                hashIndexes.push_back(indexes[iter]);
+            }
+
+            hashes.resize(hashData.size());
+            sha2::sha256_batch(hashData.data(), hashSizes.data(), hashes.data(), hashData.size());
+
+            size_t readIndex = 0, hashIndex = 0;
+            for(size_t iter = begin; iter < end; iter++) {
+                BuildJob& job = jobs[iter];
+
+                try {
+                    std::u8string data;
+                    if(job.NeedRead) {
+                        assert(indexes[readIndex] == iter);
+                        if(failed[readIndex])
+                            data = readFileData(job.Info->Path);
+                        else
+                            data = std::move(datas[readIndex]);
+
+                        readIndex++;
+                        bytesRead.fetch_add(data.size(), std::memory_order_relaxed);
+                    }
+
+                    const ResourceFile::Hash_t* knownHash = job.KnownHash ? &*job.KnownHash : nullptr;
+                    if(hashIndex < hashIndexes.size() && hashIndexes[hashIndex] == iter)
+                        knownHash = &hashes[hashIndex++];
+
+                    IdResolver resolve = [&](EnumAssets type, std::string_view domain, std::string_view key) -> ResourceId {
+                        if(std::optional<ResourceId> id = findScanned(type, domain, key))
+                            return *id;
+
+                        // Заглушка, ресурс будет разобран заново после выдачи идентификаторов
+                        job.Unresolved.emplace_back(type, std::string(domain), std::string(key));
+                        return 0;
+                    };
+
+                    job.Result = buildResource(job.Type, job.Domain, job.Key, *job.Info, std::move(data), knownHash, resolve);
+                } catch(...) {
+                    job.Error = std::current_exception();
                 }
             }
         }
+    };
+
+    {
+        size_t batches = (jobs.size()+BatchFileReader::BATCH_SIZE-1) / BatchFileReader::BATCH_SIZE;
+        size_t threadsCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), batches);
+
+        if(threadsCount <= 1) {
+            worker();
+        } else {
+            std::vector<std::thread> threads;
+            threads.reserve(threadsCount);
+            for(size_t iter = 0; iter < threadsCount; iter++)
+                threads.emplace_back(worker);
+
+            for(std::thread& thread : threads)
+                thread.join();
+        }
+    }
+
+    // Отложенные ссылки получают идентификаторы в порядке заданий, затем ресурс разбирается с ними
+    for(BuildJob& job : jobs) {
+        if(job.Error || job.Unresolved.empty())
+            continue;
+
+        for(const auto& [type, domain, key] : job.Unresolved)
+            idResolver(type, domain, key);
+
+        try {
+            // Ссылки есть только у разбираемых ресурсов, хеш сырого файла им не нужен
+            job.Result = buildResource(job.Type, job.Domain, job.Key, *job.Info, readFileData(job.Info->Path), nullptr, idResolver);
+        } catch(...) {
+            job.Error = std::current_exception();
+        }
+    }
+
+    if(!jobs.empty()) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - timeStart).count();
+        size_t skipped = std::count_if(jobs.begin(), jobs.end(), [](const BuildJob& job) { return job.KnownHash.has_value(); });
+        double mb = double(bytesRead.load()) / (1024*1024);
+
+        LOG.info() << "Обработано ресурсов: " << jobs.size() << " (хеш из манифеста: " << skipped << "), "
+            << mb << " МБ за " << seconds*1000 << " мс; "
+            << (seconds > 0 ? jobs.size()/seconds : 0) << " файлов/с, "
+            << (seconds > 0 ? mb/seconds : 0) << " МБ/с (sha256: " << sha2::sha256_implementation() << ")";
+    }
+
+    // Сведение результатов в исходном порядке
+    for(BuildJob& job : jobs) {
+        if(job.Error)
+            std::rethrow_exception(job.Error);
+
+        size_t type = static_cast<size_t>(job.Type);
+        const auto& resourceLinksTyped = ResourceLinks[type];
+        const ResourceFindInfo& res = *job.Info;
+        PendingResource& resource = job.Result;
+
+        if(isRawAsset(job.Type)) {
+            ManifestEntry& entry = Manifest[res.Path.string()];
+            if(!job.KnownHash) {
+                entry = ManifestEntry{res.Size, res.Timestamp.time_since_epoch().count(), resource.Hash};
+                manifestChanged = true;
+            }
+        }
+
+        if(res.Id >= resourceLinksTyped.size() || !resourceLinksTyped[res.Id].IsExist)
+        {   // Если идентификатора нет в таблице или ресурс не привязан
+            if(onNewResourceParsed)
+                onNewResourceParsed(std::move(resource.Resource), resource.Hash, res.Path);
+            result.HashToPathNew[resource.Hash].push_back(res.Path);
+
+            if(res.Id >= result.MaxNewSize[type])
+                result.MaxNewSize[type] = res.Id+1;
+
+            result.ResourceUpdates[type].emplace_back(res.Id, resource.Hash, std::move(resource.Header), resource.Timestamp, res.Path);
+        } else {
+            // Ресурс теперь берётся с другого места или изменилось время изменения файла
+            const auto& lastResource = resourceLinksTyped[res.Id];
+            
+            if(lastResource.Hash != resource.Hash) {
+                // Хэш изменился
+                // Сообщаем о новом ресурсе
+                if(onNewResourceParsed)
+                    onNewResourceParsed(std::move(resource.Resource), resource.Hash, res.Path);
+                // Старый хэш более не доступен по этому расположению.
+                result.HashToPathLost[lastResource.Hash].push_back(resourceLinksTyped[res.Id].Path);
+                // Новый хеш стал доступен по этому расположению.
+                result.HashToPathNew[resource.Hash].push_back(res.Path);
+            } else if(resourceLinksTyped[res.Id].Path != res.Path) {
+                // Изменился конечный путь.
+                // Хэш более не доступен по этому расположению.
+                result.HashToPathLost[resource.Hash].push_back(resourceLinksTyped[res.Id].Path);
+                // Хеш теперь доступен по этому расположению.
+                result.HashToPathNew[resource.Hash].push_back(res.Path);
+            } else {
+                // Ресурс без заголовка никак не изменился.
+            }
+
+            // Чтобы там не поменялось, мог поменятся заголовок. Уведомляем о новой привязке.
+            result.ResourceUpdates[type].emplace_back(res.Id, resource.Hash, std::move(resource.Header), resource.Timestamp, res.Path);
+        }
     }
 
+    // Забываем файлы, которых больше нет
+    for(auto iter = Manifest.begin(); iter != Manifest.end(); ) {
+        if(seenRawPaths.contains(iter->first)) {
+            iter++;
+        } else {
+            iter = Manifest.erase(iter);
+            manifestChanged = true;
+        }
+    }
+
+    if(manifestChanged)
+        saveManifest();
+
     // 3) Определяем какие ресурсы пропали
     for(size_t type = 0; type < static_cast<size_t>(AssetType::MAX_ENUM); ++type) {
         const auto& resourceLinksTyped = ResourceLinks[type];
@@ -396,4 +766,82 @@ AssetsPreloader::Out_applyResourcesUpdate AssetsPreloader::applyResourcesUpdate(
     return result;
 }
 
+void AssetsPreloader::loadManifest() {
+    if(ManifestLoaded)
+        return;
+
+    ManifestLoaded = true;
+    Manifest.clear();
+
+    if(ManifestPath.empty() || !fs::exists(ManifestPath))
+        return;
+
+    try {
+        TOS::ByteBuffer buff(std::ifstream(ManifestPath, std::ios::binary));
+        TOS::ByteBuffer::Reader reader = buff.reader();
+
+        if(reader.readUInt32() != MANIFEST_MAGIC || reader.readUInt32() != MANIFEST_VERSION)
+            MAKE_ERROR("Неизвестный формат манифеста");
+
+        uint32_t count = reader.readUInt32();
+        Manifest.reserve(count);
+
+        for(uint32_t iter = 0; iter < count; iter++) {
+            std::string path(reader.readUInt32(), '\0');
+            for(char& ch : path)
+                ch = reader.readUInt8();
+
+            ManifestEntry entry;
+            entry.Size = reader.readUInt64();
+            entry.Timestamp = reader.readInt64();
+            for(uint8_t& byte : entry.Hash)
+                byte = reader.readUInt8();
+
+            Manifest.emplace(std::move(path), entry);
+        }
+    } catch(const std::exception& exc) {
+        // Манифест только ускоряет сканирование, при любой ошибке пересчитываем всё
+        LOG.warn() << "Манифест ресурсов " << ManifestPath.string() << " проигнорирован: " << exc.what();
+        Manifest.clear();
+    }
+}
+
+void AssetsPreloader::saveManifest() {
+    if(ManifestPath.empty())
+        return;
+
+    TOS::ByteBuffer::Writer writer;
+    writer << MANIFEST_MAGIC << MANIFEST_VERSION << uint32_t(Manifest.size());
+
+    for(const auto& [path, entry] : Manifest) {
+        writer << uint32_t(path.size());
+        for(char ch : path)
+            writer << uint8_t(ch);
+
+        writer << uint64_t(entry.Size) << entry.Timestamp;
+        for(uint8_t byte : entry.Hash)
+            writer << byte;
+    }
+
+    TOS::ByteBuffer buff = writer.complite();
+
+    // Пишем во временный файл, чтобы не оставить испорченный манифест
+    fs::path temp = ManifestPath;
+    temp += ".tmp";
+
+    {
+        std::ofstream fd(temp, std::ios::binary | std::ios::trunc);
+        fd.write(reinterpret_cast<const char*>(buff.data()), buff.size());
+        if(!fd) {
+            LOG.warn() << "Не удалось записать манифест ресурсов " << temp.string();
+            return;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(temp, ManifestPath, ec);
+    if(ec)
+        LOG.warn() << "Не удалось записать манифест ресурсов " << ManifestPath.string() << ": " << ec.message();
+}
+
 }
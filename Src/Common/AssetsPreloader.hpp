@@ -233,6 +233,17 @@ public:
         fs::path Path;
     };
 
+    /*
+        Файл манифеста сырых ресурсов (размер + время изменения -> хеш).
+        Совпавшие с манифестом файлы не перехешируются между запусками,
+        а если содержимое не запрошено (нет onNewResourceParsed) - и не читаются.
+    */
+    void setManifestPath(fs::path path) {
+        ManifestPath = std::move(path);
+        ManifestLoaded = false;
+        Manifest.clear();
+    }
+
     std::optional<Out_Resource> getResource(EnumAssets type, ResourceId id) const {
         const auto& rl = ResourceLinks[static_cast<size_t>(type)];
         if(id >= rl.size() || !rl[id].IsExist)
@@ -247,10 +258,18 @@ private:
         fs::path ArchivePath, Path;
         // Время изменения файла
         fs::file_time_type Timestamp;
+        // Размер файла
+        uintmax_t Size = 0;
         // Идентификатор ресурса
         ResourceId Id;
     };
 
+    struct ManifestEntry {
+        uintmax_t Size;
+        int64_t Timestamp;
+        ResourceFile::Hash_t Hash;
+    };
+
     struct HashHasher {
         std::size_t operator()(const ResourceFile::Hash_t& hash) const noexcept {
             std::size_t v = 14695981039346656037ULL;
@@ -283,6 +302,14 @@ private:
         ReloadStatus& status
     );
 
+    void loadManifest();
+    void saveManifest();
+
+    fs::path ManifestPath;
+    bool ManifestLoaded = false;
+    // Путь файла -> последние известные размер, время изменения и хеш
+    std::unordered_map<std::string, ManifestEntry> Manifest;
+
     // Привязка Id -> Hash + Header + Timestamp + Path
     std::array<
         std::vector<ResourceLink>, 
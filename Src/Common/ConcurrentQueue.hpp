@@ -0,0 +1,364 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+namespace LV {
+
+/*
+    Очереди для передачи данных между потоками без спинлоков.
+
+    MPSCQueue   - неограниченная, много производителей, один потребитель (Vyukov)
+    BoundedQueue - кольцевой буфер фиксированного размера, много производителей и потребителей (Vyukov)
+    WorkQueue   - MPSCQueue, разбираемая пулом потоков (потребители сериализуются мьютексом,
+                  производители остаются lock-free)
+
+    Ожидание построено на std::atomic::wait/notify (futex), без опроса со сном.
+    Шаблон ожидания у потребителя:
+
+        uint32_t seq = queue.sequence();
+        if(NeedShutdown) break;
+        if(auto value = queue.tryPop()) { ... continue; }
+        queue.wait(seq);
+
+    Для пробуждения ожидающих при остановке используется wake().
+*/
+
+static constexpr size_t CACHE_LINE_SIZE = 64;
+
+// Счётчик событий, на котором можно заснуть до следующего notify()
+class EventSignal {
+public:
+    EventSignal() = default;
+
+    EventSignal(const EventSignal&) = delete;
+    EventSignal(EventSignal&&) = delete;
+    EventSignal& operator=(const EventSignal&) = delete;
+    EventSignal& operator=(EventSignal&&) = delete;
+
+    uint32_t sequence() const {
+        return Seq.load(std::memory_order_acquire);
+    }
+
+    void notify() {
+        Seq.fetch_add(1, std::memory_order_release);
+        Seq.notify_all();
+    }
+
+    // Блокирует поток пока значение счётчика равно seq
+    void wait(uint32_t seq) const {
+        Seq.wait(seq, std::memory_order_acquire);
+    }
+
+private:
+    std::atomic<uint32_t> Seq = 0;
+};
+
+template<typename T>
+class MPSCQueue {
+    struct Node {
+        std::atomic<Node*> Next = nullptr;
+        std::optional<T> Value;
+    };
+
+public:
+    MPSCQueue()
+        : Signal(&OwnSignal)
+    {
+        Node* stub = new Node();
+        Head.store(stub, std::memory_order_relaxed);
+        Tail = stub;
+    }
+
+    // Оповещения о новых элементах уходят во внешний сигнал (одно ожидание на несколько очередей)
+    explicit MPSCQueue(EventSignal* signal)
+        : MPSCQueue()
+    {
+        assert(signal);
+        Signal = signal;
+    }
+
+    ~MPSCQueue() {
+        Node* node = Tail;
+        while(node) {
+            Node* next = node->Next.load(std::memory_order_relaxed);
+            delete node;
+            node = next;
+        }
+    }
+
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue(MPSCQueue&&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(MPSCQueue&&) = delete;
+
+    // Производители (любой поток)
+
+    template<typename ...Args>
+    void emplace(Args&& ...args) {
+        Node* node = new Node();
+        node->Value.emplace(std::forward<Args>(args)...);
+        link(node, node);
+        Signal->notify();
+    }
+
+    void push(const T& value) { emplace(value); }
+    void push(T&& value) { emplace(std::move(value)); }
+
+    // Пакет публикуется одной атомарной операцией
+    template<typename Range>
+    void push_range(Range&& range) {
+        Node *first = nullptr, *last = nullptr;
+
+        for(auto&& value : range) {
+            Node* node = new Node();
+            if constexpr(std::is_rvalue_reference_v<Range&&>)
+                node->Value.emplace(std::move(value));
+            else
+                node->Value.emplace(value);
+
+            if(last)
+                last->Next.store(node, std::memory_order_relaxed);
+            else
+                first = node;
+
+            last = node;
+        }
+
+        if(!first)
+            return;
+
+        link(first, last);
+        Signal->notify();
+    }
+
+    // Потребитель (только один поток одновременно)
+
+    std::optional<T> tryPop() {
+        Node* tail = Tail;
+        Node* next = tail->Next.load(std::memory_order_acquire);
+        if(!next)
+            return std::nullopt;
+
+        std::optional<T> out = std::move(next->Value);
+        next->Value.reset();
+        Tail = next;
+        delete tail;
+        return out;
+    }
+
+    // Забирает всё, что успело опубликоваться
+    template<typename Func>
+    size_t consumeAll(Func&& func) {
+        size_t count = 0;
+        while(std::optional<T> value = tryPop()) {
+            func(std::move(*value));
+            count++;
+        }
+
+        return count;
+    }
+
+    std::vector<T> popAll() {
+        std::vector<T> out;
+        consumeAll([&](T&& value) { out.push_back(std::move(value)); });
+        return out;
+    }
+
+    // Только для потребителя
+    bool empty() const {
+        return !Tail->Next.load(std::memory_order_acquire);
+    }
+
+    uint32_t sequence() const { return Signal->sequence(); }
+    void wait(uint32_t seq) const { Signal->wait(seq); }
+    void wake() { Signal->notify(); }
+
+private:
+    alignas(CACHE_LINE_SIZE) std::atomic<Node*> Head;
+    alignas(CACHE_LINE_SIZE) Node* Tail;
+    EventSignal OwnSignal;
+    EventSignal* Signal;
+
+    void link(Node* first, Node* last) {
+        Node* prev = Head.exchange(last, std::memory_order_acq_rel);
+        prev->Next.store(first, std::memory_order_release);
+    }
+};
+
+template<typename T>
+class BoundedQueue {
+    struct Cell {
+        std::atomic<size_t> Sequence;
+        alignas(T) std::byte Storage[sizeof(T)];
+
+        T* value() { return std::launder(reinterpret_cast<T*>(Storage)); }
+    };
+
+public:
+    // Ёмкость округляется вверх до степени двойки
+    explicit BoundedQueue(size_t capacity) {
+        size_t size = 2;
+        while(size < capacity)
+            size <<= 1;
+
+        Mask = size-1;
+        Buffer = std::make_unique<Cell[]>(size);
+        for(size_t iter = 0; iter < size; iter++)
+            Buffer[iter].Sequence.store(iter, std::memory_order_relaxed);
+    }
+
+    ~BoundedQueue() {
+        while(tryPop());
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue(BoundedQueue&&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(BoundedQueue&&) = delete;
+
+    // false если очередь заполнена, значение при этом не перемещается
+    bool tryPush(T&& value) {
+        size_t pos = EnqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+
+        while(true) {
+            cell = &Buffer[pos & Mask];
+            size_t seq = cell->Sequence.load(std::memory_order_acquire);
+            intptr_t dif = intptr_t(seq) - intptr_t(pos);
+
+            if(dif == 0) {
+                if(EnqueuePos.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+                    break;
+            } else if(dif < 0) {
+                return false;
+            } else {
+                pos = EnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        new (cell->Storage) T(std::move(value));
+        cell->Sequence.store(pos+1, std::memory_order_release);
+        Filled.notify();
+        return true;
+    }
+
+    bool tryPush(const T& value) {
+        T copy = value;
+        return tryPush(std::move(copy));
+    }
+
+    // Ожидает освобождения места
+    void push(T value) {
+        while(true) {
+            uint32_t seq = Freed.sequence();
+            if(tryPush(std::move(value)))
+                return;
+
+            Freed.wait(seq);
+        }
+    }
+
+    std::optional<T> tryPop() {
+        size_t pos = DequeuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+
+        while(true) {
+            cell = &Buffer[pos & Mask];
+            size_t seq = cell->Sequence.load(std::memory_order_acquire);
+            intptr_t dif = intptr_t(seq) - intptr_t(pos+1);
+
+            if(dif == 0) {
+                if(DequeuePos.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+                    break;
+            } else if(dif < 0) {
+                return std::nullopt;
+            } else {
+                pos = DequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        std::optional<T> out(std::move(*cell->value()));
+        cell->value()->~T();
+        cell->Sequence.store(pos+Mask+1, std::memory_order_release);
+        Freed.notify();
+        return out;
+    }
+
+    template<typename Func>
+    size_t consumeAll(Func&& func) {
+        size_t count = 0;
+        while(std::optional<T> value = tryPop()) {
+            func(std::move(*value));
+            count++;
+        }
+
+        return count;
+    }
+
+    size_t capacity() const { return Mask+1; }
+
+    uint32_t sequence() const { return Filled.sequence(); }
+    void wait(uint32_t seq) const { Filled.wait(seq); }
+    void wake() { Filled.notify(); Freed.notify(); }
+
+private:
+    std::unique_ptr<Cell[]> Buffer;
+    size_t Mask;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> EnqueuePos = 0;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> DequeuePos = 0;
+    EventSignal Filled, Freed;
+};
+
+/*
+    Очередь заданий для пула потоков.
+    Публикация без блокировок, потребители забирают по одному элементу под мьютексом
+    (работа над элементом много дороже самого извлечения).
+*/
+template<typename T>
+class WorkQueue {
+public:
+    WorkQueue() = default;
+
+    // Оповещения уходят во внешний сигнал (пул ждёт сразу несколько очередей)
+    explicit WorkQueue(EventSignal* signal)
+        : Queue(signal)
+    {}
+
+    template<typename ...Args>
+    void emplace(Args&& ...args) { Queue.emplace(std::forward<Args>(args)...); }
+    void push(const T& value) { Queue.push(value); }
+    void push(T&& value) { Queue.push(std::move(value)); }
+    template<typename Range>
+    void push_range(Range&& range) { Queue.push_range(std::forward<Range>(range)); }
+
+    std::optional<T> tryPop() {
+        std::lock_guard lock(ConsumerMtx);
+        return Queue.tryPop();
+    }
+
+    bool empty() const {
+        std::lock_guard lock(ConsumerMtx);
+        return Queue.empty();
+    }
+
+    uint32_t sequence() const { return Queue.sequence(); }
+    void wait(uint32_t seq) const { Queue.wait(seq); }
+    void wake() { Queue.wake(); }
+
+private:
+    MPSCQueue<T> Queue;
+    mutable std::mutex ConsumerMtx;
+};
+
+}
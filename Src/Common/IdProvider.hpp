@@ -7,6 +7,8 @@
 #include <array>
 #include <atomic>
 #include <cassert>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <shared_mutex>
 #include <string>
@@ -84,6 +86,11 @@ public:
         }
     }
 
+    ~IdProvider() {
+        for(auto& published : _Published)
+            delete published.load(std::memory_order_relaxed);
+    }
+
     /*
         Находит или выдаёт идентификатор на запрошенный ресурс.
         Функция не требует внешней синхронизации.
@@ -92,6 +99,15 @@ public:
 #ifndef NDEBUG
         assert(!DKToIdInBakingMode);
 #endif
+        // 0) Опубликованная копия, без блокировок
+        {
+            ReadGuard guard(*this);
+            if(const Published* published = _Published[static_cast<size_t>(type)].load(std::memory_order_seq_cst)) {
+                if(auto it = published->Forward.find(BindDomainKeyViewInfo{domain, key}); it != published->Forward.end())
+                    return it->second;
+            }
+        }
+
         auto& sh = _shardFor(type, domain, key);
 
         // 1) Поиск в режиме для чтения
@@ -151,8 +167,12 @@ public:
             std::vector<ResourceId> new_ids;
             _drainNew(type, new_ids);
 
-            if(new_ids.empty())
+            if(new_ids.empty()) {
+                if(!_Published[t].load(std::memory_order_relaxed))
+                    _publish(type);
+
                 continue;
+            }
 
             // 2) превратить id -> (domain,key) через reverse и вернуть наружу
             // + дописать в IdToDK[type] в порядке id (по желанию)
@@ -178,6 +198,9 @@ public:
 
             // 3) дописать в IdToDK (для новых клиентов)
             IdToDK[t].append_range(result[t]);
+
+            // 4) опубликовать новую копию таблиц для чтения без блокировок
+            _publish(type);
         }
 
         return result;
@@ -185,10 +208,19 @@ public:
 
     // id to DK
     std::optional<BindDomainKeyInfo> getDK(Enum type, ResourceId id) {
+        {
+            ReadGuard guard(*this);
+            if(const Published* published = _Published[static_cast<size_t>(type)].load(std::memory_order_seq_cst)) {
+                if(id < published->Reverse.size() && !published->Reverse[id].Key.empty())
+                    return published->Reverse[id];
+            }
+        }
+
+        // Выданные после последнего bake()
         auto& vec = _Reverse[static_cast<size_t>(type)];
         auto& mtx = _ReverseMutex[static_cast<size_t>(type)];
 
-        std::unique_lock lk(mtx);
+        std::shared_lock lk(mtx);
         if(id >= vec.size())
             return std::nullopt;
         
@@ -200,6 +232,17 @@ public:
         return IdToDK;
     }
 
+    /*
+        Освобождает заменённые копии таблиц, если ни один читатель сейчас не внутри опубликованной копии.
+        bake() пробует сам, но при занятых читателях копии остаются до следующего вызова,
+        поэтому владелец провайдера вызывает это периодически. Возвращает число ещё не освобождённых копий
+    */
+    size_t reclaim() {
+        std::lock_guard lk(_RetiredMutex);
+        _reclaimLocked();
+        return _Retired.size();
+    }
+
 private:
     using Map = ankerl::unordered_dense::map<BindDomainKeyInfo, ResourceId, KeyHash, KeyEq>;
 
@@ -209,6 +252,46 @@ private:
         std::vector<ResourceId> newlyInserted;
     };
 
+    /*
+        Неизменяемая копия таблиц на момент bake(). Читатели берут указатель атомарно и не блокируются,
+        новые регистрации попадают в следующую копию (копирование и замена указателя).
+        Заменённые копии могут ещё читаться, поэтому откладываются в _Retired
+        и освобождаются в точке покоя, когда все счётчики читателей равны нулю
+    */
+    struct Published {
+        Map Forward;
+        std::vector<BindDomainKeyInfo> Reverse;
+    };
+
+    static constexpr size_t READER_SLOTS = 32;
+
+    // Счётчик читателей внутри опубликованной копии, поток закрепляется за слотом при первом чтении
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint32_t> Active{0};
+    };
+
+    /*
+        Увеличение счётчика и загрузка указателя идут в полном порядке (seq_cst) с заменой указателя
+        и проверкой счётчиков в _reclaimLocked: если проверка увидела ноль, читатель,
+        вошедший позже, уже получит новую копию
+    */
+    struct ReadGuard {
+        std::atomic<uint32_t>& Slot;
+
+        explicit ReadGuard(IdProvider& provider)
+            : Slot(provider._Readers[_readerIndex()].Active)
+        {
+            Slot.fetch_add(1, std::memory_order_seq_cst);
+        }
+
+        ~ReadGuard() {
+            Slot.fetch_sub(1, std::memory_order_release);
+        }
+
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+    };
+
 private:
     // Кластер таблиц идентификаторов
     std::array<
@@ -222,6 +305,11 @@ private:
     std::array<std::vector<BindDomainKeyInfo>, MAX_ENUM> _Reverse;
     mutable std::array<std::shared_mutex, MAX_ENUM> _ReverseMutex;
 
+    std::array<std::atomic<const Published*>, MAX_ENUM> _Published{};
+    std::array<ReaderSlot, READER_SLOTS> _Readers;
+    std::mutex _RetiredMutex;
+    std::vector<std::unique_ptr<const Published>> _Retired;
+
 #ifndef NDEBUG
     bool DKToIdInBakingMode = false;
 #endif
@@ -240,6 +328,24 @@ private:
         return _Shards[static_cast<size_t>(type)][idx];
     }
 
+    static size_t _readerIndex() {
+        static std::atomic<size_t> next{0};
+        thread_local const size_t index = next.fetch_add(1, std::memory_order_relaxed) % READER_SLOTS;
+        return index;
+    }
+
+    // Вызывается под _RetiredMutex после замены указателей
+    void _reclaimLocked() {
+        if(_Retired.empty())
+            return;
+
+        for(const ReaderSlot& slot : _Readers)
+            if(slot.Active.load(std::memory_order_seq_cst) != 0)
+                return;
+
+        _Retired.clear();
+    }
+
     void _storeReverse(Enum type, ResourceId id, std::string&& domain, std::string&& key) {
         auto& vec = _Reverse[static_cast<size_t>(type)];
         auto& mtx = _ReverseMutex[static_cast<size_t>(type)];
@@ -252,6 +358,31 @@ private:
         vec[idx] = BindDomainKeyInfo{std::move(domain), std::move(key)};
     }
 
+    void _publish(Enum type) {
+        const size_t t = static_cast<size_t>(type);
+        auto published = std::make_unique<Published>();
+
+        {
+            std::shared_lock lk(_ReverseMutex[t]);
+            published->Reverse = _Reverse[t];
+        }
+
+        // Пустая запись - идентификатор выдан, но ещё не записан, её найдёт обычный путь
+        published->Forward.reserve(published->Reverse.size());
+        for(size_t id = 0; id < published->Reverse.size(); id++) {
+            const BindDomainKeyInfo& dk = published->Reverse[id];
+            if(!dk.Key.empty())
+                published->Forward.emplace(dk, static_cast<ResourceId>(id));
+        }
+
+        const Published* old = _Published[t].exchange(published.release(), std::memory_order_seq_cst);
+        if(old) {
+            std::lock_guard lk(_RetiredMutex);
+            _Retired.emplace_back(old);
+            _reclaimLocked();
+        }
+    }
+
     void _drainNew(Enum type, std::vector<ResourceId>& out) {
         out.clear();
         auto& shards = _Shards[static_cast<size_t>(type)];
@@ -100,6 +100,11 @@ std::string AsyncSocket::getError() const {
     return SendPackets.Context->Error;
 }
 
+size_t AsyncSocket::getQueuedBytes() {
+    boost::lock_guard lock(SendPackets.Mtx);
+    return SendPackets.SizeInQueue;
+}
+
 bool AsyncSocket::isAlive() const {
     return !SendPackets.Context->NeedShutdown
         && !SendPackets.Context->RunSendShutdowned
@@ -174,6 +179,7 @@ coro<> AsyncSocket::runSender(std::shared_ptr<AsyncContext> context) {
                                     packetSize -= needCopy;
                                 }
 
+                                SendPackets.SizeInQueue -= std::min(SendPackets.SizeInQueue, packet.size());
                                 SendPackets.SimpleBuffer.pop_front();
                             }
                         } else {
@@ -181,6 +187,7 @@ coro<> AsyncSocket::runSender(std::shared_ptr<AsyncContext> context) {
                                 SmartPacket &packet = SendPackets.SmartBuffer.front();
 
                                 if(packet.IsStillRelevant && !packet.IsStillRelevant (/* */)) {
+                                    SendPackets.SizeInQueue -= std::min(SendPackets.SizeInQueue, packet.size());
                                     SendPackets.SmartBuffer.pop_front();
                                     continue;
                                 }
@@ -196,10 +203,14 @@ coro<> AsyncSocket::runSender(std::shared_ptr<AsyncContext> context) {
                                     packetSize -= needCopy;
                                 }
 
+                                SendPackets.SizeInQueue -= std::min(SendPackets.SizeInQueue, packet.size());
+
                                 if(packet.OnSend) {
                                     std::optional<SmartPacket> nextPacket = packet.OnSend();
-                                    if(nextPacket)
+                                    if(nextPacket) {
+                                        SendPackets.SizeInQueue += nextPacket->size();
                                         SendPackets.SmartBuffer.push_back(std::move(*nextPacket));
+                                    }
                                 }
 
                                 SendPackets.SmartBuffer.pop_front();
@@ -297,6 +297,8 @@ protected:
 
         std::string getError() const;
         bool isAlive() const;
+        // Байт в очереди отправки
+        size_t getQueuedBytes();
 
         coro<> read(std::byte *data, uint32_t size);
         void closeRead();
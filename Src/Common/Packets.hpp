@@ -78,7 +78,8 @@ enum struct L2System : uint8_t {
     Test_CAM_PYR_POS,
     BlockChange,
     ResourceRequest,
-    ReloadMods
+    ReloadMods,
+    ToggleLuaProfiler
 };
 
 }
@@ -97,7 +98,7 @@ enum struct ToClient : uint8_t {
 
     ChunkVoxels,        // Обновление вокселей чанка
     ChunkNodes,         // Обновление нод чанка
-    ChunkLightPrism,    // 
+    ChunkLight,         // Освещённость нод чанка
     RemoveRegion,       // Удаление региона из зоны видимости
 
     Tick,               // Новые или потерянные игровые объекты (миры, сущности), динамичные данные такта (положение сущностей)
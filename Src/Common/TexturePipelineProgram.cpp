@@ -1,5 +1,12 @@
 #include "Common/TexturePipelineProgram.hpp"
 
+#if defined(__SSE2__)
+#define TPP_SSE2 1
+#include <emmintrin.h>
+#else
+#define TPP_SSE2 0
+#endif
+
 bool TexturePipelineProgram::compile(std::string_view src, std::string* err) {
   Source_ = src;
   Code_.clear();
@@ -637,6 +644,16 @@ bool TexturePipelineProgram::VM::run(const std::vector<uint8_t>& code, OwnedText
   Image cur;
   std::unordered_map<uint32_t, Image> texCache;
   std::unordered_map<uint64_t, Image> subCache; // key = (off<<24) | len
+  Image scratch;
+
+  ChannelLut lut;
+  bool lutPending = false;
+  auto flushLut = [&]() {
+    if(!lutPending) return;
+    _applyLut(cur, lut);
+    lut.reset();
+    lutPending = false;
+  };
 
   size_t ip = 0;
 
@@ -648,6 +665,7 @@ bool TexturePipelineProgram::VM::run(const std::vector<uint8_t>& code, OwnedText
   while(true) {
     if(!need(1)) return false;
     Op op = static_cast<Op>(code[ip++]);
+    if(!_isPointwise(op)) flushLut();
     if(op == Op::End) break;
 
     switch(op) {
@@ -655,8 +673,9 @@ bool TexturePipelineProgram::VM::run(const std::vector<uint8_t>& code, OwnedText
         SrcRef src;
         if(!_readSrc(code, ip, src, err)) return false;
         if(src.Kind != SrcKind::TexId) return _bad(err, "Base_Tex must be TexId");
-        cur = _loadTex(src.TexId24, texCache, err);
-        if(cur.W == 0) return false;
+        const Image& tex = _loadTex(src.TexId24, texCache, err);
+        if(tex.W == 0) return false;
+        cur = tex;
       } break;
 
       case Op::Base_Fill: {
@@ -679,7 +698,7 @@ bool TexturePipelineProgram::VM::run(const std::vector<uint8_t>& code, OwnedText
         uint32_t fpsQ = _rd16(code, ip);
         uint32_t flags = code[ip++];
 
-        Image sheet = _loadTex(src.TexId24, texCache, err);
+        const Image& sheet = _loadTex(src.TexId24, texCache, err);
         if(sheet.W == 0) return false;
 
         uint32_t fw = frameW ? frameW : sheet.W;
@@ -729,7 +748,7 @@ bool TexturePipelineProgram::VM::run(const std::vector<uint8_t>& code, OwnedText
         uint32_t fpsQ = _rd16(code, ip);
         uint32_t flags = code[ip++];
 
-        const Image& sheet = cur;
+        const Image sheet = std::move(cur);
         uint32_t fw = frameW ? frameW : sheet.W;
         uint32_t fh = frameH ? frameH : sheet.H;
         if(fw == 0 || fh == 0) return _bad(err, "Anim invalid frame size");
@@ -769,21 +788,19 @@ bool TexturePipelineProgram::VM::run(const std::vector<uint8_t>& code, OwnedText
       case Op::Overlay: {
         SrcRef src;
         if(!_readSrc(code, ip, src, err)) return false;
-        Image over = _loadSrc(code, src, texCache, subCache, timeSeconds, err);
+        const Image& over = _loadSrc(code, src, texCache, subCache, timeSeconds, err);
         if(over.W == 0) return false;
-        if(!cur.W) { cur = std::move(over); break; }
-        over = _resizeNN_ifNeeded(over, cur.W, cur.H);
-        _alphaOver(cur, over);
+        if(!cur.W) { cur = over; break; }
+        _alphaOver(cur, _resizeNN_ifNeeded(over, cur.W, cur.H, scratch));
       } break;
 
       case Op::Mask: {
         SrcRef src;
         if(!_readSrc(code, ip, src, err)) return false;
-        Image m = _loadSrc(code, src, texCache, subCache, timeSeconds, err);
+        const Image& m = _loadSrc(code, src, texCache, subCache, timeSeconds, err);
         if(m.W == 0) return false;
         if(!cur.W) return _bad(err, "Mask requires base image");
-        m = _resizeNN_ifNeeded(m, cur.W, cur.H);
-        _applyMask(cur, m);
+        _applyMask(cur, _resizeNN_ifNeeded(m, cur.W, cur.H, scratch));
       } break;
 
       case Op::LowPart: {
@@ -791,11 +808,10 @@ bool TexturePipelineProgram::VM::run(const std::vector<uint8_t>& code, OwnedText
         uint32_t pct = std::min<uint32_t>(100u, uint32_t(code[ip++]));
         SrcRef src;
         if(!_readSrc(code, ip, src, err)) return false;
-        Image over = _loadSrc(code, src, texCache, subCache, timeSeconds, err);
+        const Image& over = _loadSrc(code, src, texCache, subCache, timeSeconds, err);
         if(over.W == 0) return false;
         if(!cur.W) return _bad(err, "LowPart requires base image");
-        over = _resizeNN_ifNeeded(over, cur.W, cur.H);
-        _lowpart(cur, over, pct);
+        _lowpart(cur, _resizeNN_ifNeeded(over, cur.W, cur.H, scratch), pct);
       } break;
 
       case Op::Resize: {
@@ -817,12 +833,14 @@ bool TexturePipelineProgram::VM::run(const std::vector<uint8_t>& code, OwnedText
         if(!cur.W) return _bad(err, "Opacity requires base image");
         if(!need(1)) return false;
         uint32_t a = code[ip++] & 0xFFu;
-        _opacity(cur, uint8_t(a));
+        _opacity(lut, uint8_t(a));
+        lutPending = true;
       } break;
 
       case Op::NoAlpha: {
         if(!cur.W) return _bad(err, "NoAlpha requires base image");
-        _noAlpha(cur);
+        _noAlpha(lut);
+        lutPending = true;
       } break;
 
       case Op::MakeAlpha: {
@@ -837,12 +855,14 @@ bool TexturePipelineProgram::VM::run(const std::vector<uint8_t>& code, OwnedText
         if(!cur.W) return _bad(err, "Invert requires base image");
         if(!need(1)) return false;
         uint32_t mask = code[ip++] & 0xFu;
-        _invert(cur, mask);
+        _invert(lut, mask);
+        lutPending = true;
       } break;
 
       case Op::Brighten: {
         if(!cur.W) return _bad(err, "Brighten requires base image");
-        _brighten(cur);
+        _brighten(lut);
+        lutPending = true;
       } break;
 
       case Op::Contrast: {
@@ -850,21 +870,24 @@ bool TexturePipelineProgram::VM::run(const std::vector<uint8_t>& code, OwnedText
         if(!need(2)) return false;
         int c = int(code[ip++]) - 127;
         int b = int(code[ip++]) - 127;
-        _contrast(cur, c, b);
+        _contrast(lut, c, b);
+        lutPending = true;
       } break;
 
       case Op::Multiply: {
         if(!cur.W) return _bad(err, "Multiply requires base image");
         if(!need(4)) return false;
         uint32_t color = _rd32(code, ip);
-        _multiply(cur, color);
+        _multiply(lut, color);
+        lutPending = true;
       } break;
 
       case Op::Screen: {
         if(!cur.W) return _bad(err, "Screen requires base image");
         if(!need(4)) return false;
         uint32_t color = _rd32(code, ip);
-        _screen(cur, color);
+        _screen(lut, color);
+        lutPending = true;
       } break;
 
       case Op::Colorize: {
@@ -872,7 +895,8 @@ bool TexturePipelineProgram::VM::run(const std::vector<uint8_t>& code, OwnedText
         if(!need(4+1)) return false;
         uint32_t color = _rd32(code, ip);
         uint32_t ratio = code[ip++] & 0xFFu;
-        _colorize(cur, color, uint8_t(ratio));
+        _colorize(lut, color, uint8_t(ratio));
+        lutPending = true;
       } break;
 
       default:
@@ -910,48 +934,46 @@ bool TexturePipelineProgram::VM::_readSrc(const std::vector<uint8_t>& code, size
   return _bad(err, "Unknown SrcKind");
 }
 
-TexturePipelineProgram::Image TexturePipelineProgram::VM::_loadTex(uint32_t id, std::unordered_map<uint32_t, Image>& cache, std::string* err) {
+const TexturePipelineProgram::Image& TexturePipelineProgram::VM::_loadTex(uint32_t id, std::unordered_map<uint32_t, Image>& cache, std::string* err) {
   auto it = cache.find(id);
   if(it != cache.end()) return it->second;
 
   auto t = Provider_(id);
   if(!t || !t->Pixels || !t->Width || !t->Height) {
     if(err) *err = "Идентификатор текстуры не найден: " + std::to_string(id);
-    return {};
+    return _emptyImage();
   }
   Image img;
   img.W = t->Width; img.H = t->Height;
   img.Px.assign(t->Pixels, t->Pixels + size_t(img.W)*size_t(img.H));
-  cache.emplace(id, img);
-  return img;
+  return cache.emplace(id, std::move(img)).first->second;
 }
 
-TexturePipelineProgram::Image TexturePipelineProgram::VM::_loadSub(const std::vector<uint8_t>& code,
+const TexturePipelineProgram::Image& TexturePipelineProgram::VM::_loadSub(const std::vector<uint8_t>& code,
                uint32_t off, uint32_t len,
                std::unordered_map<uint32_t, Image>& /*texCache*/,
                std::unordered_map<uint64_t, Image>& subCache,
                double timeSeconds,
                std::string* err) {
-  uint64_t key = (uint32_t(off) << 24) | uint32_t(len);
+  uint64_t key = (uint64_t(off) << 24) | uint64_t(len);
   auto it = subCache.find(key);
   if(it != subCache.end()) return it->second;
 
   size_t start = size_t(off);
   size_t end = start + size_t(len);
-  if(end > code.size()) { if(err) *err="Подпрограмма выходит за пределы"; return {}; }
+  if(end > code.size()) { if(err) *err="Подпрограмма выходит за пределы"; return _emptyImage(); }
 
   std::vector<uint8_t> slice(code.begin()+start, code.begin()+end);
   OwnedTexture tmp;
   VM nested(Provider_);
-  if(!nested.run(slice, tmp, timeSeconds, err)) return {};
+  if(!nested.run(slice, tmp, timeSeconds, err)) return _emptyImage();
 
   Image img;
   img.W = tmp.Width; img.H = tmp.Height; img.Px = std::move(tmp.Pixels);
-  subCache.emplace(key, img);
-  return img;
+  return subCache.emplace(key, std::move(img)).first->second;
 }
 
-TexturePipelineProgram::Image TexturePipelineProgram::VM::_loadSrc(const std::vector<uint8_t>& code,
+const TexturePipelineProgram::Image& TexturePipelineProgram::VM::_loadSrc(const std::vector<uint8_t>& code,
                const SrcRef& src,
                std::unordered_map<uint32_t, Image>& texCache,
                std::unordered_map<uint64_t, Image>& subCache,
@@ -960,7 +982,12 @@ TexturePipelineProgram::Image TexturePipelineProgram::VM::_loadSrc(const std::ve
   if(src.Kind == SrcKind::TexId) return _loadTex(src.TexId24, texCache, err);
   if(src.Kind == SrcKind::Sub)   return _loadSub(code, src.Off24, src.Len24, texCache, subCache, timeSeconds, err);
   if(err) *err = "Неизвестный SrcKind";
-  return {};
+  return _emptyImage();
+}
+
+const TexturePipelineProgram::Image& TexturePipelineProgram::VM::_emptyImage() {
+  static const Image empty;
+  return empty;
 }
 
 TexturePipelineProgram::Image TexturePipelineProgram::VM::_makeSolid(uint32_t w, uint32_t h, uint32_t color) {
@@ -982,9 +1009,10 @@ TexturePipelineProgram::Image TexturePipelineProgram::VM::_resizeNN(const Image&
   return dst;
 }
 
-TexturePipelineProgram::Image TexturePipelineProgram::VM::_resizeNN_ifNeeded(Image img, uint32_t w, uint32_t h) {
+const TexturePipelineProgram::Image& TexturePipelineProgram::VM::_resizeNN_ifNeeded(const Image& img, uint32_t w, uint32_t h, Image& scratch) {
   if(img.W == w && img.H == h) return img;
-  return _resizeNN(img, w, h);
+  scratch = _resizeNN(img, w, h);
+  return scratch;
 }
 
 TexturePipelineProgram::Image TexturePipelineProgram::VM::_cropFrame(const Image& sheet, uint32_t index, uint32_t fw, uint32_t fh, bool horizontal) {
@@ -1038,78 +1066,154 @@ TexturePipelineProgram::Image TexturePipelineProgram::VM::_cropFrameGrid(const I
   return out;
 }
 
+// x / 255 для x <= 255*255 без деления
+static inline uint32_t div255(uint32_t x) {
+  return (x + 1 + (x >> 8)) >> 8;
+}
+
+#if TPP_SSE2
+static inline __m128i div255_epi16(__m128i x) {
+  return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), _mm_srli_epi16(x, 8)), 8);
+}
+#endif
+
 void TexturePipelineProgram::VM::_lerp(Image& base, const Image& over, double t) {
   if(t <= 0.0) return;
   if(t >= 1.0) { base = over; return; }
   if(base.W != over.W || base.H != over.H) return;
 
+  // Вес в 1/256: (a*(256-w) + b*w) >> 8 помещается в 16 бит, каналы считаются одинаково в любом порядке
+  const uint32_t w = uint32_t(t * 256.0 + 0.5);
+  const uint32_t iw = 256 - w;
   const size_t n = base.Px.size();
-  for(size_t i = 0; i < n; ++i) {
+  size_t i = 0;
+
+#if TPP_SSE2
+  // По 4 пикселя за шаг, 8 каналов в каждой половине регистра
+  const __m128i vw = _mm_set1_epi16(int16_t(w));
+  const __m128i viw = _mm_set1_epi16(int16_t(iw));
+  const __m128i zero = _mm_setzero_si128();
+  for(; i + 4 <= n; i += 4) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(base.Px.data() + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(over.Px.data() + i));
+
+    __m128i lo = _mm_add_epi16(
+      _mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), viw),
+      _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), vw));
+    __m128i hi = _mm_add_epi16(
+      _mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), viw),
+      _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), vw));
+
+    __m128i r = _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(base.Px.data() + i), r);
+  }
+#endif
+
+  for(; i < n; ++i) {
     uint32_t a = base.Px[i];
     uint32_t b = over.Px[i];
-    int ar = _r(a), ag = _g(a), ab = _b(a), aa = _a(a);
-    int br = _r(b), bg = _g(b), bb = _b(b), ba = _a(b);
+    uint32_t r = 0;
+    for(uint32_t shift = 0; shift < 32; shift += 8) {
+      uint32_t ca = (a >> shift) & 0xff;
+      uint32_t cb = (b >> shift) & 0xff;
+      r |= ((ca * iw + cb * w) >> 8) << shift;
+    }
 
-    uint8_t rr = _clampu8(int(ar + (br - ar) * t));
-    uint8_t rg = _clampu8(int(ag + (bg - ag) * t));
-    uint8_t rb = _clampu8(int(ab + (bb - ab) * t));
-    uint8_t ra = _clampu8(int(aa + (ba - aa) * t));
+    base.Px[i] = r;
+  }
+}
 
-    base.Px[i] = _pack(ra, rr, rg, rb);
+uint32_t TexturePipelineProgram::VM::_alphaOverPx(uint32_t b, uint32_t o) {
+  uint8_t ba=_a(b), br=_r(b), bg=_g(b), bb=_b(b);
+  uint8_t oa=_a(o), or_=_r(o), og=_g(o), ob=_b(o);
+
+  uint32_t brp = (uint32_t(br) * ba) / 255;
+  uint32_t bgp = (uint32_t(bg) * ba) / 255;
+  uint32_t bbp = (uint32_t(bb) * ba) / 255;
+
+  uint32_t orp = (uint32_t(or_) * oa) / 255;
+  uint32_t ogp = (uint32_t(og)  * oa) / 255;
+  uint32_t obp = (uint32_t(ob)  * oa) / 255;
+
+  uint32_t inv = 255 - oa;
+  uint32_t outA  = oa + (uint32_t(ba) * inv) / 255;
+  uint32_t outRp = orp + (brp * inv) / 255;
+  uint32_t outGp = ogp + (bgp * inv) / 255;
+  uint32_t outBp = obp + (bbp * inv) / 255;
+
+  uint8_t outR=0,outG=0,outB=0;
+  if(outA) {
+    outR = uint8_t(std::min<uint32_t>(255, (outRp * 255) / outA));
+    outG = uint8_t(std::min<uint32_t>(255, (outGp * 255) / outA));
+    outB = uint8_t(std::min<uint32_t>(255, (outBp * 255) / outA));
   }
+  return _pack(uint8_t(outA), outR, outG, outB);
 }
 
-void TexturePipelineProgram::VM::_alphaOver(Image& base, const Image& over) {
-  const size_t n = base.Px.size();
-  for(size_t i=0;i<n;i++){
-    uint32_t b = base.Px[i], o = over.Px[i];
-    uint8_t ba=_a(b), br=_r(b), bg=_g(b), bb=_b(b);
-    uint8_t oa=_a(o), or_=_r(o), og=_g(o), ob=_b(o);
-
-    uint32_t brp = (uint32_t(br) * ba) / 255;
-    uint32_t bgp = (uint32_t(bg) * ba) / 255;
-    uint32_t bbp = (uint32_t(bb) * ba) / 255;
-
-    uint32_t orp = (uint32_t(or_) * oa) / 255;
-    uint32_t ogp = (uint32_t(og)  * oa) / 255;
-    uint32_t obp = (uint32_t(ob)  * oa) / 255;
-
-    uint32_t inv = 255 - oa;
-    uint32_t outA  = oa + (uint32_t(ba) * inv) / 255;
-    uint32_t outRp = orp + (brp * inv) / 255;
-    uint32_t outGp = ogp + (bgp * inv) / 255;
-    uint32_t outBp = obp + (bbp * inv) / 255;
-
-    uint8_t outR=0,outG=0,outB=0;
-    if(outA) {
-      outR = uint8_t(std::min<uint32_t>(255, (outRp * 255) / outA));
-      outG = uint8_t(std::min<uint32_t>(255, (outGp * 255) / outA));
-      outB = uint8_t(std::min<uint32_t>(255, (outBp * 255) / outA));
+void TexturePipelineProgram::VM::_alphaOverRange(uint32_t* base, const uint32_t* over, size_t n) {
+  size_t i = 0;
+
+#if TPP_SSE2
+  // Быстрые случаи, совпадающие с точной формулой:
+  //   непрозрачный верх                    -> верх
+  //   прозрачный верх над непрозрачным низом -> низ
+  //   прозрачный верх над прозрачным низом   -> 0
+  // Группы из 4 пикселей, где все пиксели попадают в эти случаи, обрабатываются без деления
+  const __m128i alphaMask = _mm_set1_epi32(int(0xFF000000u));
+  const __m128i zero = _mm_setzero_si128();
+  for(; i + 4 <= n; i += 4) {
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(base + i));
+    __m128i o = _mm_loadu_si128(reinterpret_cast<const __m128i*>(over + i));
+    __m128i oa = _mm_and_si128(o, alphaMask);
+    __m128i ba = _mm_and_si128(b, alphaMask);
+
+    __m128i overOpaque = _mm_cmpeq_epi32(oa, alphaMask);
+    __m128i overClear = _mm_cmpeq_epi32(oa, zero);
+    __m128i keepBase = _mm_and_si128(overClear, _mm_cmpeq_epi32(ba, alphaMask));
+    __m128i clear = _mm_and_si128(overClear, _mm_cmpeq_epi32(ba, zero));
+
+    __m128i handled = _mm_or_si128(_mm_or_si128(overOpaque, keepBase), clear);
+    if(_mm_movemask_epi8(handled) == 0xFFFF) {
+      __m128i r = _mm_or_si128(_mm_and_si128(overOpaque, o), _mm_and_si128(keepBase, b));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(base + i), r);
+    } else {
+      for(size_t j = i; j < i + 4; j++)
+        base[j] = _alphaOverPx(base[j], over[j]);
     }
-    base.Px[i] = _pack(uint8_t(outA), outR, outG, outB);
   }
+#endif
+
+  for(; i < n; i++)
+    base[i] = _alphaOverPx(base[i], over[i]);
+}
+
+void TexturePipelineProgram::VM::_alphaOver(Image& base, const Image& over) {
+  _alphaOverRange(base.Px.data(), over.Px.data(), base.Px.size());
 }
 
 void TexturePipelineProgram::VM::_applyMask(Image& base, const Image& mask) {
   const size_t n = base.Px.size();
-  for(size_t i=0;i<n;i++){
-    uint32_t b = base.Px[i], m = mask.Px[i];
-    uint8_t outA = uint8_t((uint32_t(_a(b)) * uint32_t(_a(m))) / 255);
-    base.Px[i] = _pack(outA, _r(b), _g(b), _b(b));
+  size_t i = 0;
+
+#if TPP_SSE2
+  const __m128i rgbMask = _mm_set1_epi32(0x00FFFFFF);
+  for(; i + 4 <= n; i += 4) {
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&base.Px[i]));
+    __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&mask.Px[i]));
+    // Альфы в младших 16 битах каждого 32-битного слова, старшие половины нулевые
+    __m128i a = _mm_mullo_epi16(_mm_srli_epi32(b, 24), _mm_srli_epi32(m, 24));
+    a = _mm_slli_epi32(div255_epi16(a), 24);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&base.Px[i]), _mm_or_si128(_mm_and_si128(b, rgbMask), a));
   }
-}
+#endif
 
-void TexturePipelineProgram::VM::_opacity(Image& img, uint8_t mul) {
-  for(auto& p : img.Px) {
-    uint8_t na = uint8_t((uint32_t(_a(p)) * mul) / 255);
-    p = _pack(na, _r(p), _g(p), _b(p));
+  for(; i < n; i++) {
+    uint32_t b = base.Px[i], m = mask.Px[i];
+    uint8_t outA = uint8_t(div255(uint32_t(_a(b)) * uint32_t(_a(m))));
+    base.Px[i] = _pack(outA, _r(b), _g(b), _b(b));
   }
 }
 
-void TexturePipelineProgram::VM::_noAlpha(Image& img) {
-  for(auto& p : img.Px) p = _pack(255, _r(p), _g(p), _b(p));
-}
-
 void TexturePipelineProgram::VM::_makeAlpha(Image& img, uint32_t rgb24) {
   uint8_t rr = uint8_t((rgb24 >> 16) & 0xFF);
   uint8_t gg = uint8_t((rgb24 >>  8) & 0xFF);
@@ -1119,99 +1223,92 @@ void TexturePipelineProgram::VM::_makeAlpha(Image& img, uint32_t rgb24) {
   }
 }
 
-void TexturePipelineProgram::VM::_invert(Image& img, uint32_t maskBits) {
-  for(auto& p : img.Px) {
-    uint8_t a=_a(p), r=_r(p), g=_g(p), b=_b(p);
-    if(maskBits & 1u) r = 255 - r;
-    if(maskBits & 2u) g = 255 - g;
-    if(maskBits & 4u) b = 255 - b;
-    if(maskBits & 8u) a = 255 - a;
-    p = _pack(a,r,g,b);
-  }
+void TexturePipelineProgram::VM::_lowpart(Image& base, const Image& over, uint32_t percent) {
+  uint32_t startY = base.H - (base.H * percent) / 100;
+  size_t offset = size_t(startY) * base.W;
+  _alphaOverRange(base.Px.data() + offset, over.Px.data() + offset, base.Px.size() - offset);
 }
 
-void TexturePipelineProgram::VM::_brighten(Image& img) {
-  for(auto& p : img.Px) {
-    int r = _r(p), g = _g(p), b = _b(p);
-    r = r + (255 - r) / 3;
-    g = g + (255 - g) / 3;
-    b = b + (255 - b) / 3;
-    p = _pack(_a(p), _clampu8(r), _clampu8(g), _clampu8(b));
+bool TexturePipelineProgram::VM::_isPointwise(Op op) {
+  switch(op) {
+    case Op::Opacity:
+    case Op::NoAlpha:
+    case Op::Invert:
+    case Op::Brighten:
+    case Op::Contrast:
+    case Op::Multiply:
+    case Op::Screen:
+    case Op::Colorize:
+      return true;
+    default:
+      return false;
   }
 }
 
-void TexturePipelineProgram::VM::_contrast(Image& img, int c, int br) {
-  double C = double(std::max(-127, std::min(127, c)));
-  double factor = (259.0 * (C + 255.0)) / (255.0 * (259.0 - C));
-  for(auto& p : img.Px) {
-    int r = int(factor * (int(_r(p)) - 128) + 128) + br;
-    int g = int(factor * (int(_g(p)) - 128) + 128) + br;
-    int b = int(factor * (int(_b(p)) - 128) + 128) + br;
-    p = _pack(_a(p), _clampu8(r), _clampu8(g), _clampu8(b));
+void TexturePipelineProgram::VM::_applyLut(Image& img, const ChannelLut& lut) {
+  for(auto& p : img.Px)
+    p = _pack(lut.A[_a(p)], lut.R[_r(p)], lut.G[_g(p)], lut.B[_b(p)]);
+}
+
+void TexturePipelineProgram::VM::_opacity(ChannelLut& lut, uint8_t mul) {
+  for(auto& a : lut.A)
+    a = uint8_t(div255(uint32_t(a) * mul));
+}
+
+void TexturePipelineProgram::VM::_noAlpha(ChannelLut& lut) {
+  std::fill(std::begin(lut.A), std::end(lut.A), uint8_t(255));
+}
+
+void TexturePipelineProgram::VM::_invert(ChannelLut& lut, uint32_t maskBits) {
+  auto invert = [](uint8_t (&table)[256]) {
+    for(auto& v : table) v = 255 - v;
+  };
+
+  if(maskBits & 1u) invert(lut.R);
+  if(maskBits & 2u) invert(lut.G);
+  if(maskBits & 4u) invert(lut.B);
+  if(maskBits & 8u) invert(lut.A);
+}
+
+void TexturePipelineProgram::VM::_brighten(ChannelLut& lut) {
+  for(uint8_t* table : {lut.R, lut.G, lut.B}) {
+    for(int i = 0; i < 256; i++) {
+      int v = table[i];
+      table[i] = _clampu8(v + (255 - v) / 3);
+    }
   }
 }
 
-void TexturePipelineProgram::VM::_multiply(Image& img, uint32_t color) {
-  uint8_t cr=_r(color), cg=_g(color), cb=_b(color);
-  for(auto& p : img.Px) {
-    uint8_t r = uint8_t((uint32_t(_r(p)) * cr) / 255);
-    uint8_t g = uint8_t((uint32_t(_g(p)) * cg) / 255);
-    uint8_t b = uint8_t((uint32_t(_b(p)) * cb) / 255);
-    p = _pack(_a(p), r,g,b);
+void TexturePipelineProgram::VM::_contrast(ChannelLut& lut, int c, int br) {
+  double C = double(std::max(-127, std::min(127, c)));
+  double factor = (259.0 * (C + 255.0)) / (255.0 * (259.0 - C));
+  for(uint8_t* table : {lut.R, lut.G, lut.B}) {
+    for(int i = 0; i < 256; i++)
+      table[i] = _clampu8(int(factor * (int(table[i]) - 128) + 128) + br);
   }
 }
 
-void TexturePipelineProgram::VM::_screen(Image& img, uint32_t color) {
-  uint8_t cr=_r(color), cg=_g(color), cb=_b(color);
-  for(auto& p : img.Px) {
-    uint8_t r = uint8_t(255 - ((255 - _r(p)) * (255 - cr)) / 255);
-    uint8_t g = uint8_t(255 - ((255 - _g(p)) * (255 - cg)) / 255);
-    uint8_t b = uint8_t(255 - ((255 - _b(p)) * (255 - cb)) / 255);
-    p = _pack(_a(p), r,g,b);
+void TexturePipelineProgram::VM::_multiply(ChannelLut& lut, uint32_t color) {
+  const std::pair<uint8_t*, uint8_t> tables[] = {{lut.R, _r(color)}, {lut.G, _g(color)}, {lut.B, _b(color)}};
+  for(auto [table, k] : tables) {
+    for(int i = 0; i < 256; i++)
+      table[i] = uint8_t(div255(uint32_t(table[i]) * k));
   }
 }
 
-void TexturePipelineProgram::VM::_colorize(Image& img, uint32_t color, uint8_t ratio) {
-  uint8_t cr=_r(color), cg=_g(color), cb=_b(color);
-  for(auto& p : img.Px) {
-    int r = (int(_r(p)) * (255 - ratio) + int(cr) * ratio) / 255;
-    int g = (int(_g(p)) * (255 - ratio) + int(cg) * ratio) / 255;
-    int b = (int(_b(p)) * (255 - ratio) + int(cb) * ratio) / 255;
-    p = _pack(_a(p), uint8_t(r), uint8_t(g), uint8_t(b));
+void TexturePipelineProgram::VM::_screen(ChannelLut& lut, uint32_t color) {
+  const std::pair<uint8_t*, uint8_t> tables[] = {{lut.R, _r(color)}, {lut.G, _g(color)}, {lut.B, _b(color)}};
+  for(auto [table, k] : tables) {
+    for(int i = 0; i < 256; i++)
+      table[i] = uint8_t(255 - div255(uint32_t(255 - table[i]) * (255 - k)));
   }
 }
 
-void TexturePipelineProgram::VM::_lowpart(Image& base, const Image& over, uint32_t percent) {
-  uint32_t startY = base.H - (base.H * percent) / 100;
-  for(uint32_t y=startY; y<base.H; y++){
-    for(uint32_t x=0; x<base.W; x++){
-      size_t i = size_t(y)*base.W + x;
-      uint32_t b = base.Px[i], o = over.Px[i];
-      uint8_t ba=_a(b), br=_r(b), bg=_g(b), bb=_b(b);
-      uint8_t oa=_a(o), or_=_r(o), og=_g(o), ob=_b(o);
-
-      uint32_t brp = (uint32_t(br) * ba) / 255;
-      uint32_t bgp = (uint32_t(bg) * ba) / 255;
-      uint32_t bbp = (uint32_t(bb) * ba) / 255;
-
-      uint32_t orp = (uint32_t(or_) * oa) / 255;
-      uint32_t ogp = (uint32_t(og)  * oa) / 255;
-      uint32_t obp = (uint32_t(ob)  * oa) / 255;
-
-      uint32_t inv = 255 - oa;
-      uint32_t outA  = oa + (uint32_t(ba) * inv) / 255;
-      uint32_t outRp = orp + (brp * inv) / 255;
-      uint32_t outGp = ogp + (bgp * inv) / 255;
-      uint32_t outBp = obp + (bbp * inv) / 255;
-
-      uint8_t outR=0,outG=0,outB=0;
-      if(outA) {
-        outR = uint8_t(std::min<uint32_t>(255, (outRp * 255) / outA));
-        outG = uint8_t(std::min<uint32_t>(255, (outGp * 255) / outA));
-        outB = uint8_t(std::min<uint32_t>(255, (outBp * 255) / outA));
-      }
-      base.Px[i] = _pack(uint8_t(outA), outR, outG, outB);
-    }
+void TexturePipelineProgram::VM::_colorize(ChannelLut& lut, uint32_t color, uint8_t ratio) {
+  const std::pair<uint8_t*, uint8_t> tables[] = {{lut.R, _r(color)}, {lut.G, _g(color)}, {lut.B, _b(color)}};
+  for(auto [table, k] : tables) {
+    for(int i = 0; i < 256; i++)
+      table[i] = uint8_t((int(table[i]) * (255 - ratio) + int(k) * ratio) / 255);
   }
 }
 
@@ -196,42 +196,64 @@ private:
   private:
     TextureProvider Provider_;
 
+    // Подряд идущие поканальные операции (opacity, invert, contrast, ...) сворачиваются
+    // в одну таблицу на канал и применяются к изображению одним проходом
+    struct ChannelLut {
+      uint8_t A[256], R[256], G[256], B[256];
+
+      ChannelLut() { reset(); }
+      void reset() {
+        for(int i = 0; i < 256; i++) A[i] = R[i] = G[i] = B[i] = uint8_t(i);
+      }
+    };
+
     static bool _bad(std::string* err, const char* msg);
     static bool _readSrc(const std::vector<uint8_t>& code, size_t& ip, SrcRef& out, std::string* err);
-    Image _loadTex(uint32_t id, std::unordered_map<uint32_t, Image>& cache, std::string* err);
-    Image _loadSub(const std::vector<uint8_t>& code,
+    // Загруженные изображения живут в кешах на время run(), возвращаются ссылки на них
+    const Image& _loadTex(uint32_t id, std::unordered_map<uint32_t, Image>& cache, std::string* err);
+    const Image& _loadSub(const std::vector<uint8_t>& code,
                    uint32_t off, uint32_t len,
                    std::unordered_map<uint32_t, Image>& texCache,
                    std::unordered_map<uint64_t, Image>& subCache,
                    double timeSeconds,
                    std::string* err);
-    Image _loadSrc(const std::vector<uint8_t>& code,
+    const Image& _loadSrc(const std::vector<uint8_t>& code,
                    const SrcRef& src,
                    std::unordered_map<uint32_t, Image>& texCache,
                    std::unordered_map<uint64_t, Image>& subCache,
                    double timeSeconds,
                    std::string* err);
 
+    static const Image& _emptyImage();
+
     // ---- image ops (как в исходнике) ----
     static Image _makeSolid(uint32_t w, uint32_t h, uint32_t color);
     static Image _resizeNN(const Image& src, uint32_t nw, uint32_t nh);
-    static Image _resizeNN_ifNeeded(Image img, uint32_t w, uint32_t h);
+    // Возвращает img, либо растянутую копию в scratch
+    static const Image& _resizeNN_ifNeeded(const Image& img, uint32_t w, uint32_t h, Image& scratch);
     static Image _cropFrame(const Image& sheet, uint32_t index, uint32_t fw, uint32_t fh, bool horizontal);
     static Image _cropFrameGrid(const Image& sheet, uint32_t index, uint32_t fw, uint32_t fh);
     static void _lerp(Image& base, const Image& over, double t);
     static void _alphaOver(Image& base, const Image& over);
+    static uint32_t _alphaOverPx(uint32_t b, uint32_t o);
+    // Наложение с альфой для непрерывного диапазона пикселей
+    static void _alphaOverRange(uint32_t* base, const uint32_t* over, size_t n);
     static void _applyMask(Image& base, const Image& mask);
-    static void _opacity(Image& img, uint8_t mul);
-    static void _noAlpha(Image& img);
     static void _makeAlpha(Image& img, uint32_t rgb24);
-    static void _invert(Image& img, uint32_t maskBits);
-    static void _brighten(Image& img);
-    static void _contrast(Image& img, int c, int br);
-    static void _multiply(Image& img, uint32_t color);
-    static void _screen(Image& img, uint32_t color);
-    static void _colorize(Image& img, uint32_t color, uint8_t ratio);
     static void _lowpart(Image& base, const Image& over, uint32_t percent);
     static Image _transform(const Image& src, uint32_t t);
+
+    // ---- поканальные операции, дописываются в таблицу ----
+    static bool _isPointwise(Op op);
+    static void _applyLut(Image& img, const ChannelLut& lut);
+    static void _opacity(ChannelLut& lut, uint8_t mul);
+    static void _noAlpha(ChannelLut& lut);
+    static void _invert(ChannelLut& lut, uint32_t maskBits);
+    static void _brighten(ChannelLut& lut);
+    static void _contrast(ChannelLut& lut, int c, int br);
+    static void _multiply(ChannelLut& lut, uint32_t color);
+    static void _screen(ChannelLut& lut, uint32_t color);
+    static void _colorize(ChannelLut& lut, uint32_t color, uint8_t ratio);
   };
 
   // ========================
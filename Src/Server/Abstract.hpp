@@ -38,6 +38,22 @@ struct ServerTime {
     uint32_t Seconds : 24, Sub : 8;
 };
 
+// Запланированный такт ноды в пределах региона (хранится вместе с регионом)
+struct NodeTickRecord {
+    // Позиция ноды в регионе: x | y << 6 | z << 12
+    uint32_t Index;
+    // Через сколько тактов сработает
+    uint32_t Delay;
+};
+
+// Lua скрипт мода, исполняемый вне основного состояния (генераторы, рабочие состояния)
+struct ModScript {
+    std::string ModId;
+    // Имя чанка для сообщений об ошибках
+    std::string Name;
+    std::string Source;
+};
+
 struct VoxelCube_Region {
     union {
         struct {
@@ -3,6 +3,8 @@
 #include "Common/Abstract.hpp"
 #include "Common/IdProvider.hpp"
 #include "Common/AssetsPreloader.hpp"
+#include "Server/AssetsPack.hpp"
+#include <algorithm>
 #include <unordered_map>
 
 namespace LV::Server {
@@ -10,6 +12,7 @@ namespace LV::Server {
 class AssetsManager : public IdProvider<EnumAssets>, protected AssetsPreloader {
 public:
     using BindHashHeaderInfo = AssetsManager::BindHashHeaderInfo;
+    using AssetsPreloader::setManifestPath;
 
     struct Out_checkAndPrepareResourcesUpdate : public AssetsPreloader::Out_checkAndPrepareResourcesUpdate {
         Out_checkAndPrepareResourcesUpdate(AssetsPreloader::Out_checkAndPrepareResourcesUpdate&& obj)
@@ -68,8 +71,10 @@ public:
             }
         }
 
+        std::vector<ResourceFile::Hash_t> added, removed;
         for(auto& [hash, data] : orr.NewHeadless) {
-            Resources.emplace(hash, ResourceHashData{0, std::make_shared<std::u8string>(std::move(data))});
+            if(Resources.emplace(hash, ResourceHashData{0, Resource(std::move(data), hash)}).second)
+                added.push_back(hash);
         }
 
         for(auto& [hash, pathes] : orr.HashToPathNew) {
@@ -83,17 +88,31 @@ public:
             assert(iter != Resources.end());
             iter->second.RefCount -= pathes.size();
 
-            if(iter->second.RefCount == 0)
+            if(iter->second.RefCount == 0) {
                 Resources.erase(iter);
+                removed.push_back(hash);
+            }
         }
 
+        if((!added.empty() || !removed.empty()) && !PackPath.empty())
+            syncPack(added, removed);
+
         return result;
     }
 
-    std::vector<std::tuple<ResourceFile::Hash_t, std::shared_ptr<const std::u8string>>>
+    /*
+        Файл пакета ресурсов. Новые ресурсы дописываются в пакет, а данные в памяти
+        заменяются представлениями его отображения.
+    */
+    void setPackPath(fs::path path) {
+        PackPath = std::move(path);
+    }
+
+    // Ресурсы - представления пакета (или данные в памяти, если пакет не задан)
+    std::vector<std::tuple<ResourceFile::Hash_t, Resource>>
         getResources(const std::vector<ResourceFile::Hash_t>& hashes) const 
     {
-        std::vector<std::tuple<ResourceFile::Hash_t, std::shared_ptr<const std::u8string>>> result;
+        std::vector<std::tuple<ResourceFile::Hash_t, Resource>> result;
         result.reserve(hashes.size());
 
         for(const auto& hash : hashes) {
@@ -107,6 +126,15 @@ public:
         return result;
     }
 
+    // Объём данных ресурсов, при заданном пакете это отображённые из него страницы
+    size_t getResourcesBytes() const {
+        size_t bytes = 0;
+        for(const auto& [hash, data] : Resources)
+            bytes += data.Data.size();
+
+        return bytes;
+    }
+
     std::array< 
         std::vector<BindHashHeaderInfo>,
         static_cast<size_t>(EnumAssets::MAX_ENUM)
@@ -117,13 +145,82 @@ public:
 private:
     struct ResourceHashData {
         size_t RefCount;
-        std::shared_ptr<std::u8string> Data;
+        Resource Data;
     };
 
     std::unordered_map<
         ResourceFile::Hash_t,
         ResourceHashData
     > Resources;
+
+    fs::path PackPath;
+    std::optional<AssetsPack> Pack;
+
+    void syncPack(const std::vector<ResourceFile::Hash_t>& added, const std::vector<ResourceFile::Hash_t>& removed) {
+        static TOS::Logger LOG = "Server>AssetsManager";
+
+        try {
+            std::vector<ResourceFile::Hash_t> toAppend;
+            if(Pack) {
+                for(const auto& hash : removed)
+                    Pack->remove(hash);
+
+                toAppend = added;
+            } else {
+                // Пакета ещё нет или прошлая запись не удалась: в пакет уходит всё
+                for(const auto& [hash, data] : Resources)
+                    toAppend.push_back(hash);
+            }
+
+            std::vector<AssetsPack::Entry> entries;
+            entries.reserve(toAppend.size());
+            for(const auto& hash : toAppend) {
+                auto iter = Resources.find(hash);
+                if(iter != Resources.end())
+                    entries.emplace_back(hash, iter->second.Data.data(), iter->second.Data.size());
+            }
+
+            if(Pack) {
+                Pack->append(entries);
+            } else {
+                // Пакет прошлого запуска с тем же набором ресурсов берётся без перезаписи
+                std::vector<ResourceFile::Hash_t> sorted = toAppend;
+                std::sort(sorted.begin(), sorted.end());
+                Pack = AssetsPack::open(PackPath);
+                if(Pack && Pack->matches(sorted))
+                    LOG.info() << "Пакет ресурсов прошлого запуска подходит: " << Pack->size() << " ресурсов";
+                else
+                    Pack.emplace(PackPath, entries);
+            }
+
+            // Старые представления продолжают ссылаться на прежнее отображение, пока живы
+            if(Pack->needCompaction()) {
+                size_t garbage = Pack->garbageBytes();
+                Pack->compact();
+                for(auto& [hash, data] : Resources) {
+                    std::optional<Resource> res = Pack->find(hash);
+                    assert(res);
+                    data.Data = std::move(*res);
+                }
+
+                LOG.info() << "Пакет ресурсов уплотнён: " << Pack->size() << " ресурсов, освобождено " << garbage << " байт";
+            } else {
+                for(const auto& hash : toAppend) {
+                    auto iter = Resources.find(hash);
+                    if(iter == Resources.end())
+                        continue;
+
+                    std::optional<Resource> res = Pack->find(hash);
+                    assert(res);
+                    iter->second.Data = std::move(*res);
+                }
+            }
+        } catch(const std::exception& exc) {
+            // Ресурсы, не попавшие в пакет, остаются в памяти, при следующем изменении пакет пишется заново
+            Pack.reset();
+            LOG.warn() << "Не удалось обновить пакет ресурсов, ресурсы остаются в памяти: " << exc.what();
+        }
+    }
 };
 
 }
@@ -0,0 +1,286 @@
+#include "AssetsPack.hpp"
+#include "TOSLib.hpp"
+#include <algorithm>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <fstream>
+
+
+namespace LV::Server {
+
+static constexpr uint32_t PACK_MAGIC = 0x4b50564c; // LVPK
+static constexpr uint32_t PACK_VERSION = 3;
+// Выравнивание данных ресурсов в файле
+static constexpr size_t PACK_ALIGN = 64;
+
+struct PackHeader {
+    uint32_t Magic;
+    uint32_t Version;
+    // Записей индекса сразу за заголовком
+    uint64_t Count;
+};
+
+static_assert(sizeof(PackHeader) == 16);
+
+// Смещение от начала файла
+struct AssetsPack::IndexEntry {
+    Hash_t Hash;
+    uint64_t Offset;
+    uint64_t Size;
+};
+
+static_assert(sizeof(AssetsPack::Hash_t) == 32);
+
+static uint64_t alignUp(uint64_t value, uint64_t align) {
+    return (value + align - 1) / align * align;
+}
+
+// Отображение участка файла [Offset, Offset+size)
+struct AssetsPack::Mapping {
+    boost::interprocess::file_mapping File;
+    boost::interprocess::mapped_region Region;
+
+    Mapping(const fs::path& path, uint64_t offset, size_t size)
+        : File(path.c_str(), boost::interprocess::read_only),
+            Region(File, boost::interprocess::read_only, offset, size)
+    {}
+
+    const std::byte* data() const { return (const std::byte*) Region.get_address(); }
+};
+
+// Дописывает ресурсы начиная с pos, возвращает их смещения и конец записанного (выровненный)
+static uint64_t writeEntries(std::ostream& fd, uint64_t pos, const std::vector<AssetsPack::Entry>& entries, std::vector<uint64_t>& offsets) {
+    static constexpr char zeros[PACK_ALIGN] = {0};
+
+    offsets.resize(entries.size());
+    for(size_t iter = 0; iter < entries.size(); iter++) {
+        const auto& [hash, data, size] = entries[iter];
+        uint64_t offset = alignUp(pos, PACK_ALIGN);
+        fd.write(zeros, offset - pos);
+        fd.write((const char*) data, size);
+        offsets[iter] = offset;
+        pos = offset + size;
+    }
+
+    // Участок не бывает пустым, даже если все ресурсы пустые
+    uint64_t end = std::max<uint64_t>(alignUp(pos, PACK_ALIGN), PACK_ALIGN);
+    fd.write(zeros, end - pos);
+    return end;
+}
+
+AssetsPack::AssetsPack(fs::path path, const std::vector<Entry>& entries)
+    : Path(std::move(path))
+{
+    writeFresh(entries);
+}
+
+std::optional<AssetsPack> AssetsPack::open(fs::path path) {
+    std::error_code ec;
+    uint64_t fileSize = fs::file_size(path, ec);
+    if(ec || fileSize < sizeof(PackHeader))
+        return std::nullopt;
+
+    PackHeader header;
+    {
+        std::ifstream fd(path, std::ios::binary);
+        if(!fd.read((char*) &header, sizeof(header)))
+            return std::nullopt;
+    }
+
+    if(header.Magic != PACK_MAGIC || header.Version != PACK_VERSION
+        || header.Count > (fileSize - sizeof(PackHeader)) / sizeof(IndexEntry))
+        return std::nullopt;
+
+    AssetsPack pack;
+    pack.Path = std::move(path);
+
+    try {
+        pack.BaseMap = std::make_shared<const Mapping>(pack.Path, 0, fileSize);
+    } catch(const std::exception&) {
+        return std::nullopt;
+    }
+
+    pack.BaseIndex = (const IndexEntry*) (pack.BaseMap->data() + sizeof(PackHeader));
+    pack.BaseCount = header.Count;
+
+    // Индекс должен быть строго упорядочен и указывать внутрь файла, иначе пакет пишется заново
+    const uint64_t dataBegin = sizeof(PackHeader) + header.Count * sizeof(IndexEntry);
+    for(size_t iter = 0; iter < pack.BaseCount; iter++) {
+        const IndexEntry& entry = pack.BaseIndex[iter];
+        if(iter && !(pack.BaseIndex[iter-1].Hash < entry.Hash))
+            return std::nullopt;
+
+        if(entry.Offset < dataBegin || entry.Offset > fileSize || entry.Size > fileSize - entry.Offset)
+            return std::nullopt;
+
+        pack.LiveBytes += entry.Size;
+    }
+
+    // Хвост от дописанных в прошлом запуске участков и выравнивание
+    pack.GarbageBytes = fileSize - dataBegin - std::min(pack.LiveBytes, size_t(fileSize - dataBegin));
+    return pack;
+}
+
+void AssetsPack::writeFresh(const std::vector<Entry>& entries) {
+    fs::path temp = Path;
+    temp += ".tmp";
+
+    std::vector<Entry> sorted = entries;
+    std::sort(sorted.begin(), sorted.end(), [](const Entry& a, const Entry& b) { return std::get<0>(a) < std::get<0>(b); });
+    sorted.erase(std::unique(sorted.begin(), sorted.end(), [](const Entry& a, const Entry& b) { return std::get<0>(a) == std::get<0>(b); }), sorted.end());
+
+    std::vector<uint64_t> offsets;
+    uint64_t end;
+
+    {
+        std::ofstream fd(temp, std::ios::binary | std::ios::trunc);
+        if(!fd)
+            MAKE_ERROR("Не удалось создать пакет ресурсов " << temp.string());
+
+        PackHeader header{PACK_MAGIC, PACK_VERSION, sorted.size()};
+        fd.write((const char*) &header, sizeof(header));
+
+        // Смещения известны до записи данных, индекс пишется первым
+        const uint64_t dataBegin = sizeof(header) + sorted.size() * sizeof(IndexEntry);
+        uint64_t pos = dataBegin;
+        for(const auto& [hash, data, size] : sorted) {
+            uint64_t offset = alignUp(pos, PACK_ALIGN);
+            IndexEntry entry{hash, offset, size};
+            fd.write((const char*) &entry, sizeof(entry));
+            pos = offset + size;
+        }
+
+        end = writeEntries(fd, dataBegin, sorted, offsets);
+
+        if(!fd)
+            MAKE_ERROR("Не удалось записать пакет ресурсов " << temp.string());
+    }
+
+    fs::rename(temp, Path);
+
+    BaseMap = std::make_shared<const Mapping>(Path, 0, end);
+    BaseIndex = (const IndexEntry*) (BaseMap->data() + sizeof(PackHeader));
+    BaseCount = sorted.size();
+    BaseRemoved.clear();
+    Index.clear();
+
+    LiveBytes = 0;
+    for(const auto& [hash, data, size] : sorted)
+        LiveBytes += size;
+
+    GarbageBytes = 0;
+}
+
+const AssetsPack::IndexEntry* AssetsPack::findBase(const Hash_t& hash) const {
+    const IndexEntry* end = BaseIndex + BaseCount;
+    const IndexEntry* iter = std::lower_bound(BaseIndex, end, hash,
+        [](const IndexEntry& entry, const Hash_t& hash) { return entry.Hash < hash; });
+
+    if(iter == end || iter->Hash != hash || BaseRemoved.contains(hash))
+        return nullptr;
+
+    return iter;
+}
+
+bool AssetsPack::contains(const Hash_t& hash) const {
+    return Index.contains(hash) || findBase(hash);
+}
+
+bool AssetsPack::matches(const std::vector<Hash_t>& sorted) const {
+    if(!Index.empty() || !BaseRemoved.empty() || sorted.size() != BaseCount)
+        return false;
+
+    for(size_t iter = 0; iter < BaseCount; iter++)
+        if(BaseIndex[iter].Hash != sorted[iter])
+            return false;
+
+    return true;
+}
+
+void AssetsPack::append(const std::vector<Entry>& entries) {
+    std::vector<Entry> fresh;
+    fresh.reserve(entries.size());
+    for(const Entry& entry : entries)
+        if(!contains(std::get<0>(entry)))
+            fresh.push_back(entry);
+
+    if(fresh.empty())
+        return;
+
+    std::vector<uint64_t> offsets;
+    uint64_t begin, end;
+
+    {
+        std::fstream fd(Path, std::ios::binary | std::ios::in | std::ios::out);
+        if(!fd)
+            MAKE_ERROR("Не удалось открыть пакет ресурсов " << Path.string());
+
+        // Участок начинается с границы страницы, чтобы отобразить только его.
+        // Размер берётся из файла: после неудачной записи в конце мог остаться мусор
+        fd.seekp(0, std::ios::end);
+        uint64_t fileSize = uint64_t(fd.tellp());
+        begin = alignUp(fileSize, boost::interprocess::mapped_region::get_page_size());
+
+        static constexpr char zeros[PACK_ALIGN] = {0};
+        for(uint64_t pos = fileSize; pos < begin; pos += std::min<uint64_t>(PACK_ALIGN, begin - pos))
+            fd.write(zeros, std::min<uint64_t>(PACK_ALIGN, begin - pos));
+
+        end = begin + writeEntries(fd, 0, fresh, offsets);
+
+        if(!fd.flush())
+            MAKE_ERROR("Не удалось дописать пакет ресурсов " << Path.string());
+    }
+
+    auto map = std::make_shared<const Mapping>(Path, begin, end - begin);
+    for(size_t iter = 0; iter < fresh.size(); iter++) {
+        const auto& [hash, data, size] = fresh[iter];
+        if(Index.emplace(hash, Slot{map, offsets[iter], size}).second)
+            LiveBytes += size;
+    }
+}
+
+void AssetsPack::remove(const Hash_t& hash) {
+    if(auto iter = Index.find(hash); iter != Index.end()) {
+        LiveBytes -= iter->second.Size;
+        GarbageBytes += iter->second.Size;
+        Index.erase(iter);
+    } else if(const IndexEntry* entry = findBase(hash)) {
+        LiveBytes -= entry->Size;
+        GarbageBytes += entry->Size;
+        BaseRemoved.insert(hash);
+    }
+}
+
+bool AssetsPack::needCompaction() const {
+    return GarbageBytes >= COMPACT_MIN_BYTES && GarbageBytes > LiveBytes * COMPACT_RATIO;
+}
+
+void AssetsPack::compact() {
+    // Данные читаются из текущих отображений, они живут до замены индекса
+    std::vector<Entry> entries;
+    entries.reserve(size());
+    for(size_t iter = 0; iter < BaseCount; iter++) {
+        const IndexEntry& entry = BaseIndex[iter];
+        if(!BaseRemoved.contains(entry.Hash))
+            entries.emplace_back(entry.Hash, BaseMap->data() + entry.Offset, entry.Size);
+    }
+
+    for(const auto& [hash, slot] : Index)
+        entries.emplace_back(hash, slot.Map->data() + slot.Offset, slot.Size);
+
+    writeFresh(entries);
+}
+
+std::optional<Resource> AssetsPack::find(const Hash_t& hash) const {
+    if(auto iter = Index.find(hash); iter != Index.end()) {
+        const Slot& slot = iter->second;
+        return Resource(slot.Map, slot.Map->data() + slot.Offset, slot.Size, hash);
+    }
+
+    if(const IndexEntry* entry = findBase(hash))
+        return Resource(BaseMap, BaseMap->data() + entry->Offset, entry->Size, hash);
+
+    return std::nullopt;
+}
+
+}
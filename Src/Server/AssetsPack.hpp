@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Common/Abstract.hpp"
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+
+namespace LV::Server {
+
+namespace fs = std::filesystem;
+
+/*
+    Пакет ресурсов, адресуемых по хешу.
+
+    [заголовок][индекс][участок][участок]...
+
+    Новые ресурсы дописываются в конец файла участком, выровненным по странице,
+    и отображаются в память только этим участком: уже выданные представления не меняются.
+    Удалённые ресурсы остаются в файле мусором, пока его не станет больше порога,
+    тогда живые ресурсы переписываются в новый файл (compact).
+
+    Индекс ресурсов первого участка хранится в файле после заголовка, отсортированным по хешу,
+    и ищется двоичным поиском прямо в отображении. Дописанные позже ресурсы индексируются в памяти,
+    поэтому пакет прошлого запуска берётся как есть (open), только если его индекс совпадает
+    с набором ресурсов, иначе пакет пишется заново одним участком.
+    Файл никогда не усекается на месте: новый пишется рядом и заменяет старый,
+    поэтому отображения, удерживаемые ресурсами в отправке, остаются действительными.
+*/
+class AssetsPack {
+public:
+    using Hash_t = ResourceFile::Hash_t;
+
+    // Хеш, данные, размер
+    using Entry = std::tuple<Hash_t, const std::byte*, size_t>;
+
+    // Мусор собирается, когда его больше этой доли живых данных
+    static constexpr double COMPACT_RATIO = 0.5;
+    // и не меньше этого объёма
+    static constexpr size_t COMPACT_MIN_BYTES = 16 << 20;
+
+    // Создаёт пакет из entries, прежний файл заменяется
+    explicit AssetsPack(fs::path path, const std::vector<Entry>& entries = {});
+
+    // Пакет прошлого запуска, если файл есть и его заголовок и индекс целы
+    static std::optional<AssetsPack> open(fs::path path);
+
+    AssetsPack(const AssetsPack&) = delete;
+    AssetsPack(AssetsPack&&) = default;
+    AssetsPack& operator=(const AssetsPack&) = delete;
+    AssetsPack& operator=(AssetsPack&&) = default;
+
+    // Дописывает ресурсы, которых ещё нет в пакете
+    void append(const std::vector<Entry>& entries);
+    // Место ресурса становится мусором до уплотнения
+    void remove(const Hash_t& hash);
+
+    bool needCompaction() const;
+    // Переписывает живые ресурсы в новый файл, представления нужно перезапросить через find
+    void compact();
+
+    std::optional<Resource> find(const Hash_t& hash) const;
+    bool contains(const Hash_t& hash) const;
+    // В пакете ровно ресурсы sorted (отсортированы по возрастанию)
+    bool matches(const std::vector<Hash_t>& sorted) const;
+
+    size_t size() const { return BaseCount - BaseRemoved.size() + Index.size(); }
+    size_t liveBytes() const { return LiveBytes; }
+    size_t garbageBytes() const { return GarbageBytes; }
+
+private:
+    struct Mapping;
+
+    struct Slot {
+        std::shared_ptr<const Mapping> Map;
+        // Смещение внутри отображения
+        size_t Offset;
+        size_t Size;
+    };
+
+    struct IndexEntry;
+
+    fs::path Path;
+    // Первый участок с сохранённым индексом, удалённые из него ресурсы отмечаются отдельно
+    std::shared_ptr<const Mapping> BaseMap;
+    const IndexEntry* BaseIndex = nullptr;
+    size_t BaseCount = 0;
+    std::unordered_set<Hash_t> BaseRemoved;
+    // Дописанные участки
+    std::unordered_map<Hash_t, Slot> Index;
+    size_t LiveBytes = 0, GarbageBytes = 0;
+
+    AssetsPack() = default;
+
+    // Пишет заголовок, индекс и ресурсы в файл рядом и заменяет им основной
+    void writeFresh(const std::vector<Entry>& entries);
+    // Запись сохранённого индекса, если ресурс в первом участке и не удалён
+    const IndexEntry* findBase(const Hash_t& hash) const;
+};
+
+}
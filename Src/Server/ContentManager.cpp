@@ -141,8 +141,56 @@ void ContentManager::unRegisterModifier(EnumDefContent type, const std::string&
 //     }
 // }
 
+void ContentManager::beginReload() {
+    assert(!ReloadBackup.Active);
+    ReloadBackup.Active = true;
+
+    // Изменения до перезагрузки ещё не собраны buildEndProfiles, при отмене они должны остаться
+    for(size_t type = 0; type < MAX_ENUM; type++)
+        ReloadBackup.ProfileChanges[type] = ProfileChanges[type];
+
+    // Все профили подлежат пересборке: не зарегистрированные заново окажутся потерянными
+    auto stash = [&](auto& base, auto& backup, EnumDefContent type) {
+        ResourceId counter = 0;
+        for(const auto& entry : base)
+            for(const auto& item : entry->Entries) {
+                if(item)
+                    ProfileChanges[static_cast<size_t>(type)].push_back(counter);
+
+                counter++;
+            }
+
+        backup = std::move(base);
+        base.clear();
+    };
+
+    stash(Profiles_Base_Voxel,  ReloadBackup.Voxel,     EnumDefContent::Voxel);
+    stash(Profiles_Base_Node,   ReloadBackup.Node,      EnumDefContent::Node);
+    stash(Profiles_Base_World,  ReloadBackup.World,     EnumDefContent::World);
+    stash(Profiles_Base_Portal, ReloadBackup.Portal,    EnumDefContent::Portal);
+    stash(Profiles_Base_Entity, ReloadBackup.Entity,    EnumDefContent::Entity);
+    stash(Profiles_Base_Item,   ReloadBackup.Item,      EnumDefContent::Item);
+}
+
+void ContentManager::abortReload() {
+    if(!ReloadBackup.Active)
+        return;
+
+    Profiles_Base_Voxel = std::move(ReloadBackup.Voxel);
+    Profiles_Base_Node = std::move(ReloadBackup.Node);
+    Profiles_Base_World = std::move(ReloadBackup.World);
+    Profiles_Base_Portal = std::move(ReloadBackup.Portal);
+    Profiles_Base_Entity = std::move(ReloadBackup.Entity);
+    Profiles_Base_Item = std::move(ReloadBackup.Item);
+
+    for(size_t type = 0; type < MAX_ENUM; type++)
+        ProfileChanges[type] = std::move(ReloadBackup.ProfileChanges[type]);
+
+    ReloadBackup = {};
+}
+
 template<class type, class modType>
-void ContentManager::buildEndProfilesByType(auto& profiles, auto enumType, auto& base, auto& keys, auto& result, auto& modsTable) {
+void ContentManager::buildEndProfilesByType(auto& profiles, auto enumType, auto& base, auto& keys, auto& result, auto& changed, auto& modsTable) {
     // Расширяем таблицу итоговых профилей до нужного количества
     if(!keys.empty()) {
         size_t need = keys.back() / TableEntry<type>::ChunkSize;
@@ -161,14 +209,18 @@ void ContentManager::buildEndProfilesByType(auto& profiles, auto enumType, auto&
         size_t entryIndex = id / TableEntry<type>::ChunkSize;
         size_t subIndex = id % TableEntry<type>::ChunkSize;
 
+        std::optional<type>& current = profiles[entryIndex]->Entries[subIndex];
+
         if(
             entryIndex >= base.size()
             || !base[entryIndex]->Entries[subIndex]
         ) {
             // Базовый профиль не существует
-            profiles[entryIndex]->Entries[subIndex] = std::nullopt;
-            // Уведомляем о потере профиля
-            result.LostProfiles[static_cast<size_t>(enumType)].push_back(id);
+            if(current) {
+                current = std::nullopt;
+                // Уведомляем о потере профиля
+                result.LostProfiles[static_cast<size_t>(enumType)].push_back(id);
+            }
         } else {
             // Собираем конечный профиль
             std::vector<std::tuple<std::string, modType>> mods_default, *mods = &mods_default;
@@ -179,9 +231,17 @@ void ContentManager::buildEndProfilesByType(auto& profiles, auto enumType, auto&
             std::optional<BindDomainKeyInfo> dk = getDK(enumType, id);
             assert(dk);
             TOS::Logger("CM").debug() << "\t" << dk->Domain << ":" << dk->Key << " -> " << id;
-            profiles[entryIndex]->Entries[subIndex] = base[entryIndex]->Entries[subIndex]->compile(AM, *this, dk->Domain, dk->Key, *mods);
+            type profile = base[entryIndex]->Entries[subIndex]->compile(AM, *this, dk->Domain, dk->Key, *mods);
+
+            // Клиенты видят профиль через dumpToClient, при совпадении рассылать нечего
+            bool same = current && current->dumpToClient() == profile.dumpToClient();
+            current = std::move(profile);
+            if(!same)
+                changed.emplace_back(id, &*current);
         }
     }
+
+    keys.clear();
 }
 
 ContentManager::Out_buildEndProfiles ContentManager::buildEndProfiles() {
@@ -195,16 +255,19 @@ ContentManager::Out_buildEndProfiles ContentManager::buildEndProfiles() {
         keys.erase(iterErase, keys.end());
 
         switch(type) {
-            case 0: buildEndProfilesByType<DefVoxel, DefVoxel_Mod>      (Profiles_Voxel,    EnumDefContent::Voxel,  Profiles_Base_Voxel,    keys, result, Profiles_Mod_Voxel);  break;
-            case 1: buildEndProfilesByType<DefNode, DefNode_Mod>        (Profiles_Node,     EnumDefContent::Node,   Profiles_Base_Node,     keys, result, Profiles_Mod_Node);   break;
-            case 2: buildEndProfilesByType<DefWorld, DefWorld_Mod>      (Profiles_World,    EnumDefContent::World,  Profiles_Base_World,    keys, result, Profiles_Mod_World);  break;
-            case 3: buildEndProfilesByType<DefPortal, DefPortal_Mod>    (Profiles_Portal,   EnumDefContent::Portal, Profiles_Base_Portal,   keys, result, Profiles_Mod_Portal); break;
-            case 4: buildEndProfilesByType<DefEntity, DefEntity_Mod>    (Profiles_Entity,   EnumDefContent::Entity, Profiles_Base_Entity,   keys, result, Profiles_Mod_Entity); break;
-            case 5: buildEndProfilesByType<DefItem, DefItem_Mod>        (Profiles_Item,     EnumDefContent::Item,   Profiles_Base_Item,     keys, result, Profiles_Mod_Item);   break;
+            case 0: buildEndProfilesByType<DefVoxel, DefVoxel_Mod>      (Profiles_Voxel,    EnumDefContent::Voxel,  Profiles_Base_Voxel,    keys, result, result.ChangedProfiles_Voxel, Profiles_Mod_Voxel);  break;
+            case 1: buildEndProfilesByType<DefNode, DefNode_Mod>        (Profiles_Node,     EnumDefContent::Node,   Profiles_Base_Node,     keys, result, result.ChangedProfiles_Node, Profiles_Mod_Node);   break;
+            case 2: buildEndProfilesByType<DefWorld, DefWorld_Mod>      (Profiles_World,    EnumDefContent::World,  Profiles_Base_World,    keys, result, result.ChangedProfiles_World, Profiles_Mod_World);  break;
+            case 3: buildEndProfilesByType<DefPortal, DefPortal_Mod>    (Profiles_Portal,   EnumDefContent::Portal, Profiles_Base_Portal,   keys, result, result.ChangedProfiles_Portal, Profiles_Mod_Portal); break;
+            case 4: buildEndProfilesByType<DefEntity, DefEntity_Mod>    (Profiles_Entity,   EnumDefContent::Entity, Profiles_Base_Entity,   keys, result, result.ChangedProfiles_Entity, Profiles_Mod_Entity); break;
+            case 5: buildEndProfilesByType<DefItem, DefItem_Mod>        (Profiles_Item,     EnumDefContent::Item,   Profiles_Base_Item,     keys, result, result.ChangedProfiles_Item, Profiles_Mod_Item);   break;
             default: std::unreachable();
         }
     }
 
+    // Перезагрузка завершена, отложенные профили больше не нужны
+    ReloadBackup = {};
+
     return result;
 }
 
@@ -215,6 +215,15 @@ public:
     // void markAllProfilesDirty(EnumDefContent type);
     // Список всех зарегистрированных профилей выбранного типа
     std::vector<ResourceId> collectProfileIds(EnumDefContent type) const;
+
+    /*
+        Перезагрузка модов: базовые профили откладываются и моды регистрируют их заново.
+        Идентификаторы (домен, ключ) не меняются, buildEndProfiles сравнивает новый профиль
+        со старым и отдаёт клиентам только изменённые, а не перерегистрированные - как потерянные.
+        При ошибке в модах abortReload возвращает отложенные профили и список изменений как были
+    */
+    void beginReload();
+    void abortReload();
     // Компилирует изменённые профили
     struct Out_buildEndProfiles {
         std::vector<
@@ -419,7 +428,7 @@ private:
     void registerBase_Entity(ResourceId id, const std::string& domain, const std::string& key, const sol::table& profile);
 
     template<class type, class modType>
-    void buildEndProfilesByType(auto& profiles, auto enumType, auto& base, auto& keys, auto& result, auto& mods);
+    void buildEndProfilesByType(auto& profiles, auto enumType, auto& base, auto& keys, auto& result, auto& changed, auto& mods);
 
     TOS::Logger LOG = "Server>ContentManager";
     AssetsManager& AM;
@@ -445,6 +454,19 @@ private:
     // По ним будут пересобраны профили
     std::vector<ResourceId> ProfileChanges[MAX_ENUM];
 
+    // Базовые профили до перезагрузки модов (beginReload)
+    struct {
+        bool Active = false;
+        std::vector<std::unique_ptr<TableEntry<DefVoxel_Base>>>     Voxel;
+        std::vector<std::unique_ptr<TableEntry<DefNode_Base>>>       Node;
+        std::vector<std::unique_ptr<TableEntry<DefWorld_Base>>>     World;
+        std::vector<std::unique_ptr<TableEntry<DefPortal_Base>>>   Portal;
+        std::vector<std::unique_ptr<TableEntry<DefEntity_Base>>>   Entity;
+        std::vector<std::unique_ptr<TableEntry<DefItem_Base>>>       Item;
+        // Изменения, накопленные до перезагрузки
+        std::vector<ResourceId> ProfileChanges[MAX_ENUM];
+    } ReloadBackup;
+
     // Конечные профили контента
     std::array<std::shared_mutex, MAX_ENUM> Profiles_Mtx;
     std::vector<std::unique_ptr<TableEntry<DefVoxel>>>     Profiles_Voxel;
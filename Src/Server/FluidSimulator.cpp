@@ -0,0 +1,277 @@
+#include "FluidSimulator.hpp"
+#include "World.hpp"
+#include <algorithm>
+
+
+namespace LV::Server {
+
+// Порядок как у граней чанка: +X, -X, +Y, -Y, +Z, -Z
+static const Pos::GlobalNode Dirs[6] = {
+    Pos::GlobalNode(1, 0, 0), Pos::GlobalNode(-1, 0, 0),
+    Pos::GlobalNode(0, 1, 0), Pos::GlobalNode(0, -1, 0),
+    Pos::GlobalNode(0, 0, 1), Pos::GlobalNode(0, 0, -1)
+};
+
+static const Pos::GlobalNode Down(0, -1, 0), Up(0, 1, 0);
+
+// Стороны в порядке обхода по кругу, начало сдвигается от такта к такту
+static const Pos::GlobalNode Sides[4] = {
+    Pos::GlobalNode(1, 0, 0), Pos::GlobalNode(0, 0, 1),
+    Pos::GlobalNode(-1, 0, 0), Pos::GlobalNode(0, 0, -1)
+};
+
+static Pos::GlobalNode regionBase(Pos::GlobalRegion rPos) {
+    // Покомпонентно: приведение BitVec3 между типами не расширяет знак
+    return Pos::GlobalNode(rPos.x, rPos.y, rPos.z) << 6;
+}
+
+void FluidSimulator::onNodeChanged(Pos::GlobalNode pos) {
+    Cursor cursor;
+    wake(cursor, pos);
+    for(const Pos::GlobalNode& dir : Dirs)
+        wake(cursor, pos + dir);
+}
+
+void FluidSimulator::onRegionLoaded(Pos::GlobalRegion rPos) {
+    if(!Table)
+        return;
+
+    auto iterRegion = Regions.find(rPos);
+    if(iterRegion == Regions.end())
+        return;
+
+    const Region& region = *iterRegion->second;
+    const Pos::GlobalNode base = regionBase(rPos);
+    Cursor cursor;
+
+    for(uint32_t chunk = 0; chunk < 64; chunk++) {
+        Pos::bvec4u cPos;
+        cPos.unpack(chunk);
+
+        for(uint32_t index = 0; index < 16*16*16; index++) {
+            Node self = region.Nodes[chunk][index];
+            if(self.NodeId == 0 || !lookup(self.NodeId).Viscosity)
+                continue;
+
+            Pos::bvec16u nPos;
+            nPos.unpack(index);
+            Pos::GlobalNode pos = base + (Pos::GlobalNode(cPos) << 4) + Pos::GlobalNode(nPos);
+            if(canFlow(cursor, pos, self))
+                wake(cursor, pos);
+        }
+    }
+
+    // Жидкости соседей упирались в незагруженный регион как в стену
+    for(int face = 0; face < 6; face++) {
+        if(!Regions.contains(rPos + Pos::GlobalRegion(Dirs[face].x, Dirs[face].y, Dirs[face].z)))
+            continue;
+
+        const int axis = face >> 1;
+        for(int u = 0; u < 64; u++)
+            for(int v = 0; v < 64; v++) {
+                int coord[3];
+                coord[axis] = (face & 1) ? -1 : 64;
+                coord[(axis+1) % 3] = u;
+                coord[(axis+2) % 3] = v;
+
+                wake(cursor, base + Pos::GlobalNode(coord[0], coord[1], coord[2]));
+            }
+    }
+}
+
+void FluidSimulator::onRegionUnloaded(Pos::GlobalRegion rPos) {
+    Wakeups.dropRegion(rPos);
+    // Отложенные ноды выгруженного региона отсеются в step (flow не найдёт регион)
+}
+
+void FluidSimulator::step(const SetNode& setNode) {
+    std::vector<Pos::GlobalNode> positions;
+    takeDue(positions);
+    flowNodes(positions, setNode);
+}
+
+void FluidSimulator::takeDue(std::vector<Pos::GlobalNode>& out) {
+    Due.clear();
+    Wakeups.advance(Due);
+
+    uint32_t budget = Budget;
+    while(budget && !Backlog.empty()) {
+        Pos::GlobalNode pos = Backlog.front();
+        Backlog.pop_front();
+        InBacklog.erase(pos);
+        out.push_back(pos);
+        budget--;
+    }
+
+    size_t iter = 0;
+    for(; budget && iter < Due.size(); iter++, budget--)
+        out.push_back(Due[iter]);
+
+    for(; iter < Due.size(); iter++)
+        if(InBacklog.insert(Due[iter]).second)
+            Backlog.push_back(Due[iter]);
+}
+
+void FluidSimulator::flowNodes(const std::vector<Pos::GlobalNode>& positions, const SetNode& setNode) const {
+    Cursor cursor;
+    for(Pos::GlobalNode pos : positions)
+        flow(cursor, pos, setNode);
+}
+
+Node* FluidSimulator::node(Cursor& cursor, Pos::GlobalNode pos) const {
+    Pos::GlobalRegion rPos = pos >> 6;
+    if(!cursor.Has || cursor.RegionPos != rPos) {
+        auto iterRegion = Regions.find(rPos);
+        cursor.Ptr = iterRegion == Regions.end() ? nullptr : iterRegion->second.get();
+        cursor.RegionPos = rPos;
+        cursor.Has = true;
+    }
+
+    if(!cursor.Ptr)
+        return nullptr;
+
+    Pos::bvec4u cPos = (pos >> 4) & 0x3;
+    Pos::bvec16u nPos = pos & 0xf;
+    return &cursor.Ptr->Nodes[cPos.pack()][nPos.pack()];
+}
+
+void FluidSimulator::wake(Cursor& cursor, Pos::GlobalNode pos) {
+    if(!Table)
+        return;
+
+    Node* self = node(cursor, pos);
+    if(!self || self->NodeId == 0 || InBacklog.contains(pos))
+        return;
+
+    if(uint16_t viscosity = lookup(self->NodeId).Viscosity)
+        Wakeups.schedule(pos, viscosity);
+}
+
+bool FluidSimulator::canFlow(Cursor& cursor, Pos::GlobalNode pos, Node self) const {
+    if(Node* below = node(cursor, pos + Down)) {
+        if(below->NodeId == 0)
+            return true;
+        if(below->NodeId == self.NodeId && levelOf(*below) < MAX_LEVEL)
+            return true;
+    }
+
+    const uint32_t selfHead = head(cursor, pos, self);
+    if(selfHead < 2)
+        return false;
+
+    Side sides[4];
+    int count = collectSides(cursor, pos, self.NodeId, 0, sides);
+    for(int iter = 0; iter < count; iter++)
+        if(selfHead >= sides[iter].Head + 2)
+            return true;
+
+    return false;
+}
+
+uint32_t FluidSimulator::head(Cursor& cursor, Pos::GlobalNode pos, Node self) const {
+    uint32_t value = levelOf(self);
+    for(int depth = 0; depth < PRESSURE_DEPTH; depth++) {
+        pos = pos + Up;
+        Node* above = node(cursor, pos);
+        if(!above || above->NodeId != self.NodeId)
+            break;
+
+        value += levelOf(*above);
+    }
+
+    return value;
+}
+
+int FluidSimulator::collectSides(Cursor& cursor, Pos::GlobalNode pos, DefNodeId fluid, uint32_t rotate, Side out[4]) const {
+    int count = 0;
+    for(int iter = 0; iter < 4; iter++) {
+        Pos::GlobalNode sidePos = pos + Sides[(iter + rotate) & 3];
+        Node* side = node(cursor, sidePos);
+        if(!side)
+            continue;
+
+        if(side->NodeId == 0) {
+            out[count++] = {sidePos, 0, 0};
+            continue;
+        }
+
+        if(side->NodeId != fluid)
+            continue;
+
+        // Через полную ноду объём уходит наверх её столба, как в сообщающихся сосудах
+        const uint32_t sideHead = head(cursor, sidePos, *side);
+        Pos::GlobalNode top = sidePos;
+        Node* topNode = side;
+        for(int depth = 0; depth < PRESSURE_DEPTH && topNode && topNode->NodeId == fluid && levelOf(*topNode) == MAX_LEVEL; depth++) {
+            top = top + Up;
+            topNode = node(cursor, top);
+        }
+
+        if(!topNode)
+            continue;
+
+        if(topNode->NodeId == 0)
+            out[count++] = {top, 0, sideHead};
+        else if(topNode->NodeId == fluid && levelOf(*topNode) < MAX_LEVEL)
+            out[count++] = {top, levelOf(*topNode), sideHead};
+    }
+
+    return count;
+}
+
+void FluidSimulator::flow(Cursor& cursor, Pos::GlobalNode pos, const SetNode& setNode) const {
+    Node* selfPtr = node(cursor, pos);
+    if(!selfPtr || selfPtr->NodeId == 0)
+        return;
+
+    const Node self = *selfPtr;
+    const DefNodeId fluid = self.NodeId;
+    if(!lookup(fluid).Viscosity)
+        return;
+
+    const uint8_t start = levelOf(self);
+    uint8_t level = start;
+
+    // Вниз стекает всё, что помещается
+    if(Node* below = node(cursor, pos + Down)) {
+        if(below->NodeId == 0) {
+            setNode(pos + Down, makeFluid(fluid, level));
+            level = 0;
+        } else if(below->NodeId == fluid) {
+            uint8_t belowLevel = levelOf(*below);
+            uint8_t move = std::min<uint8_t>(level, MAX_LEVEL - belowLevel);
+            if(move) {
+                setNode(pos + Down, makeFluid(fluid, belowLevel + move));
+                level -= move;
+            }
+        }
+    }
+
+    /*
+        В стороны, начиная с самых низких соседей, каждому половина разницы напоров.
+        Напор - свой объём плюс жидкость над нодой, так глубокая вода
+        выдавливается к стоку снизу, а убыль восполняется сверху
+    */
+    uint32_t selfHead = level ? head(cursor, pos, makeFluid(fluid, level)) : 0;
+    if(level && selfHead >= 2) {
+        Side sides[4];
+        int count = collectSides(cursor, pos, fluid, uint32_t(Wakeups.now() + pos.x + pos.z), sides);
+
+        std::stable_sort(sides, sides+count, [](const Side& a, const Side& b) { return a.Head < b.Head; });
+
+        for(int iter = 0; iter < count && level; iter++) {
+            if(selfHead < sides[iter].Head + 2)
+                break;
+
+            uint32_t move = std::min<uint32_t>({(selfHead - sides[iter].Head) / 2, level, uint32_t(MAX_LEVEL - sides[iter].Level)});
+            setNode(sides[iter].Pos, makeFluid(fluid, sides[iter].Level + move));
+            level -= move;
+            selfHead -= move;
+        }
+    }
+
+    if(level != start)
+        setNode(pos, makeFluid(fluid, level));
+}
+
+}
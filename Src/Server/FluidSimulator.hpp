@@ -0,0 +1,150 @@
+#pragma once
+
+#include "Common/Abstract.hpp"
+#include "Server/Abstract.hpp"
+#include "Server/NodeTickScheduler.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+
+namespace LV::Server {
+
+class Region;
+
+// Свойства жидкой ноды
+struct NodeFluidInfo {
+    // Тактов мира между шагами течения, 0 - нода не жидкость
+    uint16_t Viscosity = 0;
+};
+
+/*
+    Течение жидкостей по нодам мира.
+
+    Жидкость хранит объём в Meta: 1..MAX_LEVEL-1 - частично заполненная нода, 0 - полная
+    (так сгенерированная вода сразу полная). Объём сохраняется: нода сливается вниз
+    и выравнивает напор (объём вместе со столбом жидкости сверху) с соседями сбоку,
+    если разница хотя бы два. Через полного соседа объём уходит наверх его столба.
+    Устойчивый уклон - единица объёма на ноду, при 255 уровнях озеро стекает почти полностью,
+    а ровная гладь не колеблется.
+
+    Активные ноды держатся в колесе таймеров (NodeTickScheduler), по одному ожиданию на позицию.
+    Нода просыпается через Viscosity тактов после изменения себя или соседа,
+    а устоявшаяся больше не планируется, так что регионы без течения ничего не стоят.
+    За шаг обрабатывается не больше Budget нод, остальные переходят на следующий такт.
+
+    Сам симулятор нод не пишет: изменения уходят через setNode мира,
+    чтобы попасть в общий учёт изменённых чанков, свет и рассылку клиентам.
+
+    Шаг можно разбить: takeDue выбирает ноды такта, flowNodes их обрабатывает.
+    flowNodes не меняет состояние симулятора, поэтому вызовы для нод, чьи окрестности
+    REACH_* не пересекаются, можно вести из разных потоков (шарды мира).
+*/
+class FluidSimulator {
+public:
+    static constexpr uint8_t MAX_LEVEL = 255;
+    static constexpr uint32_t DEFAULT_BUDGET = 4096;
+    // Сколько нод жидкости сверху учитывается в напоре
+    static constexpr int PRESSURE_DEPTH = 16;
+    // Окрестность ноды, которую читает и пишет её шаг течения
+    static constexpr int REACH_SIDE = 1, REACH_DOWN = 1, REACH_UP = PRESSURE_DEPTH;
+
+    using SetNode = std::function<void(Pos::GlobalNode, Node)>;
+
+    explicit FluidSimulator(std::unordered_map<Pos::GlobalRegion, std::unique_ptr<Region>>& regions)
+        : Regions(regions)
+    {}
+
+    // Свойства нод, индекс - DefNodeId. Без таблицы жидкостей нет
+    void setFluidTable(const std::vector<NodeFluidInfo>* table) {
+        Table = table;
+    }
+
+    // Сколько нод обрабатывается за такт
+    void setBudget(uint32_t budget) {
+        Budget = std::max<uint32_t>(budget, 1);
+    }
+
+    // Нода в pos изменилась: будит её и соседние жидкости
+    void onNodeChanged(Pos::GlobalNode pos);
+    // Будит жидкости нового региона, которые могут течь, и жидкости соседей у его граней
+    void onRegionLoaded(Pos::GlobalRegion rPos);
+    void onRegionUnloaded(Pos::GlobalRegion rPos);
+
+    // Один такт течения
+    void step(const SetNode& setNode);
+    // Переходит к следующему такту и выбирает ноды на него в пределах бюджета, остальные откладываются
+    void takeDue(std::vector<Pos::GlobalNode>& out);
+    // Шаг течения для выбранных нод по порядку
+    void flowNodes(const std::vector<Pos::GlobalNode>& positions, const SetNode& setNode) const;
+
+    // Ожидающие и отложенные ноды
+    size_t activeCount() const {
+        return Wakeups.pendingCount() + Backlog.size();
+    }
+
+    NodeFluidInfo lookup(DefNodeId id) const {
+        if(Table && id < Table->size())
+            return (*Table)[id];
+
+        return {};
+    }
+
+    static uint8_t levelOf(Node node) {
+        return node.Meta == 0 || node.Meta >= MAX_LEVEL ? MAX_LEVEL : node.Meta;
+    }
+
+    static Node makeFluid(DefNodeId id, uint8_t level) {
+        Node node;
+        node.Data = 0;
+        if(level == 0)
+            return node;
+
+        node.NodeId = id;
+        node.Meta = level >= MAX_LEVEL ? 0 : level;
+        return node;
+    }
+
+private:
+    std::unordered_map<Pos::GlobalRegion, std::unique_ptr<Region>>& Regions;
+    const std::vector<NodeFluidInfo>* Table = nullptr;
+    uint32_t Budget = DEFAULT_BUDGET;
+
+    NodeTickScheduler Wakeups;
+    // Проснувшиеся, но не уместившиеся в бюджет. Пока нода здесь, повторно она не планируется
+    std::deque<Pos::GlobalNode> Backlog;
+    std::unordered_set<Pos::GlobalNode> InBacklog;
+    std::vector<Pos::GlobalNode> Due;
+
+    // Куда может уйти единица объёма сбоку: сам сосед или верх его столба
+    struct Side {
+        Pos::GlobalNode Pos;
+        uint8_t Level;
+        uint32_t Head;
+    };
+
+    // Последний найденный регион, свой у каждого прохода
+    struct Cursor {
+        Pos::GlobalRegion RegionPos;
+        Region* Ptr = nullptr;
+        bool Has = false;
+    };
+
+    // Нода загруженного региона
+    Node* node(Cursor& cursor, Pos::GlobalNode pos) const;
+    void wake(Cursor& cursor, Pos::GlobalNode pos);
+    // Изменит ли шаг течения эту ноду
+    bool canFlow(Cursor& cursor, Pos::GlobalNode pos, Node self) const;
+    // Напор: объём ноды и жидкости того же типа над ней
+    uint32_t head(Cursor& cursor, Pos::GlobalNode pos, Node self) const;
+    // Соседи по сторонам, принимающие жидкость, обход начинается с rotate
+    int collectSides(Cursor& cursor, Pos::GlobalNode pos, DefNodeId fluid, uint32_t rotate, Side out[4]) const;
+    void flow(Cursor& cursor, Pos::GlobalNode pos, const SetNode& setNode) const;
+};
+
+}
@@ -4,6 +4,7 @@
 #include "Common/Packets.hpp"
 #include "Server/Abstract.hpp"
 #include "Server/ContentManager.hpp"
+#include "Server/RegionGenerator.hpp"
 #include "Server/RemoteClient.hpp"
 #include <algorithm>
 #include <array>
@@ -11,6 +12,7 @@
 #include <chrono>
 #include <filesystem>
 #include <functional>
+#include <tuple>
 #include <glm/geometric.hpp>
 #include <glm/gtc/noise.hpp>
 #include <iostream>
@@ -495,20 +497,86 @@ GameServer::GameServer(asio::io_context &ioc, fs::path worldPath)
 GameServer::~GameServer() {
     shutdown("on ~GameServer");
     BackingChunkPressure.NeedShutdown.store(true, std::memory_order_release);
+    BackingWorldShards.NeedShutdown.store(true, std::memory_order_release);
     BackingNoiseGenerator.NeedShutdown = true;
     BackingAsyncLua.NeedShutdown = true;
+    BackingLight.NeedShutdown = true;
+    BackingLuaWorkers.NeedShutdown = true;
 
     RunThread.join();
     WorkDeadline.cancel();
     UseLock.wait_no_use();
 
     BackingChunkPressure.stop();
+    BackingWorldShards.stop();
     BackingNoiseGenerator.stop();
     BackingAsyncLua.stop();
+    BackingLight.stop();
+    BackingLuaWorkers.stop();
+    BackingModReload.join();
 
     LOG.info() << "Сервер уничтожен";
 }
 
+void GameServer::BackingWorldShards_t::parallelFor(size_t count, const std::function<void(size_t)>& job) {
+    if(count == 0)
+        return;
+
+    if(!Start || count == 1 || NeedShutdown.load(std::memory_order_acquire)) {
+        for(size_t index = 0; index < count; index++)
+            job(index);
+        return;
+    }
+
+    Job = &job;
+    JobCount = count;
+    NextJob.store(0, std::memory_order_relaxed);
+    Error = nullptr;
+
+    Start->arrive_and_wait();
+    drain();
+    End->arrive_and_wait();
+
+    Job = nullptr;
+    if(Error)
+        std::rethrow_exception(std::exchange(Error, nullptr));
+}
+
+void GameServer::BackingWorldShards_t::drain() {
+    while(true) {
+        size_t index = NextJob.fetch_add(1, std::memory_order_relaxed);
+        if(index >= JobCount)
+            break;
+
+        try {
+            (*Job)(index);
+        } catch(...) {
+            std::lock_guard lock(ErrorMutex);
+            if(!Error)
+                Error = std::current_exception();
+        }
+    }
+}
+
+void GameServer::BackingWorldShards_t::run(int id) {
+    LOG.debug() << "Старт потока " << id;
+
+    while(true) {
+        // Уходя, поток снимается с обоих барьеров, чтобы не держать ни главный поток, ни остальных
+        if(NeedShutdown.load(std::memory_order_acquire)) {
+            Start->arrive_and_drop();
+            End->arrive_and_drop();
+            break;
+        }
+
+        Start->arrive_and_wait();
+        drain();
+        End->arrive_and_wait();
+    }
+
+    LOG.debug() << "Завершение выполнения потока " << id;
+}
+
 void GameServer::BackingChunkPressure_t::run(int id) {
     LOG.debug() << "Старт потока " << id;
 
@@ -532,7 +600,8 @@ void GameServer::BackingChunkPressure_t::run(int id) {
                 std::vector<std::shared_ptr<RemoteClient>> CECs, NewCECs;
                 std::unordered_map<Pos::bvec4u, std::vector<VoxelCube>> Voxels;
                 std::unordered_map<Pos::bvec4u, std::array<Node, 16*16*16>> Nodes;
-                uint64_t IsChunkChanged_Nodes, IsChunkChanged_Voxels;
+                std::unordered_map<Pos::bvec4u, ChunkLight> Light;
+                uint64_t IsChunkChanged_Nodes, IsChunkChanged_Voxels, IsChunkChanged_Light;
             };
 
             std::vector<std::pair<WorldId_t, std::vector<std::pair<Pos::GlobalRegion, Dump>>>> dump;
@@ -556,6 +625,9 @@ void GameServer::BackingChunkPressure_t::run(int id) {
                             regionObj.IsChunkChanged_Voxels = 0;
                             dumpRegion.IsChunkChanged_Nodes = regionObj.IsChunkChanged_Nodes;
                             regionObj.IsChunkChanged_Nodes = 0;
+                            // Пока свет не рассчитан, отправлять нечего
+                            dumpRegion.IsChunkChanged_Light = regionObj.LightReady ? regionObj.IsChunkChanged_Light : 0;
+                            regionObj.IsChunkChanged_Light = 0;
                             
                             if(!regionObj.NewRMs.empty()) {
                                 dumpRegion.NewCECs = std::move(regionObj.NewRMs);
@@ -568,6 +640,9 @@ void GameServer::BackingChunkPressure_t::run(int id) {
                                         auto &toPtr = dumpRegion.Nodes[Pos::bvec4u(x, y, z)];
                                         const Node *fromPtr = regionObj.Nodes[Pos::bvec4u(x, y, z).pack()].data();
                                         std::copy(fromPtr, fromPtr+16*16*16, toPtr.data());
+
+                                        if(regionObj.LightReady)
+                                            dumpRegion.Light[Pos::bvec4u(x, y, z)] = regionObj.Light[Pos::bvec4u(x, y, z).pack()];
                                     }
                             } else {
                                 if(dumpRegion.IsChunkChanged_Voxels) {
@@ -602,6 +677,18 @@ void GameServer::BackingChunkPressure_t::run(int id) {
                                 }
                             }
 
+                            // Освещение меняется и без изменения нод (сшивка, соседние правки)
+                            if(dumpRegion.IsChunkChanged_Light) {
+                                for(int index = 0; index < 64; index++) {
+                                    if(((dumpRegion.IsChunkChanged_Light >> index) & 0x1) == 0)
+                                        continue;
+
+                                    Pos::bvec4u chunkPos;
+                                    chunkPos.unpack(index);
+                                    dumpRegion.Light[chunkPos] = regionObj.Light[index];
+                                }
+                            }
+
                             if(!dumpRegion.CECs.empty()) {
                                 dumpWorld.push_back({regionPos, std::move(dumpRegion)});
                             }
@@ -673,6 +760,23 @@ void GameServer::BackingChunkPressure_t::run(int id) {
                                     }
                                 }
                             }
+
+                            for(auto& [chunkPos, chunk] : region.Light) {
+                                std::u8string cmp = compressLight(chunk);
+
+                                for(auto& ptr : region.NewCECs) {
+                                    ptr->prepareChunkUpdate_Light(worldId, regionPos, chunkPos, cmp);
+                                }
+
+                                if((region.IsChunkChanged_Light >> chunkPos.pack()) & 0x1) {
+                                    for(auto& ptr : region.CECs) {
+                                        if(std::find(region.NewCECs.begin(), region.NewCECs.end(), ptr) != region.NewCECs.end())
+                                            continue;
+
+                                        ptr->prepareChunkUpdate_Light(worldId, regionPos, chunkPos, cmp);
+                                    }
+                                }
+                            }
                         }
                     }
                 } catch(const std::exception&) {
@@ -698,25 +802,30 @@ void GameServer::BackingNoiseGenerator_t::run(int id) {
 
     try {
         while(true) {
+            uint32_t seq = Input.sequence();
+
             if(NeedShutdown) {
                 LOG.debug() << "Завершение выполнения потока " << id;
                 break;
             }
 
-            if(Input.get_read().empty())
-                TOS::Time::sleep3(50);
-
-            NoiseKey key;
+            std::optional<NoiseKey> next = Input.tryPop();
+            while(!next) {
+                next = PrefetchInput.tryPop();
+                if(!next || takePrefetch(*next))
+                    break;
 
-            {
-                auto lock = Input.lock();
-                if(lock->empty())
-                    continue;
+                // Перенесён в Input через promote
+                next.reset();
+            }
 
-                key = lock->front();
-                lock->pop();
+            if(!next) {
+                Input.wait(seq);
+                continue;
             }
 
+            NoiseKey key = *next;
+
             Pos::GlobalNode posNode = key.RegionPos;
             posNode <<= 6;
 
@@ -732,7 +841,7 @@ void GameServer::BackingNoiseGenerator_t::run(int id) {
             //         //*ptr = std::pow(*ptr, 0.75f)*1.5f;
             //     }
 
-            Output.lock()->push_back({key, std::move(data)});
+            Output.emplace(key, std::move(data));
         }
     } catch(const std::exception& exc) {
         NeedShutdown = true;
@@ -741,202 +850,190 @@ void GameServer::BackingNoiseGenerator_t::run(int id) {
 
 }
 
-void GameServer::BackingAsyncLua_t::run(int id) {
+void GameServer::BackingLight_t::run(int id) {
     LOG.debug() << "Старт потока " << id;
 
-    BackingNoiseGenerator_t::NoiseKey key;
-    std::array<float, 64*64*64> noise;
-    World::RegionIn out;
-
     try {
         while(true) {
+            uint32_t seq = Input.sequence();
+
             if(NeedShutdown) {
                 LOG.debug() << "Завершение выполнения потока " << id;
                 break;
             }
 
-            if(NoiseIn.get_read().empty())
-                TOS::Time::sleep3(50);
+            std::optional<Job> job = Input.tryPop();
+            if(!job) {
+                Input.wait(seq);
+                continue;
+            }
 
-            {
-                auto lock = NoiseIn.lock();
-                if(lock->empty())
-                    continue;
+            auto light = std::make_unique<RegionLight>();
+            LightEngine::computeRegion(*job->Nodes, job->Table.get(), *light);
+            Output.emplace(job->WId, job->RegionPos, job->JobId, std::move(light));
+        }
+    } catch(const std::exception& exc) {
+        NeedShutdown = true;
+        LOG.error() << "Ошибка выполнения потока " << id << ":\n" << exc.what();
+    }
+}
 
-                key = lock->front().first;
-                noise = lock->front().second;
-                lock->pop();
-            }
+// Сообщает объём кучи состояния потока и по запросу MemoryGovernor собирает мусор
+static void accountLuaHeap(sol::state& lua, std::atomic<size_t>& total, size_t& reported,
+    const std::atomic<uint32_t>& gcRequests, uint32_t& gcSeen)
+{
+    if(uint32_t requests = gcRequests.load(std::memory_order_relaxed); requests != gcSeen) {
+        gcSeen = requests;
+        lua_gc(lua.lua_state(), LUA_GCCOLLECT, 0);
+    }
 
-            out.Voxels.clear();
-            out.Entityes.clear();
+    size_t bytes = MemoryGovernor::luaHeapBytes(lua.lua_state());
+    total.fetch_add(bytes - reported, std::memory_order_relaxed);
+    reported = bytes;
+}
 
-            auto lru = CM.createLRU();
+void GameServer::BackingLuaWorkers_t::run(int id) {
+    LOG.debug() << "Старт потока " << id;
 
-            {
-                DefNodeId kNodeAir = 0;
-                DefNodeId kNodeGrass = lru.getIdNode("test", "grass");
-                uint8_t kMetaGrass = 1;
-                DefNodeId kNodeDirt = lru.getIdNode("test", "dirt");
-                DefNodeId kNodeStone = lru.getIdNode("test", "stone");
-                DefNodeId kNodeWood = lru.getIdNode("test", "log");
-                DefNodeId kNodeLeaves = lru.getIdNode("test", "leaves");
-                DefNodeId kNodeLava = lru.getIdNode("test", "lava");
-                DefNodeId kNodeWater = lru.getIdNode("test", "water");
-                DefNodeId kNodeFire = lru.getIdNode("test", "fire");
-
-                auto hash32 = [](uint32_t x) {
-                    x ^= x >> 16;
-                    x *= 0x7feb352dU;
-                    x ^= x >> 15;
-                    x *= 0x846ca68bU;
-                    x ^= x >> 16;
-                    return x;
-                };
+    // Собственное состояние потока, скрипт воркера возвращает функцию handler(message) -> message.
+    // Воркер с ошибкой в скрипте отключается, его задачи завершаются ошибкой, остальные работают
+    sol::state lua;
+    std::vector<std::optional<sol::protected_function>> handlers;
+    std::vector<std::string> handlerErrors;
+    size_t luaReported = 0;
+    uint32_t luaGcSeen = 0;
 
-                Pos::GlobalNode regionBase = key.RegionPos;
-                regionBase <<= 6;
-
-                std::array<int, 64*64> heights;
-                for(int z = 0; z < 64; z++) {
-                    for(int x = 0; x < 64; x++) {
-                        int32_t gx = regionBase.x + x;
-                        int32_t gz = regionBase.z + z;
-                        float fx = float(gx);
-                        float fz = float(gz);
-
-                        float base = glm::perlin(glm::vec2(fx * 0.005f, fz * 0.005f));
-                        float detail = glm::perlin(glm::vec2(fx * 0.02f, fz * 0.02f)) * 0.35f;
-                        float ridge = glm::perlin(glm::vec2(fx * 0.0015f, fz * 0.0015f));
-                        float ridged = 1.f - std::abs(ridge);
-                        float mountains = ridged * ridged;
-                        float noiseDetail = noise[(z * 64) + x];
-
-                        float height = 18.f + (base + detail) * 8.f + mountains * 32.f + noiseDetail * 3.f;
-                        int h = std::clamp<int>(int(height + 0.5f), -256, 256);
-                        heights[z * 64 + x] = h;
-                    }
+    try {
+        lua.open_libraries();
+
+        for(const std::shared_ptr<const ModScript>& script : Scripts) {
+            std::string error;
+
+            try {
+                sol::load_result chunk = lua.load(script->Source, "@" + script->Name);
+                if(!chunk.valid()) {
+                    sol::error err = chunk;
+                    MAKE_ERROR("Ошибка загрузки воркера мода " << script->ModId << ":\n" << err.what());
                 }
 
-                for(int z = 0; z < 64; z++) {
-                    for(int x = 0; x < 64; x++) {
-                        int surface = heights[z * 64 + x];
-                        int32_t gx = regionBase.x + x;
-                        int32_t gz = regionBase.z + z;
-                        uint32_t seed = hash32(uint32_t(gx) * 73856093u ^ uint32_t(gz) * 19349663u);
-
-                        for(int y = 0; y < 64; y++) {
-                            int32_t gy = regionBase.y + y;
-                            Pos::bvec64u nodePos(x, y, z);
-                            auto &node = out.Nodes[Pos::bvec4u(nodePos >> 4).pack()][Pos::bvec16u(nodePos & 0xf).pack()];
-
-                            if(gy <= surface) {
-                                if(gy == surface) {
-                                    node.NodeId = kNodeGrass;
-                                    node.Meta = kMetaGrass;
-                                } else if(gy >= surface - 3) {
-                                    node.NodeId = kNodeDirt;
-                                    node.Meta = uint8_t((seed + gy) & 0x3);
-                                } else {
-                                    node.NodeId = kNodeStone;
-                                    node.Meta = uint8_t((seed + gy + 1) & 0x3);
-                                }
-                            } else {
-                                node.Data = kNodeAir;
-                            }
-                        }
-                    }
+                sol::protected_function_result result = chunk.get<sol::protected_function>()();
+                if(!result.valid()) {
+                    sol::error err = result;
+                    MAKE_ERROR("Ошибка инициализации воркера мода " << script->ModId << ":\n" << err.what());
                 }
 
-                auto setNode = [&](int x, int y, int z, DefNodeId id, uint8_t meta, bool onlyAir) {
-                    if(x < 0 || x >= 64 || y < 0 || y >= 64 || z < 0 || z >= 64)
-                        return;
+                std::optional<sol::protected_function> handler = result.get<std::optional<sol::protected_function>>();
+                if(!handler)
+                    MAKE_ERROR("Воркер " << script->Name << " должен вернуть функцию");
 
-                    Pos::bvec64u nodePos(x, y, z);
-                    auto &node = out.Nodes[Pos::bvec4u(nodePos >> 4).pack()][Pos::bvec16u(nodePos & 0xf).pack()];
-                    if(onlyAir && node.Data != 0)
-                        return;
+                handlers.push_back(std::move(handler));
+            } catch(const std::exception& exc) {
+                error = exc.what();
+                handlers.push_back(std::nullopt);
+            }
 
-                    node.NodeId = id;
-                    node.Meta = meta;
-                };
+            // Скрипт одинаков во всех потоках, сообщает только первый
+            if(!error.empty() && id == 0)
+                LOG.error() << "Воркер " << script->Name << " отключён:\n" << error;
 
-                for(int z = 1; z < 63; z++) {
-                    for(int x = 1; x < 63; x++) {
-                        int surface = heights[z * 64 + x];
-                        int localY = surface - regionBase.y;
-                        if(localY < 1 || localY >= 63)
-                            continue;
-
-                        int32_t gx = regionBase.x + x;
-                        int32_t gz = regionBase.z + z;
-                        uint32_t seed = hash32(uint32_t(gx) * 83492791u ^ uint32_t(gz) * 2971215073u);
-
-                        int treeHeight = 4 + int(seed % 3);
-                        if(localY + treeHeight + 2 >= 64)
-                            continue;
-
-                        if((seed % 97) >= 2)
-                            continue;
-
-                        int diff = surface - heights[z * 64 + (x - 1)];
-                        if(diff > 2 || diff < -2)
-                            continue;
-                        diff = surface - heights[z * 64 + (x + 1)];
-                        if(diff > 2 || diff < -2)
-                            continue;
-                        diff = surface - heights[(z - 1) * 64 + x];
-                        if(diff > 2 || diff < -2)
-                            continue;
-                        diff = surface - heights[(z + 1) * 64 + x];
-                        if(diff > 2 || diff < -2)
-                            continue;
-
-                        uint8_t woodMeta = uint8_t((seed >> 2) & 0x3);
-                        uint8_t leafMeta = uint8_t((seed >> 4) & 0x3);
-
-                        for(int i = 1; i <= treeHeight; i++) {
-                            setNode(x, localY + i, z, kNodeWood, woodMeta, false);
-                        }
+            handlerErrors.push_back(std::move(error));
+        }
 
-                        int topY = localY + treeHeight;
-                        for(int dy = -2; dy <= 2; dy++) {
-                            for(int dz = -2; dz <= 2; dz++) {
-                                for(int dx = -2; dx <= 2; dx++) {
-                                    int dist2 = dx * dx + dz * dz + dy * dy;
-                                    if(dist2 > 5)
-                                        continue;
+        while(true) {
+            uint32_t seq = Input.sequence();
 
-                                    setNode(x + dx, topY + dy, z + dz, kNodeLeaves, leafMeta, true);
-                                }
-                            }
-                        }
-                    }
+            if(NeedShutdown) {
+                LOG.debug() << "Завершение выполнения потока " << id;
+                break;
+            }
+
+            std::optional<Job> job = Input.tryPop();
+            if(!job) {
+                Input.wait(seq);
+                continue;
+            }
+
+            Result out{job->Id, false, {}, {}};
+
+            // Ошибка обработчика или непередаваемый ответ уходят вызвавшему, поток продолжает работу
+            try {
+                if(!handlers.at(job->Worker))
+                    MAKE_ERROR("Воркер отключён: " << handlerErrors[job->Worker]);
+
+                sol::protected_function_result result = (*handlers[job->Worker])(job->Message.toLua(lua));
+                if(result.valid()) {
+                    out.Message = LuaMessage::fromLua(result.get<sol::object>());
+                    out.Ok = true;
+                } else {
+                    sol::error err = result;
+                    out.Error = err.what();
                 }
+            } catch(const std::exception& exc) {
+                out.Error = exc.what();
+            }
 
-                if(regionBase.x == 0 && regionBase.z == 0) {
-                    constexpr int kTestGlobalY = 64;
-                    if(regionBase.y <= kTestGlobalY && (regionBase.y + 63) >= kTestGlobalY) {
-                        int localY = kTestGlobalY - regionBase.y;
-                        setNode(7, localY, 2, kNodeLava, 0, false);
-                        setNode(8, localY, 2, kNodeWater, 0, false);
-                        setNode(9, localY, 2, kNodeFire, 0, false);
-                    }
+            Output.push(std::move(out));
+            accountLuaHeap(lua, LuaBytes, luaReported, LuaGcRequests, luaGcSeen);
+        }
+    } catch(const std::exception& exc) {
+        NeedShutdown = true;
+        LOG.error() << "Ошибка выполнения потока " << id << ":\n" << exc.what();
+    }
+
+    LuaBytes.fetch_sub(luaReported, std::memory_order_relaxed);
+}
+
+void GameServer::BackingAsyncLua_t::run(int id) {
+    LOG.debug() << "Старт потока " << id;
+
+    BackingNoiseGenerator_t::NoiseKey key;
+    std::array<float, 64*64*64> noise;
+    World::RegionIn out;
+
+    // Собственное состояние LuaJIT потока и загруженные в него генераторы
+    LuaRegionGenerator lua(CM);
+    size_t luaReported = 0;
+    uint32_t luaGcSeen = 0;
+
+    try {
+        if(!Generators.empty())
+            lua.init();
+
+        while(true) {
+            uint32_t seq = NoiseIn.sequence();
+
+            if(NeedShutdown) {
+                LOG.debug() << "Завершение выполнения потока " << id;
+                break;
+            }
+
+            {
+                auto next = NoiseIn.tryPop();
+                if(!next) {
+                    NoiseIn.wait(seq);
+                    continue;
                 }
-            } 
-            // else {
-            //     Node *ptr = (Node*) &out.Nodes[0][0];
-            //     Node node;
-            //     node.Data = 0;
-            //     std::fill(ptr, ptr+64*64*64, node);
-            // }
 
-            RegionOut.lock()->push_back({key, out});
+                key = next->first;
+                noise = next->second;
+            }
+
+            out.Voxels.clear();
+            out.Entityes.clear();
+
+            auto iterGenerator = Generators.find(key.WId);
+            if(iterGenerator == Generators.end() || !lua.generate(key.WId, *iterGenerator->second, key.RegionPos, noise, out))
+                generateRegionNative(CM, key.RegionPos, noise, out);
+
+            RegionOut.emplace(key, out);
+            accountLuaHeap(lua.state(), LuaBytes, luaReported, LuaGcRequests, luaGcSeen);
         }
     } catch(const std::exception& exc) {
         NeedShutdown = true;
         LOG.error() << "Ошибка выполнения потока " << id << ":\n" << exc.what();
     }
+
+    LuaBytes.fetch_sub(luaReported, std::memory_order_relaxed);
 }
 
 static thread_local std::vector<ContentViewCircle> TL_Circles;
@@ -1179,6 +1276,7 @@ void GameServer::init(fs::path worldPath) {
 
     fs::create_directories(worldPath);
     fs::path worldJson = worldPath / "world.json";
+    LuaProfilePath = worldPath / "lua_profile.folded";
 
     LOG.info() << "Обработка файла " << worldJson.string();
 
@@ -1219,6 +1317,23 @@ void GameServer::init(fs::path worldPath) {
                 sbModStorage = sb.at("mod_storage").as_object();
             }
 
+            // "memory": {"budget_mb": 4096, "soft": 0.8, "hard": 0.95, "cold_mb": 64}
+            if(auto iter = obj.find("memory"); iter != obj.end()) {
+                const js::object& memory = iter->value().as_object();
+                MemoryGovernor::Config config;
+                if(auto budget = memory.find("budget_mb"); budget != memory.end())
+                    config.Budget = size_t(budget->value().to_number<uint64_t>()) << 20;
+                if(auto soft = memory.find("soft"); soft != memory.end())
+                    config.SoftWatermark = float(soft->value().to_number<double>());
+                if(auto hard = memory.find("hard"); hard != memory.end())
+                    config.HardWatermark = float(hard->value().to_number<double>());
+
+                Memory.setConfig(config);
+
+                if(auto cold = memory.find("cold_mb"); cold != memory.end())
+                    ColdRegionBudget = size_t(cold->value().to_number<uint64_t>()) << 20;
+            }
+
             {
                 js::array arr = obj.at("mods").as_array();
                 for(const js::value& v : arr) {
@@ -1308,31 +1423,9 @@ void GameServer::init(fs::path worldPath) {
     LuaMainState.open_libraries();
 	LuaMainState.set_exception_handler(&my_exception_handler);
 
-    for(const ModInfo& info : mlt.LoadChain) {
-        LOG.info() << info.Id;
-        CurrentModId = info.Id;
-        sol::load_result res = LuaMainState.load_file(info.Path / "init.lua");
-        ModInstances.emplace_back(info.Id, res.call<sol::table>());
-    }
+    loadModInstances();
 
-    std::function<void(const std::string&)> pushEvent = [&](const std::string& function) {
-        for(auto& [id, core] : ModInstances) {
-            std::optional<sol::protected_function> func = core.get<std::optional<sol::protected_function>>(function);
-            if(func) {
-                sol::protected_function_result result;
-                try {
-                    result = func->operator()();
-                } catch(const std::exception &exc) {
-                    MAKE_ERROR("Ошибка инициализации мода " << id << ":\n" << exc.what());
-                }
-
-                if(!result.valid()) {
-                    sol::error err = result;
-                    MAKE_ERROR("Ошибка инициализации мода " << id << ":\n" << err.what());
-                }
-            }
-        }
-    };
+    auto pushEvent = [this](const std::string& function) { pushModEvent(function); };
 
     initLuaAssets();
     pushEvent("initAssets");
@@ -1340,6 +1433,8 @@ void GameServer::init(fs::path worldPath) {
         AssetsInit.Assets.push_back(mlt.LoadChain[index].Path / "assets");
     }
 
+    Content.AM.setManifestPath(worldPath / "assets_manifest.bin");
+    Content.AM.setPackPath(worldPath / "assets.pack");
     auto capru = Content.AM.checkAndPrepareResourcesUpdate(AssetsInit);
     Content.AM.applyResourcesUpdate(capru);
 
@@ -1362,6 +1457,8 @@ void GameServer::init(fs::path worldPath) {
     pushEvent("highPreInit");
 
     Content.CM.buildEndProfiles();
+    // Регистрация завершена: таблицы идентификаторов публикуются для чтения без блокировок
+    Content.CM.bake();
 
     LOG.info() << "Инициализация";
     initLua();
@@ -1375,7 +1472,14 @@ void GameServer::init(fs::path worldPath) {
     // Загрузить миры с существующими профилями
     LOG.info() << "Загрузка существующих миров...";
 
-    Expanse.Worlds[0] = std::make_unique<World>(0);
+    Expanse.Worlds[0] = std::make_unique<World>(Content.CM.getId(EnumDefContent::World, "test", "devel_world"));
+    Expanse.Worlds[0]->setRandomTickFilter(&NodeTickHandlers.RandomTickable);
+    Expanse.Worlds[0]->setParallelFor([this](size_t count, const std::function<void(size_t)>& job) {
+        BackingWorldShards.parallelFor(count, job);
+    });
+    Expanse.Worlds[0]->setNodeLightTable(&NodeLightTable);
+    Expanse.Worlds[0]->setNodeFluidTable(&NodeFluidTable);
+    Expanse.Worlds[0]->setColdBudget(ColdRegionBudget);
 
     LOG.info() << "Оповещаем моды о завершении загрузки";
     pushEvent("serverReady");
@@ -1388,19 +1492,113 @@ void GameServer::init(fs::path worldPath) {
         BackingChunkPressure.Threads[iter] = std::thread(&BackingChunkPressure_t::run, &BackingChunkPressure, iter);
     }
 
+    // Главный поток тоже разбирает шарды, поэтому пул на один поток меньше ядер
+    BackingWorldShards.Threads.resize(std::clamp<size_t>(std::thread::hardware_concurrency(), 2, 9) - 1);
+    BackingWorldShards.init(BackingWorldShards.Threads.size());
+    for(size_t iter = 0; iter < BackingWorldShards.Threads.size(); iter++) {
+        BackingWorldShards.Threads[iter] = std::thread(&BackingWorldShards_t::run, &BackingWorldShards, iter);
+    }
+
     BackingNoiseGenerator.Threads.resize(4);
     for(size_t iter = 0; iter < BackingNoiseGenerator.Threads.size(); iter++) {
         BackingNoiseGenerator.Threads[iter] = std::thread(&BackingNoiseGenerator_t::run, &BackingNoiseGenerator, iter);
     }
 
-    BackingAsyncLua.Threads.resize(1);
+    for(auto& [worldId, world] : Expanse.Worlds) {
+        auto iterGenerator = WorldGenerators.find(world->getDefId());
+        if(iterGenerator != WorldGenerators.end())
+            BackingAsyncLua.Generators[worldId] = iterGenerator->second;
+    }
+
+    // У каждого потока своё состояние LuaJIT, генерация регионов идёт параллельно
+    BackingAsyncLua.Threads.resize(4);
     for(size_t iter = 0; iter < BackingAsyncLua.Threads.size(); iter++) {
         BackingAsyncLua.Threads[iter] = std::thread(&BackingAsyncLua_t::run, &BackingAsyncLua, iter);
     }
 
+    // Каждый поток загружает все воркеры, задания раздаются любому свободному
+    if(!BackingLuaWorkers.Scripts.empty()) {
+        BackingLuaWorkers.Threads.resize(2);
+        for(size_t iter = 0; iter < BackingLuaWorkers.Threads.size(); iter++) {
+            BackingLuaWorkers.Threads[iter] = std::thread(&BackingLuaWorkers_t::run, &BackingLuaWorkers, iter);
+        }
+    }
+
+    NodeLightShared = std::make_shared<const std::vector<NodeLightInfo>>(NodeLightTable);
+    BackingLight.Threads.resize(2);
+    for(size_t iter = 0; iter < BackingLight.Threads.size(); iter++) {
+        BackingLight.Threads[iter] = std::thread(&BackingLight_t::run, &BackingLight, iter);
+    }
+
     RunThread = std::thread(&GameServer::prerun, this);
 }
 
+void GameServer::loadModInstances(const std::vector<std::string>* chunks) {
+    ModInstances.clear();
+
+    for(size_t index = 0; index < LoadedMods.size(); index++) {
+        const ModInfo& info = LoadedMods[index];
+        LOG.info() << info.Id;
+        CurrentModId = info.Id;
+        const fs::path path = info.Path / "init.lua";
+        sol::load_result res = chunks
+            ? LuaMainState.load(std::string_view((*chunks)[index]), "@" + path.string(), sol::load_mode::binary)
+            : LuaMainState.load_file(path.string());
+        ModInstances.emplace_back(info.Id, res.call<sol::table>());
+    }
+}
+
+void GameServer::pushModEvent(const std::string& function, std::vector<std::string>* failed) {
+    for(auto& [id, core] : ModInstances) {
+        if(failed && std::find(failed->begin(), failed->end(), id) != failed->end())
+            continue;
+
+        std::optional<sol::protected_function> func = core.get<std::optional<sol::protected_function>>(function);
+        if(func) {
+            // Регистрации внутри события относятся к этому моду
+            CurrentModId = id;
+
+            std::string error;
+            try {
+                sol::protected_function_result result = LuaTasks.call(id, *func);
+                if(!result.valid()) {
+                    sol::error err = result;
+                    error = err.what();
+                }
+            } catch(const std::exception &exc) {
+                error = exc.what();
+            }
+
+            if(error.empty())
+                continue;
+
+            if(!failed)
+                MAKE_ERROR("Ошибка инициализации мода " << id << ":\n" << error);
+
+            LOG.error() << "Ошибка инициализации мода " << id << ", мод отключается:\n" << error;
+            failed->push_back(id);
+        }
+    }
+}
+
+void GameServer::disableMod(const std::string& modId) {
+    std::erase_if(ModInstances, [&](const auto& instance) { return instance.first == modId; });
+
+    for(size_t nodeId = 0; nodeId < NodeTickHandlers.ModId.size(); nodeId++) {
+        if(NodeTickHandlers.ModId[nodeId] != modId)
+            continue;
+
+        NodeTickHandlers.OnTimer[nodeId].reset();
+        NodeTickHandlers.OnRandomTick[nodeId].reset();
+        NodeTickHandlers.RandomTickable[nodeId] = 0;
+    }
+
+    // Результаты уже отправленных задач доставлять некому
+    for(auto& [postId, post] : LuaPosts)
+        if(post.ModId == modId)
+            post.Callback.reset();
+}
+
 void GameServer::prerun() {
     try {
         auto useLock = UseLock.lock();
@@ -1460,6 +1658,7 @@ void GameServer::run() {
 
         stepConnections();
         stepModInitializations();
+        stepMemoryGovernor();
         IWorldSaveBackend::TickSyncInfo_Out dat1;
         try {
             dat1 = stepDatabaseSync();
@@ -1469,6 +1668,7 @@ void GameServer::run() {
             LOG.error() << "Неизвестная ошибка stepDatabaseSync";
         }
         stepGeneratorAndLuaAsync(std::move(dat1));
+        stepLighting();
         stepPlayerProceed();
         stepWorldPhysic();
         stepGlobalStep();
@@ -1477,7 +1677,10 @@ void GameServer::run() {
         // Прочие моменты
         if(!IsGoingShutdown) {
             if(BackingChunkPressure.NeedShutdown
-                || BackingNoiseGenerator.NeedShutdown)
+                || BackingNoiseGenerator.NeedShutdown
+                || BackingAsyncLua.NeedShutdown
+                || BackingLight.NeedShutdown
+                || BackingLuaWorkers.NeedShutdown)
             {
                 LOG.error() << "Ошибка работы одного из модулей";
                 IsGoingShutdown = true;
@@ -1557,10 +1760,15 @@ void GameServer::initLuaPre() {
         }
         
         auto &result = *result_o;
-        if(result[1])
-            Content.CM.registerBase(type, *result[1], *result[2], profile);
-        else
-            Content.CM.registerBase(type, CurrentModId, *result[2], profile);
+        const std::string& domain = result[1] ? *result[1] : CurrentModId;
+        Content.CM.registerBase(type, domain, *result[2], profile);
+
+        if(type == EnumDefContent::Node) {
+            DefNodeId id = Content.CM.getId(type, domain, *result[2]);
+            bindNodeTickHandlers(id, profile);
+            bindNodeLight(id, profile);
+            bindNodeFluid(id, profile);
+        }
     };
 
     core.set_function("register_voxel",    [reg](const std::string& key, const sol::table& profile) { reg(EnumDefContent::Voxel, key, profile); });
@@ -1569,6 +1777,61 @@ void GameServer::initLuaPre() {
     core.set_function("register_portal",   [reg](const std::string& key, const sol::table& profile) { reg(EnumDefContent::Portal, key, profile); });
     core.set_function("register_entity",   [reg](const std::string& key, const sol::table& profile) { reg(EnumDefContent::Entity, key, profile); });
     core.set_function("register_item",     [reg](const std::string& key, const sol::table& profile) { reg(EnumDefContent::Item, key, profile); });
+
+    // core.register_generator(world, "worldgen.lua"): скрипт из папки мода, исполняется в потоках генерации
+    core.set_function("register_generator", [this](const std::string& world, const std::string& path) {
+        std::optional<std::vector<std::optional<std::string>>> result_o = TOS::Str::match(world, "^(?:([\\w\\d_]+):)?([\\w\\d_]+)$");
+        if(!result_o)
+            MAKE_ERROR("Недействительный идентификатор: " << world);
+
+        auto& result = *result_o;
+        const std::string& domain = result[1] ? *result[1] : CurrentModId;
+
+        WorldGenerators[Content.CM.getId(EnumDefContent::World, domain, *result[2])] = loadModScript(path);
+    });
+
+    // core.register_worker(name, "worker.lua"): скрипт возвращает функцию handler(message) -> message,
+    // исполняется в потоках воркеров, вызывается через core.post
+    core.set_function("register_worker", [this](const std::string& name, const std::string& path) {
+        std::optional<std::vector<std::optional<std::string>>> result_o = TOS::Str::match(name, "^(?:([\\w\\d_]+):)?([\\w\\d_]+)$");
+        if(!result_o)
+            MAKE_ERROR("Недействительный идентификатор: " << name);
+
+        auto& result = *result_o;
+        const std::string key = (result[1] ? *result[1] : CurrentModId) + ":" + *result[2];
+
+        // Потоки воркеров загрузили скрипты при старте, заменить их на ходу нельзя
+        if(ModsReloading) {
+            auto iterWorker = LuaWorkerNames.find(key);
+            if(iterWorker == LuaWorkerNames.end() || BackingLuaWorkers.Scripts[iterWorker->second]->Source != loadModScript(path)->Source)
+                LOG.warn() << "Изменения воркера " << key << " вступят в силу после перезапуска сервера";
+
+            return;
+        }
+
+        if(LuaWorkerNames.contains(key))
+            MAKE_ERROR("Воркер " << key << " уже зарегистрирован");
+
+        LuaWorkerNames[key] = BackingLuaWorkers.Scripts.size();
+        BackingLuaWorkers.Scripts.push_back(loadModScript(path));
+    });
+}
+
+std::shared_ptr<const ModScript> GameServer::loadModScript(const std::string& path) {
+    auto iterMod = std::find_if(LoadedMods.begin(), LoadedMods.end(), [&](const ModInfo& info) { return info.Id == CurrentModId; });
+    if(iterMod == LoadedMods.end())
+        MAKE_ERROR("Скрипт " << path << " можно зарегистрировать только из мода");
+
+    fs::path file = iterMod->Path / path;
+    std::ifstream stream(file, std::ios::binary);
+    if(!stream)
+        MAKE_ERROR("Не удалось открыть скрипт " << file);
+
+    auto script = std::make_shared<ModScript>();
+    script->ModId = CurrentModId;
+    script->Name = CurrentModId + "/" + path;
+    script->Source.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    return script;
 }
 
 void GameServer::initLua() {
@@ -1580,10 +1843,121 @@ void GameServer::initLua() {
         luaL_error(L.lua_state(), "Данная функция может использоваться только в стадии [preInit]");
     };
 
-    for(const char* name : {"register_voxel", "register_node", "register_world", "register_portal", "register_entity", "register_item"})
+    for(const char* name : {"register_voxel", "register_node", "register_world", "register_portal", "register_entity", "register_item", "register_generator", "register_worker"})
         core.set_function(name, lambdaError);
 
-    
+    // Запланированные такты нод: core.schedule_node_tick(world, x, y, z, delay) -> bool
+    core.set_function("schedule_node_tick", [this](WorldId_t worldId, int32_t x, int32_t y, int32_t z, uint32_t delay) -> bool {
+        auto iterWorld = Expanse.Worlds.find(worldId);
+        if(iterWorld == Expanse.Worlds.end())
+            return false;
+
+        return iterWorld->second->scheduleNodeTick(Pos::GlobalNode(x, y, z), delay);
+    });
+
+    core.set_function("cancel_node_tick", [this](WorldId_t worldId, int32_t x, int32_t y, int32_t z) -> bool {
+        auto iterWorld = Expanse.Worlds.find(worldId);
+        if(iterWorld == Expanse.Worlds.end())
+            return false;
+
+        return iterWorld->second->cancelNodeTick(Pos::GlobalNode(x, y, z));
+    });
+
+    // core.spawn(fn) -> id: сопрограмма мода, возобновляется каждый такт в пределах бюджета
+    core.set_function("spawn", [this](sol::protected_function func) -> uint32_t {
+        return LuaTasks.spawn(luaCurrentMod(), std::move(func));
+    });
+
+    core.set_function("cancel_task", [this](uint32_t id) -> bool {
+        return LuaTasks.cancel(id);
+    });
+
+    // core.post(worker, message, callback): callback(result, error) вызывается на одном из следующих тактов
+    core.set_function("post", [this](const std::string& name, sol::object message, sol::optional<sol::protected_function> callback) {
+        const std::string key = name.find(':') == std::string::npos ? luaCurrentMod() + ":" + name : name;
+        auto iterWorker = LuaWorkerNames.find(key);
+        if(iterWorker == LuaWorkerNames.end())
+            MAKE_ERROR("Неизвестный воркер: " << key);
+
+        uint64_t id = NextLuaPostId++;
+        BackingLuaWorkers.Input.emplace(id, iterWorker->second, LuaMessage::fromLua(message));
+        LuaPosts[id] = {luaCurrentMod(), callback ? std::optional<sol::protected_function>(*callback) : std::nullopt};
+    });
+
+    // core.mod_stats() -> {[mod] = {time_ms, calls, resumes, preemptions, errors}}
+    core.set_function("mod_stats", [this](sol::this_state L) -> sol::table {
+        sol::state_view lua(L);
+        sol::table out = lua.create_table();
+        for(const auto& [modId, stats] : LuaTasks.stats()) {
+            out[modId] = lua.create_table_with(
+                "time_ms", std::chrono::duration<double, std::milli>(stats.Time).count(),
+                "calls", stats.Calls,
+                "resumes", stats.Resumes,
+                "preemptions", stats.Preemptions,
+                "errors", stats.Errors
+            );
+        }
+
+        return out;
+    });
+
+    // core.prefetch_stats() -> {requested, hits, late, wasted, pending, hit_rate}
+    core.set_function("prefetch_stats", [this](sol::this_state L) -> sol::table {
+        sol::state_view lua(L);
+        const RegionPrefetch::Metrics& metrics = Prefetch.metrics();
+
+        return lua.create_table_with(
+            "requested", metrics.Requested,
+            "hits", metrics.Hits,
+            "late", metrics.Late,
+            "wasted", metrics.Wasted,
+            "pending", Prefetch.pendingCount(),
+            "hit_rate", Prefetch.hitRate()
+        );
+    });
+
+    // core.memory_stats() -> {budget, total, peak, pressure, subsystems = {[name] = bytes}, ...}
+    core.set_function("memory_stats", [this](sol::this_state L) -> sol::table {
+        sol::state_view lua(L);
+        const MemoryGovernor::Metrics& metrics = Memory.metrics();
+
+        sol::table subsystems = lua.create_table();
+        for(size_t iter = 0; iter < metrics.Bytes.size(); iter++)
+            subsystems[MemoryGovernor::name(MemoryGovernor::EnumSubsystem(iter))] = metrics.Bytes[iter];
+
+        sol::table out = lua.create_table_with(
+            "budget", Memory.config().Budget,
+            "total", metrics.Total,
+            "peak", metrics.Peak,
+            "pressure", MemoryGovernor::name(Memory.pressure()),
+            "evicted_regions", metrics.EvictedRegions,
+            "deferred_loads", metrics.DeferredLoads,
+            "soft_events", metrics.SoftEvents,
+            "hard_events", metrics.HardEvents,
+            "lua_collections", metrics.LuaCollections
+        );
+        out["subsystems"] = subsystems;
+
+        World::ColdStats cold;
+        for(const auto& [worldId, world] : Expanse.Worlds) {
+            const World::ColdStats& stats = world->getColdStats();
+            cold.Bytes += stats.Bytes;
+            cold.Count += stats.Count;
+            cold.Demotions += stats.Demotions;
+            cold.Promotions += stats.Promotions;
+            cold.Dropped += stats.Dropped;
+        }
+
+        out["cold"] = lua.create_table_with(
+            "bytes", cold.Bytes,
+            "regions", cold.Count,
+            "demotions", cold.Demotions,
+            "promotions", cold.Promotions,
+            "dropped", cold.Dropped
+        );
+
+        return out;
+    });
 }
 
 void GameServer::initLuaPost() {
@@ -1597,6 +1971,10 @@ void GameServer::requestModsReload() {
     }
 }
 
+void GameServer::requestLuaProfilerToggle() {
+    LuaProfilerToggleRequested = true;
+}
+
 void GameServer::stepConnections() {
     std::vector<std::shared_ptr<RemoteClient>> newClients;
     // Подключить новых игроков
@@ -1675,52 +2053,299 @@ void GameServer::stepConnections() {
         Game.RemoteClients.end());
 }
 
+void GameServer::stepMemoryGovernor() {
+    if(Game.Tick % MemoryGovernor::CHECK_TICKS != 0)
+        return;
+
+    using Subsystem = MemoryGovernor::EnumSubsystem;
+
+    // Копии таблиц идентификаторов, заменённые при bake() на занятых читателях
+    Content.CM.reclaim();
+    Content.AM.reclaim();
+
+    size_t regionsBytes = 0, regionsCount = 0;
+    for(auto& [worldId, world] : Expanse.Worlds) {
+        regionsBytes += world->getMemoryUsage();
+        regionsCount += world->getRegionCount();
+    }
+
+    size_t sendBytes = 0, networkBytes = 0;
+    for(const std::shared_ptr<RemoteClient>& remoteClient : Game.RemoteClients) {
+        if(!remoteClient)
+            continue;
+
+        sendBytes += remoteClient->getSendCacheBytes();
+        networkBytes += remoteClient->getNetworkBytes();
+    }
+
+    Memory.report(Subsystem::Regions, regionsBytes);
+    Memory.report(Subsystem::SendCaches, sendBytes);
+    Memory.report(Subsystem::Assets, Content.AM.getResourcesBytes());
+    Memory.report(Subsystem::Lua, MemoryGovernor::luaHeapBytes(LuaMainState.lua_state())
+        + BackingAsyncLua.LuaBytes.load(std::memory_order_relaxed)
+        + BackingLuaWorkers.LuaBytes.load(std::memory_order_relaxed));
+    Memory.report(Subsystem::Network, networkBytes);
+
+    if(Memory.update() == MemoryGovernor::EnumPressure::None)
+        return;
+
+    // Сначала отдаёт холодный ярус: его копии и так есть в хранилище
+    size_t excess = Memory.excess();
+    for(auto& [worldId, world] : Expanse.Worlds) {
+        size_t cold = world->getColdStats().Bytes;
+        size_t trim = std::min(cold, excess);
+        world->trimCold(cold - trim);
+        excess -= trim;
+    }
+
+    // Регионов на выгрузку столько, сколько в среднем покрывает оставшееся превышение
+    if(regionsCount && excess) {
+        size_t average = std::max<size_t>(regionsBytes / regionsCount, 1);
+        size_t count = std::min<size_t>((excess + average - 1) / average, 64);
+        for(auto& [worldId, world] : Expanse.Worlds)
+            world->requestEviction(count);
+    }
+
+    /*
+        Кэши отправки не вытесняются: это уже обещанные игрокам чанки, pushPreparedPackets
+        сбрасывает их в сокет каждый такт, без них у клиента останутся дыры до повторного входа в регион.
+        ContentManager::LRU живёт в пределах одного вызова генератора (createLRU на регион),
+        общего долгоживущего кэша у него нет, освобождать нечего
+    */
+
+    lua_gc(LuaMainState.lua_state(), LUA_GCCOLLECT, 0);
+    BackingAsyncLua.LuaGcRequests.fetch_add(1, std::memory_order_relaxed);
+    BackingLuaWorkers.LuaGcRequests.fetch_add(1, std::memory_order_relaxed);
+    Memory.onLuaCollected();
+}
+
 void GameServer::stepModInitializations() {
-    if(ModsReloadRequested.exchange(false)) {
-        reloadMods();
+    // Запрос во время перезагрузки дожидается её конца
+    if(BackingModReload.Stage == BackingModReload_t::EnumStage::Idle && ModsReloadRequested.exchange(false)) {
+        startModsReload();
+    } else if(BackingModReload.Stage != BackingModReload_t::EnumStage::Idle && BackingModReload.Ready.load(std::memory_order_acquire)) {
+        BackingModReload.join();
+        BackingModReload.Ready.store(false, std::memory_order_relaxed);
+
+        if(BackingModReload.Stage == BackingModReload_t::EnumStage::Compile)
+            reloadModsContent();
+        else
+            applyModsReloadAssets();
+    }
+
+    if(LuaProfilerToggleRequested.exchange(false)) {
+        toggleLuaProfiler();
     }
+
     BackingChunkPressure.endWithResults();
 }
 
-void GameServer::reloadMods() {
-    std::vector<Net::Packet> packetsToSend;
+void GameServer::toggleLuaProfiler() {
+    if(!LuaProfile.isRunning()) {
+        LuaProfile.start();
+        LOG.info() << "Профилировщик Lua включён";
+        return;
+    }
+
+    LuaProfile.stop();
+
+    uint64_t total = 0;
+    for(const auto& [modId, cost] : LuaProfile.costs())
+        total += cost.Samples;
+
+    std::vector<std::pair<std::string, LuaProfiler::ModCost>> costs(LuaProfile.costs().begin(), LuaProfile.costs().end());
+    std::sort(costs.begin(), costs.end(), [](const auto& a, const auto& b) { return a.second.Samples > b.second.Samples; });
+
+    LOG.info() << "Профилировщик Lua выключен, выборок: " << total;
+    for(const auto& [modId, cost] : costs) {
+        LOG.info() << "  " << modId << ": " << (total ? 100*cost.Samples/total : 0) << "% выборок, "
+            << cost.Allocations << " выделений, " << cost.AllocatedBytes / 1024 << " КиБ";
+    }
+
+    try {
+        LuaProfile.dumpFolded(LuaProfilePath);
+        LOG.info() << "Профиль сохранён в " << LuaProfilePath.string();
+    } catch(const std::exception& exc) {
+        LOG.warn() << exc.what();
+    }
+}
+
+void GameServer::BackingModReload_t::compile(std::vector<fs::path> sources) {
+    Chunks.clear();
+    Error.clear();
+
+    // Отдельное состояние только для разбора, исполняются моды в LuaMainState
+    lua_State* lua = luaL_newstate();
+    for(const fs::path& path : sources) {
+        if(luaL_loadfile(lua, path.string().c_str()) != 0) {
+            Error = lua_tostring(lua, -1);
+            break;
+        }
+
+        std::string& chunk = Chunks.emplace_back();
+        lua_dump(lua, [](lua_State*, const void* data, size_t size, void* out) -> int {
+            static_cast<std::string*>(out)->append(static_cast<const char*>(data), size);
+            return 0;
+        }, &chunk);
+        lua_pop(lua, 1);
+    }
+
+    lua_close(lua);
+    Ready.store(true, std::memory_order_release);
+}
+
+void GameServer::BackingModReload_t::checkAssets(AssetsManager& am) {
+    // Пока идёт сверка, такт не меняет связки ресурсов, они применяются только в applyModsReloadAssets
+    AssetsUpdate.emplace(am.checkAndPrepareResourcesUpdate(Assets));
+    Ready.store(true, std::memory_order_release);
+}
 
+void GameServer::startModsReload() {
     LOG.info() << "Перезагрузка модов";
-    {
-        // TODO: перезагрузка модов
 
-        ContentManager::Out_buildEndProfiles out = Content.CM.buildEndProfiles();
-        packetsToSend.append_range(RemoteClient::makePackets_informateDefContentUpdate(out));
+    std::vector<fs::path> sources;
+    for(const ModInfo& info : LoadedMods)
+        sources.push_back(info.Path / "init.lua");
+
+    BackingModReload.Stage = BackingModReload_t::EnumStage::Compile;
+    BackingModReload.Thread = std::thread(&BackingModReload_t::compile, &BackingModReload, std::move(sources));
+}
+
+void GameServer::reloadModsContent() {
+    std::vector<Net::Packet> packetsToSend;
+
+    if(!BackingModReload.Error.empty()) {
+        LOG.error() << "Ошибка перезагрузки модов, остаётся прошлая версия:\n" << BackingModReload.Error;
+    } else {
+        /*
+            Моды исполняются заново в том же состоянии Lua и регистрируют контент повторно.
+            Идентификаторы привязаны к (домен, ключ) и не меняются, поэтому миры продолжают работу,
+            а клиентам уходят только профили, чьё содержимое изменилось, и потерянные.
+            При ошибке мода до рассылки профилей всё возвращается к прошлой версии,
+            после неё (init, postInit) отключается только упавший мод
+        */
+        auto tickHandlers = NodeTickHandlers;
+        auto lightTable = NodeLightTable;
+        auto fluidTable = NodeFluidTable;
+        auto modInstances = ModInstances;
+        auto customAssets = AssetsInit.Custom;
+
+        // Задачи исполняют код прошлых версий модов
+        LuaTasks.clear();
+        ModsReloading = true;
+        // Профили собраны и разосланы, откатывать больше нечего
+        bool committed = false;
+
+        try {
+            Content.CM.beginReload();
+            NodeTickHandlers.OnTimer.clear();
+            NodeTickHandlers.OnRandomTick.clear();
+            NodeTickHandlers.ModId.clear();
+            std::fill(NodeTickHandlers.RandomTickable.begin(), NodeTickHandlers.RandomTickable.end(), 0);
+            NodeLightTable.clear();
+            NodeFluidTable.clear();
+            for(auto& custom : AssetsInit.Custom)
+                custom.clear();
+
+            loadModInstances(&BackingModReload.Chunks);
+            initLuaAssets();
+            pushModEvent("initAssets");
+            initLuaPre();
+            pushModEvent("lowPreInit");
+            pushModEvent("preInit");
+            pushModEvent("highPreInit");
+
+            ContentManager::Out_buildEndProfiles out = Content.CM.buildEndProfiles();
+            // Новые идентификаторы публикуются для чтения без блокировок и попадают в IdToDK
+            Content.CM.bake();
+            committed = true;
+
+            size_t changed = out.ChangedProfiles_Voxel.size() + out.ChangedProfiles_Node.size() + out.ChangedProfiles_World.size()
+                + out.ChangedProfiles_Portal.size() + out.ChangedProfiles_Entity.size() + out.ChangedProfiles_Item.size();
+            size_t lost = 0;
+            for(const auto& list : out.LostProfiles)
+                lost += list.size();
+
+            LOG.info() << "Изменено профилей: " << changed << ", потеряно: " << lost;
+            if(changed || lost)
+                packetsToSend.append_range(RemoteClient::makePackets_informateDefContentUpdate(out));
+
+            // Профили уже у клиентов: ошибка мода дальше отключает только его
+            std::vector<std::string> failedMods;
+            initLua();
+            pushModEvent("init", &failedMods);
+            initLuaPost();
+            pushModEvent("postInit", &failedMods);
+
+            for(const std::string& modId : failedMods)
+                disableMod(modId);
+        } catch(const std::exception& exc) {
+            if(committed) {
+                LOG.error() << "Ошибка инициализации модов после перезагрузки:\n" << exc.what();
+            } else {
+                LOG.error() << "Ошибка перезагрузки модов, остаётся прошлая версия:\n" << exc.what();
+
+                Content.CM.abortReload();
+                NodeTickHandlers = std::move(tickHandlers);
+                NodeLightTable = std::move(lightTable);
+                NodeFluidTable = std::move(fluidTable);
+                ModInstances = std::move(modInstances);
+                AssetsInit.Custom = std::move(customAssets);
+            }
+
+            // Функции стадий регистрации закрываются как после обычной загрузки
+            initLua();
+        }
+
+        ModsReloading = false;
+        NodeLightShared = std::make_shared<const std::vector<NodeLightInfo>>(NodeLightTable);
+    }
+
+    BackingModReload.Chunks.clear();
+
+    // Профили уже в силе на сервере и уходят сразу, ассеты догонят после сверки
+    for(std::shared_ptr<RemoteClient>& cec : Game.RemoteClients) {
+        auto copy = packetsToSend;
+        cec->pushPackets(&copy);
     }
 
     LOG.info() << "Перезагрузка ассетов";
+    BackingModReload.Assets = AssetsInit;
+    BackingModReload.Stage = BackingModReload_t::EnumStage::Assets;
+    BackingModReload.Thread = std::thread(&BackingModReload_t::checkAssets, &BackingModReload, std::ref(Content.AM));
+}
+
+void GameServer::applyModsReloadAssets() {
+    std::vector<Net::Packet> packetsToSend;
+
     {
-        {
-            AssetsManager::Out_checkAndPrepareResourcesUpdate capru = Content.AM.checkAndPrepareResourcesUpdate(AssetsInit);
-            AssetsManager::Out_applyResourcesUpdate aru = Content.AM.applyResourcesUpdate(capru);
-
-            if(!capru.ResourceUpdates.empty() || !capru.LostLinks.empty())
-                packetsToSend.push_back(
-                    RemoteClient::makePacket_informateAssets_HH(
-                        aru.NewOrUpdates,
-                        capru.LostLinks
-                    )
-                );
-        }
-    
+        AssetsManager::Out_checkAndPrepareResourcesUpdate& capru = *BackingModReload.AssetsUpdate;
+        AssetsManager::Out_applyResourcesUpdate aru = Content.AM.applyResourcesUpdate(capru);
+
+        if(!capru.ResourceUpdates.empty() || !capru.LostLinks.empty())
+            packetsToSend.push_back(
+                RemoteClient::makePacket_informateAssets_HH(
+                    aru.NewOrUpdates,
+                    capru.LostLinks
+                )
+            );
+    }
 
-        {
-            std::array<
-                std::vector<AssetsManager::BindDomainKeyInfo>, 
-                static_cast<size_t>(EnumAssets::MAX_ENUM)
-            > baked = Content.AM.bake();
+    {
+        std::array<
+            std::vector<AssetsManager::BindDomainKeyInfo>, 
+            static_cast<size_t>(EnumAssets::MAX_ENUM)
+        > baked = Content.AM.bake();
 
-            if(hasAnyBindings(baked)) {
-                packetsToSend.push_back(RemoteClient::makePacket_informateAssets_DK(baked));
-            }
+        if(hasAnyBindings(baked)) {
+            packetsToSend.push_back(RemoteClient::makePacket_informateAssets_DK(baked));
         }
     }
 
+    BackingModReload.AssetsUpdate.reset();
+    BackingModReload.Stage = BackingModReload_t::EnumStage::Idle;
+    LOG.info() << "Перезагрузка модов завершена";
+
     // Отправка пакетов
     for(std::shared_ptr<RemoteClient>& cec : Game.RemoteClients) {
         auto copy = packetsToSend;
@@ -1732,200 +2357,230 @@ IWorldSaveBackend::TickSyncInfo_Out GameServer::stepDatabaseSync() {
     IWorldSaveBackend::TickSyncInfo_In toDB;
     
     constexpr uint32_t kRegionUnloadDelayTicks = 300;
-constexpr uint8_t kUnloadHysteresisExtraRegions = 1;
-const uint32_t nowTick = Game.Tick;
-
-for(std::shared_ptr<RemoteClient>& remoteClient : Game.RemoteClients) {
-    assert(remoteClient);
+    constexpr uint8_t kUnloadHysteresisExtraRegions = 1;
+    const uint32_t nowTick = Game.Tick;
+    // Под жёстким давлением памяти гистерезис выгрузки не выдерживается
+    const bool memoryHard = Memory.pressure() == MemoryGovernor::EnumPressure::Hard;
 
-    // 1) Если игрок пересёк границу региона — пересчитываем области наблюдения.
-    //    Вводим гистерезис: загрузка по "внутренней" границе, выгрузка по "внешней" (+1 регион).
-    if(remoteClient->CrossedRegion) {
-        remoteClient->CrossedRegion = false;
-
-        std::vector<ContentViewCircle> innerCVCs;
-        std::vector<ContentViewCircle> outerCVCs;
+    for(std::shared_ptr<RemoteClient>& remoteClient : Game.RemoteClients) {
+        assert(remoteClient);
 
-        {
-            std::vector<std::tuple<WorldId_t, Pos::Object, uint8_t>> points = remoteClient->getViewPoints();
-            for(auto& [wId, pos, radius] : points) {
-                assert(radius < 5);
+        // 1) Если игрок пересёк границу региона — пересчитываем области наблюдения.
+        //    Вводим гистерезис: загрузка по "внутренней" границе, выгрузка по "внешней" (+1 регион).
+        if(remoteClient->CrossedRegion) {
+            remoteClient->CrossedRegion = false;
 
-                // Внутренняя область (на загрузку)
-                {
-                    ContentViewCircle cvc;
-                    cvc.WorldId = wId;
-                    cvc.Pos = Pos::Object_t::asRegionsPos(pos);
-                    cvc.Range = int16_t(radius * radius);
+            std::vector<ContentViewCircle> innerCVCs;
+            std::vector<ContentViewCircle> outerCVCs;
 
-                    std::vector<ContentViewCircle> list = Expanse.accumulateContentViewCircles(cvc);
-                    innerCVCs.insert(innerCVCs.end(), list.begin(), list.end());
-                }
+            {
+                std::vector<std::tuple<WorldId_t, Pos::Object, uint8_t>> points = remoteClient->getViewPoints();
+                for(auto& [wId, pos, radius] : points) {
+                    assert(radius < 5);
+
+                    // Внутренняя область (на загрузку)
+                    {
+                        ContentViewCircle cvc;
+                        cvc.WorldId = wId;
+                        cvc.Pos = Pos::Object_t::asRegionsPos(pos);
+                        cvc.Range = int16_t(radius * radius);
+
+                        std::vector<ContentViewCircle> list = Expanse.accumulateContentViewCircles(cvc);
+                        innerCVCs.insert(innerCVCs.end(), list.begin(), list.end());
+                    }
 
-                // Внешняя область (на удержание/выгрузку) = внутренняя + 1 регион
-                {
-                    uint8_t outerRadius = radius + kUnloadHysteresisExtraRegions;
-                    if(outerRadius > 5) outerRadius = 5;
+                    // Внешняя область (на удержание/выгрузку) = внутренняя + 1 регион
+                    {
+                        uint8_t outerRadius = radius + kUnloadHysteresisExtraRegions;
+                        if(outerRadius > 5) outerRadius = 5;
 
-                    ContentViewCircle cvc;
-                    cvc.WorldId = wId;
-                    cvc.Pos = Pos::Object_t::asRegionsPos(pos);
-                    cvc.Range = int16_t(outerRadius * outerRadius);
+                        ContentViewCircle cvc;
+                        cvc.WorldId = wId;
+                        cvc.Pos = Pos::Object_t::asRegionsPos(pos);
+                        cvc.Range = int16_t(outerRadius * outerRadius);
 
-                    std::vector<ContentViewCircle> list = Expanse.accumulateContentViewCircles(cvc);
-                    outerCVCs.insert(outerCVCs.end(), list.begin(), list.end());
+                        std::vector<ContentViewCircle> list = Expanse.accumulateContentViewCircles(cvc);
+                        outerCVCs.insert(outerCVCs.end(), list.begin(), list.end());
+                    }
                 }
             }
-        }
-
-        ContentViewInfo viewInner = Expanse_t::makeContentViewInfo(innerCVCs);
-        ContentViewInfo viewOuter = Expanse_t::makeContentViewInfo(outerCVCs);
 
-        // Отменяем отложенную выгрузку для регионов, которые снова попали во внешнюю область
-        for(const auto& [worldId, regions] : viewOuter.Regions) {
-            auto itWorld = remoteClient->PendingRegionUnload.find(worldId);
-            if(itWorld == remoteClient->PendingRegionUnload.end())
-                continue;
+            ContentViewInfo viewInner = Expanse_t::makeContentViewInfo(innerCVCs);
+            ContentViewInfo viewOuter = Expanse_t::makeContentViewInfo(outerCVCs);
 
-            for(const Pos::GlobalRegion& pos : regions) {
-                itWorld->second.erase(pos);
-            }
+            // Отменяем отложенную выгрузку для регионов, которые снова попали во внешнюю область
+            for(const auto& [worldId, regions] : viewOuter.Regions) {
+                auto itWorld = remoteClient->PendingRegionUnload.find(worldId);
+                if(itWorld == remoteClient->PendingRegionUnload.end())
+                    continue;
 
-            if(itWorld->second.empty())
-                remoteClient->PendingRegionUnload.erase(itWorld);
-        }
+                for(const Pos::GlobalRegion& pos : regions) {
+                    itWorld->second.erase(pos);
+                }
 
-        // Загрузка: только по внутренней границе
-        ContentViewInfo_Diff diffInner = viewInner.diffWith(remoteClient->ContentViewState);
+                if(itWorld->second.empty())
+                    remoteClient->PendingRegionUnload.erase(itWorld);
+            }
 
-        if(!diffInner.WorldsNew.empty()) {
-            // Сообщить о новых мирах
-            for(const WorldId_t id : diffInner.WorldsNew) {
-                auto iter = Expanse.Worlds.find(id);
-                assert(iter != Expanse.Worlds.end());
+            // Загрузка: только по внутренней границе
+            ContentViewInfo_Diff diffInner = viewInner.diffWith(remoteClient->ContentViewState);
 
-                remoteClient->prepareWorldUpdate(id, iter->second.get());
-            }
-        }
+            if(!diffInner.WorldsNew.empty()) {
+                // Сообщить о новых мирах
+                for(const WorldId_t id : diffInner.WorldsNew) {
+                    auto iter = Expanse.Worlds.find(id);
+                    assert(iter != Expanse.Worlds.end());
 
-        // Подписываем игрока на наблюдение за регионами (внутренняя область)
-        for(const auto& [worldId, regions] : diffInner.RegionsNew) {
-            // Добавляем в состояние клиента (слиянием, т.к. там могут быть регионы на удержании)
-            {
-                auto& cur = remoteClient->ContentViewState.Regions[worldId];
-                std::vector<Pos::GlobalRegion> merged;
-                merged.reserve(cur.size() + regions.size());
-                std::merge(cur.begin(), cur.end(), regions.begin(), regions.end(), std::back_inserter(merged));
-                merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
-                cur = std::move(merged);
+                    remoteClient->prepareWorldUpdate(id, iter->second.get());
+                }
             }
 
-            auto iterWorld = Expanse.Worlds.find(worldId);
-            assert(iterWorld != Expanse.Worlds.end());
+            // Подписываем игрока на наблюдение за регионами (внутренняя область)
+            for(const auto& [worldId, regions] : diffInner.RegionsNew) {
+                // Добавляем в состояние клиента (слиянием, т.к. там могут быть регионы на удержании)
+                {
+                    auto& cur = remoteClient->ContentViewState.Regions[worldId];
+                    std::vector<Pos::GlobalRegion> merged;
+                    merged.reserve(cur.size() + regions.size());
+                    std::merge(cur.begin(), cur.end(), regions.begin(), regions.end(), std::back_inserter(merged));
+                    merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+                    cur = std::move(merged);
+                }
 
-            std::vector<Pos::GlobalRegion> notLoaded = iterWorld->second->onRemoteClient_RegionsEnter(worldId, remoteClient, regions);
-            if(!notLoaded.empty()) {
-                // Добавляем к списку на загрузку
-                std::vector<Pos::GlobalRegion> &tl = toDB.Load[worldId];
-                tl.insert(tl.end(), notLoaded.begin(), notLoaded.end());
+                auto iterWorld = Expanse.Worlds.find(worldId);
+                assert(iterWorld != Expanse.Worlds.end());
+
+                // Предвыборка, которую игрок уже ждёт, генерируется наравне с видимыми регионами
+                for(const Pos::GlobalRegion& pos : regions)
+                    if(Prefetch.onVisible(worldId, pos, iterWorld->second->Regions.contains(pos)))
+                        BackingNoiseGenerator.promote({worldId, pos});
+
+                std::vector<Pos::GlobalRegion> notLoaded = iterWorld->second->onRemoteClient_RegionsEnter(worldId, remoteClient, regions);
+                // Ещё загружаемые предвыборкой подпишутся по готовности в stepGeneratorAndLuaAsync
+                std::erase_if(notLoaded, [&](const Pos::GlobalRegion& pos) { return Prefetch.isPending(worldId, pos); });
+                if(!notLoaded.empty()) {
+                    // Добавляем к списку на загрузку
+                    std::vector<Pos::GlobalRegion> &tl = toDB.Load[worldId];
+                    tl.insert(tl.end(), notLoaded.begin(), notLoaded.end());
+                }
             }
-        }
 
-        // Кандидаты на выгрузку: то, что есть у клиента, но не попадает во внешнюю область (гистерезис)
-        for(const auto& [worldId, curRegions] : remoteClient->ContentViewState.Regions) {
-            std::vector<Pos::GlobalRegion> outer;
-            auto itOuter = viewOuter.Regions.find(worldId);
-            if(itOuter != viewOuter.Regions.end())
-                outer = itOuter->second;
+            // Кандидаты на выгрузку: то, что есть у клиента, но не попадает во внешнюю область (гистерезис)
+            for(const auto& [worldId, curRegions] : remoteClient->ContentViewState.Regions) {
+                std::vector<Pos::GlobalRegion> outer;
+                auto itOuter = viewOuter.Regions.find(worldId);
+                if(itOuter != viewOuter.Regions.end())
+                    outer = itOuter->second;
 
-            std::vector<Pos::GlobalRegion> toDelay;
-            toDelay.reserve(curRegions.size());
+                std::vector<Pos::GlobalRegion> toDelay;
+                toDelay.reserve(curRegions.size());
 
-            if(outer.empty()) {
-                toDelay = curRegions;
-            } else {
-                std::set_difference(
-                    curRegions.begin(), curRegions.end(),
-                    outer.begin(), outer.end(),
-                    std::back_inserter(toDelay)
-                );
-            }
+                if(outer.empty()) {
+                    toDelay = curRegions;
+                } else {
+                    std::set_difference(
+                        curRegions.begin(), curRegions.end(),
+                        outer.begin(), outer.end(),
+                        std::back_inserter(toDelay)
+                    );
+                }
 
-            if(!toDelay.empty()) {
-                auto& pending = remoteClient->PendingRegionUnload[worldId];
-                for(const Pos::GlobalRegion& pos : toDelay) {
-                    // если уже ждёт выгрузки — не трогаем
-                    if(pending.find(pos) == pending.end())
-                        pending[pos] = nowTick + kRegionUnloadDelayTicks;
+                if(!toDelay.empty()) {
+                    auto& pending = remoteClient->PendingRegionUnload[worldId];
+                    for(const Pos::GlobalRegion& pos : toDelay) {
+                        // если уже ждёт выгрузки — не трогаем
+                        if(pending.find(pos) == pending.end())
+                            pending[pos] = nowTick + kRegionUnloadDelayTicks;
+                    }
                 }
             }
         }
-    }
 
-    // 2) Отложенная выгрузка: если истекла задержка — реально удаляем регион из зоны видимости
-    if(!remoteClient->PendingRegionUnload.empty()) {
-        std::unordered_map<WorldId_t, std::vector<Pos::GlobalRegion>> expiredByWorld;
+        // 2) Отложенная выгрузка: если истекла задержка — реально удаляем регион из зоны видимости
+        if(!remoteClient->PendingRegionUnload.empty()) {
+            std::unordered_map<WorldId_t, std::vector<Pos::GlobalRegion>> expiredByWorld;
 
-        for(auto itWorld = remoteClient->PendingRegionUnload.begin(); itWorld != remoteClient->PendingRegionUnload.end(); ) {
-            const WorldId_t worldId = itWorld->first;
-            auto& regMap = itWorld->second;
+            for(auto itWorld = remoteClient->PendingRegionUnload.begin(); itWorld != remoteClient->PendingRegionUnload.end(); ) {
+                const WorldId_t worldId = itWorld->first;
+                auto& regMap = itWorld->second;
 
-            std::vector<Pos::GlobalRegion> expired;
-            for(auto itReg = regMap.begin(); itReg != regMap.end(); ) {
-                if(itReg->second <= nowTick) {
-                    expired.push_back(itReg->first);
-                    itReg = regMap.erase(itReg);
-                } else {
-                    ++itReg;
+                std::vector<Pos::GlobalRegion> expired;
+                for(auto itReg = regMap.begin(); itReg != regMap.end(); ) {
+                    if(itReg->second <= nowTick || memoryHard) {
+                        expired.push_back(itReg->first);
+                        itReg = regMap.erase(itReg);
+                    } else {
+                        ++itReg;
+                    }
+                }
+
+                if(!expired.empty()) {
+                    std::sort(expired.begin(), expired.end());
+                    expiredByWorld[worldId] = std::move(expired);
                 }
-            }
 
-            if(!expired.empty()) {
-                std::sort(expired.begin(), expired.end());
-                expiredByWorld[worldId] = std::move(expired);
+                if(regMap.empty())
+                    itWorld = remoteClient->PendingRegionUnload.erase(itWorld);
+                else
+                    ++itWorld;
             }
 
-            if(regMap.empty())
-                itWorld = remoteClient->PendingRegionUnload.erase(itWorld);
-            else
-                ++itWorld;
-        }
+            // Применяем выгрузку: отписка + сообщение клиенту + актуализация ContentViewState
+            for(auto& [worldId, expired] : expiredByWorld) {
+                // Удаляем регионы из состояния клиента
+                auto itCur = remoteClient->ContentViewState.Regions.find(worldId);
+                if(itCur != remoteClient->ContentViewState.Regions.end()) {
+                    std::vector<Pos::GlobalRegion> kept;
+                    kept.reserve(itCur->second.size());
+
+                    std::set_difference(
+                        itCur->second.begin(), itCur->second.end(),
+                        expired.begin(), expired.end(),
+                        std::back_inserter(kept)
+                    );
+
+                    itCur->second = std::move(kept);
+                }
 
-        // Применяем выгрузку: отписка + сообщение клиенту + актуализация ContentViewState
-        for(auto& [worldId, expired] : expiredByWorld) {
-            // Удаляем регионы из состояния клиента
-            auto itCur = remoteClient->ContentViewState.Regions.find(worldId);
-            if(itCur != remoteClient->ContentViewState.Regions.end()) {
-                std::vector<Pos::GlobalRegion> kept;
-                kept.reserve(itCur->second.size());
+                // Сообщаем клиенту и мирам
+                remoteClient->prepareRegionsRemove(worldId, expired);
 
-                std::set_difference(
-                    itCur->second.begin(), itCur->second.end(),
-                    expired.begin(), expired.end(),
-                    std::back_inserter(kept)
-                );
+                auto iterWorld = Expanse.Worlds.find(worldId);
+                if(iterWorld != Expanse.Worlds.end()) {
+                    iterWorld->second->onRemoteClient_RegionsLost(worldId, remoteClient, expired);
+                }
 
-                itCur->second = std::move(kept);
+                // Если в мире больше нет наблюдаемых регионов — удалить мир у клиента
+                auto itStateWorld = remoteClient->ContentViewState.Regions.find(worldId);
+                if(itStateWorld != remoteClient->ContentViewState.Regions.end() && itStateWorld->second.empty()) {
+                    remoteClient->ContentViewState.Regions.erase(itStateWorld);
+                    remoteClient->prepareWorldRemove(worldId);
+                }
             }
+        }
+    }
 
-            // Сообщаем клиенту и мирам
-            remoteClient->prepareRegionsRemove(worldId, expired);
 
-            auto iterWorld = Expanse.Worlds.find(worldId);
-            if(iterWorld != Expanse.Worlds.end()) {
-                iterWorld->second->onRemoteClient_RegionsLost(worldId, remoteClient, expired);
-            }
+    // Под жёстким давлением новые регионы ждут, пока память не освободится
+    if(memoryHard) {
+        for(auto& [worldId, regions] : toDB.Load) {
+            Memory.onLoadsDeferred(regions.size());
+            auto& deferred = DeferredRegionLoads[worldId];
+            deferred.insert(deferred.end(), regions.begin(), regions.end());
+        }
 
-            // Если в мире больше нет наблюдаемых регионов — удалить мир у клиента
-            auto itStateWorld = remoteClient->ContentViewState.Regions.find(worldId);
-            if(itStateWorld != remoteClient->ContentViewState.Regions.end() && itStateWorld->second.empty()) {
-                remoteClient->ContentViewState.Regions.erase(itStateWorld);
-                remoteClient->prepareWorldRemove(worldId);
-            }
+        toDB.Load.clear();
+    } else if(!DeferredRegionLoads.empty()) {
+        for(auto& [worldId, regions] : DeferredRegionLoads) {
+            auto& load = toDB.Load[worldId];
+            load.insert(load.end(), regions.begin(), regions.end());
         }
+
+        DeferredRegionLoads.clear();
     }
-}
 
+    if(Memory.pressure() == MemoryGovernor::EnumPressure::None)
+        prefetchRegions(toDB);
 
     for(auto& [worldId, regions] : toDB.Load) {
         std::sort(regions.begin(), regions.end());
@@ -1933,10 +2588,48 @@ for(std::shared_ptr<RemoteClient>& remoteClient : Game.RemoteClients) {
         regions.erase(eraseIter, regions.end());
     }
 
+    // Регионы из холодного яруса поднимаются сразу, минуя хранилище
+    for(auto& [worldId, regions] : toDB.Load) {
+        auto iterWorld = Expanse.Worlds.find(worldId);
+        assert(iterWorld != Expanse.Worlds.end());
+
+        std::vector<Pos::GlobalRegion> promoted;
+        std::erase_if(regions, [&](const Pos::GlobalRegion& pos) {
+            if(!iterWorld->second->promoteCold(pos))
+                return false;
+
+            promoted.push_back(pos);
+            Prefetch.onLoaded(worldId, pos, Game.Tick);
+            return true;
+        });
+
+        if(promoted.empty())
+            continue;
+
+        for(std::shared_ptr<RemoteClient>& remoteClient : Game.RemoteClients) {
+            auto iterViewWorld = remoteClient->ContentViewState.Regions.find(worldId);
+            if(iterViewWorld == remoteClient->ContentViewState.Regions.end())
+                continue;
+
+            std::vector<Pos::GlobalRegion> enter;
+            for(const Pos::GlobalRegion& pos : promoted) {
+                if(std::binary_search(iterViewWorld->second.begin(), iterViewWorld->second.end(), pos))
+                    enter.push_back(pos);
+            }
+
+            if(!enter.empty())
+                iterWorld->second->onRemoteClient_RegionsEnter(worldId, remoteClient, enter);
+        }
+    }
+
     // Обзавелись списком на прогрузку регионов
     // Теперь узнаем что нужно сохранить и что из регионов было выгружено
+    RegionSaveBudget = std::min(RegionSaveBudget + RegionSaveBytesPerSecond * CurrentTickDuration,
+        RegionSaveBytesPerSecond * RegionSaveBurstSeconds);
+
     for(auto& [worldId, world] : Expanse.Worlds) {
-        World::SaveUnloadInfo info = world->onStepDatabaseSync(Content.CM, CurrentTickDuration);
+        World::SaveUnloadInfo info = world->onStepDatabaseSync(Content.CM, CurrentTickDuration, RegionSaveBudget);
+        Memory.onRegionsEvicted(info.Evicted);
         
         if(!info.ToSave.empty()) {
             auto &obj = toDB.ToSave[worldId];
@@ -1951,19 +2644,153 @@ for(std::shared_ptr<RemoteClient>& remoteClient : Game.RemoteClients) {
 
     // Синхронизируемся с базой
     const auto loadFallback = toDB.Load;
+    // Если хранилище упадёт целиком, ни одна запись не считается состоявшейся
+    std::unordered_map<WorldId_t, std::vector<Pos::GlobalRegion>> saveFallback;
+    for(const auto& [worldId, regions] : toDB.ToSave) {
+        auto& list = saveFallback[worldId];
+        for(const auto& [pos, _] : regions)
+            list.push_back(pos);
+    }
+
+    IWorldSaveBackend::TickSyncInfo_Out out;
+    bool synced = false;
     try {
-        return SaveBackend.World->tickSync(std::move(toDB));
+        out = SaveBackend.World->tickSync(std::move(toDB));
+        synced = true;
     } catch(const std::exception& exc) {
         LOG.error() << "Ошибка tickSync: " << exc.what();
     } catch(...) {
         LOG.error() << "Неизвестная ошибка tickSync";
     }
 
-    IWorldSaveBackend::TickSyncInfo_Out out;
-    out.NotExisten = loadFallback;
+    if(!synced) {
+        out.NotExisten = loadFallback;
+        out.SaveFailed = std::move(saveFallback);
+    }
+
+    const std::vector<Pos::GlobalRegion> noFailures;
+    for(auto& [worldId, world] : Expanse.Worlds) {
+        auto iterFailed = out.SaveFailed.find(worldId);
+        world->onSaveResults(iterFailed != out.SaveFailed.end() ? iterFailed->second : noFailures);
+    }
+
     return out;
 }
 
+void GameServer::prefetchRegions(IWorldSaveBackend::TickSyncInfo_In& toDB) {
+    Prefetch.expire(Game.Tick);
+
+    struct Candidate {
+        WorldId_t WorldId;
+        Pos::GlobalRegion RegionPos;
+        // Квадрат расстояния до игрока в регионах, ближние запрашиваются первыми
+        int32_t Distance;
+    };
+
+    std::vector<Candidate> candidates;
+
+    for(const std::shared_ptr<RemoteClient>& remoteClient : Game.RemoteClients) {
+        const glm::vec3 velocity = remoteClient->getVelocity();
+        const float speed = glm::length(velocity);
+
+        for(auto& [wId, pos, radius] : remoteClient->getViewPoints()) {
+            const Pos::GlobalRegion origin = Pos::Object_t::asRegionsPos(pos);
+            const int32_t portalReach = radius + PrefetchPortalRegions;
+            std::vector<ContentViewCircle> circles;
+
+            // Точки прогноза примерно через регион пути, мосты на пути учитываются как у видимой области
+            if(speed >= PrefetchMinSpeed) {
+                const glm::vec3 start = Pos::Object_t::asFloatVec(pos);
+                const int steps = std::clamp(int(std::ceil(speed * PrefetchSeconds / 64)), 1, 8);
+
+                for(int step = 1; step <= steps; step++) {
+                    glm::vec3 point = start + velocity * (PrefetchSeconds * step / steps);
+
+                    ContentViewCircle cvc;
+                    cvc.WorldId = wId;
+                    cvc.Pos = Pos::GlobalRegion(glm::floor(point / 64.f));
+                    cvc.Range = int16_t(radius * radius);
+
+                    std::vector<ContentViewCircle> list = Expanse.accumulateContentViewCircles(cvc);
+                    circles.insert(circles.end(), list.begin(), list.end());
+                }
+            }
+
+            // Игрок у портала: область за ним прогревается до того, как он войдёт в видимую
+            for(const auto& [bridgeId, bridge] : Expanse.ContentBridges) {
+                auto isNear = [&](WorldId_t worldId, Pos::GlobalRegion bridgePos) {
+                    if(worldId != wId)
+                        return false;
+
+                    glm::i32vec3 vec = origin - bridgePos;
+                    return vec.x*vec.x+vec.y*vec.y+vec.z*vec.z <= portalReach*portalReach;
+                };
+
+                if(isNear(bridge.LeftWorld, bridge.LeftPos))
+                    circles.push_back({bridge.RightWorld, bridge.RightPos, int16_t(radius * radius)});
+
+                if(bridge.IsTwoWay && isNear(bridge.RightWorld, bridge.RightPos))
+                    circles.push_back({bridge.LeftWorld, bridge.LeftPos, int16_t(radius * radius)});
+            }
+
+            if(circles.empty())
+                continue;
+
+            ContentViewInfo view = Expanse_t::makeContentViewInfo(circles);
+            for(const auto& [worldId, regions] : view.Regions) {
+                auto iterWorld = Expanse.Worlds.find(worldId);
+                if(iterWorld == Expanse.Worlds.end())
+                    continue;
+
+                for(const Pos::GlobalRegion& regionPos : regions) {
+                    if(iterWorld->second->Regions.contains(regionPos))
+                        continue;
+
+                    int32_t distance = portalReach * portalReach;
+                    if(worldId == wId) {
+                        glm::i32vec3 vec = regionPos - origin;
+                        distance = vec.x*vec.x+vec.y*vec.y+vec.z*vec.z;
+                    }
+
+                    candidates.push_back({worldId, regionPos, distance});
+                }
+            }
+        }
+    }
+
+    if(candidates.empty())
+        return;
+
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.Distance < b.Distance; });
+
+    // Видимые регионы загружает stepDatabaseSync, предвыборка их не трогает
+    auto isViewed = [&](WorldId_t worldId, const Pos::GlobalRegion& regionPos) {
+        for(const std::shared_ptr<RemoteClient>& remoteClient : Game.RemoteClients) {
+            auto iter = remoteClient->ContentViewState.Regions.find(worldId);
+            if(iter != remoteClient->ContentViewState.Regions.end()
+                && std::binary_search(iter->second.begin(), iter->second.end(), regionPos))
+                return true;
+        }
+
+        return false;
+    };
+
+    size_t requested = 0;
+    for(const Candidate& candidate : candidates) {
+        if(requested >= PrefetchPerTick)
+            break;
+
+        if(isViewed(candidate.WorldId, candidate.RegionPos))
+            continue;
+
+        if(!Prefetch.request(candidate.WorldId, candidate.RegionPos, Game.Tick))
+            continue;
+
+        toDB.Load[candidate.WorldId].push_back(candidate.RegionPos);
+        requested++;
+    }
+}
+
 void GameServer::stepGeneratorAndLuaAsync(IWorldSaveBackend::TickSyncInfo_Out db) {
     // 1. Получили сырые регионы и те регионы, что не существуют
     // 2.1 Те регионы, что не существуют отправляются на расчёт шума
@@ -1981,23 +2808,33 @@ void GameServer::stepGeneratorAndLuaAsync(IWorldSaveBackend::TickSyncInfo_Out db
     // 2.2 и 3.1
     // Обработка шума на стороне луа
     {
-        std::vector<std::pair<BackingNoiseGenerator_t::NoiseKey, std::array<float, 64*64*64>>> calculatedNoise = BackingNoiseGenerator.tickSync(std::move(db.NotExisten));
+        // Регионы предвыборки генерируются после всех видимых
+        std::vector<BackingNoiseGenerator_t::NoiseKey> prefetchNoise;
+        for(auto& [worldId, regions] : db.NotExisten) {
+            std::erase_if(regions, [&](const Pos::GlobalRegion& pos) {
+                // Увиденные игроком во время загрузки идут в основную очередь
+                if(!Prefetch.isPending(worldId, pos) || Prefetch.isLate(worldId, pos))
+                    return false;
+
+                prefetchNoise.push_back({worldId, pos});
+                return true;
+            });
+        }
+
+        std::vector<std::pair<BackingNoiseGenerator_t::NoiseKey, std::array<float, 64*64*64>>> calculatedNoise
+            = BackingNoiseGenerator.tickSync(std::move(db.NotExisten), std::move(prefetchNoise));
         if(!calculatedNoise.empty())
-            BackingAsyncLua.NoiseIn.lock()->push_range(calculatedNoise);
+            BackingAsyncLua.NoiseIn.push_range(std::move(calculatedNoise));
 
         calculatedNoise.clear();
 
-        if(!BackingAsyncLua.RegionOut.get_read().empty()) {
-            std::vector<
-                std::pair<BackingNoiseGenerator_t::NoiseKey, World::RegionIn>
-            > toLoad = std::move(*BackingAsyncLua.RegionOut.lock());
-            
-            for(auto& [key, region] : toLoad) {
-                toLoadRegions[key.WId].push_back({key.RegionPos, region});
-            }
-        }
+        BackingAsyncLua.RegionOut.consumeAll([&](std::pair<BackingNoiseGenerator_t::NoiseKey, World::RegionIn>&& entry) {
+            toLoadRegions[entry.first.WId].push_back({entry.first.RegionPos, std::move(entry.second)});
+        });
     }
 
+    deliverLuaWorkerResults();
+
     // Обработка идентификаторов на стороне луа
 
     // Трансформация полученных ключей в профили сервера
@@ -2061,6 +2898,8 @@ void GameServer::stepGeneratorAndLuaAsync(IWorldSaveBackend::TickSyncInfo_Out db
             convertRegionVoxelsToChunks(region.Voxels, obj.Voxels);
             obj.Nodes = std::move(region.Nodes);
             obj.Entityes = std::move(region.Entityes);
+            obj.NodeTicks = std::move(region.NodeTicks);
+            obj.Stored = true;
         }
     }
 
@@ -2071,8 +2910,10 @@ void GameServer::stepGeneratorAndLuaAsync(IWorldSaveBackend::TickSyncInfo_Out db
 
         std::vector<Pos::GlobalRegion> newRegions;
         newRegions.reserve(regions.size());
-        for(auto& [pos, _] : regions)
+        for(auto& [pos, _] : regions) {
             newRegions.push_back(pos);
+            Prefetch.onLoaded(worldId, pos, Game.Tick);
+        }
         std::sort(newRegions.begin(), newRegions.end());
 
         std::unordered_map<std::shared_ptr<RemoteClient>, std::vector<Pos::GlobalRegion>> toSubscribe;
@@ -2095,6 +2936,32 @@ void GameServer::stepGeneratorAndLuaAsync(IWorldSaveBackend::TickSyncInfo_Out db
     }
 }
 
+void GameServer::stepLighting() {
+    for(auto& [worldId, world] : Expanse.Worlds) {
+        std::vector<World::LightJob> jobs = world->takeLightJobs();
+        if(jobs.empty())
+            continue;
+
+        std::vector<BackingLight_t::Job> toCompute;
+        toCompute.reserve(jobs.size());
+        for(const World::LightJob& job : jobs) {
+            auto nodes = std::make_unique<RegionNodes>(world->Regions.at(job.Pos)->Nodes);
+            toCompute.push_back({worldId, job.Pos, job.Id, std::move(nodes), NodeLightShared});
+        }
+
+        BackingLight.Input.push_range(std::move(toCompute));
+    }
+
+    BackingLight.Output.consumeAll([&](BackingLight_t::Result&& result) {
+        auto iterWorld = Expanse.Worlds.find(result.WId);
+        if(iterWorld != Expanse.Worlds.end())
+            iterWorld->second->applyRegionLight(result.RegionPos, result.JobId, *result.Light);
+    });
+
+    for(auto& [worldId, world] : Expanse.Worlds)
+        world->updateLight();
+}
+
 void GameServer::stepPlayerProceed() {
     auto iterWorld = Expanse.Worlds.find(0);
     if(iterWorld == Expanse.Worlds.end())
@@ -2644,8 +3511,113 @@ void GameServer::stepWorldPhysic() {
 }
 
 void GameServer::stepGlobalStep() {
-    for(auto &pair : Expanse.Worlds)
+    for(auto &pair : Expanse.Worlds) {
         pair.second->onUpdate(this, CurrentTickDuration);
+        dispatchNodeTicks(pair.first, pair.second->takeNodeTickEvents());
+    }
+
+    // Остаток работы задач модов переносится на следующие такты
+    LuaTasks.run(LuaScheduler::DEFAULT_BUDGET);
+}
+
+void GameServer::deliverLuaWorkerResults() {
+    BackingLuaWorkers.Output.consumeAll([&](BackingLuaWorkers_t::Result&& result) {
+        auto iterPost = LuaPosts.find(result.Id);
+        if(iterPost == LuaPosts.end())
+            return;
+
+        LuaPost post = std::move(iterPost->second);
+        LuaPosts.erase(iterPost);
+
+        if(!result.Ok)
+            LOG.warn() << "Ошибка в воркере мода " << post.ModId << ":\n" << result.Error;
+
+        if(!post.Callback)
+            return;
+
+        sol::protected_function_result callResult = result.Ok
+            ? LuaTasks.call(post.ModId, *post.Callback, result.Message.toLua(LuaMainState))
+            : LuaTasks.call(post.ModId, *post.Callback, sol::lua_nil, result.Error);
+
+        if(!callResult.valid()) {
+            sol::error err = callResult;
+            LOG.warn() << "Ошибка в обратном вызове воркера мода " << post.ModId << ":\n" << err.what();
+        }
+    });
+}
+
+void GameServer::bindNodeTickHandlers(DefNodeId id, const sol::table& profile) {
+    if(NodeTickHandlers.OnTimer.size() <= id) {
+        NodeTickHandlers.OnTimer.resize(id+1);
+        NodeTickHandlers.OnRandomTick.resize(id+1);
+        NodeTickHandlers.RandomTickable.resize(id+1, 0);
+        NodeTickHandlers.ModId.resize(id+1);
+    }
+
+    NodeTickHandlers.ModId[id] = CurrentModId;
+    NodeTickHandlers.OnTimer[id] = profile.get<std::optional<sol::protected_function>>("on_timer");
+    NodeTickHandlers.OnRandomTick[id] = profile.get<std::optional<sol::protected_function>>("on_random_tick");
+    NodeTickHandlers.RandomTickable[id] = NodeTickHandlers.OnRandomTick[id].has_value();
+}
+
+void GameServer::bindNodeLight(DefNodeId id, const sol::table& profile) {
+    if(NodeLightTable.size() <= id) {
+        size_t oldSize = NodeLightTable.size();
+        NodeLightTable.resize(id+1);
+
+        // Воздух прозрачен
+        if(oldSize == 0)
+            NodeLightTable[0] = {0, 0};
+    }
+
+    NodeLightInfo& info = NodeLightTable[id];
+    info.Emission = std::clamp(profile.get_or("light_source", 0), 0, int(LightEngine::MAX_LEVEL));
+    info.Opacity = std::clamp(profile.get_or("light_opacity", int(LightEngine::MAX_LEVEL)), 0, int(LightEngine::MAX_LEVEL));
+}
+
+void GameServer::bindNodeFluid(DefNodeId id, const sol::table& profile) {
+    if(NodeFluidTable.size() <= id)
+        NodeFluidTable.resize(id+1);
+
+    // Тактов между шагами течения, 0 - не жидкость
+    NodeFluidTable[id].Viscosity = std::clamp(profile.get_or("fluid_viscosity", 0), 0, int(UINT16_MAX));
+}
+
+void GameServer::dispatchNodeTicks(WorldId_t worldId, std::vector<World::NodeTickEvent>&& events) {
+    if(events.empty())
+        return;
+
+    // Один вызов на тип ноды и вид такта: handler(world, {x1, y1, z1, x2, y2, z2, ...})
+    std::sort(events.begin(), events.end(), [](const World::NodeTickEvent& a, const World::NodeTickEvent& b) {
+        return std::tie(a.Random, a.NodeId) < std::tie(b.Random, b.NodeId);
+    });
+
+    for(size_t begin = 0; begin < events.size();) {
+        size_t end = begin+1;
+        while(end < events.size() && events[end].Random == events[begin].Random && events[end].NodeId == events[begin].NodeId)
+            end++;
+
+        const DefNodeId nodeId = events[begin].NodeId;
+        const auto& handlers = events[begin].Random ? NodeTickHandlers.OnRandomTick : NodeTickHandlers.OnTimer;
+
+        if(nodeId < handlers.size() && handlers[nodeId]) {
+            sol::table positions = LuaMainState.create_table(int((end-begin)*3), 0);
+            int index = 1;
+            for(size_t iter = begin; iter < end; iter++) {
+                positions[index++] = events[iter].Pos.x;
+                positions[index++] = events[iter].Pos.y;
+                positions[index++] = events[iter].Pos.z;
+            }
+
+            sol::protected_function_result result = LuaTasks.call(NodeTickHandlers.ModId[nodeId], *handlers[nodeId], worldId, positions);
+            if(!result.valid()) {
+                sol::error err = result;
+                LOG.warn() << "Ошибка в обработчике такта ноды " << nodeId << ":\n" << err.what();
+            }
+        }
+
+        begin = end;
+    }
 }
 
 void GameServer::stepSyncContent() {
@@ -2657,39 +3629,28 @@ void GameServer::stepSyncContent() {
             Pos::GlobalNode node = remoteClient->Build.front();
             remoteClient->Build.pop();
 
-            Pos::GlobalRegion rPos = node >> 6;
-            Pos::bvec4u cPos = (node >> 4) & 0x3;
             Pos::bvec16u nPos = node & 0xf;
 
-            auto region = Expanse.Worlds[0]->Regions.find(rPos);
-            if(region != Expanse.Worlds[0]->Regions.end()) {
-                Node& n = region->second->Nodes[cPos.pack()][nPos.pack()];
-                n.NodeId = 4;
-                n.Meta = uint8_t((int(nPos.x) + int(nPos.y) + int(nPos.z)) & 0x3);
-                region->second->IsChunkChanged_Nodes |= 1ull << cPos.pack();
-                region->second->IsChanged = true;
-            }
+            Node n;
+            n.Data = 0;
+            n.NodeId = 4;
+            n.Meta = uint8_t((int(nPos.x) + int(nPos.y) + int(nPos.z)) & 0x3);
+            Expanse.Worlds[0]->setNode(node, n);
         }
 
         while(!remoteClient->Break.empty()) {
             Pos::GlobalNode node = remoteClient->Break.front();
             remoteClient->Break.pop();
 
-            Pos::GlobalRegion rPos = node >> 6;
-            Pos::bvec4u cPos = (node >> 4) & 0x3;
-            Pos::bvec16u nPos = node & 0xf;
-
-            auto region = Expanse.Worlds[0]->Regions.find(rPos);
-            if(region != Expanse.Worlds[0]->Regions.end()) {
-                Node& n = region->second->Nodes[cPos.pack()][nPos.pack()];
-                n.NodeId = 0;
-                n.Meta = 0;
-                region->second->IsChunkChanged_Nodes |= 1ull << cPos.pack();
-                region->second->IsChanged = true;
-            }
+            Node n;
+            n.Data = 0;
+            Expanse.Worlds[0]->setNode(node, n);
         }
     }
 
+    // Свет после правок уходит клиентам вместе с нодами
+    for(auto& [worldId, world] : Expanse.Worlds)
+        world->updateLight();
 
     // Сбор запросов на ресурсы + отправка пакетов игрокам
     ResourceRequest full = std::move(Content.OnContentChanges);
@@ -2700,7 +3661,8 @@ void GameServer::stepSyncContent() {
     full.uniq();
 
     std::vector<Net::Packet> packetsToAll;
-    {
+    // Пока BackingModReload сверяет ассеты, он выдаёт идентификаторы, их публикует applyModsReloadAssets
+    if(BackingModReload.Stage != BackingModReload_t::EnumStage::Assets) {
         std::array<
             std::vector<AssetsManager::BindDomainKeyInfo>, 
             static_cast<size_t>(EnumAssets::MAX_ENUM)
@@ -2725,7 +3687,7 @@ void GameServer::stepSyncContent() {
         }
     };
 
-    std::vector<std::tuple<ResourceFile::Hash_t, std::shared_ptr<const std::u8string>>> binaryResources
+    std::vector<std::tuple<ResourceFile::Hash_t, Resource>> binaryResources
         = Content.AM.getResources(full.Hashes);
 
     for(std::shared_ptr<RemoteClient>& remoteClient : Game.RemoteClients) {
@@ -5,27 +5,38 @@
 
 #include <Common/Net.hpp>
 #include <Common/Lockable.hpp>
+#include <Common/ConcurrentQueue.hpp>
 #include <atomic>
 #include <barrier>
 #include <boost/asio/any_io_executor.hpp>
 #include <boost/asio/io_context.hpp>
+#include <exception>
 #include <filesystem>
+#include <functional>
 #include "Common/Abstract.hpp"
 #include "RemoteClient.hpp"
 #include "Server/Abstract.hpp"
 #include <TOSLib.hpp>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <queue>
 #include <set>
 #include <sol/forward.hpp>
 #include <sol/state.hpp>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "WorldDefManager.hpp"
 #include "ContentManager.hpp"
 #include "AssetsManager.hpp"
 #include "World.hpp"
+#include "LuaMessage.hpp"
+#include "LuaProfiler.hpp"
+#include "LuaScheduler.hpp"
+#include "MemoryGovernor.hpp"
+#include "RegionPrefetch.hpp"
 
 #include "SaveBackend.hpp"
 
@@ -59,6 +70,9 @@ class GameServer : public AsyncObject {
     bool IsAlive = true, IsGoingShutdown = false;
     std::string ShutdownReason;
     std::atomic<bool> ModsReloadRequested = false;
+    // Идёт перезагрузка модов: регистрации сверяются с уже запущенными подсистемами
+    bool ModsReloading = false;
+    std::atomic<bool> LuaProfilerToggleRequested = false;
     static constexpr float
         PerTickDuration = 1/30.f,   // Минимальная и стартовая длина такта
         PerTickAdjustment = 1/60.f; // Подгонка длительности такта в случае провисаний
@@ -133,6 +147,28 @@ class GameServer : public AsyncObject {
         std::unique_ptr<IModStorageSaveBackend> ModStorage;
     } SaveBackend;
 
+    // Предел записи регионов в хранилище, несжатых байт в секунду, и запас бюджета на всплеск
+    static constexpr double
+        RegionSaveBytesPerSecond = 8 << 20,
+        RegionSaveBurstSeconds = 2;
+    // Бюджет записи регионов, пополняется каждый такт (см. World::onStepDatabaseSync)
+    double RegionSaveBudget = 0;
+
+    MemoryGovernor Memory;
+    // Регионы, загрузка которых отложена жёстким давлением памяти
+    std::unordered_map<WorldId_t, std::vector<Pos::GlobalRegion>> DeferredRegionLoads;
+    // Бюджет холодного яруса регионов каждого мира
+    size_t ColdRegionBudget = World::COLD_BUDGET_DEFAULT;
+
+    // Предвыборка регионов по траектории игроков: горизонт прогноза, скорость, с которой он строится,
+    // запас до портала в регионах и предел новых запросов за такт
+    static constexpr float
+        PrefetchSeconds = 4,
+        PrefetchMinSpeed = 6;
+    static constexpr int32_t PrefetchPortalRegions = 2;
+    static constexpr size_t PrefetchPerTick = 4;
+    RegionPrefetch Prefetch;
+
     /*
         Обязательно между тактами
 
@@ -216,6 +252,55 @@ class GameServer : public AsyncObject {
         /* __attribute__((optimize("O3"))) */ void run(int id);
     } BackingChunkPressure;
 
+    /*
+        Пул шардов мира (World::onUpdate)
+
+            Главный поток выставляет задания и сам разбирает их вместе с пулом,
+            задания берутся по счётчику, порядок результата задаёт мир
+    */
+    struct BackingWorldShards_t {
+        TOS::Logger LOG = "BackingWorldShards";
+        std::atomic<bool> NeedShutdown = false;
+        std::vector<std::thread> Threads;
+        std::unique_ptr<std::barrier<>> Start;
+        std::unique_ptr<std::barrier<>> End;
+
+        const std::function<void(size_t)>* Job = nullptr;
+        size_t JobCount = 0;
+        std::atomic<size_t> NextJob = 0;
+        std::mutex ErrorMutex;
+        std::exception_ptr Error;
+
+        void init(size_t threadCount) {
+            if(threadCount == 0)
+                return;
+
+            const ptrdiff_t participants = static_cast<ptrdiff_t>(threadCount + 1);
+            Start = std::make_unique<std::barrier<>>(participants);
+            End = std::make_unique<std::barrier<>>(participants);
+        }
+
+        // Выполняет job(0..count-1) и дожидается всех, первая ошибка пробрасывается
+        void parallelFor(size_t count, const std::function<void(size_t)>& job);
+
+        void stop() {
+            NeedShutdown.store(true, std::memory_order_release);
+
+            if(Start)
+                Start->arrive_and_drop();
+            if(End)
+                End->arrive_and_drop();
+
+            for(std::thread& thread : Threads)
+                thread.join();
+        }
+
+        void run(int id);
+
+    private:
+        void drain();
+    } BackingWorldShards;
+
     /*
         Генератор шума
     */
@@ -228,11 +313,17 @@ class GameServer : public AsyncObject {
         TOS::Logger LOG = "BackingNoiseGenerator";
         bool NeedShutdown = false;
         std::vector<std::thread> Threads;
-        TOS::SpinlockObject<std::queue<NoiseKey>> Input;
-        TOS::SpinlockObject<std::vector<std::pair<NoiseKey, std::array<float, 64*64*64>>>> Output;
+        // Общий сигнал обеих очередей, предвыборка берётся только при пустой Input
+        EventSignal Signal;
+        WorkQueue<NoiseKey> Input{&Signal}, PrefetchInput{&Signal};
+        MPSCQueue<std::pair<NoiseKey, std::array<float, 64*64*64>>> Output;
+        // Ключи PrefetchInput, ещё не взятые потоками. Ключ, которого здесь нет, при выборке пропускается
+        std::mutex PrefetchMtx;
+        std::unordered_map<WorldId_t, std::unordered_set<Pos::GlobalRegion>> PrefetchQueued;
 
         void stop() {
             NeedShutdown = true;
+            Input.wake();
 
             for(std::thread& thread : Threads)
                 thread.join();
@@ -240,23 +331,61 @@ class GameServer : public AsyncObject {
 
         void run(int id);
 
-        std::vector<std::pair<NoiseKey, std::array<float, 64*64*64>>>
-        tickSync(std::unordered_map<WorldId_t, std::vector<Pos::GlobalRegion>> &&input) {
+        /*
+            Переносит ключ из очереди предвыборки в основную, когда регион понадобился игроку.
+            false, если ключа в очереди предвыборки нет (ещё не пришёл из хранилища или уже в работе)
+        */
+        bool promote(const NoiseKey& key) {
             {
-                auto lock = Input.lock();
-                
-                for(auto& [worldId, region] : input) {
-                    for(auto& regionPos : region) {
-                        lock->push({worldId, regionPos});
-                    }
+                std::lock_guard lock(PrefetchMtx);
+                auto iterWorld = PrefetchQueued.find(key.WId);
+                if(iterWorld == PrefetchQueued.end() || !iterWorld->second.erase(key.RegionPos))
+                    return false;
+
+                if(iterWorld->second.empty())
+                    PrefetchQueued.erase(iterWorld);
+            }
+
+            Input.push(key);
+            return true;
+        }
+
+        // Поток забирает ключ предвыборки, false если он уже перенесён в Input
+        bool takePrefetch(const NoiseKey& key) {
+            std::lock_guard lock(PrefetchMtx);
+            auto iterWorld = PrefetchQueued.find(key.WId);
+            if(iterWorld == PrefetchQueued.end() || !iterWorld->second.erase(key.RegionPos))
+                return false;
+
+            if(iterWorld->second.empty())
+                PrefetchQueued.erase(iterWorld);
+
+            return true;
+        }
+
+        std::vector<std::pair<NoiseKey, std::array<float, 64*64*64>>>
+        tickSync(std::unordered_map<WorldId_t, std::vector<Pos::GlobalRegion>> &&input,
+            std::vector<NoiseKey> &&prefetch = {}
+        ) {
+            std::vector<NoiseKey> keys;
+            for(auto& [worldId, region] : input) {
+                for(auto& regionPos : region) {
+                    keys.push_back({worldId, regionPos});
                 }
             }
 
-            auto lock = Output.lock();
-            std::vector<std::pair<NoiseKey, std::array<float, 64*64*64>>> out = std::move(*lock);
-            lock->reserve(25);
+            Input.push_range(keys);
+            if(!prefetch.empty()) {
+                {
+                    std::lock_guard lock(PrefetchMtx);
+                    for(const NoiseKey& key : prefetch)
+                        PrefetchQueued[key.WId].insert(key.RegionPos);
+                }
 
-            return std::move(out);
+                PrefetchInput.push_range(prefetch);
+            }
+
+            return Output.popAll();
         }
     } BackingNoiseGenerator;
 
@@ -267,9 +396,15 @@ class GameServer : public AsyncObject {
         TOS::Logger LOG = "BackingAsyncLua";
         bool NeedShutdown = false;
         std::vector<std::thread> Threads;
-        TOS::SpinlockObject<std::queue<std::pair<BackingNoiseGenerator_t::NoiseKey, std::array<float, 64*64*64>>>> NoiseIn;
-        TOS::SpinlockObject<std::vector<std::pair<BackingNoiseGenerator_t::NoiseKey, World::RegionIn>>> RegionOut;
+        WorkQueue<std::pair<BackingNoiseGenerator_t::NoiseKey, std::array<float, 64*64*64>>> NoiseIn;
+        MPSCQueue<std::pair<BackingNoiseGenerator_t::NoiseKey, World::RegionIn>> RegionOut;
         ContentManager &CM;
+        // Генераторы миров из модов, исходник загружается в собственное состояние LuaJIT каждого потока.
+        // Заполняется до старта потоков, дальше только читается
+        std::unordered_map<WorldId_t, std::shared_ptr<const ModScript>> Generators;
+        // Сумма куч состояний потоков и запросы сборки мусора от MemoryGovernor
+        std::atomic<size_t> LuaBytes = 0;
+        std::atomic<uint32_t> LuaGcRequests = 0;
 
         BackingAsyncLua_t(ContentManager& cm)
         : CM(cm)
@@ -279,15 +414,138 @@ class GameServer : public AsyncObject {
 
         void stop() {
             NeedShutdown = true;
+            NoiseIn.wake();
 
             for(std::thread& thread : Threads)
                 thread.join();
         }
 
+        // Генератор мода из Generators (LuaRegionGenerator), если он есть и не сломан, иначе встроенный
         void run(int id);
     } BackingAsyncLua;
 
+    /*
+        Полный расчёт освещения загруженных регионов.
+        Регион считается целиком по копии нод, сшивка с соседями остаётся главному потоку
+    */
+    struct BackingLight_t {
+        struct Job {
+            WorldId_t WId;
+            Pos::GlobalRegion RegionPos;
+            uint64_t JobId;
+            std::unique_ptr<RegionNodes> Nodes;
+            // Снимок таблицы света на момент постановки (таблица меняется при перезагрузке модов)
+            std::shared_ptr<const std::vector<NodeLightInfo>> Table;
+        };
+
+        struct Result {
+            WorldId_t WId;
+            Pos::GlobalRegion RegionPos;
+            uint64_t JobId;
+            std::unique_ptr<RegionLight> Light;
+        };
+
+        TOS::Logger LOG = "BackingLight";
+        bool NeedShutdown = false;
+        std::vector<std::thread> Threads;
+        WorkQueue<Job> Input;
+        MPSCQueue<Result> Output;
+
+        void stop() {
+            NeedShutdown = true;
+            Input.wake();
+
+            for(std::thread& thread : Threads)
+                thread.join();
+        }
+
+        void run(int id);
+    } BackingLight;
+
+    /*
+        Воркеры модов (core.register_worker): чистые функции в собственных состояниях Lua потоков.
+        С основным состоянием обмениваются только копиями значений (LuaMessage),
+        ответ возвращается обратному вызову core.post на главном потоке
+    */
+    struct BackingLuaWorkers_t {
+        struct Job {
+            uint64_t Id;
+            uint32_t Worker;
+            LuaMessage Message;
+        };
+
+        struct Result {
+            uint64_t Id;
+            bool Ok;
+            LuaMessage Message;
+            std::string Error;
+        };
+
+        TOS::Logger LOG = "BackingLuaWorkers";
+        bool NeedShutdown = false;
+        std::vector<std::thread> Threads;
+        WorkQueue<Job> Input;
+        std::atomic<size_t> LuaBytes = 0;
+        std::atomic<uint32_t> LuaGcRequests = 0;
+        MPSCQueue<Result> Output;
+        // Индекс - номер воркера. Заполняется до старта потоков, дальше только читается
+        std::vector<std::shared_ptr<const ModScript>> Scripts;
+
+        void stop() {
+            NeedShutdown = true;
+            Input.wake();
+
+            for(std::thread& thread : Threads)
+                thread.join();
+        }
+
+        void run(int id);
+    } BackingLuaWorkers;
+
+    /*
+        Перезагрузка модов по стадиям. Компиляция init.lua модов и сверка ассетов с диском
+        идут в собственном потоке, такт только забирает готовые результаты.
+        Регистрация контента остаётся на такте: она исполняется в LuaMainState,
+        к которому привязаны обработчики нод и задачи модов
+    */
+    struct BackingModReload_t {
+        enum class EnumStage {
+            Idle,
+            // Компилируются init.lua модов
+            Compile,
+            // Ассеты сверяются с диском
+            Assets
+        };
+
+        EnumStage Stage = EnumStage::Idle;
+        std::thread Thread;
+        // Поток закончил стадию, результаты можно забирать
+        std::atomic<bool> Ready = false;
+
+        // Байткод init.lua в порядке LoadedMods, при ошибке компиляции - её текст
+        std::vector<std::string> Chunks;
+        std::string Error;
+
+        // Снимок регистрации ассетов после исполнения модов и результат сверки
+        AssetsPreloader::AssetsRegister Assets;
+        std::optional<AssetsManager::Out_checkAndPrepareResourcesUpdate> AssetsUpdate;
+
+        void compile(std::vector<fs::path> sources);
+        void checkAssets(AssetsManager& am);
+
+        void join() {
+            if(Thread.joinable())
+                Thread.join();
+        }
+    } BackingModReload;
+
     sol::state LuaMainState;
+    // Задачи модов и учёт времени по модам, работает в LuaMainState
+    LuaScheduler LuaTasks{LuaMainState};
+    // Выборочный профилировщик модов, включается по запросу (requestLuaProfilerToggle)
+    LuaProfiler LuaProfile{LuaMainState, LuaTasks};
+    // Куда сохраняются свёрнутые стеки профиля
+    fs::path LuaProfilePath;
     std::vector<ModInfo> LoadedMods;
     std::vector<std::pair<std::string, sol::table>> ModInstances;
     // Идентификатор текущегго мода, находящевося в обработке
@@ -295,6 +553,36 @@ class GameServer : public AsyncObject {
     AssetsPreloader::AssetsRegister AssetsInit;
     DefEntityId PlayerEntityDefId = 0;
 
+    // Генераторы миров из модов (core.register_generator)
+    std::unordered_map<DefWorldId, std::shared_ptr<const ModScript>> WorldGenerators;
+
+    // Воркеры по имени домен:ключ, значение - номер в BackingLuaWorkers.Scripts
+    std::unordered_map<std::string, uint32_t> LuaWorkerNames;
+    // Ожидающие ответа воркера вызовы core.post
+    struct LuaPost {
+        std::string ModId;
+        std::optional<sol::protected_function> Callback;
+    };
+
+    std::unordered_map<uint64_t, LuaPost> LuaPosts;
+    uint64_t NextLuaPostId = 1;
+
+    // Световые свойства нод из профилей (light_source, light_opacity), индекс - DefNodeId
+    std::vector<NodeLightInfo> NodeLightTable;
+    // Копия NodeLightTable для потоков расчёта света, обновляется после регистрации нод
+    std::shared_ptr<const std::vector<NodeLightInfo>> NodeLightShared;
+    // Жидкие ноды из профилей (fluid_viscosity), индекс - DefNodeId
+    std::vector<NodeFluidInfo> NodeFluidTable;
+
+    // Обработчики тактов нод из профилей (on_timer, on_random_tick), индекс - DefNodeId
+    struct {
+        std::vector<std::optional<sol::protected_function>> OnTimer, OnRandomTick;
+        // Мод, зарегистрировавший ноду, для учёта времени обработчиков
+        std::vector<std::string> ModId;
+        // Фильтр случайных тактов для миров
+        std::vector<uint8_t> RandomTickable;
+    } NodeTickHandlers;
+
 public:
     GameServer(asio::io_context &ioc, fs::path worldPath);
     virtual ~GameServer();
@@ -313,6 +601,8 @@ public:
         UseLock.wait_no_use();
     }
     void requestModsReload();
+    // Включает профилировщик Lua, повторный вызов выключает его и сохраняет профиль в папку мира
+    void requestLuaProfilerToggle();
 
     // Подключение tcp сокета
     coro<> pushSocketConnect(tcp::socket socket);
@@ -330,6 +620,27 @@ private:
     void initLuaPre();
     void initLua();
     void initLuaPost();
+    // Загружает init.lua модов из LoadedMods в ModInstances, chunks - уже скомпилированный байткод в том же порядке
+    void loadModInstances(const std::vector<std::string>* chunks = nullptr);
+    // Вызывает событие во всех модах, ошибка мода прерывает загрузку.
+    // Если передан failed, ошибка только записывает мод туда, и он пропускается в следующих событиях
+    void pushModEvent(const std::string& function, std::vector<std::string>* failed = nullptr);
+    // Отключает мод после ошибки, когда откатывать уже нечего: события и обработчики нод больше не вызываются
+    void disableMod(const std::string& modId);
+
+    // Читает скрипт из папки текущего мода (CurrentModId)
+    std::shared_ptr<const ModScript> loadModScript(const std::string& path);
+    void bindNodeTickHandlers(DefNodeId id, const sol::table& profile);
+    void bindNodeLight(DefNodeId id, const sol::table& profile);
+    void bindNodeFluid(DefNodeId id, const sol::table& profile);
+    // Мод, чей код сейчас исполняется: задача или обработчик, иначе загружаемый мод
+    const std::string& luaCurrentMod() const {
+        return LuaTasks.currentMod().empty() ? CurrentModId : LuaTasks.currentMod();
+    }
+    // Передаёт обратным вызовам core.post ответы воркеров
+    void deliverLuaWorkerResults();
+    // Пакетная передача сработавших тактов нод обработчикам модов
+    void dispatchNodeTicks(WorldId_t worldId, std::vector<World::NodeTickEvent>&& events);
 
     /*
         Подключение/отключение игроков
@@ -342,7 +653,18 @@ private:
     */
 
     void stepModInitializations();
-    void reloadMods();
+    void toggleLuaProfiler();
+    // Стадии перезагрузки модов, см. BackingModReload_t
+    void startModsReload();
+    void reloadModsContent();
+    void applyModsReloadAssets();
+
+    /*
+        Учёт памяти раз в MemoryGovernor::CHECK_TICKS тактов и разгрузка под давлением:
+        выгрузка регионов без наблюдателей и сборка мусора Lua.
+        Под жёстким давлением stepDatabaseSync ещё и сокращает задержку выгрузки и откладывает загрузки
+    */
+    void stepMemoryGovernor();
 
     /*
         Пересчёт зон видимости игроков, если необходимо
@@ -356,6 +678,11 @@ private:
     */
 
     IWorldSaveBackend::TickSyncInfo_Out stepDatabaseSync();
+    /*
+        Дозапрашивает регионы на пути игроков и за порталами, к которым они приближаются,
+        после видимых и в пределах PrefetchPerTick. Под давлением памяти не работает
+    */
+    void prefetchRegions(IWorldSaveBackend::TickSyncInfo_In& toDB);
 
     /*
         Синхронизация с генератором карт (отправка запросов на генерацию и получение шума для обработки модами)
@@ -365,6 +692,13 @@ private:
 
     void stepGeneratorAndLuaAsync(IWorldSaveBackend::TickSyncInfo_Out db);
 
+    /*
+        Освещение: новые регионы отправляются на расчёт в пул,
+        готовые результаты устанавливаются в миры и сшиваются с соседями
+    */
+
+    void stepLighting();
+
     /*
         Пакеты игроков получает асинхронный поток в RemoteClient
         Остаётся только обработать распаршенные пакеты 
@@ -0,0 +1,387 @@
+#include "LightEngine.hpp"
+#include "World.hpp"
+
+
+namespace LV::Server {
+
+// Порядок как у граней чанка: +X, -X, +Y, -Y, +Z, -Z
+static const Pos::GlobalNode Dirs[6] = {
+    Pos::GlobalNode(1, 0, 0), Pos::GlobalNode(-1, 0, 0),
+    Pos::GlobalNode(0, 1, 0), Pos::GlobalNode(0, -1, 0),
+    Pos::GlobalNode(0, 0, 1), Pos::GlobalNode(0, 0, -1)
+};
+
+static constexpr int DIR_DOWN = 3;
+
+static Pos::GlobalNode regionBase(Pos::GlobalRegion rPos) {
+    // Покомпонентно: приведение BitVec3 между типами не расширяет знак
+    return Pos::GlobalNode(rPos.x, rPos.y, rPos.z) << 6;
+}
+
+uint8_t LightEngine::Cell::get(int channel) const {
+    uint8_t value = R->Light[Chunk][Index];
+    return channel ? value >> 4 : value & 0xf;
+}
+
+void LightEngine::Cell::set(int channel, uint8_t level) const {
+    uint8_t& value = R->Light[Chunk][Index];
+    value = channel ? (value & 0x0f) | (level << 4) : (value & 0xf0) | level;
+    R->IsChunkChanged_Light |= uint64_t(1) << Chunk;
+}
+
+const Node& LightEngine::Cell::node() const {
+    return R->Nodes[Chunk][Index];
+}
+
+void LightEngine::computeRegion(const RegionNodes& nodes, const std::vector<NodeLightInfo>* table, RegionLight& out) {
+    // Плоская раскладка региона: x | y << 6 | z << 12
+    constexpr uint32_t SIZE = 64*64*64;
+    std::vector<uint8_t> opacity(SIZE), block(SIZE, 0), sky(SIZE, 0);
+    std::vector<uint32_t> queue;
+
+    auto flat = [](uint32_t chunk, uint32_t index) -> uint32_t {
+        uint32_t x = ((chunk & 3) << 4) | (index & 15);
+        uint32_t y = (((chunk >> 2) & 3) << 4) | ((index >> 4) & 15);
+        uint32_t z = ((chunk >> 4) << 4) | (index >> 8);
+        return x | (y << 6) | (z << 12);
+    };
+
+    for(uint32_t chunk = 0; chunk < 64; chunk++) {
+        for(uint32_t index = 0; index < 16*16*16; index++) {
+            NodeLightInfo info = lookup(table, nodes[chunk][index].NodeId);
+            uint32_t iter = flat(chunk, index);
+            opacity[iter] = info.Opacity;
+
+            if(info.Emission) {
+                block[iter] = info.Emission;
+                queue.push_back(iter);
+            }
+        }
+    }
+
+    auto flood = [&](std::vector<uint8_t>& light, bool isSky) {
+        for(size_t head = 0; head < queue.size(); head++) {
+            uint32_t iter = queue[head];
+            uint8_t level = light[iter];
+            if(level <= 1)
+                continue;
+
+            int x = iter & 63, y = (iter >> 6) & 63, z = iter >> 12;
+
+            auto visit = [&](int nx, int ny, int nz, bool down) {
+                if((nx | ny | nz) & ~63)
+                    return;
+
+                uint32_t next = nx | (ny << 6) | (nz << 12);
+                uint8_t value = attenuate(level, opacity[next], isSky && down);
+                if(value > light[next]) {
+                    light[next] = value;
+                    queue.push_back(next);
+                }
+            };
+
+            visit(x+1, y, z, false);
+            visit(x-1, y, z, false);
+            visit(x, y+1, z, false);
+            visit(x, y-1, z, true);
+            visit(x, y, z+1, false);
+            visit(x, y, z-1, false);
+        }
+
+        queue.clear();
+    };
+
+    flood(block, false);
+
+    // Столбы неба сверху вниз, затем заливка от тех, кто может осветить соседей сбоку
+    for(uint32_t z = 0; z < 64; z++)
+        for(uint32_t x = 0; x < 64; x++) {
+            uint8_t level = MAX_LEVEL;
+            for(int y = 63; y >= 0 && level; y--) {
+                uint32_t iter = x | (y << 6) | (z << 12);
+                level = attenuate(level, opacity[iter], true);
+                sky[iter] = level;
+            }
+        }
+
+    for(uint32_t iter = 0; iter < SIZE; iter++) {
+        uint8_t level = sky[iter];
+        if(level <= 1)
+            continue;
+
+        int x = iter & 63, z = iter >> 12;
+        auto brighter = [&](int nx, int nz) {
+            if((nx | nz) & ~63)
+                return false;
+
+            uint32_t next = nx | (iter & (63 << 6)) | (nz << 12);
+            return attenuate(level, opacity[next], false) > sky[next];
+        };
+
+        if(brighter(x+1, z) || brighter(x-1, z) || brighter(x, z+1) || brighter(x, z-1))
+            queue.push_back(iter);
+    }
+
+    flood(sky, true);
+
+    for(uint32_t chunk = 0; chunk < 64; chunk++)
+        for(uint32_t index = 0; index < 16*16*16; index++) {
+            uint32_t iter = flat(chunk, index);
+            out[chunk][index] = block[iter] | (sky[iter] << 4);
+        }
+}
+
+void LightEngine::installRegion(Pos::GlobalRegion rPos, const RegionLight& light) {
+    resetCache();
+
+    auto iterRegion = Regions.find(rPos);
+    if(iterRegion == Regions.end())
+        return;
+
+    Region& region = *iterRegion->second;
+    region.Light = light;
+    region.LightReady = true;
+    region.IsChunkChanged_Light = ~uint64_t(0);
+
+    // Регион считался под открытым небом, а нижний сосед - под открытым небом над собой
+    const Pos::GlobalRegion up = rPos + Pos::GlobalRegion(0, 1, 0);
+    const Pos::GlobalRegion down = rPos + Pos::GlobalRegion(0, -1, 0);
+    if(readyRegion(up))
+        dimSkyBelow(up, rPos);
+    if(readyRegion(down))
+        dimSkyBelow(rPos, down);
+
+    // Сшивка: обе ноды каждой пары на общей грани ставятся в очередь распространения
+    const Pos::GlobalNode base = regionBase(rPos);
+    for(int face = 0; face < 6; face++) {
+        if(!readyRegion(rPos + Pos::GlobalRegion(Dirs[face].x, Dirs[face].y, Dirs[face].z)))
+            continue;
+
+        const int axis = face >> 1;
+        for(int u = 0; u < 64; u++)
+            for(int v = 0; v < 64; v++) {
+                int coord[3];
+                coord[axis] = (face & 1) ? 0 : 63;
+                coord[(axis+1) % 3] = u;
+                coord[(axis+2) % 3] = v;
+
+                Pos::GlobalNode inner = base + Pos::GlobalNode(coord[0], coord[1], coord[2]);
+                Pos::GlobalNode outer = inner + Dirs[face];
+                for(int channel = 0; channel < 2; channel++) {
+                    AddQueue[channel].push_back(inner);
+                    AddQueue[channel].push_back(outer);
+                }
+            }
+    }
+
+    // Изменения, пришедшие пока свет считался в пуле
+    std::vector<Pos::GlobalNode> edits = std::move(region.LightPendingEdits);
+    for(Pos::GlobalNode pos : edits)
+        onNodeChanged(pos);
+}
+
+void LightEngine::onRegionUnloaded(Pos::GlobalRegion rPos) {
+    resetCache();
+
+    // Свет соседей у общей грани мог прийти из выгруженного региона: снимается и восстанавливается
+    // от оставшихся источников (у нижнего соседа источником снова становится открытое небо)
+    const Pos::GlobalNode base = regionBase(rPos);
+    for(int face = 0; face < 6; face++) {
+        if(!readyRegion(rPos + Pos::GlobalRegion(Dirs[face].x, Dirs[face].y, Dirs[face].z)))
+            continue;
+
+        const int axis = face >> 1;
+        for(int u = 0; u < 64; u++)
+            for(int v = 0; v < 64; v++) {
+                int coord[3];
+                coord[axis] = (face & 1) ? -1 : 64;
+                coord[(axis+1) % 3] = u;
+                coord[(axis+2) % 3] = v;
+
+                Pos::GlobalNode pos = base + Pos::GlobalNode(coord[0], coord[1], coord[2]);
+                Cell outer = cell(pos);
+                for(int channel = 0; channel < 2; channel++) {
+                    removeAt(channel, pos, outer);
+                    if(uint8_t level = sourceLevel(channel, pos, outer))
+                        Relight[channel].push_back({pos, level});
+                }
+            }
+    }
+}
+
+void LightEngine::onNodeChanged(Pos::GlobalNode pos) {
+    resetCache();
+
+    Cell target = cell(pos);
+    if(!target) {
+        auto iterRegion = Regions.find(pos >> 6);
+        if(iterRegion != Regions.end())
+            iterRegion->second->LightPendingEdits.push_back(pos);
+
+        return;
+    }
+
+    // Свет ноды снимается целиком и восстанавливается от источника и соседей
+    for(int channel = 0; channel < 2; channel++) {
+        removeAt(channel, pos, target);
+        if(uint8_t level = sourceLevel(channel, pos, target))
+            Relight[channel].push_back({pos, level});
+
+        for(const Pos::GlobalNode& dir : Dirs)
+            if(cell(pos + dir))
+                AddQueue[channel].push_back(pos + dir);
+    }
+}
+
+void LightEngine::update() {
+    resetCache();
+
+    for(int channel = 0; channel < 2; channel++) {
+        processRemove(channel);
+
+        for(const Entry& entry : Relight[channel]) {
+            Cell target = cell(entry.Pos);
+            if(target && entry.Level > target.get(channel)) {
+                target.set(channel, entry.Level);
+                AddQueue[channel].push_back(entry.Pos);
+            }
+        }
+
+        Relight[channel].clear();
+        processAdd(channel);
+    }
+}
+
+Region* LightEngine::readyRegion(Pos::GlobalRegion rPos) {
+    if(HasCached && CachedPos == rPos)
+        return CachedRegion;
+
+    auto iterRegion = Regions.find(rPos);
+    CachedRegion = iterRegion != Regions.end() && iterRegion->second->LightReady ? iterRegion->second.get() : nullptr;
+    CachedPos = rPos;
+    HasCached = true;
+    return CachedRegion;
+}
+
+LightEngine::Cell LightEngine::cell(Pos::GlobalNode pos) {
+    return cellIn(readyRegion(pos >> 6), pos);
+}
+
+LightEngine::Cell LightEngine::cellIn(Region* region, Pos::GlobalNode pos) {
+    Cell out;
+    out.R = region;
+    out.Chunk = ((pos.x >> 4) & 3) | (((pos.y >> 4) & 3) << 2) | (((pos.z >> 4) & 3) << 4);
+    out.Index = (pos.x & 15) | ((pos.y & 15) << 4) | ((pos.z & 15) << 8);
+    return out;
+}
+
+uint8_t LightEngine::sourceLevel(int channel, Pos::GlobalNode pos, const Cell& target) {
+    NodeLightInfo info = lookup(Table, target.node().NodeId);
+    if(channel == 0)
+        return info.Emission;
+
+    if((pos.y & 63) != 63)
+        return 0;
+
+    Pos::GlobalRegion rPos = pos >> 6;
+    if(readyRegion(rPos + Pos::GlobalRegion(0, 1, 0)))
+        return 0;
+
+    return attenuate(MAX_LEVEL, info.Opacity, true);
+}
+
+void LightEngine::removeAt(int channel, Pos::GlobalNode pos, const Cell& target) {
+    uint8_t level = target.get(channel);
+    if(!level)
+        return;
+
+    target.set(channel, 0);
+    RemoveQueue[channel].push_back({pos, level});
+}
+
+void LightEngine::dimSkyBelow(Pos::GlobalRegion upper, Pos::GlobalRegion lower) {
+    const Pos::GlobalNode base = regionBase(lower);
+    // Грань лежит в двух регионах, обращения чередуются и кеш одного региона не помогает
+    Region* upperRegion = readyRegion(upper);
+    Region* lowerRegion = readyRegion(lower);
+    if(!upperRegion || !lowerRegion)
+        return;
+
+    for(int z = 0; z < 64; z++)
+        for(int x = 0; x < 64; x++) {
+            Pos::GlobalNode top = base + Pos::GlobalNode(x, 63, z);
+            Pos::GlobalNode above = top + Dirs[2];
+
+            if(cellIn(upperRegion, above).get(1) < MAX_LEVEL)
+                removeAt(1, top, cellIn(lowerRegion, top));
+
+            AddQueue[1].push_back(above);
+        }
+}
+
+void LightEngine::processRemove(int channel) {
+    std::vector<Entry>& queue = RemoveQueue[channel];
+
+    for(size_t head = 0; head < queue.size(); head++) {
+        const Entry entry = queue[head];
+
+        for(int dir = 0; dir < 6; dir++) {
+            Pos::GlobalNode pos = entry.Pos + Dirs[dir];
+            Cell next = cell(pos);
+            if(!next)
+                continue;
+
+            uint8_t level = next.get(channel);
+            if(!level)
+                continue;
+
+            // Более тусклый сосед (или столб неба под нодой) светился от неё
+            bool fromEntry = level < entry.Level
+                || (channel == 1 && dir == DIR_DOWN && entry.Level == MAX_LEVEL && level == MAX_LEVEL);
+
+            if(fromEntry) {
+                next.set(channel, 0);
+                queue.push_back({pos, level});
+
+                if(uint8_t source = sourceLevel(channel, pos, next))
+                    Relight[channel].push_back({pos, source});
+            } else {
+                AddQueue[channel].push_back(pos);
+            }
+        }
+    }
+
+    queue.clear();
+}
+
+void LightEngine::processAdd(int channel) {
+    std::vector<Pos::GlobalNode>& queue = AddQueue[channel];
+
+    for(size_t head = 0; head < queue.size(); head++) {
+        const Pos::GlobalNode pos = queue[head];
+        Cell from = cell(pos);
+        if(!from)
+            continue;
+
+        uint8_t level = from.get(channel);
+        if(level <= 1)
+            continue;
+
+        for(int dir = 0; dir < 6; dir++) {
+            Pos::GlobalNode nextPos = pos + Dirs[dir];
+            Cell next = cell(nextPos);
+            if(!next)
+                continue;
+
+            uint8_t value = attenuate(level, lookup(Table, next.node().NodeId).Opacity, channel == 1 && dir == DIR_DOWN);
+            if(value > next.get(channel)) {
+                next.set(channel, value);
+                queue.push_back(nextPos);
+            }
+        }
+    }
+
+    queue.clear();
+}
+
+}
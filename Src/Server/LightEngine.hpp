@@ -0,0 +1,140 @@
+#pragma once
+
+#include "Common/Abstract.hpp"
+#include "Server/Abstract.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+
+namespace LV::Server {
+
+class Region;
+
+// Световые свойства ноды
+struct NodeLightInfo {
+    // Собственное свечение, 0..15
+    uint8_t Emission = 0;
+    // Ослабление света при прохождении через ноду, 15 - не пропускает
+    uint8_t Opacity = 15;
+};
+
+using RegionNodes = std::array<std::array<Node, 16*16*16>, 4*4*4>;
+using RegionLight = std::array<ChunkLight, 4*4*4>;
+
+/*
+    Распространение света по нодам мира (заливка в ширину).
+
+    Два канала: свет от источников и небесный свет. За шаг свет теряет max(1, Opacity) уровней,
+    небесный свет максимального уровня опускается вниз (по -Y) через прозрачные ноды без потерь.
+    Небо считается открытым над верхней гранью региона, если регион выше не загружен.
+
+    Полный расчёт региона (computeRegion) не трогает мир и выполняется в пуле потоков.
+    Дальше регион сшивается с соседями, а изменения нод обрабатываются инкрементально
+    очередями удаления и распространения, которые свободно переходят между чанками и регионами.
+    Регионы без установленного света (LightReady) для движка не существуют.
+*/
+class LightEngine {
+public:
+    static constexpr uint8_t MAX_LEVEL = 15;
+
+    explicit LightEngine(std::unordered_map<Pos::GlobalRegion, std::unique_ptr<Region>>& regions)
+        : Regions(regions)
+    {}
+
+    // Свойства нод, индекс - DefNodeId. Без таблицы прозрачен только воздух (0)
+    void setNodeTable(const std::vector<NodeLightInfo>* table) {
+        Table = table;
+    }
+
+    // Освещение региона без учёта соседей, над регионом открытое небо. Потокобезопасна
+    static void computeRegion(const RegionNodes& nodes, const std::vector<NodeLightInfo>* table, RegionLight& out);
+
+    // Устанавливает рассчитанный свет и ставит в очереди сшивку с загруженными соседями
+    void installRegion(Pos::GlobalRegion rPos, const RegionLight& light);
+    // Регион выгружен (вызывается после удаления из Regions): пересчёт света соседей у его граней
+    void onRegionUnloaded(Pos::GlobalRegion rPos);
+    // Нода в pos изменилась. Для региона без света изменение откладывается до installRegion
+    void onNodeChanged(Pos::GlobalNode pos);
+
+    // Разбирает очереди удаления и распространения
+    void update();
+
+    bool hasWork() const {
+        for(int channel = 0; channel < 2; channel++)
+            if(!RemoveQueue[channel].empty() || !AddQueue[channel].empty() || !Relight[channel].empty())
+                return true;
+
+        return false;
+    }
+
+    static NodeLightInfo lookup(const std::vector<NodeLightInfo>* table, DefNodeId id) {
+        if(table && id < table->size())
+            return (*table)[id];
+
+        return id == 0 ? NodeLightInfo{0, 0} : NodeLightInfo{};
+    }
+
+    // Уровень после входа света level в ноду с прозрачностью opacity
+    static uint8_t attenuate(uint8_t level, uint8_t opacity, bool skyDown) {
+        if(opacity >= MAX_LEVEL)
+            return 0;
+
+        if(skyDown && level == MAX_LEVEL && opacity == 0)
+            return MAX_LEVEL;
+
+        uint8_t loss = std::max<uint8_t>(opacity, 1);
+        return level > loss ? level-loss : 0;
+    }
+
+private:
+    // Нода загруженного региона со светом
+    struct Cell {
+        Region* R = nullptr;
+        uint8_t Chunk = 0;
+        uint16_t Index = 0;
+
+        explicit operator bool() const { return R; }
+        uint8_t get(int channel) const;
+        void set(int channel, uint8_t level) const;
+        const Node& node() const;
+    };
+
+    struct Entry {
+        Pos::GlobalNode Pos;
+        uint8_t Level;
+    };
+
+    std::unordered_map<Pos::GlobalRegion, std::unique_ptr<Region>>& Regions;
+    const std::vector<NodeLightInfo>* Table = nullptr;
+
+    // Канал 0 - источники, 1 - небо
+    std::vector<Entry> RemoveQueue[2];
+    std::vector<Pos::GlobalNode> AddQueue[2];
+    // Источники, восстанавливаемые после удаления
+    std::vector<Entry> Relight[2];
+
+    // Последний найденный регион, заливка редко выходит за его пределы
+    Pos::GlobalRegion CachedPos;
+    Region* CachedRegion = nullptr;
+    bool HasCached = false;
+
+    Region* readyRegion(Pos::GlobalRegion rPos);
+    Cell cell(Pos::GlobalNode pos);
+    // Нода в уже найденном регионе, без поиска по таблице
+    static Cell cellIn(Region* region, Pos::GlobalNode pos);
+    void resetCache() { HasCached = false; }
+
+    // Собственный уровень ноды в канале: свечение или открытое небо над регионом
+    uint8_t sourceLevel(int channel, Pos::GlobalNode pos, const Cell& cell);
+    void removeAt(int channel, Pos::GlobalNode pos, const Cell& cell);
+    // Через грань upper (нижний слой) -> lower (верхний слой) небо стало темнее, чем открытое
+    void dimSkyBelow(Pos::GlobalRegion upper, Pos::GlobalRegion lower);
+    void processRemove(int channel);
+    void processAdd(int channel);
+};
+
+}
@@ -0,0 +1,61 @@
+#include "LuaMessage.hpp"
+#include "TOSLib.hpp"
+
+
+namespace LV::Server {
+
+LuaMessage LuaMessage::fromLua(const sol::object& object, int depth) {
+    LuaMessage out;
+
+    switch(object.get_type()) {
+    case sol::type::lua_nil:
+    case sol::type::none:
+        break;
+    case sol::type::boolean:
+        out.Value = object.as<bool>();
+        break;
+    case sol::type::number:
+        out.Value = object.as<double>();
+        break;
+    case sol::type::string:
+        out.Value = object.as<std::string>();
+        break;
+    case sol::type::table: {
+        if(depth >= MAX_DEPTH)
+            MAKE_ERROR("Слишком глубокая вложенность таблиц в сообщении");
+
+        Table table;
+        for(const auto& [key, value] : object.as<sol::table>()) {
+            table.Items.push_back(fromLua(key, depth+1));
+            table.Items.push_back(fromLua(value, depth+1));
+        }
+
+        out.Value = std::move(table);
+        break;
+    }
+    default:
+        MAKE_ERROR("Значение типа " << sol::type_name(object.lua_state(), object.get_type()) << " нельзя передать в другое состояние Lua");
+    }
+
+    return out;
+}
+
+sol::object LuaMessage::toLua(sol::state_view lua) const {
+    return std::visit([&](const auto& value) -> sol::object {
+        using T = std::decay_t<decltype(value)>;
+
+        if constexpr(std::is_same_v<T, std::monostate>) {
+            return sol::make_object(lua, sol::lua_nil);
+        } else if constexpr(std::is_same_v<T, Table>) {
+            sol::table table = lua.create_table(0, int(value.Items.size() / 2));
+            for(size_t iter = 0; iter+1 < value.Items.size(); iter += 2)
+                table[value.Items[iter].toLua(lua)] = value.Items[iter+1].toLua(lua);
+
+            return table;
+        } else {
+            return sol::make_object(lua, value);
+        }
+    }, Value);
+}
+
+}
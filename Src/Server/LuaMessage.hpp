@@ -0,0 +1,30 @@
+#pragma once
+
+#include <sol/sol.hpp>
+#include <string>
+#include <variant>
+#include <vector>
+
+
+namespace LV::Server {
+
+/*
+    Значение, передаваемое между состояниями Lua.
+    Допускаются nil, boolean, number, string и таблицы из них (без циклов и функций),
+    всё копируется, общих ссылок между состояниями нет.
+*/
+struct LuaMessage {
+    static constexpr int MAX_DEPTH = 32;
+
+    // Пары ключ, значение подряд
+    struct Table {
+        std::vector<LuaMessage> Items;
+    };
+
+    std::variant<std::monostate, bool, double, std::string, Table> Value;
+
+    static LuaMessage fromLua(const sol::object& object, int depth = 0);
+    sol::object toLua(sol::state_view lua) const;
+};
+
+}
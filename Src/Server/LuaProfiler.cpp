@@ -0,0 +1,111 @@
+#include "LuaProfiler.hpp"
+#include <algorithm>
+#include <fstream>
+
+
+namespace LV::Server {
+
+// Включённый профилировщик (для ловушки)
+static LuaProfiler* ActiveProfiler = nullptr;
+
+LuaProfiler::~LuaProfiler() {
+    stop();
+}
+
+void LuaProfiler::start() {
+    if(Running)
+        return;
+
+    Costs.clear();
+    Stacks.clear();
+
+    lua_State* L = Lua.lua_state();
+    PrevAlloc = lua_getallocf(L, &PrevAllocUd);
+    lua_setallocf(L, &LuaProfiler::alloc, this);
+
+    ActiveProfiler = this;
+    lua_sethook(L, &LuaProfiler::hook, LUA_MASKCOUNT, SAMPLE_INSTRUCTIONS);
+    Running = true;
+}
+
+void LuaProfiler::stop() {
+    if(!Running)
+        return;
+
+    lua_State* L = Lua.lua_state();
+    lua_sethook(L, nullptr, 0, 0);
+    ActiveProfiler = nullptr;
+
+    // Блоки, выделенные через обёртку, принадлежат тому же распределителю
+    lua_setallocf(L, PrevAlloc, PrevAllocUd);
+    Running = false;
+}
+
+void LuaProfiler::dumpFolded(const std::filesystem::path& path) const {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if(!out)
+        MAKE_ERROR("Не удалось открыть файл профиля " << path);
+
+    for(const auto& [stack, count] : Stacks)
+        out << stack << ' ' << count << '\n';
+}
+
+LuaProfiler::ModCost& LuaProfiler::currentCost() {
+    const std::string& mod = Tasks.currentMod();
+    return Costs[mod.empty() ? "?" : mod];
+}
+
+void LuaProfiler::sample(lua_State* L) {
+    currentCost().Samples++;
+
+    Frames.clear();
+    lua_Debug info;
+    for(int level = 0; level < MAX_DEPTH && lua_getstack(L, level, &info); level++) {
+        if(!lua_getinfo(L, "Sn", &info))
+            break;
+
+        std::string frame = info.name ? info.name : (*info.what == 'm' ? "main" : "?");
+        if(*info.what != 'C') {
+            frame += " (";
+            frame += info.short_src;
+            frame += ':';
+            frame += std::to_string(info.linedefined);
+            frame += ')';
+        }
+
+        // ';' разделяет кадры в свёрнутом стеке
+        std::replace(frame.begin(), frame.end(), ';', ':');
+        Frames.push_back(std::move(frame));
+    }
+
+    const std::string& mod = Tasks.currentMod();
+    Folded = mod.empty() ? "?" : mod;
+    for(size_t iter = Frames.size(); iter-- > 0;) {
+        Folded += ';';
+        Folded += Frames[iter];
+    }
+
+    Stacks[Folded]++;
+}
+
+void LuaProfiler::hook(lua_State* L, lua_Debug* ar) {
+    if(ActiveProfiler && ar->event == LUA_HOOKCOUNT)
+        ActiveProfiler->sample(L);
+}
+
+void* LuaProfiler::alloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+    LuaProfiler* self = static_cast<LuaProfiler*>(ud);
+
+    // Освобождения и сжатия не считаются, при ptr == nullptr osize не несёт размера
+    size_t had = ptr ? osize : 0;
+    if(nsize > had) {
+        ModCost& cost = self->currentCost();
+        if(!ptr)
+            cost.Allocations++;
+        cost.AllocatedBytes += nsize - had;
+    }
+
+    return self->PrevAlloc(self->PrevAllocUd, ptr, osize, nsize);
+}
+
+}
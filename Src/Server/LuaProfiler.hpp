@@ -0,0 +1,77 @@
+#pragma once
+
+#include "LuaScheduler.hpp"
+#include "TOSLib.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <sol/sol.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace LV::Server {
+
+/*
+    Выборочный профилировщик основного состояния Lua.
+
+    Ловушка счётчика инструкций раз в SAMPLE_INSTRUCTIONS инструкций снимает стек Lua
+    и относит выборку к моду, чей код исполняется (LuaScheduler::currentMod).
+    Обёртка распределителя памяти считает выделения по модам так же.
+    Пока профилировщик выключен, ни ловушки, ни обёртки нет и он ничего не стоит.
+
+    В LuaJIT ловушка одна на состояние, а с ней код исполняется интерпретатором,
+    поэтому время под профилировщиком выше обычного, но доли модов сохраняются.
+    Время в функциях C++ выборками не покрывается: оно есть в LuaScheduler::stats.
+*/
+class LuaProfiler {
+public:
+    // Совпадает с периодом планировщика, пока он работает, выборки идут через его ловушку
+    static constexpr int SAMPLE_INSTRUCTIONS = LuaScheduler::HOOK_INSTRUCTIONS;
+    static constexpr int MAX_DEPTH = 64;
+
+    struct ModCost {
+        uint64_t Samples = 0;
+        uint64_t Allocations = 0;
+        uint64_t AllocatedBytes = 0;
+    };
+
+    LuaProfiler(sol::state& lua, const LuaScheduler& tasks)
+        : Lua(lua), Tasks(tasks)
+    {}
+
+    // Возвращает распределитель состоянию до его закрытия
+    ~LuaProfiler();
+
+    // Начинает новый замер, прошлые выборки сбрасываются
+    void start();
+    void stop();
+    bool isRunning() const { return Running; }
+
+    const std::unordered_map<std::string, ModCost>& costs() const { return Costs; }
+
+    // Свёрнутые стеки для flamegraph.pl и speedscope: "мод;функция;...;функция выборки"
+    void dumpFolded(const std::filesystem::path& path) const;
+
+private:
+    TOS::Logger LOG = "LuaProfiler";
+    sol::state& Lua;
+    const LuaScheduler& Tasks;
+    bool Running = false;
+
+    lua_Alloc PrevAlloc = nullptr;
+    void* PrevAllocUd = nullptr;
+
+    std::unordered_map<std::string, ModCost> Costs;
+    std::unordered_map<std::string, uint64_t> Stacks;
+    std::vector<std::string> Frames;
+    std::string Folded;
+
+    ModCost& currentCost();
+    void sample(lua_State* L);
+
+    static void hook(lua_State* L, lua_Debug* ar);
+    static void* alloc(void* ud, void* ptr, size_t osize, size_t nsize);
+};
+
+}
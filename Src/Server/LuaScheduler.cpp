@@ -0,0 +1,144 @@
+#include "LuaScheduler.hpp"
+#include <algorithm>
+
+
+namespace LV::Server {
+
+// Планировщик, задачи которого сейчас исполняются (для ловушки счётчика инструкций)
+static thread_local LuaScheduler* ActiveScheduler = nullptr;
+
+LuaScheduler::~LuaScheduler() {
+    // Ссылки задач живут в состоянии Lua, поэтому освобождаются до него
+    Tasks.clear();
+}
+
+uint32_t LuaScheduler::spawn(const std::string& modId, sol::protected_function func) {
+    auto task = std::make_unique<Task>();
+    task->Id = NextId++;
+    task->ModId = modId;
+    task->Thread = sol::thread::create(Lua.lua_state());
+    task->Func = std::move(func);
+
+    uint32_t id = task->Id;
+    Tasks.push_back(std::move(task));
+    return id;
+}
+
+bool LuaScheduler::cancel(uint32_t id) {
+    for(std::unique_ptr<Task>& task : Tasks) {
+        if(task->Id != id || task->Cancelled)
+            continue;
+
+        // Задача может отменить саму себя, поэтому удаляется она в run
+        task->Cancelled = true;
+        return true;
+    }
+
+    return false;
+}
+
+void LuaScheduler::clear() {
+    Tasks.clear();
+    Cursor = 0;
+}
+
+void LuaScheduler::run(Clock::duration budget) {
+    if(Tasks.empty())
+        return;
+
+    const Clock::time_point end = Clock::now() + budget;
+    lua_State* mainState = Lua.lua_state();
+
+    PrevHook = lua_gethook(mainState);
+    const int prevMask = lua_gethookmask(mainState), prevCount = lua_gethookcount(mainState);
+
+    ActiveScheduler = this;
+    lua_sethook(mainState, &LuaScheduler::hook, LUA_MASKCOUNT, HOOK_INSTRUCTIONS);
+
+    // За такт каждая задача возобновляется не больше одного раза
+    size_t left = Tasks.size();
+    while(left && !Tasks.empty()) {
+        if(Cursor >= Tasks.size())
+            Cursor = 0;
+
+        Task& task = *Tasks[Cursor];
+        if(task.Cancelled) {
+            Tasks.erase(Tasks.begin()+Cursor);
+            left--;
+            continue;
+        }
+
+        Clock::time_point start = Clock::now();
+        if(start >= end)
+            break;
+
+        SliceDeadline = start + std::max<Clock::duration>((end-start) / left, MIN_SLICE);
+        left--;
+
+        lua_State* L = task.Thread.thread_state();
+        if(!task.Started) {
+            task.Started = true;
+            sol::stack::push(L, task.Func);
+            task.Func = sol::lua_nil;
+        } else {
+            // Значения, отданные через yield, не нужны
+            lua_settop(L, 0);
+        }
+
+        Current = &task;
+        task.Preempted = false;
+        CurrentMod = task.ModId;
+
+        // LuaJIT: lua_resume(L, narg)
+        int status = lua_resume(L, 0);
+
+        Current = nullptr;
+        CurrentMod.clear();
+
+        ModStats& stats = Stats[task.ModId];
+        stats.Time += Clock::now() - start;
+        stats.Resumes++;
+        if(task.Preempted)
+            stats.Preemptions++;
+
+        if(status != 0 && status != LUA_YIELD) {
+            stats.Errors++;
+            const char* message = lua_tostring(L, -1);
+            LOG.warn() << "Ошибка в задаче " << task.Id << " мода " << task.ModId << ":\n" << (message ? message : "?");
+        }
+
+        if(status != LUA_YIELD || task.Cancelled)
+            Tasks.erase(Tasks.begin()+Cursor);
+        else
+            Cursor++;
+    }
+
+    lua_sethook(mainState, PrevHook, prevMask, prevCount);
+    PrevHook = nullptr;
+    ActiveScheduler = nullptr;
+}
+
+void LuaScheduler::hook(lua_State* L, lua_Debug* ar) {
+    LuaScheduler* self = ActiveScheduler;
+    if(!self)
+        return;
+
+    if(self->PrevHook)
+        self->PrevHook(L, ar);
+
+    if(!self->Current || L != self->Current->Thread.thread_state())
+        return;
+
+    if(Clock::now() < self->SliceDeadline)
+        return;
+
+    // Изнутри вызова C++ уступить нельзя, задача остановится на следующем срабатывании
+    if(!lua_isyieldable(L))
+        return;
+
+    self->Current->Preempted = true;
+    // LuaJIT позволяет уступать из ловушки, исполнение продолжится с той же инструкции
+    lua_yield(L, 0);
+}
+
+}
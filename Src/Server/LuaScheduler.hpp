@@ -0,0 +1,115 @@
+#pragma once
+
+#include "TOSLib.hpp"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <sol/sol.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace LV::Server {
+
+/*
+    Сопрограммы модов в основном состоянии Lua.
+
+    Задача (core.spawn) исполняется в своей сопрограмме и возобновляется по кругу
+    в пределах бюджета такта. Задача может уступить сама (coroutine.yield),
+    иначе её вытесняет счётчик инструкций: раз в HOOK_INSTRUCTIONS инструкций ловушка
+    сверяет время с окончанием отведённого кванта и уступает за задачу.
+    Пока ловушка стоит, LuaJIT исполняет код интерпретатором, поэтому она ставится только на время run.
+    Ловушка в состоянии одна, прежняя на время run вызывается из ловушки планировщика.
+
+    Здесь же ведётся учёт времени по модам: задачи и синхронные вызовы обработчиков через call.
+*/
+class LuaScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr int HOOK_INSTRUCTIONS = 1000;
+    // Бюджет задач по умолчанию, из 33 мс такта
+    static constexpr std::chrono::microseconds DEFAULT_BUDGET{4000};
+    // Меньше кванта задача не получает, даже если бюджет почти исчерпан
+    static constexpr std::chrono::microseconds MIN_SLICE{200};
+
+    struct ModStats {
+        // Всего в коде мода: задачи и обработчики
+        Clock::duration Time{0};
+        uint64_t Calls = 0;
+        uint64_t Resumes = 0;
+        // Сколько раз задачу остановил счётчик инструкций
+        uint64_t Preemptions = 0;
+        uint64_t Errors = 0;
+    };
+
+    explicit LuaScheduler(sol::state& lua)
+        : Lua(lua)
+    {}
+
+    ~LuaScheduler();
+
+    // Новая задача мода, первый раз запускается в ближайшем run
+    uint32_t spawn(const std::string& modId, sol::protected_function func);
+    bool cancel(uint32_t id);
+    // Снимает все задачи, например перед перезагрузкой модов
+    void clear();
+    size_t taskCount() const { return Tasks.size(); }
+
+    // Возобновляет задачи по кругу, пока не исчерпан бюджет
+    void run(Clock::duration budget);
+
+    // Синхронный вызов обработчика мода с учётом времени
+    template<typename... Args>
+    sol::protected_function_result call(const std::string& modId, const sol::protected_function& func, Args&&... args) {
+        std::string previous = std::move(CurrentMod);
+        CurrentMod = modId;
+
+        Clock::time_point start = Clock::now();
+        sol::protected_function_result result = func(std::forward<Args>(args)...);
+
+        ModStats& stats = Stats[modId];
+        stats.Time += Clock::now() - start;
+        stats.Calls++;
+        if(!result.valid())
+            stats.Errors++;
+
+        CurrentMod = std::move(previous);
+        return result;
+    }
+
+    // Мод, чей код сейчас исполняется (пусто вне call и задач)
+    const std::string& currentMod() const { return CurrentMod; }
+
+    const std::unordered_map<std::string, ModStats>& stats() const { return Stats; }
+
+private:
+    struct Task {
+        uint32_t Id;
+        std::string ModId;
+        sol::thread Thread;
+        // Функция задачи до первого запуска
+        sol::protected_function Func;
+        bool Started = false, Preempted = false, Cancelled = false;
+    };
+
+    TOS::Logger LOG = "LuaScheduler";
+    sol::state& Lua;
+    std::vector<std::unique_ptr<Task>> Tasks;
+    size_t Cursor = 0;
+    uint32_t NextId = 1;
+
+    std::unordered_map<std::string, ModStats> Stats;
+    std::string CurrentMod;
+
+    // Для ловушки: исполняемая задача и конец её кванта
+    Task* Current = nullptr;
+    Clock::time_point SliceDeadline;
+    // Ловушка, стоявшая до run (профилировщик), вызывается из своей
+    lua_Hook PrevHook = nullptr;
+
+    static void hook(lua_State* L, lua_Debug* ar);
+};
+
+}
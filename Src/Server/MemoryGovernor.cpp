@@ -0,0 +1,80 @@
+#include "MemoryGovernor.hpp"
+#include <algorithm>
+#include <sol/sol.hpp>
+
+
+namespace LV::Server {
+
+void MemoryGovernor::setConfig(const Config& config) {
+    Cfg = config;
+    Cfg.SoftWatermark = std::clamp(Cfg.SoftWatermark, 0.1f, 1.0f);
+    Cfg.HardWatermark = std::clamp(Cfg.HardWatermark, Cfg.SoftWatermark, 1.0f);
+}
+
+MemoryGovernor::EnumPressure MemoryGovernor::update() {
+    Stats.Total = 0;
+    for(size_t bytes : Stats.Bytes)
+        Stats.Total += bytes;
+
+    Stats.Peak = std::max(Stats.Peak, Stats.Total);
+
+    EnumPressure next = EnumPressure::None;
+    if(Cfg.Budget) {
+        if(Stats.Total >= size_t(Cfg.Budget * double(Cfg.HardWatermark)))
+            next = EnumPressure::Hard;
+        else if(Stats.Total >= size_t(Cfg.Budget * double(Cfg.SoftWatermark)))
+            next = EnumPressure::Soft;
+    }
+
+    if(next == Pressure)
+        return Pressure;
+
+    if(next > Pressure) {
+        if(next >= EnumPressure::Soft && Pressure < EnumPressure::Soft)
+            Stats.SoftEvents++;
+        if(next == EnumPressure::Hard)
+            Stats.HardEvents++;
+    }
+
+    auto log = next > Pressure ? LOG.warn() : LOG.info();
+    log << "Давление памяти: " << name(next) << ", занято " << (Stats.Total >> 20) << " из " << (Cfg.Budget >> 20) << " МиБ";
+    for(size_t iter = 0; iter < Stats.Bytes.size(); iter++)
+        log << "\n\t" << name(EnumSubsystem(iter)) << ": " << (Stats.Bytes[iter] >> 20) << " МиБ";
+
+    Pressure = next;
+    return Pressure;
+}
+
+size_t MemoryGovernor::excess() const {
+    if(!Cfg.Budget)
+        return 0;
+
+    size_t soft = size_t(Cfg.Budget * double(Cfg.SoftWatermark));
+    return Stats.Total > soft ? Stats.Total - soft : 0;
+}
+
+const char* MemoryGovernor::name(EnumSubsystem subsystem) {
+    switch(subsystem) {
+    case EnumSubsystem::Regions:    return "regions";
+    case EnumSubsystem::SendCaches: return "send_caches";
+    case EnumSubsystem::Assets:     return "assets";
+    case EnumSubsystem::Lua:        return "lua";
+    case EnumSubsystem::Network:    return "network";
+    default:                        return "unknown";
+    }
+}
+
+const char* MemoryGovernor::name(EnumPressure pressure) {
+    switch(pressure) {
+    case EnumPressure::None:    return "none";
+    case EnumPressure::Soft:    return "soft";
+    case EnumPressure::Hard:    return "hard";
+    default:                    return "unknown";
+    }
+}
+
+size_t MemoryGovernor::luaHeapBytes(lua_State* L) {
+    return size_t(lua_gc(L, LUA_GCCOUNT, 0)) * 1024 + size_t(lua_gc(L, LUA_GCCOUNTB, 0));
+}
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "TOSLib.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+struct lua_State;
+
+
+namespace LV::Server {
+
+/*
+    Учёт памяти сервера по подсистемам и давление при заданном бюджете.
+
+    Подсистемы раз в CHECK_TICKS тактов сообщают свой объём (report), после чего update
+    сравнивает сумму с отметками бюджета. Выше мягкой сервер освобождает то, что легко вернуть:
+    выгружает регионы без наблюдателей и собирает мусор Lua. Выше жёсткой дополнительно
+    сокращает задержку выгрузки у игроков и откладывает загрузку новых регионов.
+    Без бюджета (0) ведётся только учёт.
+
+    Объём оценочный: считаются полезные данные контейнеров, а не служебные структуры распределителя.
+*/
+class MemoryGovernor {
+public:
+    static constexpr uint32_t CHECK_TICKS = 30;
+
+    enum class EnumSubsystem {
+        Regions,        // Ноды, воксели и сущности загруженных регионов
+        SendCaches,     // Сжатые чанки, ожидающие отправки игрокам
+        Assets,         // Ресурсы, в том числе отображённые из пакета
+        Lua,            // Кучи состояний Lua, основного и потоков
+        Network,        // Очереди отправки сокетов
+        MAX_ENUM
+    };
+
+    enum class EnumPressure {
+        None, Soft, Hard
+    };
+
+    struct Config {
+        // Бюджет в байтах, 0 - без ограничения
+        size_t Budget = 0;
+        // Доли бюджета
+        float SoftWatermark = 0.8f, HardWatermark = 0.95f;
+    };
+
+    struct Metrics {
+        std::array<size_t, size_t(EnumSubsystem::MAX_ENUM)> Bytes = {};
+        size_t Total = 0, Peak = 0;
+        // Сколько раз давление поднималось до уровня
+        uint64_t SoftEvents = 0, HardEvents = 0;
+        uint64_t EvictedRegions = 0, DeferredLoads = 0, LuaCollections = 0;
+    };
+
+    void setConfig(const Config& config);
+    const Config& config() const { return Cfg; }
+
+    void report(EnumSubsystem subsystem, size_t bytes) {
+        Stats.Bytes[size_t(subsystem)] = bytes;
+    }
+
+    // Пересчитывает сумму и уровень давления после report всех подсистем
+    EnumPressure update();
+
+    EnumPressure pressure() const { return Pressure; }
+    // Сколько нужно освободить, чтобы опуститься под мягкую отметку
+    size_t excess() const;
+
+    void onRegionsEvicted(size_t count) { Stats.EvictedRegions += count; }
+    void onLoadsDeferred(size_t count) { Stats.DeferredLoads += count; }
+    void onLuaCollected() { Stats.LuaCollections++; }
+
+    const Metrics& metrics() const { return Stats; }
+
+    static const char* name(EnumSubsystem subsystem);
+    static const char* name(EnumPressure pressure);
+    // Объём кучи состояния Lua по его же счётчику
+    static size_t luaHeapBytes(lua_State* L);
+
+private:
+    TOS::Logger LOG = "MemoryGovernor";
+    Config Cfg;
+    Metrics Stats;
+    EnumPressure Pressure = EnumPressure::None;
+};
+
+}
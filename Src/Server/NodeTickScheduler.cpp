@@ -0,0 +1,145 @@
+#include "NodeTickScheduler.hpp"
+#include <algorithm>
+#include <bit>
+
+
+namespace LV::Server {
+
+bool NodeTickScheduler::schedule(Pos::GlobalNode pos, uint32_t delay) {
+    if(delay == 0)
+        delay = 1;
+
+    Entry entry{pos, Now+delay};
+    auto [iter, inserted] = Pending[pos >> 6].try_emplace(localIndex(pos), entry.Due);
+    if(!inserted)
+        return false;
+
+    PendingCount++;
+    place(entry);
+    return true;
+}
+
+bool NodeTickScheduler::cancel(Pos::GlobalNode pos) {
+    auto iterRegion = Pending.find(pos >> 6);
+    if(iterRegion == Pending.end())
+        return false;
+
+    if(!iterRegion->second.erase(localIndex(pos)))
+        return false;
+
+    PendingCount--;
+    if(iterRegion->second.empty())
+        Pending.erase(iterRegion);
+
+    return true;
+}
+
+bool NodeTickScheduler::isScheduled(Pos::GlobalNode pos) const {
+    auto iterRegion = Pending.find(pos >> 6);
+    return iterRegion != Pending.end() && iterRegion->second.contains(localIndex(pos));
+}
+
+void NodeTickScheduler::advance(std::vector<Pos::GlobalNode>& out) {
+    Now++;
+
+    // Каскад сверху вниз: опустившиеся записи могут попасть в ячейку, которая разбирается следом
+    for(int level = LEVELS; level >= 1; level--) {
+        uint64_t period = uint64_t(1) << (SLOT_BITS*level);
+        if(Now & (period-1))
+            continue;
+
+        if(level == LEVELS)
+            cascade(Overflow);
+        else
+            cascade(Wheel[level][(Now >> (SLOT_BITS*level)) & (SLOTS-1)]);
+    }
+
+    std::vector<Entry> slot = std::move(Wheel[0][Now & (SLOTS-1)]);
+    Wheel[0][Now & (SLOTS-1)].clear();
+
+    for(const Entry& entry : slot) {
+        auto iterRegion = Pending.find(entry.Pos >> 6);
+        if(iterRegion == Pending.end())
+            continue;
+
+        auto iterNode = iterRegion->second.find(localIndex(entry.Pos));
+        // Такт отменён или перепланирован
+        if(iterNode == iterRegion->second.end() || iterNode->second != entry.Due)
+            continue;
+
+        iterRegion->second.erase(iterNode);
+        PendingCount--;
+        if(iterRegion->second.empty())
+            Pending.erase(iterRegion);
+
+        out.push_back(entry.Pos);
+    }
+
+    // Ёмкость ячейки возвращается колесу
+    slot.clear();
+    if(Wheel[0][Now & (SLOTS-1)].empty())
+        Wheel[0][Now & (SLOTS-1)] = std::move(slot);
+}
+
+std::vector<NodeTickRecord> NodeTickScheduler::collectRegion(Pos::GlobalRegion rPos) const {
+    std::vector<NodeTickRecord> out;
+
+    auto iterRegion = Pending.find(rPos);
+    if(iterRegion == Pending.end())
+        return out;
+
+    out.reserve(iterRegion->second.size());
+    for(const auto& [index, due] : iterRegion->second)
+        out.push_back({index, uint32_t(std::min<uint64_t>(due-Now, UINT32_MAX))});
+
+    return out;
+}
+
+void NodeTickScheduler::restoreRegion(Pos::GlobalRegion rPos, const std::vector<NodeTickRecord>& records) {
+    for(const NodeTickRecord& record : records)
+        schedule(fromLocal(rPos, record.Index & 0x3ffff), record.Delay);
+}
+
+void NodeTickScheduler::dropRegion(Pos::GlobalRegion rPos) {
+    auto iterRegion = Pending.find(rPos);
+    if(iterRegion == Pending.end())
+        return;
+
+    PendingCount -= iterRegion->second.size();
+    Pending.erase(iterRegion);
+}
+
+void NodeTickScheduler::place(const Entry& entry) {
+    uint64_t diff = entry.Due ^ Now;
+    uint32_t level = diff ? (std::bit_width(diff)-1) / SLOT_BITS : 0;
+
+    if(level >= LEVELS) {
+        Overflow.push_back(entry);
+        return;
+    }
+
+    Wheel[level][(entry.Due >> (SLOT_BITS*level)) & (SLOTS-1)].push_back(entry);
+}
+
+void NodeTickScheduler::cascade(std::vector<Entry>& slot) {
+    if(slot.empty())
+        return;
+
+    std::vector<Entry> entries = std::move(slot);
+    slot.clear();
+
+    for(const Entry& entry : entries) {
+        // Снятые записи не переносятся
+        auto iterRegion = Pending.find(entry.Pos >> 6);
+        if(iterRegion == Pending.end())
+            continue;
+
+        auto iterNode = iterRegion->second.find(localIndex(entry.Pos));
+        if(iterNode == iterRegion->second.end() || iterNode->second != entry.Due)
+            continue;
+
+        place(entry);
+    }
+}
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Server/Abstract.hpp"
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+
+namespace LV::Server {
+
+/*
+    Запланированные такты нод мира.
+
+    Иерархическое колесо таймеров: LEVELS уровней по SLOTS ячеек.
+    Уровень записи определяется старшим отличающимся битом между моментом срабатывания и текущим тактом,
+    поэтому вставка O(1), а за такт разбирается одна ячейка нулевого уровня
+    (ячейки старших уровней каскадом опускаются вниз на границах своих периодов).
+
+    Одна позиция ноды имеет не больше одного ожидающего такта. Отмена и выгрузка региона
+    ленивые: записи в колесе сверяются с таблицей ожидающих при срабатывании.
+*/
+class NodeTickScheduler {
+public:
+    static constexpr uint32_t SLOT_BITS = 6;
+    static constexpr uint32_t SLOTS = 1u << SLOT_BITS;
+    static constexpr uint32_t LEVELS = 4;
+
+    NodeTickScheduler() = default;
+
+    // Текущий такт мира
+    uint64_t now() const { return Now; }
+
+    /*
+        Планирует такт ноды через delay тактов (не меньше одного).
+        Если для позиции уже есть ожидающий такт, он сохраняется и возвращается false
+    */
+    bool schedule(Pos::GlobalNode pos, uint32_t delay);
+
+    // Снимает ожидающий такт
+    bool cancel(Pos::GlobalNode pos);
+
+    bool isScheduled(Pos::GlobalNode pos) const;
+
+    // Переходит к следующему такту и дописывает в out позиции сработавших нод
+    void advance(std::vector<Pos::GlobalNode>& out);
+
+    // Ожидающие такты региона для сохранения
+    std::vector<NodeTickRecord> collectRegion(Pos::GlobalRegion rPos) const;
+    // Восстанавливает такты загруженного региона
+    void restoreRegion(Pos::GlobalRegion rPos, const std::vector<NodeTickRecord>& records);
+    // Забывает такты выгруженного региона
+    void dropRegion(Pos::GlobalRegion rPos);
+
+    size_t pendingCount() const { return PendingCount; }
+
+    static uint32_t localIndex(Pos::GlobalNode pos) {
+        return uint32_t(pos.x & 63) | (uint32_t(pos.y & 63) << 6) | (uint32_t(pos.z & 63) << 12);
+    }
+
+    static Pos::GlobalNode fromLocal(Pos::GlobalRegion rPos, uint32_t index) {
+        // Покомпонентно: приведение BitVec3 между типами не расширяет знак
+        return (Pos::GlobalNode(rPos.x, rPos.y, rPos.z) << 6) + Pos::GlobalNode(index & 63, (index >> 6) & 63, (index >> 12) & 63);
+    }
+
+private:
+    struct Entry {
+        Pos::GlobalNode Pos;
+        uint64_t Due;
+    };
+
+    uint64_t Now = 0;
+    size_t PendingCount = 0;
+    std::array<std::array<std::vector<Entry>, SLOTS>, LEVELS> Wheel;
+    // Дальше чем охватывает колесо
+    std::vector<Entry> Overflow;
+    // Ожидающие такты по регионам: локальный индекс ноды -> такт срабатывания
+    std::unordered_map<Pos::GlobalRegion, std::unordered_map<uint32_t, uint64_t>> Pending;
+
+    void place(const Entry& entry);
+    void cascade(std::vector<Entry>& slot);
+};
+
+}
@@ -0,0 +1,271 @@
+#include "RegionGenerator.hpp"
+#include "Server/ContentManager.hpp"
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/noise.hpp>
+#include <string>
+#include <vector>
+
+
+namespace LV::Server {
+
+/*
+    Обвязка генератора мода в состоянии потока.
+    Скрипт возвращает функцию generate(nodes, noise, x, y, z):
+        nodes - uint32_t[64*4096], значение ноды id | meta << 24, индекс gen.index(x, y, z)
+            (чанк (x>>4) | (y>>4)<<2 | (z>>4)<<4, внутри чанка x&15 | (y&15)<<4 | (z&15)<<8),
+            перед вызовом заполнен воздухом;
+        noise - const float[64*64*64], индекс x + y*64 + z*4096;
+        x, y, z - глобальная позиция первой ноды региона.
+    Идентификаторы нод берутся при загрузке скрипта через gen.node_id("домен:ключ")
+*/
+static const char* LuaGeneratorPrelude = R"LUA(
+local ffi = require("ffi")
+local bit = require("bit")
+local band, bor, lshift, rshift = bit.band, bit.bor, bit.lshift, bit.rshift
+
+gen = gen or {}
+
+function gen.index(x, y, z)
+    return bor(
+        lshift(bor(rshift(x, 4), lshift(rshift(y, 4), 2), lshift(rshift(z, 4), 4)), 12),
+        band(x, 15), lshift(band(y, 15), 4), lshift(band(z, 15), 8))
+end
+
+function gen.node(id, meta)
+    return bor(id, lshift(meta or 0, 24))
+end
+
+function gen.wrap(generate)
+    local cast = ffi.cast
+    return function(nodes, noise, x, y, z)
+        return generate(cast("uint32_t*", nodes), cast("const float*", noise), x, y, z)
+    end
+end
+)LUA";
+
+void LuaRegionGenerator::init() {
+    Lua.open_libraries();
+    Lua.script(LuaGeneratorPrelude, "@generator_prelude");
+    Lua["gen"]["node_id"] = [this](const std::string& name) -> DefNodeId {
+        std::optional<std::vector<std::optional<std::string>>> match = TOS::Str::match(name, "^([\\w\\d_]+):([\\w\\d_]+)$");
+        if(!match)
+            MAKE_ERROR("Недействительный идентификатор: " << name);
+
+        return CM.getId(EnumDefContent::Node, *(*match)[1], *(*match)[2]);
+    };
+}
+
+bool LuaRegionGenerator::generate(WorldId_t worldId, const ModScript& script, Pos::GlobalRegion rPos,
+    std::array<float, 64*64*64>& noise, World::RegionIn& out)
+{
+    auto iterLoaded = Loaded.find(worldId);
+    if(iterLoaded == Loaded.end()) {
+        // Сломанный генератор запоминается пустым, мир дальше генерируется встроенным
+        std::optional<sol::protected_function> wrapped;
+        try {
+            sol::load_result chunk = Lua.load(script.Source, "@" + script.Name);
+            if(!chunk.valid()) {
+                sol::error err = chunk;
+                MAKE_ERROR("Ошибка загрузки генератора мода " << script.ModId << ":\n" << err.what());
+            }
+
+            sol::protected_function_result result = chunk.get<sol::protected_function>()();
+            if(!result.valid()) {
+                sol::error err = result;
+                MAKE_ERROR("Ошибка инициализации генератора мода " << script.ModId << ":\n" << err.what());
+            }
+
+            std::optional<sol::protected_function> generate = result.get<std::optional<sol::protected_function>>();
+            if(!generate)
+                MAKE_ERROR("Генератор мода " << script.ModId << " должен вернуть функцию");
+
+            sol::protected_function wrap = Lua["gen"]["wrap"];
+            wrapped = wrap(*generate).get<sol::protected_function>();
+        } catch(const std::exception& exc) {
+            LOG.error() << exc.what() << "\nГенератор отключён, используется встроенный";
+        }
+
+        iterLoaded = Loaded.emplace(worldId, std::move(wrapped)).first;
+    }
+
+    if(!iterLoaded->second)
+        return false;
+
+    Node air;
+    air.Data = 0;
+    for(auto& chunk : out.Nodes)
+        chunk.fill(air);
+
+    static_assert(sizeof(out.Nodes) == sizeof(uint32_t)*64*4096, "Генератор видит ноды региона плоским массивом uint32_t");
+
+    // Ноды - битовые поля в uint32_t, скрипт пишет их напрямую
+    Pos::GlobalNode base = Pos::GlobalNode(rPos.x, rPos.y, rPos.z) << 6;
+    sol::protected_function_result result = (*iterLoaded->second)(
+        static_cast<void*>(out.Nodes.data()), static_cast<void*>(noise.data()), base.x, base.y, base.z);
+
+    if(!result.valid()) {
+        sol::error err = result;
+        LOG.warn() << "Ошибка генератора мода в регионе " << rPos.x << ' ' << rPos.y << ' ' << rPos.z
+            << ", используется встроенный:\n" << err.what();
+        return false;
+    }
+
+    return true;
+}
+
+void generateRegionNative(ContentManager& cm, Pos::GlobalRegion rPos, const std::array<float, 64*64*64>& noise, World::RegionIn& out) {
+    auto lru = cm.createLRU();
+
+    DefNodeId kNodeAir = 0;
+    DefNodeId kNodeGrass = lru.getIdNode("test", "grass");
+    uint8_t kMetaGrass = 1;
+    DefNodeId kNodeDirt = lru.getIdNode("test", "dirt");
+    DefNodeId kNodeStone = lru.getIdNode("test", "stone");
+    DefNodeId kNodeWood = lru.getIdNode("test", "log");
+    DefNodeId kNodeLeaves = lru.getIdNode("test", "leaves");
+    DefNodeId kNodeLava = lru.getIdNode("test", "lava");
+    DefNodeId kNodeWater = lru.getIdNode("test", "water");
+    DefNodeId kNodeFire = lru.getIdNode("test", "fire");
+
+    auto hash32 = [](uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352dU;
+        x ^= x >> 15;
+        x *= 0x846ca68bU;
+        x ^= x >> 16;
+        return x;
+    };
+
+    Pos::GlobalNode regionBase = rPos;
+    regionBase <<= 6;
+
+    std::array<int, 64*64> heights;
+    for(int z = 0; z < 64; z++) {
+        for(int x = 0; x < 64; x++) {
+            int32_t gx = regionBase.x + x;
+            int32_t gz = regionBase.z + z;
+            float fx = float(gx);
+            float fz = float(gz);
+
+            float base = glm::perlin(glm::vec2(fx * 0.005f, fz * 0.005f));
+            float detail = glm::perlin(glm::vec2(fx * 0.02f, fz * 0.02f)) * 0.35f;
+            float ridge = glm::perlin(glm::vec2(fx * 0.0015f, fz * 0.0015f));
+            float ridged = 1.f - std::abs(ridge);
+            float mountains = ridged * ridged;
+            float noiseDetail = noise[(z * 64) + x];
+
+            float height = 18.f + (base + detail) * 8.f + mountains * 32.f + noiseDetail * 3.f;
+            int h = std::clamp<int>(int(height + 0.5f), -256, 256);
+            heights[z * 64 + x] = h;
+        }
+    }
+
+    for(int z = 0; z < 64; z++) {
+        for(int x = 0; x < 64; x++) {
+            int surface = heights[z * 64 + x];
+            int32_t gx = regionBase.x + x;
+            int32_t gz = regionBase.z + z;
+            uint32_t seed = hash32(uint32_t(gx) * 73856093u ^ uint32_t(gz) * 19349663u);
+
+            for(int y = 0; y < 64; y++) {
+                int32_t gy = regionBase.y + y;
+                Pos::bvec64u nodePos(x, y, z);
+                auto &node = out.Nodes[Pos::bvec4u(nodePos >> 4).pack()][Pos::bvec16u(nodePos & 0xf).pack()];
+
+                if(gy <= surface) {
+                    if(gy == surface) {
+                        node.NodeId = kNodeGrass;
+                        node.Meta = kMetaGrass;
+                    } else if(gy >= surface - 3) {
+                        node.NodeId = kNodeDirt;
+                        node.Meta = uint8_t((seed + gy) & 0x3);
+                    } else {
+                        node.NodeId = kNodeStone;
+                        node.Meta = uint8_t((seed + gy + 1) & 0x3);
+                    }
+                } else {
+                    node.Data = kNodeAir;
+                }
+            }
+        }
+    }
+
+    auto setNode = [&](int x, int y, int z, DefNodeId id, uint8_t meta, bool onlyAir) {
+        if(x < 0 || x >= 64 || y < 0 || y >= 64 || z < 0 || z >= 64)
+            return;
+
+        Pos::bvec64u nodePos(x, y, z);
+        auto &node = out.Nodes[Pos::bvec4u(nodePos >> 4).pack()][Pos::bvec16u(nodePos & 0xf).pack()];
+        if(onlyAir && node.Data != 0)
+            return;
+
+        node.NodeId = id;
+        node.Meta = meta;
+    };
+
+    for(int z = 1; z < 63; z++) {
+        for(int x = 1; x < 63; x++) {
+            int surface = heights[z * 64 + x];
+            int localY = surface - regionBase.y;
+            if(localY < 1 || localY >= 63)
+                continue;
+
+            int32_t gx = regionBase.x + x;
+            int32_t gz = regionBase.z + z;
+            uint32_t seed = hash32(uint32_t(gx) * 83492791u ^ uint32_t(gz) * 2971215073u);
+
+            int treeHeight = 4 + int(seed % 3);
+            if(localY + treeHeight + 2 >= 64)
+                continue;
+
+            if((seed % 97) >= 2)
+                continue;
+
+            int diff = surface - heights[z * 64 + (x - 1)];
+            if(diff > 2 || diff < -2)
+                continue;
+            diff = surface - heights[z * 64 + (x + 1)];
+            if(diff > 2 || diff < -2)
+                continue;
+            diff = surface - heights[(z - 1) * 64 + x];
+            if(diff > 2 || diff < -2)
+                continue;
+            diff = surface - heights[(z + 1) * 64 + x];
+            if(diff > 2 || diff < -2)
+                continue;
+
+            uint8_t woodMeta = uint8_t((seed >> 2) & 0x3);
+            uint8_t leafMeta = uint8_t((seed >> 4) & 0x3);
+
+            for(int i = 1; i <= treeHeight; i++) {
+                setNode(x, localY + i, z, kNodeWood, woodMeta, false);
+            }
+
+            int topY = localY + treeHeight;
+            for(int dy = -2; dy <= 2; dy++) {
+                for(int dz = -2; dz <= 2; dz++) {
+                    for(int dx = -2; dx <= 2; dx++) {
+                        int dist2 = dx * dx + dz * dz + dy * dy;
+                        if(dist2 > 5)
+                            continue;
+
+                        setNode(x + dx, topY + dy, z + dz, kNodeLeaves, leafMeta, true);
+                    }
+                }
+            }
+        }
+    }
+
+    if(regionBase.x == 0 && regionBase.z == 0) {
+        constexpr int kTestGlobalY = 64;
+        if(regionBase.y <= kTestGlobalY && (regionBase.y + 63) >= kTestGlobalY) {
+            int localY = kTestGlobalY - regionBase.y;
+            setNode(7, localY, 2, kNodeLava, 0, false);
+            setNode(8, localY, 2, kNodeWater, 0, false);
+            setNode(9, localY, 2, kNodeFire, 0, false);
+        }
+    }
+}
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Server/Abstract.hpp"
+#include "Server/World.hpp"
+#include "TOSLib.hpp"
+#include <array>
+#include <optional>
+#include <sol/sol.hpp>
+#include <unordered_map>
+
+
+namespace LV::Server {
+
+class ContentManager;
+
+// Встроенный генератор: холмы, деревья и тестовые ноды
+void generateRegionNative(ContentManager& cm, Pos::GlobalRegion rPos, const std::array<float, 64*64*64>& noise, World::RegionIn& out);
+
+/*
+    Генераторы миров из модов в собственном состоянии LuaJIT одного потока.
+    Генератор мода получает ffi указатели на ноды региона и шум без копирования и поштучной передачи.
+    Исходник загружается в состояние при первом регионе мира
+*/
+class LuaRegionGenerator {
+public:
+    explicit LuaRegionGenerator(ContentManager& cm)
+        : CM(cm)
+    {}
+
+    // Открывает библиотеки и обвязку gen, без этого generate не вызывается
+    void init();
+
+    sol::state& state() { return Lua; }
+
+    /*
+        При ошибке скрипта возвращает false, генератор, который не удалось загрузить,
+        запоминается пустым и больше не вызывается
+    */
+    bool generate(WorldId_t worldId, const ModScript& script, Pos::GlobalRegion rPos,
+        std::array<float, 64*64*64>& noise, World::RegionIn& out);
+
+private:
+    TOS::Logger LOG = "LuaRegionGenerator";
+    ContentManager& CM;
+    sol::state Lua;
+    std::unordered_map<WorldId_t, std::optional<sol::protected_function>> Loaded;
+};
+
+}
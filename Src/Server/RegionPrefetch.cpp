@@ -0,0 +1,126 @@
+#include "RegionPrefetch.hpp"
+
+
+namespace LV::Server {
+
+bool RegionPrefetch::request(WorldId_t worldId, Pos::GlobalRegion pos, uint32_t tick) {
+    if(Pending >= MAX_PENDING)
+        return false;
+
+    auto [iter, inserted] = Entries[worldId].try_emplace(pos, Entry{tick});
+    if(!inserted)
+        return false;
+
+    Pending++;
+    Stats.Requested++;
+    return true;
+}
+
+bool RegionPrefetch::isPending(WorldId_t worldId, Pos::GlobalRegion pos) const {
+    auto iterWorld = Entries.find(worldId);
+    if(iterWorld == Entries.end())
+        return false;
+
+    auto iter = iterWorld->second.find(pos);
+    return iter != iterWorld->second.end() && !iter->second.Ready;
+}
+
+bool RegionPrefetch::isLate(WorldId_t worldId, Pos::GlobalRegion pos) const {
+    auto iterWorld = Entries.find(worldId);
+    if(iterWorld == Entries.end())
+        return false;
+
+    auto iter = iterWorld->second.find(pos);
+    return iter != iterWorld->second.end() && !iter->second.Ready && iter->second.Late;
+}
+
+void RegionPrefetch::onLoaded(WorldId_t worldId, Pos::GlobalRegion pos, uint32_t tick) {
+    auto iterWorld = Entries.find(worldId);
+    if(iterWorld == Entries.end())
+        return;
+
+    auto iter = iterWorld->second.find(pos);
+    if(iter == iterWorld->second.end() || iter->second.Ready)
+        return;
+
+    Pending--;
+
+    if(iter->second.Late) {
+        // Уже учтён в Late, дальше регион живёт как обычный наблюдаемый
+        iterWorld->second.erase(iter);
+        if(iterWorld->second.empty())
+            Entries.erase(iterWorld);
+
+        return;
+    }
+
+    iter->second.Ready = true;
+    iter->second.Tick = tick;
+}
+
+bool RegionPrefetch::onVisible(WorldId_t worldId, Pos::GlobalRegion pos, bool loaded) {
+    auto iterWorld = Entries.find(worldId);
+    if(iterWorld == Entries.end())
+        return false;
+
+    auto iter = iterWorld->second.find(pos);
+    if(iter == iterWorld->second.end())
+        return false;
+
+    if(!iter->second.Ready) {
+        // Запись остаётся до onLoaded, чтобы не потерять счётчик Pending
+        if(iter->second.Late)
+            return false;
+
+        iter->second.Late = true;
+        Stats.Late++;
+        return true;
+    }
+
+    if(loaded)
+        Stats.Hits++;
+    else
+        Stats.Wasted++;
+
+    iterWorld->second.erase(iter);
+    if(iterWorld->second.empty())
+        Entries.erase(iterWorld);
+
+    return false;
+}
+
+void RegionPrefetch::expire(uint32_t tick) {
+    for(auto iterWorld = Entries.begin(); iterWorld != Entries.end(); ) {
+        auto& regions = iterWorld->second;
+
+        for(auto iter = regions.begin(); iter != regions.end(); ) {
+            const Entry& entry = iter->second;
+            // Зависшая загрузка не должна вечно занимать место в очереди
+            const uint32_t ttl = entry.Ready ? TTL_TICKS : PENDING_TIMEOUT_TICKS;
+
+            if(tick - entry.Tick > ttl) {
+                if(!entry.Late)
+                    Stats.Wasted++;
+                if(!entry.Ready)
+                    Pending--;
+
+                iter = regions.erase(iter);
+                continue;
+            }
+
+            ++iter;
+        }
+
+        if(regions.empty())
+            iterWorld = Entries.erase(iterWorld);
+        else
+            ++iterWorld;
+    }
+}
+
+double RegionPrefetch::hitRate() const {
+    uint64_t total = Stats.Hits + Stats.Late + Stats.Wasted;
+    return total ? double(Stats.Hits) / double(total) : 0;
+}
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Common/Abstract.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+
+namespace LV::Server {
+
+/*
+    Учёт регионов, запрошенных наперёд по траектории игрока и у порталов.
+
+    Предвыборка идёт в обход видимой области: регион загружается без наблюдателей,
+    генерация ставится в очередь пониженного приоритета. Если игрок дошёл до региона,
+    пока тот ещё в работе, повторно он не запрашивается, наблюдатель подпишется по готовности,
+    а генерация переходит в основную очередь.
+    Неиспользованные регионы выгружает мир как обычные регионы без наблюдателей,
+    здесь же они только списываются в промахи по истечении TTL_TICKS.
+    Всё вызывается из основного потока сервера.
+*/
+class RegionPrefetch {
+public:
+    // Сколько регионов могут одновременно ждать загрузки или генерации
+    static constexpr size_t MAX_PENDING = 64;
+    // Не дольше задержки выгрузки региона без наблюдателей в World (15 с)
+    static constexpr uint32_t TTL_TICKS = 15*30;
+    // Сколько ждать загрузки или генерации, прежде чем считать её потерянной
+    static constexpr uint32_t PENDING_TIMEOUT_TICKS = 4*TTL_TICKS;
+
+    struct Metrics {
+        uint64_t Requested = 0;
+        // Регион был готов к моменту, когда игрок его увидел
+        uint64_t Hits = 0;
+        // Игрок увидел регион, пока тот ещё загружался или генерировался
+        uint64_t Late = 0;
+        // Регион так и не понадобился, либо успел выгрузиться
+        uint64_t Wasted = 0;
+    };
+
+    // Ставит регион на учёт, false если он уже учтён или очередь заполнена
+    bool request(WorldId_t worldId, Pos::GlobalRegion pos, uint32_t tick);
+    // Регион запрошен предвыборкой и ещё не готов
+    bool isPending(WorldId_t worldId, Pos::GlobalRegion pos) const;
+    // Регион ещё не готов, а игрок его уже увидел
+    bool isLate(WorldId_t worldId, Pos::GlobalRegion pos) const;
+    size_t pendingCount() const { return Pending; }
+
+    // Регион загружен или сгенерирован и передан миру
+    void onLoaded(WorldId_t worldId, Pos::GlobalRegion pos, uint32_t tick);
+    /*
+        Регион вошёл в видимую область игрока, loaded - регион сейчас есть в мире.
+        Если его загрузка ещё идёт, он остаётся isPending и повторно запрашивать его не нужно.
+        true, если регион только что стал опоздавшим и его генерацию пора поднять в приоритете
+    */
+    bool onVisible(WorldId_t worldId, Pos::GlobalRegion pos, bool loaded);
+    // Списывает в промахи готовые регионы, не увиденные за TTL_TICKS
+    void expire(uint32_t tick);
+
+    const Metrics& metrics() const { return Stats; }
+    // Доля готовых к приходу игрока среди всех завершённых предвыборок
+    double hitRate() const;
+
+private:
+    struct Entry {
+        // Такт запроса, после загрузки - такт готовности
+        uint32_t Tick;
+        bool Ready = false;
+        // Игрок увидел регион раньше, чем тот был готов
+        bool Late = false;
+    };
+
+    std::unordered_map<WorldId_t, std::unordered_map<Pos::GlobalRegion, Entry>> Entries;
+    size_t Pending = 0;
+    Metrics Stats;
+};
+
+}
@@ -300,7 +300,7 @@ std::vector<Net::Packet> RemoteClient::makePackets_informateDefContentUpdate(
             
             for(const auto& [domain, key] : profiles.IdToDK[type]) {
                 check(domain.size() + key.size() + 8);
-                pack << key << domain;
+                pack << domain << key;
             }
         }
     }
@@ -420,6 +420,14 @@ void RemoteClient::NetworkAndResource_t::prepareRegionsRemove(WorldId_t worldId,
             ChunksToSend.erase(worldIter);
     }
 
+    if(auto lightIter = LightToSend.find(worldId); lightIter != LightToSend.end()) {
+        for(const Pos::GlobalRegion &regionPos : regionPoses)
+            lightIter->second.erase(regionPos);
+
+        if(lightIter->second.empty())
+            LightToSend.erase(lightIter);
+    }
+
     for(Pos::GlobalRegion regionPos : regionPoses) {
         checkPacketBorder(16);
         NextPacket << (uint8_t) ToClient::RemoveRegion
@@ -479,6 +487,28 @@ void RemoteClient::NetworkAndResource_t::flushChunksToPackets()
     }
 
     ChunksToSend.clear();
+
+    for(auto &[worldId, regions] : LightToSend) {
+        for(auto &[regionPos, chunks] : regions) {
+            for(auto &[chunkPos, compressed] : chunks) {
+                Pos::GlobalChunk globalPos = (Pos::GlobalChunk) regionPos;
+                globalPos <<= 2;
+                globalPos += (Pos::GlobalChunk) chunkPos;
+
+                const size_t size = 1 + sizeof(WorldId_t)
+                    + sizeof(Pos::GlobalChunk::Pack)
+                    + sizeof(uint32_t)
+                    + compressed.size();
+                checkPacketBorder(static_cast<uint16_t>(std::min<size_t>(size, 64000)));
+
+                NextPacket << (uint8_t) ToClient::ChunkLight
+                    << worldId << globalPos.pack() << uint32_t(compressed.size());
+                NextPacket.write((const std::byte*) compressed.data(), compressed.size());
+            }
+        }
+    }
+
+    LightToSend.clear();
 }
 
 void RemoteClient::NetworkAndResource_t::prepareEntitiesUpdate(const std::vector<std::tuple<ServerEntityId_t, const Entity*>>& entities)
@@ -582,7 +612,7 @@ ResourceRequest RemoteClient::pushPreparedPackets() {
     return std::move(nextRequest);
 }
 
-void RemoteClient::informateBinaryAssets(const std::vector<std::tuple<ResourceFile::Hash_t, std::shared_ptr<const std::u8string>>>& resources)
+void RemoteClient::informateBinaryAssets(const std::vector<std::tuple<ResourceFile::Hash_t, Resource>>& resources)
 {
     for(const auto& [hash, resource] : resources) {
         auto lock = NetworkAndResource.lock();
@@ -655,7 +685,12 @@ coro<> RemoteClient::rP_System(Net::AsyncSocket &sock) {
     case ToServer::L2System::BlockChange:
     {
         uint8_t action = co_await sock.read<uint8_t>();
-        Actions.lock()->push(action);
+        if(!Actions.tryPush(action)) {
+            // За такт столько действий честный клиент не присылает, молча терять их нельзя
+            LOG.warn() << "Игрок '" << Username << "' переполнил очередь действий (" << Actions.capacity() << ")";
+            shutdown(EnumDisconnect::ProtocolError, "Слишком много действий");
+        }
+
         co_return;
     }
     case ToServer::L2System::ResourceRequest:
@@ -706,6 +741,16 @@ coro<> RemoteClient::rP_System(Net::AsyncSocket &sock) {
         }
         co_return;
     }
+    case ToServer::L2System::ToggleLuaProfiler:
+    {
+        if(Server) {
+            Server->requestLuaProfilerToggle();
+            LOG.info() << "Запрос на переключение профилировщика Lua";
+        } else {
+            LOG.warn() << "Запрос на переключение профилировщика Lua отклонён: сервер не назначен";
+        }
+        co_return;
+    }
     default:
         protocolError();
     }
@@ -720,29 +765,26 @@ void RemoteClient::onUpdate() {
         CrossedRegion = true;
     }
 
-    if(!Actions.get_read().empty()) {
-        auto lock = Actions.lock();
-        while(!lock->empty()) {
-            uint8_t action = lock->front();
-            lock->pop();
+    while(std::optional<uint8_t> next = Actions.tryPop()) {
+        uint8_t action = *next;
 
-            glm::quat q = CameraQuat.toQuat();
-            glm::vec4 v = glm::mat4(q)*glm::vec4(0, 0, -6, 1);
-            Pos::GlobalNode pos = (Pos::GlobalNode) (glm::vec3) v;
-            pos += cameraPos >> Pos::Object_t::BS_Bit;
+        glm::quat q = CameraQuat.toQuat();
+        glm::vec4 v = glm::mat4(q)*glm::vec4(0, 0, -6, 1);
+        Pos::GlobalNode pos = (Pos::GlobalNode) (glm::vec3) v;
+        pos += cameraPos >> Pos::Object_t::BS_Bit;
 
-            if(action == 0) {
-                // Break
-                Break.push(pos);
+        if(action == 0) {
+            // Break
+            Break.push(pos);
 
-            } else if(action == 1) {
-                // Build
-                Build.push(pos);
-            }
+        } else if(action == 1) {
+            // Build
+            Build.push(pos);
         }
     }
 
     LastPos = cameraPos;
+    recordMotion(cameraPos);
 
     // Отправка ресурсов
     if(!AssetsInWork.ToSend.empty()) {
@@ -770,29 +812,29 @@ void RemoteClient::onUpdate() {
                 if(p.size() + initSize > kMaxAssetPacketSize)
                     flushAssetsPacket();
                 p << (uint8_t) ToClient::AssetsInitSend
-                    << uint32_t(res->size());
+                    << uint32_t(res.size());
                 p.write((const std::byte*) hash.data(), 32);
             }
 
             // Отправляем чанк
-            size_t willSend = std::min(chunkSize, res->size()-sended);
+            size_t willSend = std::min(chunkSize, res.size()-sended);
             const size_t chunkMsgSize = 1 + 1 + 32 + 4 + willSend;
             if(p.size() + chunkMsgSize > kMaxAssetPacketSize)
                 flushAssetsPacket();
             p << (uint8_t) ToClient::AssetsNextSend;
             p.write((const std::byte*) hash.data(), 32);
             p << uint32_t(willSend);
-            p.write((const std::byte*) res->data() + sended, willSend);
+            p.write(res.data() + sended, willSend);
             sended += willSend;
 
-            if(sended == res->size()) {
+            if(sended == res.size()) {
                 hasFullSended = true;
             }
         }
 
         if(hasFullSended) {
             for(ssize_t iter = toSend.size()-1; iter >= 0; iter--) {
-                if(std::get<1>(toSend[iter])->size() == std::get<2>(toSend[iter])) {
+                if(std::get<1>(toSend[iter]).size() == std::get<2>(toSend[iter])) {
                     toSend.erase(toSend.begin()+iter);
                 }
             }
@@ -804,4 +846,55 @@ std::vector<std::tuple<WorldId_t, Pos::Object, uint8_t>> RemoteClient::getViewPo
     return {{0, CameraPos, 1}};
 }
 
+glm::vec3 RemoteClient::getVelocity() const {
+    if(MotionCount < 2)
+        return glm::vec3(0);
+
+    const MotionSample& last = Motion[(MotionHead + MOTION_SAMPLES - 1) % MOTION_SAMPLES];
+    const MotionSample& first = Motion[(MotionHead + MOTION_SAMPLES - MotionCount) % MOTION_SAMPLES];
+
+    float seconds = std::chrono::duration<float>(last.Time - first.Time).count();
+    if(seconds <= 0)
+        return glm::vec3(0);
+
+    return Pos::Object_t::asFloatVec(last.Pos - first.Pos) / seconds;
+}
+
+void RemoteClient::recordMotion(Pos::Object pos) {
+    auto now = std::chrono::steady_clock::now();
+
+    if(MotionCount) {
+        const MotionSample& prev = Motion[(MotionHead + MOTION_SAMPLES - 1) % MOTION_SAMPLES];
+        if(glm::length(Pos::Object_t::asFloatVec(pos - prev.Pos)) > TELEPORT_DISTANCE)
+            MotionCount = 0;
+    }
+
+    Motion[MotionHead] = {pos, now};
+    MotionHead = (MotionHead + 1) % MOTION_SAMPLES;
+    MotionCount = std::min(MotionCount + 1, MOTION_SAMPLES);
+}
+
+size_t RemoteClient::getSendCacheBytes() {
+    auto lock = NetworkAndResource.lock();
+    size_t bytes = lock->NextPacket.size();
+
+    for(const Net::Packet& packet : lock->SimplePackets)
+        bytes += packet.size();
+
+    for(const auto& [worldId, regions] : lock->ChunksToSend)
+        for(const auto& [regionPos, chunks] : regions) {
+            for(const auto& [chunkPos, data] : chunks.first)
+                bytes += data.size();
+            for(const auto& [chunkPos, data] : chunks.second)
+                bytes += data.size();
+        }
+
+    for(const auto& [worldId, regions] : lock->LightToSend)
+        for(const auto& [regionPos, chunks] : regions)
+            for(const auto& [chunkPos, data] : chunks)
+                bytes += data.size();
+
+    return bytes;
+}
+
 }
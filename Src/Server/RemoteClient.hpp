@@ -2,13 +2,16 @@
 
 #include <TOSLib.hpp>
 #include <Common/Lockable.hpp>
+#include <Common/ConcurrentQueue.hpp>
 #include <Common/Net.hpp>
 #include "Abstract.hpp"
 #include "Common/Packets.hpp"
 #include "Server/AssetsManager.hpp"
 #include "Server/ContentManager.hpp"
 #include <Common/Abstract.hpp>
+#include <array>
 #include <bitset>
+#include <chrono>
 #include <initializer_list>
 #include <optional>
 #include <queue>
@@ -201,6 +204,8 @@ class RemoteClient {
                 >
             >
         > ChunksToSend;
+        // Накопленная освещённость чанков, отправляется после нод
+        std::unordered_map<WorldId_t, std::unordered_map<Pos::GlobalRegion, std::unordered_map<Pos::bvec4u, std::u8string>>> LightToSend;
 
         // Запрос информации об ассетах и профилях контента
         ResourceRequest NextRequest;
@@ -234,6 +239,15 @@ class RemoteClient {
             ChunksToSend[worldId][regionPos].second[chunkPos] = compressed_nodes;
         }
 
+        void prepareChunkUpdate_Light(
+            WorldId_t worldId,
+            Pos::GlobalRegion regionPos,
+            Pos::bvec4u chunkPos,
+            const std::u8string& compressed_light
+        ) {
+            LightToSend[worldId][regionPos][chunkPos] = compressed_light;
+        }
+
         void flushChunksToPackets();
 
         void prepareEntitiesRemove(const std::vector<ServerEntityId_t>& entityId);
@@ -257,7 +271,7 @@ class RemoteClient {
         std::vector<Hash_t> OnClient;
         // Отправляемые на клиент ресурсы
         // Ресурс, количество отправленных байт
-        std::vector<std::tuple<ResourceFile::Hash_t, std::shared_ptr<const std::u8string>, size_t>> ToSend;
+        std::vector<std::tuple<ResourceFile::Hash_t, Resource, size_t>> ToSend;
         // Пакет с ресурсами
         std::vector<Net::Packet> AssetsPackets;
         Net::Packet AssetsPacket;
@@ -270,7 +284,8 @@ public:
     Pos::Object CameraPos = {0, 0, 0};
     Pos::Object LastPos = CameraPos;
     ToServer::PacketQuat CameraQuat = {0};
-    TOS::SpinlockObject<std::queue<uint8_t>> Actions;
+    // Действия игрока, разбираются каждый такт. Переполнение - нарушение протокола, клиент отключается
+    BoundedQueue<uint8_t> Actions{256};
     ResourceId RecievedAssets[(int) EnumAssets::MAX_ENUM] = {0};
 
     // Регионы, наблюдаемые клиентом
@@ -307,6 +322,13 @@ public:
 
     // Возвращает список точек наблюдений клиентом с радиусом в регионах
     std::vector<std::tuple<WorldId_t, Pos::Object, uint8_t>> getViewPoints();
+    // Скорость камеры в метрах в секунду по последним тактам, нулевая сразу после телепортации
+    glm::vec3 getVelocity() const;
+
+    // Сжатые чанки и собранные пакеты, ещё не переданные сокету (для учёта памяти)
+    size_t getSendCacheBytes();
+    // Очередь отправки сокета
+    size_t getNetworkBytes() { return Socket.getQueuedBytes(); }
 
     /*
         Сервер собирает изменения миров, сжимает их и раздаёт на отправку игрокам
@@ -337,6 +359,16 @@ public:
         NetworkAndResource.lock()->prepareChunkUpdate_Nodes(worldId, regionPos, chunkPos, compressed_nodes);
     }
 
+    // Создаёт пакет отправки освещённости чанка
+    void prepareChunkUpdate_Light(
+        WorldId_t worldId,
+        Pos::GlobalRegion regionPos,
+        Pos::bvec4u chunkPos,
+        const std::u8string& compressed_light
+    ) {
+        NetworkAndResource.lock()->prepareChunkUpdate_Light(worldId, regionPos, chunkPos, compressed_light);
+    }
+
     // Клиент перестал наблюдать за сущностями
     void prepareEntitiesRemove(const std::vector<ServerEntityId_t>& entityId) { NetworkAndResource.lock()->prepareEntitiesRemove(entityId); }
     // Регион удалён из зоны видимости
@@ -385,7 +417,7 @@ public:
 
     // Оповещение о двоичных ресурсах (стриминг по запросу)
     void informateBinaryAssets(
-        const std::vector<std::tuple<ResourceFile::Hash_t, std::shared_ptr<const std::u8string>>>& resources
+        const std::vector<std::tuple<ResourceFile::Hash_t, Resource>>& resources
     );
 
 
@@ -403,6 +435,20 @@ public:
 
 private:
     GameServer* Server = nullptr;
+
+    // Последние положения камеры для оценки скорости
+    struct MotionSample {
+        Pos::Object Pos;
+        std::chrono::steady_clock::time_point Time;
+    };
+
+    static constexpr size_t MOTION_SAMPLES = 8;
+    // Скачок дальше этого за такт считается телепортацией, история сбрасывается
+    static constexpr float TELEPORT_DISTANCE = 64;
+    std::array<MotionSample, MOTION_SAMPLES> Motion;
+    size_t MotionHead = 0, MotionCount = 0;
+
+    void recordMotion(Pos::Object pos);
     void protocolError();
     coro<> readPacket(Net::AsyncSocket &sock);
     coro<> rP_System(Net::AsyncSocket &sock);
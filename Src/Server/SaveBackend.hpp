@@ -15,24 +15,41 @@ namespace LV::Server {
     Обменная единица мира
 */
 struct SB_Region_In {
+    /*
+        Полная запись заменяет регион целиком.
+        Частичная дописывает NodeChunks поверх уже сохранённого региона,
+        воксели заменяются только при HasVoxels, сущности и такты - всегда
+    */
+    bool Full = true;
+    bool HasVoxels = true;
     // Список вокселей всех чанков
     std::unordered_map<Pos::bvec4u, std::vector<VoxelCube>> Voxels;
     // Привязка вокселей к ключу профиля
     std::vector<std::pair<DefVoxelId, std::string>> VoxelsMap;
-    // Ноды всех чанков
-    std::array<std::array<Node, 16*16*16>, 4*4*4> Nodes;
-    // Привязка нод к ключу профиля
+
+    struct NodeChunk {
+        // Индекс чанка в регионе (x | y << 2 | z << 4)
+        uint8_t Index;
+        std::array<Node, 16*16*16> Nodes;
+    };
+
+    // Записываемые чанки нод, при полной записи - все
+    std::vector<NodeChunk> NodeChunks;
+    // Привязка нод из NodeChunks к ключу профиля
     std::vector<std::pair<DefNodeId, std::string>> NodeMap;
     // Сущности
     std::vector<Entity> Entityes;
     // Привязка идентификатора к ключу профиля
     std::vector<std::pair<DefEntityId, std::string>> EntityMap;
+    // Запланированные такты нод
+    std::vector<NodeTickRecord> NodeTicks;
 };
 
 struct DB_Region_Out {
     std::vector<VoxelCube_Region> Voxels;
     std::array<std::array<Node, 16*16*16>, 4*4*4> Nodes;
     std::vector<Entity> Entityes;
+    std::vector<NodeTickRecord> NodeTicks;
 
     std::vector<std::string> VoxelIdToKey, NodeIdToKey, EntityToKey;
 };
@@ -51,6 +68,8 @@ public:
     struct TickSyncInfo_Out {
         std::unordered_map<WorldId_t, std::vector<Pos::GlobalRegion>> NotExisten;
         std::unordered_map<WorldId_t, std::vector<std::pair<Pos::GlobalRegion, DB_Region_Out>>> LoadedRegions;
+        // Регионы из ToSave, которые не удалось записать
+        std::unordered_map<WorldId_t, std::vector<Pos::GlobalRegion>> SaveFailed;
     };
 
     /*
@@ -11,7 +11,11 @@
 #include <memory>
 #include <filesystem>
 #include <fstream>
+#include <iterator>
 #include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
 #include <vector>
 #include <algorithm>
 #include <cstring>
@@ -23,7 +27,7 @@ namespace js = boost::json;
 
 namespace {
 
-constexpr uint32_t kRegionVersion = 1;
+constexpr uint32_t kRegionVersion = 2;
 constexpr size_t kRegionNodeCount = 4 * 4 * 4 * 16 * 16 * 16;
 
 template<typename T>
@@ -70,11 +74,184 @@ std::u8string decodeCompressed(const std::string& base64) {
     return unCompressLinear(std::u8string_view(reinterpret_cast<const char8_t*>(buffer.data()), buffer.size()));
 }
 
-bool writeRegionFile(const fs::path& path, const SB_Region_In& data) {
-    js::object jobj;
-    jobj["version"] = kRegionVersion;
+/*
+    Регион хранится файлом с описанием (воксели, сущности, такты, таблицы идентификаторов)
+    и каталогом <файл>.nodes со сжатыми нодами по файлу на чанк, чтобы изменённые чанки
+    перезаписывались без остального региона. Пустые чанки не пишутся.
+    Идентификаторы нод в файлах чанков - в пространстве nodes_map региона. Оно только дополняется:
+    и полная, и частичная запись переводят ноды в него через ключи профилей, поэтому
+    прежнее описание остаётся верным для уже записанных чанков.
+    Чанки и описание пишутся во временные файлы и переносятся на место, описание последним,
+    так что нехватка места или сбой посреди записи оставляют прежний регион целым.
+    Версия 1 держала все ноды одним блоком "nodes", она читается и переводится при первой частичной записи.
+*/
+fs::path chunksDir(const fs::path& path) {
+    fs::path dir = path;
+    dir += ".nodes";
+    return dir;
+}
 
-    {
+fs::path chunkPath(const fs::path& dir, uint8_t index) {
+    return dir / std::to_string(index);
+}
+
+fs::path tempPath(const fs::path& path) {
+    fs::path tmp = path;
+    tmp += ".tmp";
+    return tmp;
+}
+
+bool isEmptyChunk(const std::array<Node, 16*16*16>& nodes) {
+    return std::all_of(nodes.begin(), nodes.end(), [](const Node& node) { return node.Data == 0; });
+}
+
+bool writeFile(const fs::path& path, std::string_view data) {
+    std::ofstream fd(path, std::ios::binary | std::ios::trunc);
+    if(!fd)
+        return false;
+
+    fd.write(data.data(), data.size());
+    fd.flush();
+    return bool(fd);
+}
+
+// Пишет чанк во временный файл, на место его переносит commitRegion
+bool writeChunkFile(const fs::path& dir, uint8_t index, const std::array<Node, 16*16*16>& nodes) {
+    std::u8string compressed = compressLinear(std::u8string_view(reinterpret_cast<const char8_t*>(nodes.data()), sizeof(nodes)));
+    return writeFile(tempPath(chunkPath(dir, index)), std::string_view(reinterpret_cast<const char*>(compressed.data()), compressed.size()));
+}
+
+bool readChunkFile(const fs::path& dir, uint8_t index, std::array<Node, 16*16*16>& nodes) {
+    std::ifstream fd(chunkPath(dir, index), std::ios::binary);
+    if(!fd)
+        return false;
+
+    std::string compressed((std::istreambuf_iterator<char>(fd)), std::istreambuf_iterator<char>());
+    std::u8string raw = unCompressLinear(std::u8string_view(reinterpret_cast<const char8_t*>(compressed.data()), compressed.size()));
+    if(raw.size() != sizeof(nodes))
+        return false;
+
+    std::memcpy(nodes.data(), raw.data(), raw.size());
+    return true;
+}
+
+// Описание региона на диске, пустой объект если его нет
+js::object readMetaFile(const fs::path& path) {
+    std::ifstream fd(path, std::ios::binary);
+    if(!fd)
+        return {};
+
+    return js::parse(fd).as_object();
+}
+
+/*
+    Переводит идентификаторы нод записи в пространство nodes_map региона.
+    Ключи, которых в idToKey ещё нет, дописываются в конец
+*/
+std::vector<DefNodeId> remapToRegion(std::vector<std::string>& idToKey, const std::vector<std::pair<DefNodeId, std::string>>& nodeMap) {
+    std::unordered_map<std::string, DefNodeId> keyToId;
+    for(size_t id = 0; id < idToKey.size(); id++) {
+        if(!idToKey[id].empty())
+            keyToId.emplace(idToKey[id], DefNodeId(id));
+    }
+
+    DefNodeId maxId = 0;
+    for(const auto& [id, key] : nodeMap)
+        maxId = std::max(maxId, id);
+
+    std::vector<DefNodeId> remap(size_t(maxId) + 1);
+    for(size_t id = 0; id < remap.size(); id++)
+        remap[id] = DefNodeId(id);
+
+    for(const auto& [id, key] : nodeMap) {
+        auto iter = keyToId.find(key);
+        if(iter == keyToId.end()) {
+            iter = keyToId.emplace(key, DefNodeId(idToKey.size())).first;
+            idToKey.push_back(key);
+        }
+
+        remap[id] = iter->second;
+    }
+
+    return remap;
+}
+
+js::object packNodeMap(const std::vector<std::string>& idToKey) {
+    std::vector<std::pair<DefNodeId, std::string>> nodeMap;
+    for(size_t id = 0; id < idToKey.size(); id++) {
+        if(!idToKey[id].empty())
+            nodeMap.emplace_back(DefNodeId(id), idToKey[id]);
+    }
+
+    return packIdMap(nodeMap);
+}
+
+// Пишет чанки записи во временные файлы в пространстве региона, written и removed отмечают чанки
+bool stageChunks(const fs::path& dir, const SB_Region_In& data, const std::vector<DefNodeId>& remap, uint64_t& written, uint64_t& removed) {
+    for(const SB_Region_In::NodeChunk& chunk : data.NodeChunks) {
+        if(isEmptyChunk(chunk.Nodes)) {
+            // Чанк мог быть уже подготовлен переводом версии 1
+            if((written >> chunk.Index) & 1) {
+                std::error_code ec;
+                fs::remove(tempPath(chunkPath(dir, chunk.Index)), ec);
+                written &= ~(uint64_t(1) << chunk.Index);
+            }
+
+            removed |= uint64_t(1) << chunk.Index;
+            continue;
+        }
+
+        std::array<Node, 16*16*16> nodes = chunk.Nodes;
+        for(Node& node : nodes) {
+            if(node.NodeId < remap.size())
+                node.NodeId = remap[node.NodeId];
+        }
+
+        if(!writeChunkFile(dir, chunk.Index, nodes))
+            return false;
+
+        written |= uint64_t(1) << chunk.Index;
+        removed &= ~(uint64_t(1) << chunk.Index);
+    }
+
+    return true;
+}
+
+/*
+    Переносит записанное на место: сначала описание ложится во временный файл (после этого
+    записывать больше нечего), затем чанки written и последним описание.
+    Чанки removed удаляются уже после описания, которое на них не ссылается
+*/
+bool commitRegion(const fs::path& path, const js::object& jobj, uint64_t written, uint64_t removed) {
+    const fs::path dir = chunksDir(path);
+    if(!writeFile(tempPath(path), js::serialize(jobj)))
+        return false;
+
+    std::error_code ec;
+    for(uint8_t index = 0; index < 64; index++) {
+        if(!((written >> index) & 1))
+            continue;
+
+        fs::rename(tempPath(chunkPath(dir, index)), chunkPath(dir, index), ec);
+        if(ec)
+            return false;
+    }
+
+    fs::rename(tempPath(path), path, ec);
+    if(ec)
+        return false;
+
+    for(uint8_t index = 0; index < 64; index++) {
+        if((removed >> index) & 1)
+            fs::remove(chunkPath(dir, index), ec);
+    }
+
+    return true;
+}
+
+// Воксели, сущности и такты нод, общее для полной и частичной записи
+void packRegionData(js::object& jobj, const SB_Region_In& data) {
+    if(data.HasVoxels) {
         std::vector<VoxelCube_Region> voxels;
         convertChunkVoxelsToRegion(data.Voxels, voxels);
 
@@ -92,16 +269,6 @@ bool writeRegionFile(const fs::path& path, const SB_Region_In& data) {
         jobj["voxels_map"] = packIdMap(data.VoxelsMap);
     }
 
-    {
-        js::object jnodes;
-        const Node* nodePtr = data.Nodes[0].data();
-        const uint8_t* raw = reinterpret_cast<const uint8_t*>(nodePtr);
-        size_t rawSize = sizeof(Node) * kRegionNodeCount;
-        jnodes["data"] = encodeCompressed(raw, rawSize);
-        jobj["nodes"] = std::move(jnodes);
-        jobj["nodes_map"] = packIdMap(data.NodeMap);
-    }
-
     {
         js::array ents;
         for(const Entity& entity : data.Entityes) {
@@ -129,13 +296,103 @@ bool writeRegionFile(const fs::path& path, const SB_Region_In& data) {
         jobj["entities_map"] = packIdMap(data.EntityMap);
     }
 
-    fs::create_directories(path.parent_path());
-    std::ofstream fd(path, std::ios::binary);
-    if(!fd)
+    if(!data.NodeTicks.empty()) {
+        js::object jticks;
+        jticks["count"] = static_cast<uint64_t>(data.NodeTicks.size());
+        jticks["data"] = encodeCompressed(reinterpret_cast<const uint8_t*>(data.NodeTicks.data()), sizeof(NodeTickRecord) * data.NodeTicks.size());
+        jobj["node_ticks"] = std::move(jticks);
+    } else {
+        jobj.erase("node_ticks");
+    }
+}
+
+bool writeRegionFile(const fs::path& path, const SB_Region_In& data) {
+    const fs::path dir = chunksDir(path);
+    fs::create_directories(dir);
+
+    // Из прежнего описания берётся только пространство идентификаторов нод
+    std::vector<std::string> idToKey;
+    {
+        js::object old;
+        try {
+            old = readMetaFile(path);
+        } catch(const std::exception&) {
+            // Испорченное описание не ссылается ни на что полезное, пространство начинается заново
+        }
+
+        if(auto it = old.find("nodes_map"); it != old.end())
+            unpackIdMap(it->value().as_object(), idToKey);
+    }
+
+    std::vector<DefNodeId> remap = remapToRegion(idToKey, data.NodeMap);
+
+    // Полная запись заменяет все чанки, оставшиеся от прошлых записей больше не действительны
+    uint64_t written = 0, removed = ~uint64_t(0);
+    if(!stageChunks(dir, data, remap, written, removed))
         return false;
 
-    fd << js::serialize(jobj);
-    return true;
+    js::object jobj;
+    jobj["version"] = kRegionVersion;
+    jobj["node_chunks"] = written;
+    jobj["nodes_map"] = packNodeMap(idToKey);
+    packRegionData(jobj, data);
+
+    return commitRegion(path, jobj, written, removed);
+}
+
+bool writeRegionChunks(const fs::path& path, const SB_Region_In& data) {
+    const fs::path dir = chunksDir(path);
+
+    js::object jobj = readMetaFile(path);
+    if(jobj.empty())
+        return false;
+
+    fs::create_directories(dir);
+
+    uint64_t chunks = 0, written = 0, removed = 0;
+    if(auto it = jobj.find("node_chunks"); it != jobj.end())
+        chunks = it->value().to_number<uint64_t>();
+
+    // Перевод версии 1: общий блок нод раскладывается по чанкам, идентификаторы уже в пространстве региона
+    if(auto it = jobj.find("nodes"); it != jobj.end()) {
+        std::u8string raw = decodeCompressed(std::string(it->value().as_object().at("data").as_string()));
+        if(raw.size() != sizeof(Node) * kRegionNodeCount)
+            return false;
+
+        auto nodes = std::make_unique<std::array<std::array<Node, 16*16*16>, 4*4*4>>();
+        std::memcpy(nodes->data(), raw.data(), raw.size());
+
+        for(uint8_t index = 0; index < 64; index++) {
+            if(isEmptyChunk((*nodes)[index]))
+                continue;
+
+            if(!writeChunkFile(dir, index, (*nodes)[index]))
+                return false;
+
+            written |= uint64_t(1) << index;
+        }
+
+        chunks = written;
+        jobj.erase("nodes");
+    }
+
+    // Идентификаторы нод региона и их продолжение новыми ключами
+    std::vector<std::string> idToKey;
+    if(auto it = jobj.find("nodes_map"); it != jobj.end())
+        unpackIdMap(it->value().as_object(), idToKey);
+
+    std::vector<DefNodeId> remap = remapToRegion(idToKey, data.NodeMap);
+    if(!stageChunks(dir, data, remap, written, removed))
+        return false;
+
+    chunks = (chunks | written) & ~removed;
+
+    jobj["version"] = kRegionVersion;
+    jobj["node_chunks"] = chunks;
+    jobj["nodes_map"] = packNodeMap(idToKey);
+    packRegionData(jobj, data);
+
+    return commitRegion(path, jobj, written, removed);
 }
 
 bool readRegionFile(const fs::path& path, DB_Region_Out& out) {
@@ -187,6 +444,20 @@ bool readRegionFile(const fs::path& path, DB_Region_Out& out) {
         }
     }
 
+    if(auto it = jobj.find("node_chunks"); it != jobj.end()) {
+        const fs::path dir = chunksDir(path);
+        uint64_t chunks = it->value().to_number<uint64_t>();
+
+        for(uint8_t index = 0; index < 64; index++) {
+            if(!((chunks >> index) & 1))
+                continue;
+
+            // Потерянный чанк остаётся пустым, иначе регион был бы сгенерирован и записан поверх
+            if(!readChunkFile(dir, index, out.Nodes[index]))
+                TOS::Logger("RegionLoader::Filesystem").warn() << "Не удалось прочитать чанк " << int(index) << " региона " << path;
+        }
+    }
+
     if(auto it = jobj.find("nodes_map"); it != jobj.end()) {
         unpackIdMap(it->value().as_object(), out.NodeIdToKey);
     }
@@ -274,6 +545,17 @@ bool readRegionFile(const fs::path& path, DB_Region_Out& out) {
         unpackIdMap(it->value().as_object(), out.EntityToKey);
     }
 
+    if(auto it = jobj.find("node_ticks"); it != jobj.end()) {
+        const js::object& jticks = it->value().as_object();
+        size_t count = static_cast<size_t>(jticks.at("count").to_number<uint64_t>());
+        std::u8string raw = decodeCompressed(std::string(jticks.at("data").as_string()));
+        if(raw.size() != sizeof(NodeTickRecord) * count)
+            return false;
+
+        out.NodeTicks.resize(count);
+        std::memcpy(out.NodeTicks.data(), raw.data(), raw.size());
+    }
+
         return true;
     } catch(const std::exception& exc) {
         TOS::Logger("RegionLoader::Filesystem").warn() << "Не удалось загрузить регион " << path << "\n\t" << exc.what();
@@ -284,6 +566,7 @@ bool readRegionFile(const fs::path& path, DB_Region_Out& out) {
 }
 
 class WSB_Filesystem : public IWorldSaveBackend {
+    TOS::Logger LOG = "RegionSaver::Filesystem";
     fs::path Dir;
 
 public:
@@ -304,7 +587,19 @@ public:
         // Сохранение регионов
         for(auto& [worldId, regions] : data.ToSave) {
             for(auto& [regionPos, region] : regions) {
-                writeRegionFile(getPath(std::to_string(worldId), regionPos), region);
+                const fs::path path = getPath(std::to_string(worldId), regionPos);
+
+                // Частичная запись без файла метаданных невозможна, мир повторит её полной
+                try {
+                    bool ok = region.Full ? writeRegionFile(path, region) : writeRegionChunks(path, region);
+                    if(!ok) {
+                        LOG.warn() << "Не удалось сохранить регион " << path;
+                        out.SaveFailed[worldId].push_back(regionPos);
+                    }
+                } catch(const std::exception& exc) {
+                    LOG.warn() << "Не удалось сохранить регион " << path << "\n\t" << exc.what();
+                    out.SaveFailed[worldId].push_back(regionPos);
+                }
             }
         }
 
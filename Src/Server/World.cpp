@@ -1,6 +1,9 @@
 #include "World.hpp"
 #include "ContentManager.hpp"
 #include "TOSLib.hpp"
+#include <algorithm>
+#include <cassert>
+#include <bit>
 #include <memory>
 #include <unordered_set>
 
@@ -98,49 +101,121 @@ void World::onRemoteClient_RegionsLost(WorldId_t worldId, std::shared_ptr<Remote
     }
 }
 
-World::SaveUnloadInfo World::onStepDatabaseSync(ContentManager& cm, float dtime) {
+World::SaveUnloadInfo World::onStepDatabaseSync(ContentManager& cm, float dtime, double& byteBudget) {
     SaveUnloadInfo out;
 
-    constexpr float kSaveDelay = 15.0f;
+    // Задержка сохранения: одиночная правка ждёт дольше, массовые изменения сохраняются раньше
+    constexpr float kSaveDelayMax = 30.0f;
+    constexpr float kSaveDelayMin = 5.0f;
+    // Сколько изменённых чанков сокращают задержку вдвое
+    constexpr float kDirtyChunksHalving = 8.0f;
+    // Столько правок нод весят как один изменённый чанк
+    constexpr float kEditsPerChunk = 256.0f;
     constexpr float kUnloadDelay = 15.0f;
 
-    std::vector<Pos::GlobalRegion> toErase;
-    toErase.reserve(16);
+    struct Candidate {
+        Pos::GlobalRegion RegionPos;
+        Region* Ptr;
+        // На сколько просрочено сохранение, первыми идут самые давние
+        float Overdue;
+        bool Unload;
+    };
+
+    std::vector<Candidate> candidates;
 
     for(auto& [pos, regionPtr] : Regions) {
         Region& region = *regionPtr;
 
         region.LastSaveTime += dtime;
+        if(region.RMs.empty())
+            region.IdleTime += dtime;
+        else
+            region.IdleTime = 0;
+
+        const bool hasChanges = region.IsChanged || region.SaveDirty_Voxels || region.SaveDirty_Nodes;
+        bool needToUnload = region.RMs.empty() && region.IdleTime > kUnloadDelay;
+        if(!needToUnload && region.RMs.empty() && EvictBudget) {
+            needToUnload = true;
+            EvictBudget--;
+            out.Evicted++;
+        }
+
+        float delay = kSaveDelayMax;
+        if(region.SaveDirty_Nodes) {
+            uint32_t edits = 0;
+            for(uint64_t mask = region.SaveDirty_Nodes; mask; mask &= mask-1) {
+                int chunk = std::countr_zero(mask);
+                edits += region.ChunkGeneration[chunk] - region.SavedGeneration[chunk];
+            }
+
+            float pressure = std::popcount(region.SaveDirty_Nodes) + edits / kEditsPerChunk;
+            delay = std::max(kSaveDelayMin, kSaveDelayMax / (1.0f + pressure / kDirtyChunksHalving));
+        }
+
+        const bool needToSave = hasChanges && region.LastSaveTime > delay;
+
+        if(needToSave || needToUnload)
+            candidates.push_back({pos, &region, region.LastSaveTime - delay, needToUnload});
+    }
+
+    // Выгружаемые сохраняются в любом случае, остальные - пока хватает бюджета записи
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& left, const Candidate& right) {
+        if(left.Unload != right.Unload)
+            return left.Unload;
+        return left.Overdue > right.Overdue;
+    });
 
-        const bool hasChanges = region.IsChanged || region.IsChunkChanged_Voxels || region.IsChunkChanged_Nodes;
-        const bool needToSave = hasChanges && region.LastSaveTime > kSaveDelay;
-        const bool needToUnload = region.RMs.empty() && region.LastSaveTime > kUnloadDelay;
+    for(const Candidate& candidate : candidates) {
+        Region& region = *candidate.Ptr;
+        const Pos::GlobalRegion pos = candidate.RegionPos;
 
-        if(needToSave || needToUnload) {
+        const bool hasChanges = region.IsChanged || region.SaveDirty_Voxels || region.SaveDirty_Nodes;
+        // Ни разу не сохранённый регион пишется целиком, даже без изменений (сгенерированный)
+        const bool full = !region.Stored;
+
+        if(!candidate.Unload && byteBudget <= 0)
+            continue;
+
+        if(hasChanges || full) {
             SB_Region_In data;
-            data.Voxels = region.Voxels;
-            data.Nodes = region.Nodes;
+            data.Full = full;
+            data.HasVoxels = full || region.SaveDirty_Voxels;
 
-            data.Entityes.reserve(region.Entityes.size());
-            for(const Entity& entity : region.Entityes) {
-                if(entity.IsRemoved || entity.NeedRemove)
-                    continue;
-                data.Entityes.push_back(entity);
-            }
+            const uint64_t chunks = full ? ~uint64_t(0) : region.SaveDirty_Nodes;
+            size_t bytes = 0;
 
             std::unordered_set<DefVoxelId> voxelIds;
-            for(const auto& [chunkPos, voxels] : region.Voxels) {
-                (void) chunkPos;
-                for(const VoxelCube& cube : voxels)
-                    voxelIds.insert(cube.VoxelId);
+            if(data.HasVoxels) {
+                data.Voxels = region.Voxels;
+
+                for(const auto& [chunkPos, voxels] : region.Voxels) {
+                    (void) chunkPos;
+                    bytes += voxels.size() * sizeof(VoxelCube);
+                    for(const VoxelCube& cube : voxels)
+                        voxelIds.insert(cube.VoxelId);
+                }
             }
 
             std::unordered_set<DefNodeId> nodeIds;
-            for(const auto& chunk : region.Nodes) {
-                for(const Node& node : chunk)
+            data.NodeChunks.reserve(std::popcount(chunks));
+            for(uint64_t mask = chunks; mask; mask &= mask-1) {
+                uint8_t chunk = std::countr_zero(mask);
+                data.NodeChunks.push_back({chunk, region.Nodes[chunk]});
+                bytes += sizeof(region.Nodes[chunk]);
+
+                for(const Node& node : region.Nodes[chunk])
                     nodeIds.insert(node.NodeId);
             }
 
+            data.Entityes.reserve(region.Entityes.size());
+            for(const Entity& entity : region.Entityes) {
+                if(entity.IsRemoved || entity.NeedRemove)
+                    continue;
+                data.Entityes.push_back(entity);
+            }
+
+            bytes += data.Entityes.size() * sizeof(Entity);
+
             std::unordered_set<DefEntityId> entityIds;
             for(const Entity& entity : data.Entityes)
                 entityIds.insert(entity.getDefId());
@@ -169,36 +244,409 @@ World::SaveUnloadInfo World::onStepDatabaseSync(ContentManager& cm, float dtime)
                 data.EntityMap.emplace_back(id, dk->Domain + ":" + dk->Key);
             }
 
+            data.NodeTicks = NodeTicks.collectRegion(pos);
+            bytes += data.NodeTicks.size() * sizeof(NodeTickRecord);
+
             out.ToSave.push_back({pos, std::move(data)});
+            byteBudget -= double(bytes);
+
+            // Состояние до записи, вернётся в onSaveResults, если хранилище её не примет
+            SavesInFlight[pos] = {region.SaveDirty_Voxels, region.SaveDirty_Nodes, region.SavedGeneration};
 
-            region.LastSaveTime = 0.0f;
             region.IsChanged = false;
+            region.SaveDirty_Voxels = 0;
+            region.SaveDirty_Nodes = 0;
+            region.SavedGeneration = region.ChunkGeneration;
+            region.Stored = true;
         }
 
-        if(needToUnload) {
+        region.LastSaveTime = 0.0f;
+
+        if(candidate.Unload) {
             out.ToUnload.push_back(pos);
-            toErase.push_back(pos);
+            UnloadsInFlight.push_back(pos);
         }
     }
 
-    for(const Pos::GlobalRegion& pos : toErase) {
-        Regions.erase(pos);
-    }
+    EvictBudget = 0;
 
     return out;
 }
 
+void World::onSaveResults(const std::vector<Pos::GlobalRegion>& failed) {
+    for(const Pos::GlobalRegion& pos : failed) {
+        auto iterSave = SavesInFlight.find(pos);
+        auto iterRegion = Regions.find(pos);
+        if(iterSave == SavesInFlight.end() || iterRegion == Regions.end())
+            continue;
+
+        // Следующая попытка пишет регион целиком: частичная запись не годится, если не легла полная
+        Region& region = *iterRegion->second;
+        region.SaveDirty_Voxels |= iterSave->second.Voxels;
+        region.SaveDirty_Nodes |= iterSave->second.Nodes;
+        region.SavedGeneration = iterSave->second.Generation;
+        region.IsChanged = true;
+        region.Stored = false;
+        // Выгрузка откладывается на обычную задержку, а не повторяется каждый такт
+        region.IdleTime = 0;
+
+        std::erase(UnloadsInFlight, pos);
+    }
+
+    for(const Pos::GlobalRegion& pos : UnloadsInFlight) {
+        auto iterRegion = Regions.find(pos);
+        if(iterRegion == Regions.end())
+            continue;
+
+        // Регион записан, холодная копия совпадает с хранилищем
+        demoteCold(pos, *iterRegion->second);
+        NodeTicks.dropRegion(pos);
+
+        Regions.erase(iterRegion);
+        detachShard(pos);
+        Lighting.onRegionUnloaded(pos);
+        Fluids.onRegionUnloaded(pos);
+    }
+
+    SavesInFlight.clear();
+    UnloadsInFlight.clear();
+    trimCold(ColdBudget);
+}
+
+void World::demoteCold(Pos::GlobalRegion pos, const Region& region) {
+    if(!ColdBudget)
+        return;
+
+    if(auto iter = ColdRegions.find(pos); iter != ColdRegions.end())
+        dropCold(iter);
+
+    ColdRegion cold;
+    cold.Bytes = sizeof(ColdRegion);
+
+    for(size_t chunk = 0; chunk < region.Nodes.size(); chunk++) {
+        cold.Nodes[chunk] = compressNodes(region.Nodes[chunk].data(), true);
+        cold.Bytes += cold.Nodes[chunk].size();
+    }
+
+    for(const auto& [chunkPos, voxels] : region.Voxels) {
+        if(voxels.empty())
+            continue;
+
+        cold.Voxels[chunkPos] = voxels;
+        cold.Bytes += voxels.size() * sizeof(VoxelCube);
+    }
+
+    for(const Entity& entity : region.Entityes) {
+        if(entity.IsRemoved || entity.NeedRemove)
+            continue;
+        cold.Entityes.push_back(entity);
+    }
+
+    cold.NodeTicks = NodeTicks.collectRegion(pos);
+    cold.Bytes += cold.Entityes.size() * sizeof(Entity) + cold.NodeTicks.size() * sizeof(NodeTickRecord);
+
+    ColdOrder.push_front(pos);
+    cold.Order = ColdOrder.begin();
+
+    Cold.Bytes += cold.Bytes;
+    Cold.Count++;
+    Cold.Demotions++;
+    ColdRegions.emplace(pos, std::move(cold));
+}
+
+bool World::promoteCold(Pos::GlobalRegion pos) {
+    auto iter = ColdRegions.find(pos);
+    if(iter == ColdRegions.end())
+        return false;
+
+    ColdRegion& cold = iter->second;
+
+    std::vector<std::pair<Pos::GlobalRegion, RegionIn>> regions;
+    RegionIn& in = regions.emplace_back(pos, RegionIn()).second;
+    for(size_t chunk = 0; chunk < cold.Nodes.size(); chunk++)
+        unCompressNodes(cold.Nodes[chunk], in.Nodes[chunk].data());
+
+    in.Voxels = std::move(cold.Voxels);
+    in.Entityes = std::move(cold.Entityes);
+    in.NodeTicks = std::move(cold.NodeTicks);
+    // Копия совпадает с сохранённой при выгрузке
+    in.Stored = true;
+
+    Cold.Bytes -= cold.Bytes;
+    Cold.Count--;
+    Cold.Promotions++;
+    ColdOrder.erase(cold.Order);
+    ColdRegions.erase(iter);
+
+    pushRegions(std::move(regions));
+    return true;
+}
+
+void World::trimCold(size_t bytes) {
+    while(Cold.Bytes > bytes && !ColdOrder.empty()) {
+        dropCold(ColdRegions.find(ColdOrder.back()));
+        Cold.Dropped++;
+    }
+}
+
+void World::dropCold(std::unordered_map<Pos::GlobalRegion, ColdRegion>::iterator iter) {
+    assert(iter != ColdRegions.end());
+
+    Cold.Bytes -= iter->second.Bytes;
+    Cold.Count--;
+    ColdOrder.erase(iter->second.Order);
+    ColdRegions.erase(iter);
+}
+
+size_t World::getMemoryUsage() const {
+    size_t bytes = 0;
+
+    for(const auto& [pos, regionPtr] : Regions) {
+        const Region& region = *regionPtr;
+        bytes += sizeof(Region);
+        bytes += region.Entityes.capacity() * sizeof(Entity);
+        bytes += region.LightPendingEdits.capacity() * sizeof(Pos::GlobalNode);
+
+        for(const auto& [chunkPos, voxels] : region.Voxels)
+            bytes += voxels.capacity() * sizeof(VoxelCube);
+    }
+
+    return bytes + Cold.Bytes;
+}
+
 void World::pushRegions(std::vector<std::pair<Pos::GlobalRegion, RegionIn>> regions) {
     for(auto& [key, value] : regions) {
+        // Свежие данные из хранилища или генератора важнее холодной копии
+        if(auto iter = ColdRegions.find(key); iter != ColdRegions.end())
+            dropCold(iter);
+
         Region &region = *(Regions[key] = std::make_unique<Region>());
         region.Voxels = std::move(value.Voxels);
         region.Nodes = value.Nodes;
         region.Entityes = std::move(value.Entityes);
+        region.Stored = value.Stored;
+
+        NodeTicks.dropRegion(key);
+        NodeTicks.restoreRegion(key, value.NodeTicks);
+
+        // У каждого региона свой поток случайных чисел
+        region.RandomState = std::hash<Pos::GlobalRegion>{}(key) * 0x9e3779b97f4a7c15ull | 1;
+
+        attachShard(key);
+        LightRequests.push_back(key);
+        Fluids.onRegionLoaded(key);
     }
 }
 
+bool World::setNode(Pos::GlobalNode pos, Node node) {
+    auto iterRegion = Regions.find(pos >> 6);
+    if(iterRegion == Regions.end())
+        return false;
+
+    if(writeNode(*iterRegion->second, pos, node)) {
+        Lighting.onNodeChanged(pos);
+        Fluids.onNodeChanged(pos);
+    }
+
+    return true;
+}
+
+bool World::writeNode(Region& region, Pos::GlobalNode pos, Node node) {
+    Pos::bvec4u cPos = (pos >> 4) & 0x3;
+    Pos::bvec16u nPos = pos & 0xf;
+
+    Node& current = region.Nodes[cPos.pack()][nPos.pack()];
+    if(current.Data == node.Data)
+        return false;
+
+    current = node;
+    region.IsChunkChanged_Nodes |= 1ull << cPos.pack();
+    region.SaveDirty_Nodes |= 1ull << cPos.pack();
+    region.ChunkGeneration[cPos.pack()]++;
+    region.IsChanged = true;
+    return true;
+}
+
+void World::attachShard(Pos::GlobalRegion rPos) {
+    std::vector<Pos::GlobalRegion>& list = Shards[shardOf(rPos)].Regions;
+    auto iter = std::lower_bound(list.begin(), list.end(), rPos);
+    if(iter == list.end() || *iter != rPos)
+        list.insert(iter, rPos);
+}
+
+void World::detachShard(Pos::GlobalRegion rPos) {
+    auto iterShard = Shards.find(shardOf(rPos));
+    if(iterShard == Shards.end())
+        return;
+
+    std::vector<Pos::GlobalRegion>& list = iterShard->second.Regions;
+    auto iter = std::lower_bound(list.begin(), list.end(), rPos);
+    if(iter != list.end() && *iter == rPos)
+        list.erase(iter);
+
+    if(list.empty())
+        Shards.erase(iterShard);
+}
+
+bool World::isShardInterior(Pos::GlobalNode pos) {
+    const Pos::GlobalRegion shard = shardOf(pos >> 6);
+    const Pos::GlobalNode low = pos - Pos::GlobalNode(FluidSimulator::REACH_SIDE, FluidSimulator::REACH_DOWN, FluidSimulator::REACH_SIDE);
+    const Pos::GlobalNode high = pos + Pos::GlobalNode(FluidSimulator::REACH_SIDE, FluidSimulator::REACH_UP, FluidSimulator::REACH_SIDE);
+    return shardOf(low >> 6) == shard && shardOf(high >> 6) == shard;
+}
+
+std::vector<World::LightJob> World::takeLightJobs() {
+    std::vector<LightJob> out;
+    std::sort(LightRequests.begin(), LightRequests.end());
+    LightRequests.erase(std::unique(LightRequests.begin(), LightRequests.end()), LightRequests.end());
+
+    for(Pos::GlobalRegion pos : LightRequests) {
+        auto iterRegion = Regions.find(pos);
+        if(iterRegion == Regions.end() || iterRegion->second->LightReady)
+            continue;
+
+        // Повторная загрузка того же региона отменяет предыдущий расчёт
+        iterRegion->second->LightJob = ++LightJobCounter;
+        out.push_back({pos, LightJobCounter});
+    }
+
+    LightRequests.clear();
+    return out;
+}
+
+void World::applyRegionLight(Pos::GlobalRegion rPos, uint64_t jobId, const RegionLight& light) {
+    auto iterRegion = Regions.find(rPos);
+    if(iterRegion == Regions.end() || iterRegion->second->LightReady || iterRegion->second->LightJob != jobId)
+        return;
+
+    Lighting.installRegion(rPos, light);
+}
+
+bool World::scheduleNodeTick(Pos::GlobalNode pos, uint32_t delay) {
+    auto iterRegion = Regions.find(pos >> 6);
+    if(iterRegion == Regions.end())
+        return false;
+
+    if(!NodeTicks.schedule(pos, delay))
+        return false;
+
+    iterRegion->second->IsChanged = true;
+    return true;
+}
+
+bool World::cancelNodeTick(Pos::GlobalNode pos) {
+    if(!NodeTicks.cancel(pos))
+        return false;
+
+    if(auto iterRegion = Regions.find(pos >> 6); iterRegion != Regions.end())
+        iterRegion->second->IsChanged = true;
+
+    return true;
+}
+
 void World::onUpdate(GameServer *server, float dtime) {
-    
+    NodeTickEvents.clear();
+
+    // Запланированные такты
+    DueNodeTicks.clear();
+    NodeTicks.advance(DueNodeTicks);
+
+    for(Pos::GlobalNode pos : DueNodeTicks) {
+        auto iterRegion = Regions.find(pos >> 6);
+        if(iterRegion == Regions.end())
+            continue;
+
+        Region& region = *iterRegion->second;
+        Pos::bvec4u cPos = (pos >> 4) & 0x3;
+        Pos::bvec16u nPos = pos & 0xf;
+        region.IsChanged = true;
+        NodeTickEvents.push_back({pos, region.Nodes[cPos.pack()][nPos.pack()].NodeId, false});
+    }
+
+    // Течение жидкостей: ноды такта делятся между шардами, пограничные ждут последовательной части
+    FluidDue.clear();
+    FluidBorder.clear();
+    Fluids.takeDue(FluidDue);
+
+    for(Pos::GlobalNode pos : FluidDue) {
+        auto iterShard = isShardInterior(pos) ? Shards.find(shardOf(pos >> 6)) : Shards.end();
+        if(iterShard != Shards.end())
+            iterShard->second.FluidNodes.push_back(pos);
+        else
+            FluidBorder.push_back(pos);
+    }
+
+    ShardList.clear();
+    for(auto& [key, shard] : Shards)
+        ShardList.push_back(&shard);
+
+    auto job = [this](size_t index) { updateShard(*ShardList[index]); };
+    if(Parallel && ShardList.size() > 1)
+        Parallel(ShardList.size(), job);
+    else
+        for(size_t index = 0; index < ShardList.size(); index++)
+            job(index);
+
+    // Исходящие шардов по порядку: события обработчикам, изменения - свету и жидкостям
+    for(Shard* shard : ShardList) {
+        NodeTickEvents.insert(NodeTickEvents.end(), shard->Events.begin(), shard->Events.end());
+        shard->Events.clear();
+
+        for(Pos::GlobalNode pos : shard->Changed) {
+            Lighting.onNodeChanged(pos);
+            Fluids.onNodeChanged(pos);
+        }
+
+        shard->Changed.clear();
+    }
+
+    // Изменения идут тем же путём, что и правки игроков
+    Fluids.flowNodes(FluidBorder, [this](Pos::GlobalNode pos, Node node) { setNode(pos, node); });
+}
+
+void World::updateShard(Shard& shard) {
+    // Случайные такты: несколько случайных нод в каждом чанке, xorshift на регион
+    if(RandomTickFilter && !RandomTickFilter->empty()) {
+        const std::vector<uint8_t>& filter = *RandomTickFilter;
+
+        for(Pos::GlobalRegion rPos : shard.Regions) {
+            Region& region = *Regions.at(rPos);
+            uint64_t state = region.RandomState;
+            const Pos::GlobalNode base = Pos::GlobalNode(rPos.x, rPos.y, rPos.z) << 6;
+
+            for(size_t chunk = 0; chunk < region.Nodes.size(); chunk++) {
+                const std::array<Node, 16*16*16>& nodes = region.Nodes[chunk];
+
+                for(int iter = 0; iter < RANDOM_TICKS_PER_CHUNK; iter++) {
+                    state ^= state >> 12;
+                    state ^= state << 25;
+                    state ^= state >> 27;
+                    uint32_t index = uint32_t((state * 0x2545f4914f6cdd1dull) >> 52);
+
+                    DefNodeId nodeId = nodes[index].NodeId;
+                    if(nodeId >= filter.size() || !filter[nodeId])
+                        continue;
+
+                    Pos::bvec4u cPos;
+                    cPos.unpack(chunk);
+                    Pos::bvec16u nPos;
+                    nPos.unpack(index);
+
+                    shard.Events.push_back({base + (Pos::GlobalNode(cPos) << 4) + Pos::GlobalNode(nPos), nodeId, true});
+                }
+            }
+
+            region.RandomState = state;
+        }
+    }
+
+    // Окрестность этих нод внутри шарда, писать можно сразу, остальное - через исходящие
+    Fluids.flowNodes(shard.FluidNodes, [&](Pos::GlobalNode pos, Node node) {
+        if(writeNode(*Regions.at(pos >> 6), pos, node))
+            shard.Changed.push_back(pos);
+    });
+
+    shard.FluidNodes.clear();
 }
 
 }
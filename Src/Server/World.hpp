@@ -4,6 +4,12 @@
 #include "Server/Abstract.hpp"
 #include "Server/RemoteClient.hpp"
 #include "Server/SaveBackend.hpp"
+#include "Server/NodeTickScheduler.hpp"
+#include "Server/LightEngine.hpp"
+#include "Server/FluidSimulator.hpp"
+#include <functional>
+#include <list>
+#include <map>
 #include <memory>
 #include <unordered_map>
 #include <vector>
@@ -18,17 +24,33 @@ class Region {
 public:
     uint64_t IsChunkChanged_Voxels = 0;
     uint64_t IsChunkChanged_Nodes = 0;
+    uint64_t IsChunkChanged_Light = 0;
     bool IsChanged = false; // Изменён ли был регион, относительно последнего сохранения
+    // Чанки, изменённые с последнего сохранения. IsChunkChanged_* сбрасывает рассылка игрокам, эти - только сохранение
+    uint64_t SaveDirty_Voxels = 0;
+    uint64_t SaveDirty_Nodes = 0;
+    // Счётчик изменений нод каждого чанка и его значение на момент последнего сохранения
+    std::array<uint32_t, 4*4*4> ChunkGeneration = {}, SavedGeneration = {};
+    // В хранилище уже лежит полная копия региона, можно дописывать только изменённые чанки
+    bool Stored = false;
     std::unordered_map<Pos::bvec4u, std::vector<VoxelCube>> Voxels;
-    // x y cx cy cz
-    //LightPrism Lights[16][16][4][4][4];
-
     std::array<std::array<Node, 16*16*16>, 4*4*4> Nodes;
 
+    // Освещённость нод, не сохраняется и пересчитывается при загрузке
+    RegionLight Light = {};
+    // Полный расчёт света завершён; до этого изменения нод копятся в LightPendingEdits
+    bool LightReady = false;
+    uint64_t LightJob = 0;
+    std::vector<Pos::GlobalNode> LightPendingEdits;
+
     std::vector<Entity> Entityes;
     std::vector<std::shared_ptr<RemoteClient>> RMs, NewRMs;
 
     float LastSaveTime = 0;
+    // Сколько регион пробыл без наблюдателей, по нему и выгружается (сохранения его не сбрасывают)
+    float IdleTime = 0;
+    // Состояние генератора случайных тактов
+    uint64_t RandomState = 1;
 
     void getCollideBoxes(Pos::GlobalRegion rPos, AABB aabb, std::vector<CollisionAABB> &boxes) {
         // Абсолютная позиция начала региона
@@ -152,27 +174,236 @@ public:
     struct SaveUnloadInfo {
         std::vector<Pos::GlobalRegion> ToUnload;
         std::vector<std::pair<Pos::GlobalRegion, SB_Region_In>> ToSave;
+        // Сколько из выгруженных ушло досрочно по requestEviction
+        size_t Evicted = 0;
+    };
+    /*
+        Собирает регионы на сохранение и выгрузку.
+        Чем больше изменений накопил регион, тем раньше он сохраняется.
+        byteBudget - общий на все миры бюджет записи (несжатые байты), плановые сохранения
+        ждут, пока он положителен, выгрузка сохраняется всегда и может увести его в минус
+    */
+    SaveUnloadInfo onStepDatabaseSync(ContentManager& cm, float dtime, double& byteBudget);
+    /*
+        Итог записи после tickSync, вызывается каждый такт после onStepDatabaseSync.
+        Не записанные регионы снова помечаются изменёнными и остаются загруженными,
+        остальные выгружаемые только теперь уходят из мира
+    */
+    void onSaveResults(const std::vector<Pos::GlobalRegion>& failed);
+
+    // Ближайший onStepDatabaseSync выгрузит до count регионов без наблюдателей, не дожидаясь задержки
+    void requestEviction(size_t count) {
+        EvictBudget = count;
+    }
+
+    // Оценка памяти регионов: ноды, свет, воксели и сущности, вместе с холодным ярусом
+    size_t getMemoryUsage() const;
+    size_t getRegionCount() const { return Regions.size(); }
+
+    /*
+        Холодный ярус: выгруженные регионы остаются в памяти в сжатом виде.
+        Выгрузка всегда сохраняет регион, поэтому копия совпадает с хранилищем
+        и её можно выбросить в любой момент. Идентификаторы в копии серверные,
+        как у загруженных регионов. Объём ограничен бюджетом, лишнее вытесняется
+        по давности выгрузки.
+    */
+    static constexpr size_t COLD_BUDGET_DEFAULT = 64 << 20;
+
+    struct ColdStats {
+        size_t Bytes = 0, Count = 0;
+        // Выгружено в ярус, поднято обратно в мир, вытеснено без использования
+        uint64_t Demotions = 0, Promotions = 0, Dropped = 0;
     };
-    SaveUnloadInfo onStepDatabaseSync(ContentManager& cm, float dtime);
+
+    void setColdBudget(size_t bytes) {
+        ColdBudget = bytes;
+        trimCold(ColdBudget);
+    }
+
+    // Возвращает регион из холодного яруса в мир, false если его там нет
+    bool promoteCold(Pos::GlobalRegion pos);
+    // Вытесняет давние копии, пока ярус не уложится в bytes
+    void trimCold(size_t bytes);
+    const ColdStats& getColdStats() const { return Cold; }
 
     struct RegionIn {
         std::unordered_map<Pos::bvec4u, std::vector<VoxelCube>> Voxels;
         std::array<std::array<Node, 16*16*16>, 4*4*4> Nodes;
         std::vector<Entity> Entityes;
+        std::vector<NodeTickRecord> NodeTicks;
+        // Регион прочитан из хранилища, а не сгенерирован
+        bool Stored = false;
     };
     void pushRegions(std::vector<std::pair<Pos::GlobalRegion, RegionIn>>);
 
+    // Сколько случайных нод выбирается в каждом чанке за такт
+    static constexpr uint8_t RANDOM_TICKS_PER_CHUNK = 3;
+
+    struct NodeTickEvent {
+        Pos::GlobalNode Pos;
+        DefNodeId NodeId;
+        bool Random;
+    };
+
+    /*
+        Планирует такт ноды через delay тактов мира.
+        Для позиции держится только один ожидающий такт (повторный вызов вернёт false)
+    */
+    bool scheduleNodeTick(Pos::GlobalNode pos, uint32_t delay);
+    bool cancelNodeTick(Pos::GlobalNode pos);
+
+    // Ноды, для которых выбираются случайные такты (индекс - DefNodeId)
+    void setRandomTickFilter(const std::vector<uint8_t>* filter) {
+        RandomTickFilter = filter;
+    }
+
+    // Выполняет job(0..count-1), возможно параллельно, и возвращается после завершения всех
+    using ParallelFor = std::function<void(size_t count, const std::function<void(size_t)>& job)>;
+
+    // Исполнитель шардов onUpdate, без него шарды обрабатываются по очереди
+    void setParallelFor(ParallelFor executor) {
+        Parallel = std::move(executor);
+    }
+
+    // Сработавшие за последний onUpdate такты нод, для пакетной передачи обработчикам
+    std::vector<NodeTickEvent> takeNodeTickEvents() {
+        return std::move(NodeTickEvents);
+    }
+
+    // Заменяет ноду, помечает чанк изменённым, ставит в очередь обновление света и будит жидкости рядом
+    bool setNode(Pos::GlobalNode pos, Node node);
+
+    struct LightJob {
+        Pos::GlobalRegion Pos;
+        uint64_t Id;
+    };
+
+    // Световые свойства нод (индекс - DefNodeId)
+    void setNodeLightTable(const std::vector<NodeLightInfo>* table) {
+        Lighting.setNodeTable(table);
+    }
+
+    // Новые регионы, которым нужен полный расчёт освещения в пуле
+    std::vector<LightJob> takeLightJobs();
+    // Результат полного расчёта. Если регион с тех пор перезагрузили, результат отбрасывается
+    void applyRegionLight(Pos::GlobalRegion rPos, uint64_t jobId, const RegionLight& light);
+    // Инкрементальное обновление света после изменений нод и сшивки регионов
+    void updateLight() {
+        Lighting.update();
+    }
+
+    // Жидкие ноды (индекс - DefNodeId)
+    void setNodeFluidTable(const std::vector<NodeFluidInfo>* table) {
+        Fluids.setFluidTable(table);
+    }
+
+    // Сколько жидких нод обрабатывается за такт
+    void setFluidBudget(uint32_t budget) {
+        Fluids.setBudget(budget);
+    }
+
+    size_t getActiveFluidCount() const {
+        return Fluids.activeCount();
+    }
 
     /*
         Проверка использования регионов, 
+        такты нод (запланированные и случайные),
+        течение жидкостей
+
+        Регионы делятся на шарды - кубы по SHARD_SIZE регионов. Случайные такты
+        и течение внутри шарда идут параллельно с другими шардами и трогают только его регионы.
+        Последствия изменений (свет, пробуждение жидкостей по соседству, в том числе в чужих шардах)
+        шард копит в своих исходящих и они разбираются в порядке шардов после параллельной части.
+        Ноды жидкостей, чья окрестность задевает соседний шард, обрабатываются последними по очереди.
+        Так результат не зависит от числа потоков.
     */
     void onUpdate(GameServer *server, float dtime);
 
+    static constexpr int SHARD_BITS = 2;
+    static constexpr int SHARD_SIZE = 1 << SHARD_BITS;
+
+    static Pos::GlobalRegion shardOf(Pos::GlobalRegion rPos) {
+        return rPos >> SHARD_BITS;
+    }
+
+    size_t getShardCount() const {
+        return Shards.size();
+    }
+
     /*
 
     */
 
     DefWorldId getDefId() const { return DefId; }
+
+private:
+    NodeTickScheduler NodeTicks;
+    const std::vector<uint8_t>* RandomTickFilter = nullptr;
+    std::vector<NodeTickEvent> NodeTickEvents;
+    std::vector<Pos::GlobalNode> DueNodeTicks;
+
+    LightEngine Lighting{Regions};
+    std::vector<Pos::GlobalRegion> LightRequests;
+    uint64_t LightJobCounter = 0;
+
+    FluidSimulator Fluids{Regions};
+
+    struct Shard {
+        // Регионы шарда по возрастанию позиции
+        std::vector<Pos::GlobalRegion> Regions;
+        // Ноды жидкостей этого такта, чья окрестность целиком внутри шарда
+        std::vector<Pos::GlobalNode> FluidNodes;
+
+        // Исходящие: сработавшие случайные такты и изменённые ноды
+        std::vector<NodeTickEvent> Events;
+        std::vector<Pos::GlobalNode> Changed;
+    };
+
+    // Упорядоченный контейнер задаёт порядок разбора исходящих
+    std::map<Pos::GlobalRegion, Shard> Shards;
+    size_t EvictBudget = 0;
+
+    // Отданные на запись в этом такте: грязные чанки до записи
+    struct SaveSnapshot {
+        uint64_t Voxels, Nodes;
+        std::array<uint32_t, 4*4*4> Generation;
+    };
+
+    std::unordered_map<Pos::GlobalRegion, SaveSnapshot> SavesInFlight;
+    // Выгружаются после подтверждения записи
+    std::vector<Pos::GlobalRegion> UnloadsInFlight;
+    std::vector<Shard*> ShardList;
+    std::vector<Pos::GlobalNode> FluidDue, FluidBorder;
+    ParallelFor Parallel;
+
+    // Записывает ноду и помечает чанк, без побочных действий мира. false, если нода не изменилась
+    static bool writeNode(Region& region, Pos::GlobalNode pos, Node node);
+    void attachShard(Pos::GlobalRegion rPos);
+    void detachShard(Pos::GlobalRegion rPos);
+    // Окрестность течения ноды лежит в том же шарде
+    static bool isShardInterior(Pos::GlobalNode pos);
+    void updateShard(Shard& shard);
+
+    struct ColdRegion {
+        // Чанки нод по compressNodes
+        std::array<std::u8string, 4*4*4> Nodes;
+        std::unordered_map<Pos::bvec4u, std::vector<VoxelCube>> Voxels;
+        std::vector<Entity> Entityes;
+        std::vector<NodeTickRecord> NodeTicks;
+        size_t Bytes = 0;
+        // Место в ColdOrder
+        std::list<Pos::GlobalRegion>::iterator Order;
+    };
+
+    std::unordered_map<Pos::GlobalRegion, ColdRegion> ColdRegions;
+    // От недавно выгруженных к давним
+    std::list<Pos::GlobalRegion> ColdOrder;
+    size_t ColdBudget = COLD_BUDGET_DEFAULT;
+    ColdStats Cold;
+
+    void demoteCold(Pos::GlobalRegion pos, const Region& region);
+    void dropCold(std::unordered_map<Pos::GlobalRegion, ColdRegion>::iterator iter);
 };
 
 
@@ -25,6 +25,10 @@
 #include <boost/archive/iterators/base64_from_binary.hpp>
 #include <boost/archive/iterators/transform_width.hpp>
 #include <boost/nowide/fstream.hpp>
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <unordered_map>
 
 namespace TOS {
 
@@ -874,32 +878,333 @@ static std::vector<LogFile> LogFiles;
 static std::vector<LogCmd> LogRegexs;
 static uint32_t LogCmdLastDay = Time::getDay();
 
-LogSession::LogSession(const std::string &path, EnumLogType type)
-	: Path(path)
+struct LogRoute {
+	uint32_t Generation;
+	// Уровни, выводимые в консоль
+	int ConsoleLevels = 0;
+	// Индекс в LogFiles и уровни для файла
+	std::vector<std::pair<size_t, int>> Files;
+	// Объединение уровней всех файлов
+	int FileLevels = 0;
+};
+
+// Меняется при добавлении приёмников, старые маршруты остаются живы (на них могут ссылаться логгеры)
+static std::atomic<uint32_t> LogGeneration = 1;
+static std::unordered_map<std::string, std::unique_ptr<LogRoute>> LogRoutes;
+static std::vector<std::unique_ptr<LogRoute>> LogRoutesRetired;
+
+// Вызывается под LogFilesMtx
+static void invalidateLogRoutes()
 {
+	for(auto &[path, route] : LogRoutes)
+		LogRoutesRetired.push_back(std::move(route));
+
+	LogRoutes.clear();
+	LogGeneration++;
+}
+
+static const LogRoute* resolveLogRoute(const std::string &path)
+{
+	std::lock_guard lock(LogFilesMtx);
+
+	std::unique_ptr<LogRoute> &route = LogRoutes[path];
+	if(route)
+		return route.get();
+
+	route = std::make_unique<LogRoute>();
+	route->Generation = LogGeneration.load(std::memory_order_relaxed);
+
+	for(auto &iter : LogRegexs)
+		if(boost::u32regex_match(path.data(), iter.RegexForPath))
+			route->ConsoleLevels |= int(iter.Levels);
+
+	for(size_t index = 0; index < LogFiles.size(); index++)
+		if(boost::u32regex_match(path.data(), LogFiles[index].RegexForPath))
+		{
+			route->Files.emplace_back(index, int(LogFiles[index].Levels));
+			route->FileLevels |= int(LogFiles[index].Levels);
+		}
+
+	return route.get();
+}
+
+// Перевод строк в записи сдвигается табуляцией
+static void writeLogText(std::ostream &out, const std::string &text)
+{
+	size_t prev = 0, next;
+	while((next = text.find('\n', prev)) != std::string::npos)
 	{
-		std::lock_guard lock(LogFilesMtx);
+		out.write(text.data()+prev, next-prev);
+		out.write("\n\t", 2);
+		prev = next+1;
+	}
+
+	out.write(text.data()+prev, text.size()-prev);
+	out.put('\n');
+}
 
-		for(auto &iter : LogRegexs)
-			if(int(type) & int(iter.Levels) && boost::u32regex_match(path.data(), iter.RegexForPath))
+// Вызывается под LogFilesMtx, сброс буферов на совести вызывающего
+static void writeLogRecord(const LogRoute &route, EnumLogType type, const std::string &text)
+{
+	if(route.FileLevels & int(type))
+	{
+		uint32_t day = Time::getDay();
+
+		for(auto &[index, levels] : route.Files)
+		{
+			if(!(levels & int(type)))
+				continue;
+
+			LogFile &file = LogFiles[index];
+			if(file.LastLoggedDay != day)
 			{
-				NeedC = true;
-				break;
+				file.LastLoggedDay = day;
+				file.Write << " -*[ " << Time::getDateAsString() << " ]*-\n\n";
 			}
 
-		for(auto &iter : LogFiles)
-			if(int(type) & int(iter.Levels) && boost::u32regex_match(path.data(), iter.RegexForPath))
+			writeLogText(file.Write, text);
+		}
+	}
+
+	if(route.ConsoleLevels & int(type))
+	{
+		uint32_t day = Time::getDay();
+		if(LogCmdLastDay != day)
+		{
+			LogCmdLastDay = day;
+			std::cout << " -*[ " << Time::getDateAsString() << " ]*-\n\n";
+		}
+
+		writeLogText(std::cout, text);
+	}
+}
+
+static void flushLogOutputs()
+{
+	for(auto &iter : LogFiles)
+		iter.Write.flush();
+
+	std::cout.flush();
+}
+
+struct LogRecord {
+	uint64_t Seq = 0;
+	const LogRoute *Route = nullptr;
+	EnumLogType Type = EnumLogType::Debug;
+	std::string Text;
+};
+
+// Буфер одного потока: пишет только владелец, читает только фоновый поток
+class LogRing {
+public:
+	static constexpr size_t CAPACITY = 1024;
+
+	bool tryPush(LogRecord &&record)
+	{
+		size_t head = Head.load(std::memory_order_relaxed);
+		if(head - Tail.load(std::memory_order_acquire) >= CAPACITY)
+			return false;
+
+		Records[head % CAPACITY] = std::move(record);
+		Head.store(head+1, std::memory_order_release);
+		return true;
+	}
+
+	size_t size() const
+	{
+		return Head.load(std::memory_order_acquire) - Tail.load(std::memory_order_relaxed);
+	}
+
+	template<typename Func>
+	void drain(Func &&func)
+	{
+		size_t tail = Tail.load(std::memory_order_relaxed);
+		size_t head = Head.load(std::memory_order_acquire);
+
+		for(; tail != head; tail++)
+			func(std::move(Records[tail % CAPACITY]));
+
+		Tail.store(tail, std::memory_order_release);
+	}
+
+	// Поток-владелец завершился, после опустошения буфер можно удалить
+	std::atomic<bool> Closed = false;
+
+private:
+	std::array<LogRecord, CAPACITY> Records;
+	alignas(64) std::atomic<size_t> Head = 0;
+	alignas(64) std::atomic<size_t> Tail = 0;
+};
+
+class AsyncLogBackend {
+public:
+	~AsyncLogBackend()
+	{
+		stop();
+	}
+
+	bool isEnabled() const { return Enabled.load(std::memory_order_acquire); }
+
+	void start()
+	{
+		std::lock_guard lock(Mtx);
+		if(Thread.joinable())
+			return;
+
+		NeedShutdown = false;
+		Thread = std::thread(&AsyncLogBackend::run, this);
+		Enabled.store(true, std::memory_order_release);
+	}
+
+	void stop()
+	{
+		{
+			std::lock_guard lock(Mtx);
+			if(!Thread.joinable())
+				return;
+
+			Enabled.store(false, std::memory_order_release);
+			NeedShutdown = true;
+		}
+
+		CV.notify_all();
+		Thread.join();
+
+		// Записи, успевшие попасть в буферы после выхода фонового потока
+		std::vector<LogRecord> batch;
+		collect(batch);
+		write(batch);
+	}
+
+	// false - буфер потока переполнен, text тогда остаётся у вызывающего
+	bool push(const LogRoute *route, EnumLogType type, std::string &text)
+	{
+		LogRing &ring = threadRing();
+
+		LogRecord record;
+		record.Seq = NextSeq.fetch_add(1, std::memory_order_relaxed);
+		record.Route = route;
+		record.Type = type;
+		record.Text = std::move(text);
+
+		if(!ring.tryPush(std::move(record)))
+		{
+			text = std::move(record.Text);
+			return false;
+		}
+
+		// Фоновый поток просыпается сам, будим только при наполнении буфера
+		if(ring.size() == LogRing::CAPACITY/2)
+			CV.notify_one();
+
+		return true;
+	}
+
+	std::atomic<uint64_t> Written = 0, Dropped = 0, Overflowed = 0;
+
+private:
+	struct RingHolder {
+		std::shared_ptr<LogRing> Ring;
+
+		~RingHolder()
+		{
+			if(Ring)
+				Ring->Closed.store(true, std::memory_order_release);
+		}
+	};
+
+	std::mutex Mtx;
+	std::condition_variable CV;
+	std::vector<std::shared_ptr<LogRing>> Rings;
+	std::thread Thread;
+	std::atomic<bool> Enabled = false;
+	bool NeedShutdown = false;
+	std::atomic<uint64_t> NextSeq = 0;
+
+	LogRing& threadRing()
+	{
+		static thread_local RingHolder holder;
+		if(!holder.Ring)
+		{
+			holder.Ring = std::make_shared<LogRing>();
+			std::lock_guard lock(Mtx);
+			Rings.push_back(holder.Ring);
+		}
+
+		return *holder.Ring;
+	}
+
+	void collect(std::vector<LogRecord> &batch)
+	{
+		std::lock_guard lock(Mtx);
+
+		for(size_t iter = 0; iter < Rings.size(); iter++)
+		{
+			bool closed = Rings[iter]->Closed.load(std::memory_order_acquire);
+			Rings[iter]->drain([&](LogRecord &&record) { batch.push_back(std::move(record)); });
+
+			if(closed)
 			{
-				NeedF = true;
-				break;
+				Rings[iter] = std::move(Rings.back());
+				Rings.pop_back();
+				iter--;
 			}
+		}
+	}
 
-		if(!NeedF && !NeedC)
-		{
+	void write(std::vector<LogRecord> &batch)
+	{
+		if(batch.empty())
 			return;
+
+		// Восстанавливаем порядок между потоками
+		std::sort(batch.begin(), batch.end(), [](const LogRecord &left, const LogRecord &right) { return left.Seq < right.Seq; });
+
+		{
+			std::lock_guard lock(LogFilesMtx);
+			for(LogRecord &record : batch)
+				writeLogRecord(*record.Route, record.Type, record.Text);
+
+			flushLogOutputs();
 		}
+
+		Written.fetch_add(batch.size(), std::memory_order_relaxed);
+		batch.clear();
 	}
 
+	void run()
+	{
+		std::vector<LogRecord> batch;
+
+		while(true)
+		{
+			{
+				std::unique_lock lock(Mtx);
+				CV.wait_for(lock, std::chrono::milliseconds(5));
+				if(NeedShutdown)
+					break;
+			}
+
+			collect(batch);
+			write(batch);
+		}
+
+		collect(batch);
+		write(batch);
+	}
+};
+
+static AsyncLogBackend AsyncLog;
+
+LogSession::LogSession(const std::string &path, EnumLogType type, const LogRoute *route)
+	: Type(type), Route(route)
+{
+	NeedC = route->ConsoleLevels & int(type);
+	NeedF = route->FileLevels & int(type);
+
+	if(!NeedF && !NeedC)
+		return;
+
 	*this << char(27) << '[';
 	switch(type) {
 	case EnumLogType::Debug: 	*this << "37"; break;
@@ -928,41 +1233,42 @@ LogSession::~LogSession()
 	if(!NeedF && !NeedC)
 		return;
 
-	std::lock_guard lock(LogFilesMtx);
-	
-	if(NeedF)
-	{
-		for(auto &iter : LogFiles)
-			if(boost::u32regex_match(Path.data(), iter.RegexForPath))
-			{
-				uint32_t day = Time::getDay();
-				if(iter.LastLoggedDay != day)
-				{
-					iter.LastLoggedDay = day;
-					std::stringstream date;
-					date << " -*[ " << Time::getDateAsString() << " ]*-\n";
-					iter.Write << date.str() << std::endl;
-				}
-
-				iter.Write << Str::replace(str(), "\n", "\n\t") << std::endl;
-				iter.Write.flush();
-			}
-	}
+	std::string text = std::move(*this).str();
 
-	if(NeedC)
+	if(AsyncLog.isEnabled())
 	{
-		uint32_t day = Time::getDay();
-		if(LogCmdLastDay != day)
+		if(AsyncLog.push(Route, Type, text))
+			return;
+
+		if(Type != EnumLogType::Error)
 		{
-			LogCmdLastDay = day;
-			std::stringstream date;
-			date << " -*[ " << Time::getDateAsString() << " ]*-\n";
-			std::cout << date.str() << std::endl;
+			AsyncLog.Dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
 		}
 
-		std::cout << Str::replace(str(), "\n", "\n\t") << std::endl;
-		std::cout.flush();
+		AsyncLog.Overflowed.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	std::lock_guard lock(LogFilesMtx);
+	writeLogRecord(*Route, Type, text);
+	flushLogOutputs();
+}
+
+const LogRoute* Logger::route() const
+{
+	const LogRoute *route = Route.load(std::memory_order_acquire);
+	if(!route || route->Generation != LogGeneration.load(std::memory_order_acquire))
+	{
+		route = resolveLogRoute(Path);
+		Route.store(route, std::memory_order_release);
 	}
+
+	return route;
+}
+
+LogSession Logger::print(const std::string &path)
+{
+	return LogSession(path, EnumLogType::All, resolveLogRoute(path));
 }
 
 void Logger::addLogFile(const std::string &regex_for_path, EnumLogType levels, const std::filesystem::path &file, bool rewrite)
@@ -972,12 +1278,31 @@ void Logger::addLogFile(const std::string &regex_for_path, EnumLogType levels, c
 	
 	std::lock_guard lock(LogFilesMtx);
 	LogFiles.emplace_back(regex_for_path, levels, file);
+	invalidateLogRoutes();
 }
 
 void Logger::addLogOutput(const std::string &regex_for_path, EnumLogType levels)
 {
 	std::lock_guard lock(LogFilesMtx);
 	LogRegexs.emplace_back(regex_for_path, levels);
+	invalidateLogRoutes();
+}
+
+void Logger::setAsync(bool enable)
+{
+	if(enable)
+		AsyncLog.start();
+	else
+		AsyncLog.stop();
+}
+
+Logger::Stats Logger::getStats()
+{
+	Stats stats;
+	stats.Written = AsyncLog.Written.load(std::memory_order_relaxed);
+	stats.Dropped = AsyncLog.Dropped.load(std::memory_order_relaxed);
+	stats.Overflowed = AsyncLog.Overflowed.load(std::memory_order_relaxed);
+	return stats;
 }
 
 static bool exec = [](){
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <boost/timer/timer.hpp>
+#include <atomic>
 #include <chrono>
 #include <cstring>
 #include <filesystem>
@@ -787,13 +788,16 @@ enum struct EnumLogType : int {
 	Debug = 1, Info = 2, Warn = 4, Error = 8, All = 15
 };
 
+// Набор приёмников (консоль, файлы) для пути логгера, вычисляется один раз на конфигурацию
+struct LogRoute;
 
 class LogSession : public std::stringstream {
 	bool NeedF = false, NeedC = false;
-	std::string Path;
+	EnumLogType Type;
+	const LogRoute *Route = nullptr;
 
 public:
-	LogSession(const std::string &name, EnumLogType type);
+	LogSession(const std::string &name, EnumLogType type, const LogRoute *route);
 	~LogSession();
 
 	LogSession(const LogSession&) = delete;
@@ -804,23 +808,47 @@ public:
 
 class Logger {
 	std::string Path;
+	// Кеш маршрута, сбрасывается при изменении списка приёмников
+	mutable std::atomic<const LogRoute*> Route = nullptr;
+
+	const LogRoute* route() const;
 
 public:
+	struct Stats {
+		// Записано фоновым потоком
+		uint64_t Written = 0;
+		// Отброшено из-за переполнения буфера потока
+		uint64_t Dropped = 0;
+		// Записано синхронно из-за переполнения буфера потока (ошибки не отбрасываются)
+		uint64_t Overflowed = 0;
+	};
+
 	Logger(const std::string &path) : Path(path) {}
 	Logger(const char *path) : Path(path) {}
 	~Logger() = default;
 
-	inline LogSession print(EnumLogType type) const { return LogSession(Path, type); }
+	Logger(const Logger &obj) : Path(obj.Path) {}
+	Logger& operator=(const Logger &obj) { Path = obj.Path; Route = nullptr; return *this; }
+
+	inline LogSession print(EnumLogType type) const { return LogSession(Path, type, route()); }
 	inline LogSession debug() const { return print(EnumLogType::Debug); }
 	inline LogSession info()  const { return print(EnumLogType::Info); 	}
 	inline LogSession warn()  const { return print(EnumLogType::Warn); 	}
 	inline LogSession error() const { return print(EnumLogType::Error); }
 
-	void setName(const std::string &path) { Path = path; }
+	void setName(const std::string &path) { Path = path; Route = nullptr; }
 
-	static LogSession print(const std::string &path) { return LogSession(path, EnumLogType::All); }
+	static LogSession print(const std::string &path);
 	static void addLogFile(const std::string &regex_for_path, EnumLogType levels, const std::filesystem::path &file, bool rewrite = false);
 	static void addLogOutput(const std::string &regex_for_path, EnumLogType levels);
+
+	/*
+		Асинхронный режим: потоки складывают готовые записи в собственные кольцевые буферы,
+		маршрутизацию, запись и сброс на диск пачками выполняет фоновый поток.
+		При выключении оставшиеся записи дописываются синхронно.
+	*/
+	static void setAsync(bool enable);
+	static Stats getStats();
 };
 
 }
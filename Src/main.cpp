@@ -37,7 +37,10 @@ int main() {
 int main() {
     TOS::Logger::addLogOutput(".*", TOS::EnumLogType::All);
 	TOS::Logger::addLogFile(".*", TOS::EnumLogType::All, "log.raw");
+	TOS::Logger::setAsync(true);
 	
 	std::cout << "Hello world!" << std::endl;
-	return LV::main();
+	int code = LV::main();
+	TOS::Logger::setAsync(false);
+	return code;
 }
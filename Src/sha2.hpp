@@ -8,6 +8,17 @@
 #include <cstdint>
 #include <cstring>
 
+// Runtime dispatch to SHA_NI / AVX2 is only built for x86 with GCC or Clang,
+// other targets always use the portable code.
+#if (defined(__x86_64__) || defined(__i386__)) &&                               \
+    (defined(__GNUC__) || defined(__clang__))
+#define SHA2_X86_DISPATCH 1
+#include <cpuid.h>
+#include <immintrin.h>
+#else
+#define SHA2_X86_DISPATCH 0
+#endif
+
 namespace sha2 {
 
 template <size_t N>
@@ -82,38 +93,43 @@ truncate(const hash_array<N>& hash)
     return result;
 }
 
-// Both sha256_impl and sha512_impl are used by sha224/sha256 and
-// sha384/sha512 respectively, avoiding duplication as only the initial hash
-// values (s) and output hash length change.
-inline sha256_hash
-sha256_impl(const uint32_t* s, const uint8_t* data, uint64_t length)
-{
-    static_assert(sizeof(uint32_t) == 4, "sizeof(uint32_t) must be 4");
-    static_assert(sizeof(uint64_t) == 8, "sizeof(uint64_t) must be 8");
-
-    constexpr size_t chunk_bytes = 64;
-    const uint64_t bit_length = length * 8;
-
-    uint32_t hash[8] = {s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7]};
+constexpr uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+// First 32 bits of the fractional parts of the square roots of the first
+// eight primes 2..19:
+constexpr uint32_t sha256_initial_hash_values[8] = {0x6a09e667,
+                                                    0xbb67ae85,
+                                                    0x3c6ef372,
+                                                    0xa54ff53a,
+                                                    0x510e527f,
+                                                    0x9b05688c,
+                                                    0x1f83d9ab,
+                                                    0x5be0cd19};
+
+// Block compression function: folds `blocks` consecutive 64 byte blocks into
+// the eight word state.
+using sha256_compress_fn = void (*)(uint32_t* state, const uint8_t* data,
+                                    size_t blocks);
 
-    constexpr uint32_t k[64] = {
-        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
-        0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
-        0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
-        0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
-        0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
-        0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
-        0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
-        0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
-        0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
-
-    auto chunk = [&hash, &k](const uint8_t* chunk_data) {
+inline void
+sha256_compress_portable(uint32_t* state, const uint8_t* data, size_t blocks)
+{
+    for (; blocks; --blocks, data += 64) {
         uint32_t w[64] = {0};
 
         for (int i = 0; i != 16; ++i) {
-            w[i] = read_u32(&chunk_data[i * 4]);
+            w[i] = read_u32(&data[i * 4]);
         }
 
         for (int i = 16; i != 64; ++i) {
@@ -124,19 +140,19 @@ sha256_impl(const uint32_t* s, const uint8_t* data, uint64_t length)
             w[i] = w[i - 16] + s0 + w[i - 7] + s1;
         }
 
-        auto a = hash[0];
-        auto b = hash[1];
-        auto c = hash[2];
-        auto d = hash[3];
-        auto e = hash[4];
-        auto f = hash[5];
-        auto g = hash[6];
-        auto h = hash[7];
+        auto a = state[0];
+        auto b = state[1];
+        auto c = state[2];
+        auto d = state[3];
+        auto e = state[4];
+        auto f = state[5];
+        auto g = state[6];
+        auto h = state[7];
 
         for (int i = 0; i != 64; ++i) {
             auto s1 = ror(e, 6) ^ ror(e, 11) ^ ror(e, 25);
             auto ch = (e & f) ^ (~e & g);
-            auto temp1 = h + s1 + ch + k[i] + w[i];
+            auto temp1 = h + s1 + ch + sha256_k[i] + w[i];
             auto s0 = ror(a, 2) ^ ror(a, 13) ^ ror(a, 22);
             auto maj = (a & b) ^ (a & c) ^ (b & c);
             auto temp2 = s0 + maj;
@@ -151,47 +167,173 @@ sha256_impl(const uint32_t* s, const uint8_t* data, uint64_t length)
             a = temp1 + temp2;
         }
 
-        hash[0] += a;
-        hash[1] += b;
-        hash[2] += c;
-        hash[3] += d;
-        hash[4] += e;
-        hash[5] += f;
-        hash[6] += g;
-        hash[7] += h;
-    };
-
-    while (length >= chunk_bytes) {
-        chunk(data);
-        data += chunk_bytes;
-        length -= chunk_bytes;
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
     }
+}
 
-    {
-        std::array<uint8_t, chunk_bytes> buf;
-        memcpy(buf.data(), data, length);
+#if SHA2_X86_DISPATCH
 
-        auto i = length;
-        buf[i++] = 0x80;
+// Intel SHA extensions. State is kept as ABEF/CDGH pairs as required by
+// sha256rnds2, each loop iteration performs four rounds.
+__attribute__((target("sha,sse4.1"))) inline void
+sha256_compress_shani(uint32_t* state, const uint8_t* data, size_t blocks)
+{
+    const __m128i bswap_mask =
+        _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
 
-        if (i > chunk_bytes - 8) {
-            while (i < chunk_bytes) {
-                buf[i++] = 0;
+    __m128i tmp = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0]));
+    __m128i state1 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4]));
+
+    tmp = _mm_shuffle_epi32(tmp, 0xb1);               // CDAB
+    state1 = _mm_shuffle_epi32(state1, 0x1b);         // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8); // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0);      // CDGH
+
+    for (; blocks; --blocks, data += 64) {
+        const __m128i abef_save = state0;
+        const __m128i cdgh_save = state1;
+        __m128i msg[4];
+
+        for (int i = 0; i != 16; ++i) {
+            __m128i& w = msg[i & 3];
+
+            if (i < 4) {
+                w = _mm_shuffle_epi8(
+                    _mm_loadu_si128(
+                        reinterpret_cast<const __m128i*>(data + i * 16)),
+                    bswap_mask);
+            } else {
+                // w[t] = s1(w[t-2]) + w[t-7] + s0(w[t-15]) + w[t-16]
+                const __m128i& w1 = msg[(i - 1) & 3];
+                const __m128i& w2 = msg[(i - 2) & 3];
+                w = _mm_sha256msg1_epu32(w, msg[(i - 3) & 3]);
+                w = _mm_add_epi32(w, _mm_alignr_epi8(w1, w2, 4));
+                w = _mm_sha256msg2_epu32(w, w1);
             }
 
-            chunk(buf.data());
-            i = 0;
+            __m128i wk = _mm_add_epi32(
+                w, _mm_loadu_si128(
+                       reinterpret_cast<const __m128i*>(&sha256_k[i * 4])));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+            wk = _mm_shuffle_epi32(wk, 0x0e);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, wk);
         }
 
-        while (i < chunk_bytes - 8) {
-            buf[i++] = 0;
+        state0 = _mm_add_epi32(state0, abef_save);
+        state1 = _mm_add_epi32(state1, cdgh_save);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1b);       // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xb1);    // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xf0); // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);    // HGFE
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), state1);
+}
+
+inline bool
+cpu_has_sha_ni()
+{
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+
+    return (ebx & (1u << 29)) && __builtin_cpu_supports("sse4.1");
+}
+
+inline bool
+cpu_has_avx2()
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+// Picks the fastest block function supported by the running CPU. The choice
+// is made once, the SHA_NI result is identical to the portable one.
+inline sha256_compress_fn
+sha256_compress()
+{
+    static const sha256_compress_fn fn = [] {
+#if SHA2_X86_DISPATCH
+        if (cpu_has_sha_ni()) {
+            return &sha256_compress_shani;
         }
+#endif
+        return &sha256_compress_portable;
+    }();
 
-        write_u64(&buf[i], bit_length);
+    return fn;
+}
 
-        chunk(buf.data());
+// Name of the implementation used by sha256() and sha256_batch(), for logs.
+inline const char*
+sha256_implementation()
+{
+#if SHA2_X86_DISPATCH
+    if (sha256_compress() == &sha256_compress_shani) {
+        return "sha-ni";
+    }
+
+    if (cpu_has_avx2()) {
+        return "portable (avx2 x8 batch)";
+    }
+#endif
+    return "portable";
+}
+
+// Writes the final padded block(s) of a message whose unprocessed tail is
+// `length % 64` bytes long. Returns the number of blocks written (1 or 2).
+inline size_t
+sha256_pad_tail(uint8_t* buf, const uint8_t* tail, uint64_t length)
+{
+    constexpr size_t chunk_bytes = 64;
+    const size_t rest = length % chunk_bytes;
+    const size_t blocks = rest + 9 > chunk_bytes ? 2 : 1;
+
+    if (rest) {
+        memcpy(buf, tail, rest);
     }
 
+    buf[rest] = 0x80;
+    memset(buf + rest + 1, 0, blocks * chunk_bytes - 8 - rest - 1);
+    write_u64(buf + blocks * chunk_bytes - 8, length * 8);
+
+    return blocks;
+}
+
+// Both sha256_impl and sha512_impl are used by sha224/sha256 and
+// sha384/sha512 respectively, avoiding duplication as only the initial hash
+// values (s) and output hash length change.
+inline sha256_hash
+sha256_impl(const uint32_t* s, const uint8_t* data, uint64_t length)
+{
+    static_assert(sizeof(uint32_t) == 4, "sizeof(uint32_t) must be 4");
+    static_assert(sizeof(uint64_t) == 8, "sizeof(uint64_t) must be 8");
+
+    constexpr size_t chunk_bytes = 64;
+    const sha256_compress_fn compress = sha256_compress();
+
+    uint32_t hash[8] = {s[0], s[1], s[2], s[3], s[4], s[5], s[6], s[7]};
+
+    const size_t full_blocks = length / chunk_bytes;
+    compress(hash, data, full_blocks);
+
+    uint8_t buf[chunk_bytes * 2];
+    const size_t tail_blocks =
+        sha256_pad_tail(buf, data + full_blocks * chunk_bytes, length);
+    compress(hash, buf, tail_blocks);
+
     sha256_hash result;
 
     for (uint8_t i = 0; i != 8; ++i) {
@@ -356,18 +498,200 @@ sha224(const uint8_t* data, uint64_t length)
 inline sha256_hash
 sha256(const uint8_t* data, uint64_t length)
 {
-    // First 32 bits of the fractional parts of the square roots of the first
-    // eight primes 2..19:
-    const uint32_t initial_hash_values[8] = {0x6a09e667,
-                                             0xbb67ae85,
-                                             0x3c6ef372,
-                                             0xa54ff53a,
-                                             0x510e527f,
-                                             0x9b05688c,
-                                             0x1f83d9ab,
-                                             0x5be0cd19};
-
-    return sha256_impl(initial_hash_values, data, length);
+    return sha256_impl(sha256_initial_hash_values, data, length);
+}
+
+#if SHA2_X86_DISPATCH
+
+__attribute__((target("avx2"))) inline __m256i
+ror8(__m256i x, int n)
+{
+    return _mm256_or_si256(_mm256_srli_epi32(x, n),
+                           _mm256_slli_epi32(x, 32 - n));
+}
+
+// Eight independent messages, one per 32 bit lane. state is [word][lane],
+// blocks holds one 64 byte block per lane.
+__attribute__((target("avx2"))) inline void
+sha256_compress_x8_avx2(uint32_t (*state)[8], const uint8_t* const* blocks)
+{
+    alignas(32) uint32_t words[16][8];
+
+    for (int lane = 0; lane != 8; ++lane) {
+        for (int i = 0; i != 16; ++i) {
+            words[i][lane] = read_u32(&blocks[lane][i * 4]);
+        }
+    }
+
+    __m256i w[16];
+    for (int i = 0; i != 16; ++i) {
+        w[i] = _mm256_load_si256(reinterpret_cast<const __m256i*>(words[i]));
+    }
+
+    __m256i v[8];
+    for (int i = 0; i != 8; ++i) {
+        v[i] = _mm256_load_si256(reinterpret_cast<const __m256i*>(state[i]));
+    }
+
+    auto a = v[0], b = v[1], c = v[2], d = v[3];
+    auto e = v[4], f = v[5], g = v[6], h = v[7];
+
+    for (int i = 0; i != 64; ++i) {
+        __m256i wi;
+
+        if (i < 16) {
+            wi = w[i];
+        } else {
+            auto w15 = w[(i - 15) & 15];
+            auto w2 = w[(i - 2) & 15];
+            auto s0 = _mm256_xor_si256(
+                _mm256_xor_si256(ror8(w15, 7), ror8(w15, 18)),
+                _mm256_srli_epi32(w15, 3));
+            auto s1 = _mm256_xor_si256(
+                _mm256_xor_si256(ror8(w2, 17), ror8(w2, 19)),
+                _mm256_srli_epi32(w2, 10));
+            wi = _mm256_add_epi32(
+                _mm256_add_epi32(w[i & 15], s0),
+                _mm256_add_epi32(w[(i - 7) & 15], s1));
+            w[i & 15] = wi;
+        }
+
+        auto s1 = _mm256_xor_si256(_mm256_xor_si256(ror8(e, 6), ror8(e, 11)),
+                                   ror8(e, 25));
+        auto ch = _mm256_xor_si256(_mm256_and_si256(e, f),
+                                   _mm256_andnot_si256(e, g));
+        auto temp1 = _mm256_add_epi32(
+            _mm256_add_epi32(h, s1),
+            _mm256_add_epi32(
+                ch, _mm256_add_epi32(
+                        wi, _mm256_set1_epi32(static_cast<int>(sha256_k[i])))));
+        auto s0 = _mm256_xor_si256(_mm256_xor_si256(ror8(a, 2), ror8(a, 13)),
+                                   ror8(a, 22));
+        auto maj = _mm256_xor_si256(
+            _mm256_and_si256(a, b),
+            _mm256_and_si256(c, _mm256_xor_si256(a, b)));
+        auto temp2 = _mm256_add_epi32(s0, maj);
+
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, temp1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(temp1, temp2);
+    }
+
+    const __m256i out[8] = {a, b, c, d, e, f, g, h};
+    for (int i = 0; i != 8; ++i) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(state[i]),
+                           _mm256_add_epi32(v[i], out[i]));
+    }
+}
+
+// Multi-buffer hashing: each lane walks its own message and takes the next
+// one from the batch as soon as it finishes, so lengths may differ freely.
+inline void
+sha256_batch_avx2(const uint8_t* const* data, const uint64_t* lengths,
+                  sha256_hash* out, size_t count)
+{
+    constexpr size_t lanes = 8;
+
+    struct lane_t {
+        size_t message;
+        uint64_t block;
+        uint64_t full_blocks;
+        uint64_t blocks;
+        uint8_t tail[128];
+    };
+
+    alignas(32) uint32_t state[8][8];
+    lane_t lane[lanes];
+    bool active[lanes] = {false};
+    const uint8_t* block_ptr[lanes];
+    const uint8_t zero_block[64] = {0};
+
+    size_t next = 0;
+    size_t running = 0;
+
+    auto start = [&](size_t l) {
+        if (next == count) {
+            active[l] = false;
+            return;
+        }
+
+        lane_t& ln = lane[l];
+        ln.message = next++;
+        ln.block = 0;
+        ln.full_blocks = lengths[ln.message] / 64;
+        ln.blocks = ln.full_blocks +
+                    sha256_pad_tail(ln.tail,
+                                    data[ln.message] + ln.full_blocks * 64,
+                                    lengths[ln.message]);
+
+        for (int i = 0; i != 8; ++i) {
+            state[i][l] = sha256_initial_hash_values[i];
+        }
+
+        active[l] = true;
+        running++;
+    };
+
+    for (size_t l = 0; l != lanes; ++l) {
+        start(l);
+    }
+
+    while (running) {
+        for (size_t l = 0; l != lanes; ++l) {
+            if (!active[l]) {
+                block_ptr[l] = zero_block;
+            } else if (lane[l].block < lane[l].full_blocks) {
+                block_ptr[l] = data[lane[l].message] + lane[l].block * 64;
+            } else {
+                block_ptr[l] =
+                    lane[l].tail + (lane[l].block - lane[l].full_blocks) * 64;
+            }
+        }
+
+        sha256_compress_x8_avx2(state, block_ptr);
+
+        for (size_t l = 0; l != lanes; ++l) {
+            if (!active[l] || ++lane[l].block != lane[l].blocks) {
+                continue;
+            }
+
+            for (uint8_t i = 0; i != 8; ++i) {
+                write_u32(&out[lane[l].message][i * 4], state[i][l]);
+            }
+
+            running--;
+            start(l);
+        }
+    }
+}
+
+#endif
+
+// Hashes `count` independent messages. Many small resources are processed in
+// parallel lanes when the CPU has AVX2 but no SHA extensions; with SHA_NI a
+// plain loop is already faster.
+inline void
+sha256_batch(const uint8_t* const* data, const uint64_t* lengths,
+             sha256_hash* out, size_t count)
+{
+#if SHA2_X86_DISPATCH
+    static const bool use_avx2 =
+        sha256_compress() != &sha256_compress_shani && cpu_has_avx2();
+
+    if (use_avx2 && count > 1) {
+        sha256_batch_avx2(data, lengths, out, count);
+        return;
+    }
+#endif
+
+    for (size_t i = 0; i != count; ++i) {
+        out[i] = sha256(data[i], lengths[i]);
+    }
 }
 
 inline sha384_hash
@@ -0,0 +1,130 @@
+#include "Test.hpp"
+#include "Server/RegionPrefetch.hpp"
+
+/*
+    RegionPrefetch без сервера: учёт попаданий, опозданий и промахов,
+    истечение готовых и зависших запросов и предел очереди
+*/
+
+using LV::Server::RegionPrefetch;
+using LV::Pos::GlobalRegion;
+
+namespace {
+
+constexpr LV::WorldId_t WORLD = 0;
+
+void testHit() {
+    RegionPrefetch prefetch;
+    GlobalRegion pos(1, 0, 2);
+
+    LV_CHECK(prefetch.request(WORLD, pos, 10));
+    // Повторный запрос того же региона не учитывается
+    LV_CHECK(!prefetch.request(WORLD, pos, 11));
+    LV_CHECK(prefetch.isPending(WORLD, pos) && prefetch.pendingCount() == 1);
+
+    prefetch.onLoaded(WORLD, pos, 20);
+    LV_CHECK(!prefetch.isPending(WORLD, pos) && prefetch.pendingCount() == 0);
+
+    LV_CHECK(!prefetch.onVisible(WORLD, pos, true));
+    const RegionPrefetch::Metrics& metrics = prefetch.metrics();
+    LV_CHECK(metrics.Requested == 1 && metrics.Hits == 1 && metrics.Late == 0 && metrics.Wasted == 0);
+    LV_CHECK(prefetch.hitRate() == 1.0);
+
+    // Запись закрыта, повторная видимость ничего не меняет
+    LV_CHECK(!prefetch.onVisible(WORLD, pos, true));
+    LV_CHECK(prefetch.metrics().Hits == 1);
+}
+
+void testLate() {
+    RegionPrefetch prefetch;
+    GlobalRegion pos(-3, 1, 0);
+
+    LV_CHECK(prefetch.request(WORLD, pos, 0));
+
+    // Опоздание отмечается один раз, регион остаётся в ожидании
+    LV_CHECK(prefetch.onVisible(WORLD, pos, false));
+    LV_CHECK(!prefetch.onVisible(WORLD, pos, false));
+    LV_CHECK(prefetch.isPending(WORLD, pos) && prefetch.isLate(WORLD, pos));
+    LV_CHECK(prefetch.metrics().Late == 1);
+
+    prefetch.onLoaded(WORLD, pos, 5);
+    LV_CHECK(!prefetch.isPending(WORLD, pos) && !prefetch.isLate(WORLD, pos));
+    LV_CHECK(prefetch.pendingCount() == 0);
+
+    // Дальше регион обычный наблюдаемый, запрос принимается заново
+    LV_CHECK(prefetch.request(WORLD, pos, 6));
+    LV_CHECK(prefetch.metrics().Hits == 0 && prefetch.metrics().Wasted == 0);
+    LV_CHECK(prefetch.hitRate() == 0.0);
+}
+
+void testWasted() {
+    RegionPrefetch prefetch;
+    GlobalRegion pos(0, 0, 0);
+
+    // Готовый регион, выгруженный до прихода игрока
+    LV_CHECK(prefetch.request(WORLD, pos, 0));
+    prefetch.onLoaded(WORLD, pos, 1);
+    LV_CHECK(!prefetch.onVisible(WORLD, pos, false));
+    LV_CHECK(prefetch.metrics().Wasted == 1 && prefetch.metrics().Hits == 0);
+
+    // Видимость незапрошенного региона не учитывается
+    LV_CHECK(!prefetch.onVisible(WORLD, GlobalRegion(5, 5, 5), true));
+    LV_CHECK(!prefetch.onVisible(WORLD + 1, pos, true));
+    LV_CHECK(prefetch.metrics().Hits == 0 && prefetch.metrics().Late == 0);
+}
+
+void testExpire() {
+    RegionPrefetch prefetch;
+    GlobalRegion ready(1, 0, 0), pending(2, 0, 0), late(3, 0, 0);
+
+    LV_CHECK(prefetch.request(WORLD, ready, 0));
+    LV_CHECK(prefetch.request(WORLD, pending, 0));
+    LV_CHECK(prefetch.request(WORLD, late, 0));
+    prefetch.onLoaded(WORLD, ready, 100);
+    LV_CHECK(prefetch.onVisible(WORLD, late, false));
+    LV_CHECK(prefetch.pendingCount() == 2);
+
+    // Готовый живёт TTL_TICKS от такта готовности
+    prefetch.expire(100 + RegionPrefetch::TTL_TICKS);
+    LV_CHECK(prefetch.metrics().Wasted == 0);
+    prefetch.expire(100 + RegionPrefetch::TTL_TICKS + 1);
+    LV_CHECK(prefetch.metrics().Wasted == 1);
+    LV_CHECK(prefetch.isPending(WORLD, pending) && prefetch.isPending(WORLD, late));
+
+    // Зависшие снимаются по PENDING_TIMEOUT_TICKS, опоздавший уже учтён в Late
+    prefetch.expire(RegionPrefetch::PENDING_TIMEOUT_TICKS + 1);
+    LV_CHECK(!prefetch.isPending(WORLD, pending) && !prefetch.isPending(WORLD, late));
+    LV_CHECK(prefetch.pendingCount() == 0);
+
+    const RegionPrefetch::Metrics& metrics = prefetch.metrics();
+    LV_CHECK(metrics.Requested == 3 && metrics.Hits == 0 && metrics.Late == 1 && metrics.Wasted == 2);
+
+    // Загрузка после снятия с учёта ничего не меняет
+    prefetch.onLoaded(WORLD, pending, RegionPrefetch::PENDING_TIMEOUT_TICKS + 2);
+    LV_CHECK(prefetch.pendingCount() == 0 && prefetch.metrics().Wasted == 2);
+}
+
+void testLimit() {
+    RegionPrefetch prefetch;
+
+    for(size_t iter = 0; iter < RegionPrefetch::MAX_PENDING; iter++)
+        LV_CHECK(prefetch.request(WORLD, GlobalRegion(int(iter), 0, 0), 0));
+
+    LV_CHECK(!prefetch.request(WORLD, GlobalRegion(-1, 0, 0), 0));
+    LV_CHECK(prefetch.pendingCount() == RegionPrefetch::MAX_PENDING);
+
+    // Готовые регионы место в очереди не занимают
+    prefetch.onLoaded(WORLD, GlobalRegion(0, 0, 0), 1);
+    LV_CHECK(prefetch.request(WORLD, GlobalRegion(-1, 0, 0), 1));
+    LV_CHECK(prefetch.metrics().Requested == RegionPrefetch::MAX_PENDING + 1);
+}
+
+}
+
+int main() {
+    testHit();
+    testLate();
+    testWasted();
+    testExpire();
+    testLimit();
+}
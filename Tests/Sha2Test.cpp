@@ -0,0 +1,127 @@
+#include "Test.hpp"
+#include "sha2.hpp"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+    SHA-256: эталонные значения FIPS 180-2 и совпадение ускоренных путей (SHA_NI, AVX2 x8)
+    с переносимым на сообщениях всех длин около границ блока.
+    Ускоренные пути проверяются, только если их поддерживает процессор
+*/
+
+namespace {
+
+std::string hex(const sha2::sha256_hash& hash) {
+    static constexpr char digits[] = "0123456789abcdef";
+    std::string out;
+    for(uint8_t byte : hash) {
+        out += digits[byte >> 4];
+        out += digits[byte & 15];
+    }
+
+    return out;
+}
+
+sha2::sha256_hash hashString(std::string_view text) {
+    return sha2::sha256(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+}
+
+// То же, что sha256_impl, но с заданной функцией сжатия
+sha2::sha256_hash hashWith(sha2::sha256_compress_fn compress, const uint8_t* data, uint64_t length) {
+    uint32_t state[8];
+    std::copy_n(sha2::sha256_initial_hash_values, 8, state);
+
+    const size_t full = length / 64;
+    compress(state, data, full);
+
+    uint8_t tail[128];
+    compress(state, tail, sha2::sha256_pad_tail(tail, data + full * 64, length));
+
+    sha2::sha256_hash out;
+    for(int iter = 0; iter < 8; iter++)
+        sha2::write_u32(&out[iter * 4], state[iter]);
+
+    return out;
+}
+
+void testKnownAnswers() {
+    LV_CHECK(hex(hashString("")) == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    LV_CHECK(hex(hashString("abc")) == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    LV_CHECK(hex(hashString("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"))
+        == "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+
+    // Переносимый путь отдельно, sha256() может идти через SHA_NI
+    const std::string_view abc = "abc";
+    LV_CHECK(hex(hashWith(&sha2::sha256_compress_portable, reinterpret_cast<const uint8_t*>(abc.data()), abc.size()))
+        == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+
+    std::string million(1000000, 'a');
+    LV_CHECK(hex(hashString(million)) == "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+void testAcceleratedPaths() {
+    std::mt19937 rng(29);
+    std::vector<uint8_t> data(4096);
+    for(uint8_t& byte : data)
+        byte = rng();
+
+    // Длины вокруг границ блока и заполнения (55, 56, 63, 64, 119, 120 ...)
+    std::vector<uint64_t> lengths;
+    for(uint64_t length = 0; length <= 300; length++)
+        lengths.push_back(length);
+    for(int iter = 0; iter < 64; iter++)
+        lengths.push_back(rng() % data.size());
+
+    std::vector<sha2::sha256_hash> expected;
+    for(uint64_t length : lengths)
+        expected.push_back(hashWith(&sha2::sha256_compress_portable, data.data(), length));
+
+    // sha256() использует выбранную при запуске реализацию
+    for(size_t iter = 0; iter < lengths.size(); iter++)
+        LV_CHECK(sha2::sha256(data.data(), lengths[iter]) == expected[iter]);
+
+    // Пакет: невыровненные начала, у каждого сообщения своё
+    std::vector<const uint8_t*> pointers(lengths.size());
+    std::vector<uint64_t> clamped(lengths.size());
+    std::vector<sha2::sha256_hash> shifted;
+    for(size_t iter = 0; iter < lengths.size(); iter++) {
+        pointers[iter] = data.data() + (iter * 7) % 64;
+        clamped[iter] = std::min<uint64_t>(lengths[iter], data.size() - 64);
+        shifted.push_back(hashWith(&sha2::sha256_compress_portable, pointers[iter], clamped[iter]));
+    }
+
+    std::vector<sha2::sha256_hash> batch(lengths.size());
+    sha2::sha256_batch(pointers.data(), clamped.data(), batch.data(), batch.size());
+    LV_CHECK(batch == shifted);
+
+#if SHA2_X86_DISPATCH
+    if(sha2::cpu_has_sha_ni()) {
+        for(size_t iter = 0; iter < lengths.size(); iter++)
+            LV_CHECK(hashWith(&sha2::sha256_compress_shani, data.data(), lengths[iter]) == expected[iter]);
+    } else {
+        std::printf("SHA_NI не поддерживается, путь не проверен\n");
+    }
+
+    if(sha2::cpu_has_avx2()) {
+        // Пакеты разного размера: неполные, ровно 8 полос и с перезапуском полос
+        for(size_t count : {size_t(1), size_t(3), size_t(8), size_t(9), lengths.size()}) {
+            std::vector<sha2::sha256_hash> lanes(count);
+            sha2::sha256_batch_avx2(pointers.data(), clamped.data(), lanes.data(), count);
+            LV_CHECK(std::equal(lanes.begin(), lanes.end(), shifted.begin()));
+        }
+    } else {
+        std::printf("AVX2 не поддерживается, путь не проверен\n");
+    }
+#endif
+}
+
+}
+
+int main() {
+    testKnownAnswers();
+    testAcceleratedPaths();
+}
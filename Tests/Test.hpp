@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+
+/*
+    Проверки работают и в сборках с NDEBUG, в отличие от assert.
+    Каждая проверка - отдельная программа, первая же ошибка завершает её с ненулевым кодом
+*/
+#define LV_CHECK(cond) \
+    do { \
+        if(!(cond)) { \
+            std::fprintf(stderr, "%s:%d: не выполнено: %s\n", __FILE__, __LINE__, #cond); \
+            std::abort(); \
+        } \
+    } while(false)
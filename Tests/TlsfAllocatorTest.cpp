@@ -0,0 +1,214 @@
+#include "Test.hpp"
+#include "Client/Vulkan/TlsfAllocator.hpp"
+
+#include <map>
+#include <random>
+
+/*
+    TlsfAllocator без устройства: разбиение и слияние блоков, исчерпание,
+    дефрагментация с проверкой содержимого и жизненный цикл переносов как в VertexPool
+*/
+
+using LV::Client::VK::TlsfAllocator;
+
+namespace {
+
+void testSplitMerge() {
+    TlsfAllocator allocator(100);
+    LV_CHECK(allocator.freeBlocks() == 1 && allocator.largestFree() == 100);
+
+    uint32_t a = *allocator.allocate(10);
+    uint32_t b = *allocator.allocate(20);
+    uint32_t c = *allocator.allocate(30);
+
+    // Блоки нарезаются подряд с начала, остаток - один свободный блок
+    LV_CHECK(allocator.offset(a) == 0 && allocator.size(a) == 10);
+    LV_CHECK(allocator.offset(b) == 10 && allocator.size(b) == 20);
+    LV_CHECK(allocator.offset(c) == 30 && allocator.size(c) == 30);
+    LV_CHECK(allocator.used() == 60 && allocator.freeBlocks() == 1 && allocator.largestFree() == 40);
+
+    allocator.free(b);
+    LV_CHECK(allocator.freeBlocks() == 2 && allocator.used() == 40);
+
+    // Слияние с правым свободным соседом
+    allocator.free(a);
+    LV_CHECK(allocator.freeBlocks() == 2 && allocator.largestFree() == 40);
+
+    // Слияние с обеих сторон собирает весь диапазон
+    allocator.free(c);
+    LV_CHECK(allocator.freeBlocks() == 1 && allocator.largestFree() == 100);
+    LV_CHECK(allocator.used() == 0 && allocator.allocations() == 0);
+}
+
+void testExhaustion() {
+    TlsfAllocator allocator(64);
+    LV_CHECK(!allocator.allocate(0));
+    LV_CHECK(!allocator.allocate(65));
+
+    uint32_t all = *allocator.allocate(64);
+    LV_CHECK(allocator.largestFree() == 0 && allocator.freeBlocks() == 0);
+    LV_CHECK(!allocator.allocate(1));
+
+    // Идентификатор освобождённого выделения выдаётся снова
+    allocator.free(all);
+    LV_CHECK(*allocator.allocate(1) == all);
+}
+
+void testDefragment() {
+    constexpr uint32_t CAPACITY = 64, SIZE = 4, COUNT = CAPACITY / SIZE;
+    TlsfAllocator allocator(CAPACITY);
+
+    // Содержимое диапазона: в каждой ячейке номер выделения
+    std::vector<uint32_t> memory(CAPACITY, ~0u);
+    std::vector<uint32_t> ids;
+    for(uint32_t iter = 0; iter < COUNT; iter++) {
+        uint32_t id = *allocator.allocate(SIZE);
+        std::fill_n(memory.begin() + allocator.offset(id), SIZE, id);
+        ids.push_back(id);
+    }
+
+    for(uint32_t iter = 0; iter < COUNT; iter += 2)
+        allocator.free(ids[iter]);
+
+    LV_CHECK(allocator.freeBlocks() == COUNT / 2 && allocator.largestFree() == SIZE);
+    LV_CHECK(allocator.fragmented(4, 0.5f));
+    LV_CHECK(!allocator.fragmented(COUNT, 0.5f));
+
+    // Бюджет ограничивает объём переносов
+    {
+        TlsfAllocator copy = allocator;
+        std::vector<TlsfAllocator::Move> moves = copy.defragment(SIZE, [](uint32_t) { return true; });
+        LV_CHECK(moves.size() == 1);
+    }
+
+    // Выделение, которое нельзя трогать, остаётся на месте
+    uint32_t pinned = ids[COUNT - 1];
+    uint32_t pinnedOffset = allocator.offset(pinned);
+
+    std::vector<TlsfAllocator::Move> moves = allocator.defragment(CAPACITY, [&](uint32_t id) { return id != pinned; });
+    LV_CHECK(!moves.empty());
+    LV_CHECK(allocator.offset(pinned) == pinnedOffset);
+
+    for(const TlsfAllocator::Move& move : moves) {
+        LV_CHECK(move.DstOffset < move.SrcOffset && move.Size == SIZE);
+        LV_CHECK(allocator.offset(move.AllocId) == move.DstOffset);
+        std::copy_n(memory.begin() + move.SrcOffset, move.Size, memory.begin() + move.DstOffset);
+    }
+
+    // Старые места заняты, пока их не отпустят
+    LV_CHECK(allocator.used() == (COUNT / 2 + moves.size()) * SIZE);
+    for(const TlsfAllocator::Move& move : moves)
+        allocator.releaseBlock(move.OldBlock);
+
+    LV_CHECK(allocator.used() == COUNT / 2 * SIZE);
+    for(uint32_t iter = 1; iter < COUNT; iter += 2) {
+        uint32_t id = ids[iter];
+        for(uint32_t cell = 0; cell < SIZE; cell++)
+            LV_CHECK(memory[allocator.offset(id) + cell] == id);
+    }
+
+    // Без закреплённого выделения всё сжимается к началу одним проходом
+    moves = allocator.defragment(CAPACITY, [](uint32_t) { return true; });
+    for(const TlsfAllocator::Move& move : moves)
+        allocator.releaseBlock(move.OldBlock);
+
+    LV_CHECK(allocator.freeBlocks() == 1 && allocator.largestFree() == CAPACITY - allocator.used());
+    LV_CHECK(!allocator.fragmented(1, 0.5f));
+}
+
+// Порядок вызовов VertexPool: перенос, новые выделения в том же кадре, освобождение старых мест после кадра
+void testPoolFrame() {
+    TlsfAllocator allocator(1024);
+    std::vector<uint32_t> ids;
+    for(uint32_t iter = 0; iter < 64; iter++)
+        ids.push_back(*allocator.allocate(16));
+
+    for(uint32_t iter = 0; iter < 64; iter += 2)
+        allocator.free(ids[iter]);
+
+    std::vector<TlsfAllocator::Move> moves = allocator.defragment(~0u, [](uint32_t) { return true; });
+    LV_CHECK(!moves.empty());
+
+    // Старые места не выдаются, пока кадр не завершён
+    std::vector<uint32_t> fresh;
+    while(std::optional<uint32_t> id = allocator.allocate(16))
+        fresh.push_back(*id);
+
+    for(uint32_t id : fresh)
+        for(const TlsfAllocator::Move& move : moves)
+            LV_CHECK(allocator.offset(id) + 16 <= move.SrcOffset || allocator.offset(id) >= move.SrcOffset + move.Size);
+
+    for(const TlsfAllocator::Move& move : moves)
+        allocator.releaseBlock(move.OldBlock);
+
+    LV_CHECK(allocator.allocations() == 32 + fresh.size());
+    LV_CHECK(allocator.used() == allocator.allocations() * 16);
+}
+
+// Случайные выделения и освобождения против простой модели: живые выделения не пересекаются
+void testRandom() {
+    constexpr uint32_t CAPACITY = 1 << 16;
+    TlsfAllocator allocator(CAPACITY);
+    std::mt19937 rng(3);
+    std::map<uint32_t, uint32_t> live;
+    uint64_t used = 0;
+
+    auto verify = [&]() {
+        std::map<uint32_t, uint32_t> byOffset;
+        for(const auto& [id, size] : live) {
+            LV_CHECK(allocator.size(id) == size);
+            byOffset[allocator.offset(id)] = size;
+        }
+
+        uint32_t end = 0;
+        for(const auto& [offset, size] : byOffset) {
+            LV_CHECK(offset >= end);
+            end = offset + size;
+        }
+
+        LV_CHECK(end <= CAPACITY);
+        LV_CHECK(allocator.used() == used && allocator.allocations() == live.size());
+    };
+
+    for(int step = 0; step < 200000; step++) {
+        if(live.empty() || rng() % 3) {
+            uint32_t size = 1 + (rng() % 4 ? rng() % 64 : rng() % 4096);
+            if(std::optional<uint32_t> id = allocator.allocate(size)) {
+                LV_CHECK(!live.contains(*id));
+                live[*id] = size;
+                used += size;
+            }
+        } else {
+            auto iter = live.begin();
+            std::advance(iter, rng() % live.size());
+            used -= iter->second;
+            allocator.free(iter->first);
+            live.erase(iter);
+        }
+
+        if(step % 1000 == 0) {
+            verify();
+
+            std::vector<TlsfAllocator::Move> moves = allocator.defragment(1024, [](uint32_t) { return true; });
+            for(const TlsfAllocator::Move& move : moves)
+                allocator.releaseBlock(move.OldBlock);
+
+            verify();
+        }
+    }
+
+    for(const auto& [id, size] : live)
+        allocator.free(id);
+
+    LV_CHECK(allocator.used() == 0 && allocator.freeBlocks() == 1 && allocator.largestFree() == CAPACITY);
+}
+
+}
+
+int main() {
+    testSplitMerge();
+    testExhaustion();
+    testDefragment();
+    testPoolFrame();
+    testRandom();
+}